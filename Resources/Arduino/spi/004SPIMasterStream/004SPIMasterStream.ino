@@ -0,0 +1,50 @@
+/* SPI Master Stream Demo
+
+ *
+ * Streams blocks of incrementing bytes to the STM32 SPI2 slave
+ * (019spi_slave_pingpong.c) at the fastest SPI clock (16MHz/2 = 8MHz).
+ * SS is released after every block, block lengths vary so that
+ * buffers are handed over both on NSS and on buffer full.
+ *
+ * SPI pin numbers:
+ * SCK   13  // Serial Clock.
+ * MISO  12  // Master In Slave Out.
+ * MOSI  11  // Master Out Slave In.
+ * SS    10  // Slave Select
+ *
+ 
+ */
+#include <SPI.h>
+#include<stdint.h>
+
+uint8_t counter = 0;
+uint16_t blockLen = 1;
+
+void setup()
+{
+  // Initialize serial communication 
+  Serial.begin(9600);
+
+  pinMode(SS, OUTPUT);
+  digitalWrite(SS, HIGH);
+
+  SPI.begin();
+  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+
+  Serial.println("Master Initialized");
+}
+
+void loop()
+{
+  digitalWrite(SS, LOW);
+
+  for(uint16_t i = 0 ; i < blockLen ; i++)
+  {
+    SPI.transfer(counter++);
+  }
+
+  digitalWrite(SS, HIGH);
+
+  //37 .. 1036 bytes per block
+  blockLen = (blockLen % 1000) + 37;
+}
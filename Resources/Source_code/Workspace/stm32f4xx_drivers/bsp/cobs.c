@@ -0,0 +1,364 @@
+/*
+ * cobs.c
+ *
+ * COBS packet framing with a CRC-16 over the USART rings, see cobs.h
+ */
+
+#include<string.h>
+#include "cobs.h"
+
+#define COBS_DELIMITER		0x00
+#define COBS_BLOCK_MAX		0xFF		/* code of a block of 254 data bytes, no 0x00 after it */
+
+static void cobs_emit(COBS_Link_t *pLink, uint8_t *pBuffer, uint32_t Mask, uint8_t Byte);
+static void cobs_end_of_frame(COBS_Link_t *pLink, USART_Ring_t *pRing);
+static void cobs_rx_reset(COBS_Link_t *pLink, uint32_t Index);
+
+/*
+ * CRC-16/CCITT, poly 0x1021, MSB first
+ */
+static const uint16_t cobs_crc_table[256] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+	0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+	0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+	0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+	0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+	0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+	0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+	0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+	0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+	0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+	0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+	0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+	0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+	0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+	0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+	0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+	0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+	0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+	0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+	0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+	0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+
+/*********************************************************************
+ * @fn      		  - cobs_init
+ *
+ * @brief             - binds a link to a USART and resets its decoder and stats
+ *
+ * @param[in]         - link
+ * @param[in]         - USART handle, its Tx and Rx rings must be attached (USART_AttachRings)
+ * @param[in]         - buffer for the frames which wrap around the end of the Rx ring, may be NULL
+ * @param[in]         - size of that buffer
+ *
+ * @return            - none
+ *
+ * @Note              - Frames are decoded in place in the Rx ring, so the ring must hold the
+ * 						largest encoded frame plus what arrives while it is handled. A frame
+ * 						which wraps around the end of the storage is copied once to pFrame
+ * 						to give the callback a contiguous payload
+
+ */
+void cobs_init(COBS_Link_t *pLink, USART_Handle_t *pUSARTHandle, uint8_t *pFrame, uint32_t FrameSize)
+{
+	pLink->pUSARTHandle = pUSARTHandle;
+	pLink->pFrame = pFrame;
+	pLink->FrameSize = pFrame ? FrameSize : 0;
+
+	pLink->Frames = 0;
+	pLink->CRCErrors = 0;
+	pLink->FormatErrors = 0;
+	pLink->Oversize = 0;
+	pLink->TxFull = 0;
+
+	//start decoding at the first byte not read yet
+	cobs_rx_reset(pLink,pUSARTHandle->pRxRing->Tail);
+	pLink->Skip = RESET;
+}
+
+
+/*********************************************************************
+ * @fn      		  - cobs_send
+ *
+ * @brief             - queues one frame : payload, CRC and delimiter, COBS encoded
+ *
+ * @param[in]         - link
+ * @param[in]         - payload, any byte values
+ * @param[in]         - payload length
+ *
+ * @return            - COBS_OK, or COBS_ERR_FULL if the Tx ring has less than
+ * 						COBS_ENCODED_MAX(Len) free bytes (nothing is queued then)
+ *
+ * @Note              - The frame is encoded straight in to the Tx ring storage, each code byte
+ * 						is patched in once its block is complete, and the whole frame is
+ * 						committed at once : the ISR never sends a partial frame. Never waits
+
+ */
+uint8_t cobs_send(COBS_Link_t *pLink, const uint8_t *pPayload, uint32_t Len)
+{
+	USART_Ring_t *pRing = pLink->pUSARTHandle->pTxRing;
+	uint8_t *pBuffer = pRing->pBuffer;
+	uint32_t mask = pRing->Size - 1;
+	uint32_t head = pRing->Head;
+	uint32_t code_at, out;
+	uint16_t crc;
+	uint8_t code, byte;
+	uint8_t trailer[2];
+
+	//1. room for the worst case, checked up front so a frame is queued whole or not at all
+	if(COBS_ENCODED_MAX(Len) > pRing->Size - (head - pRing->Tail))
+	{
+		pLink->TxFull++;
+		return COBS_ERR_FULL;
+	}
+
+	//2. the CRC goes after the payload, high byte first
+	crc = cobs_crc16(COBS_CRC_INIT,pPayload,Len);
+	trailer[0] = (uint8_t)(crc >> 8);
+	trailer[1] = (uint8_t)crc;
+
+	//3. encode, a block is its code byte (data bytes + 1) followed by the non zero bytes
+	code_at = head;
+	out = head + 1;
+	code = 1;
+
+	for(uint32_t i = 0 ; i < Len + 2 ; i++)
+	{
+		byte = (i < Len) ? pPayload[i] : trailer[i - Len];
+
+		if(byte == COBS_DELIMITER)
+		{
+			//the 0x00 is implied by the end of the block
+			pBuffer[code_at & mask] = code;
+			code_at = out++;
+			code = 1;
+		}else
+		{
+			pBuffer[out++ & mask] = byte;
+			code++;
+
+			if(code == COBS_BLOCK_MAX)
+			{
+				pBuffer[code_at & mask] = code;
+				code_at = out++;
+				code = 1;
+			}
+		}
+	}
+
+	pBuffer[code_at & mask] = code;
+	pBuffer[out++ & mask] = COBS_DELIMITER;
+
+	//4. hand the frame to the ISR
+	USART_WriteCommit(pLink->pUSARTHandle,out - head);
+
+	return COBS_OK;
+}
+
+
+/*********************************************************************
+ * @fn      		  - cobs_poll
+ *
+ * @brief             - decodes what the Rx ring received and delivers the complete frames
+ *
+ * @param[in]         - link
+ *
+ * @return            - none
+ *
+ * @Note              - Call it from the main loop. Every byte is decoded once, in place : the
+ * 						output never overtakes the input, so the payload ends up at the start
+ * 						of the frame in the ring and the CRC is checked on the fly. The ring
+ * 						space is released only after cobs_frame_callback returns.
+ * 						A frame which fills the Rx ring without a delimiter is dropped and the
+ * 						decoder skips to the next delimiter
+
+ */
+void cobs_poll(COBS_Link_t *pLink)
+{
+	USART_Ring_t *pRing = pLink->pUSARTHandle->pRxRing;
+	uint8_t *pBuffer = pRing->pBuffer;
+	uint32_t mask = pRing->Size - 1;
+	uint32_t head = pRing->Head;
+	uint8_t byte;
+
+	//Head is read before the bytes behind it
+	COMPILER_BARRIER();
+
+	while(pLink->Read != head)
+	{
+		byte = pBuffer[pLink->Read++ & mask];
+
+		if(byte == COBS_DELIMITER)
+		{
+			cobs_end_of_frame(pLink,pRing);
+			continue;
+		}
+
+		if(pLink->Skip)
+		{
+			continue;
+		}
+
+		if(pLink->Code)
+		{
+			//data byte of the current block
+			cobs_emit(pLink,pBuffer,mask,byte);
+			pLink->Code--;
+		}else
+		{
+			//code byte : the 0x00 closing the previous block, then byte - 1 data bytes
+			if(pLink->Zero)
+			{
+				cobs_emit(pLink,pBuffer,mask,0x00);
+			}
+			pLink->Code = byte - 1;
+			pLink->Zero = (byte != COBS_BLOCK_MAX);
+		}
+	}
+
+	if(pLink->Skip)
+	{
+		//nothing to keep of a dropped frame
+		USART_ReadRelease(pLink->pUSARTHandle,pLink->Read - pRing->Tail);
+		pLink->Write = pLink->Read;
+	}else if(pLink->Read - pRing->Tail >= pRing->Size)
+	{
+		//the ring is full and still no delimiter : the frame can never fit
+		pLink->Oversize++;
+		pLink->Skip = SET;
+		USART_ReadRelease(pLink->pUSARTHandle,pLink->Read - pRing->Tail);
+		pLink->Write = pLink->Read;
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - cobs_crc16
+ *
+ * @brief             - CRC-16/CCITT of a buffer, table driven
+ *
+ * @param[in]         - running CRC, COBS_CRC_INIT for the first buffer
+ * @param[in]         - data
+ * @param[in]         - data length
+ *
+ * @return            - updated CRC
+ *
+ * @Note              - Running it over the data followed by its CRC (high byte first) gives 0
+
+ */
+uint16_t cobs_crc16(uint16_t Crc, const uint8_t *pData, uint32_t Len)
+{
+	while(Len--)
+	{
+		Crc = (uint16_t)( (Crc << 8) ^ cobs_crc_table[ (Crc >> 8) ^ *pData++ ] );
+	}
+
+	return Crc;
+}
+
+
+/*********************************************************************
+ * @fn      		  - cobs_frame_callback
+ *
+ * @brief             -
+ *
+ * @param[in]         -
+ * @param[in]         -
+ * @param[in]         -
+ *
+ * @return            -
+ *
+ * @Note              - This is a weak implementation, the application overrides it to get the frames
+
+ */
+__weak void cobs_frame_callback(COBS_Link_t *pLink, uint8_t *pPayload, uint32_t Len)
+{
+
+}
+
+
+//some helper function implementations
+
+static void cobs_emit(COBS_Link_t *pLink, uint8_t *pBuffer, uint32_t Mask, uint8_t Byte)
+{
+	pBuffer[pLink->Write++ & Mask] = Byte;
+	pLink->Crc = (uint16_t)( (pLink->Crc << 8) ^ cobs_crc_table[ (pLink->Crc >> 8) ^ Byte ] );
+}
+
+
+static void cobs_end_of_frame(COBS_Link_t *pLink, USART_Ring_t *pRing)
+{
+	uint32_t start = pRing->Tail;
+	uint32_t len = pLink->Write - start;
+	uint32_t index = start & (pRing->Size - 1);
+	uint32_t first;
+	uint8_t *pPayload;
+
+	if(pLink->Skip)
+	{
+		//end of a dropped frame, already counted
+		pLink->Skip = RESET;
+	}else if(len == 0 && pLink->Code == 0 && !pLink->Zero)
+	{
+		//back to back delimiters, senders may use one to flush the line : not an error
+	}else if(pLink->Code || len < 2)
+	{
+		pLink->FormatErrors++;
+	}else if(pLink->Crc != 0)
+	{
+		pLink->CRCErrors++;
+	}else
+	{
+		len -= 2;
+		pPayload = &pRing->pBuffer[index];
+
+		if(index + len > pRing->Size)
+		{
+			//the payload wraps around the end of the storage
+			if(len > pLink->FrameSize)
+			{
+				pLink->Oversize++;
+				pPayload = NULL;
+			}else
+			{
+				first = pRing->Size - index;
+				memcpy(pLink->pFrame,pPayload,first);
+				memcpy(pLink->pFrame + first,pRing->pBuffer,len - first);
+				pPayload = pLink->pFrame;
+			}
+		}
+
+		if(pPayload)
+		{
+			pLink->Frames++;
+			cobs_frame_callback(pLink,pPayload,len);
+		}
+	}
+
+	//the frame and its delimiter are done with
+	USART_ReadRelease(pLink->pUSARTHandle,pLink->Read - start);
+	cobs_rx_reset(pLink,pLink->Read);
+}
+
+
+static void cobs_rx_reset(COBS_Link_t *pLink, uint32_t Index)
+{
+	pLink->Read = Index;
+	pLink->Write = Index;
+	pLink->Crc = COBS_CRC_INIT;
+	pLink->Code = 0;
+	pLink->Zero = RESET;
+}
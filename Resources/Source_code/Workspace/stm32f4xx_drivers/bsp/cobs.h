@@ -0,0 +1,66 @@
+/*
+ * cobs.h
+ *
+ * Packet layer over the USART rings. A frame is the payload followed by its CRC-16/CCITT
+ * (poly 0x1021, init 0xFFFF, high byte first), COBS encoded so it holds no 0x00, and a
+ * 0x00 delimiter :
+ *
+ * 		payload | CRC hi | CRC lo   --COBS-->   code | data ... | code | data ... | 0x00
+ *
+ * cobs_send encodes straight in to the Tx ring, cobs_poll decodes in place in the Rx ring
+ * and hands every good frame to cobs_frame_callback. Any payload byte value is allowed, a
+ * lost byte costs one frame : the receiver resyncs on the next delimiter.
+ */
+
+#ifndef COBS_H_
+#define COBS_H_
+
+#include "stm32f407xx.h"
+
+/*
+ * worst case size of an encoded frame of Len payload bytes : one code byte per 254 bytes
+ * of payload and CRC, plus the delimiter
+ */
+#define COBS_ENCODED_MAX(Len)	( (Len) + 2 + ( ((Len) + 2) / 254 ) + 2 )
+
+#define COBS_CRC_INIT			0xFFFF
+
+/*
+ * cobs_send results
+ */
+#define COBS_OK					0
+#define COBS_ERR_FULL			1		/* not enough room in the Tx ring, nothing is queued */
+
+typedef struct
+{
+	USART_Handle_t	*pUSARTHandle;	/* !< USART with a Tx and an Rx ring attached > */
+	uint8_t			*pFrame;		/* !< frames which wrap around the end of the Rx ring are copied here > */
+	uint32_t		FrameSize;		/* !< size of pFrame, 0 : wrapped frames are dropped > */
+	uint32_t		Read;			/* !< used by the module : next Rx ring byte to decode > */
+	uint32_t		Write;			/* !< used by the module : next decoded byte, in place behind Read > */
+	uint16_t		Crc;			/* !< used by the module : CRC of the decoded bytes > */
+	uint8_t			Code;			/* !< used by the module : data bytes left in the block, 0 : code byte next > */
+	uint8_t			Zero;			/* !< used by the module : SET if a 0x00 is due before the next block > */
+	uint8_t			Skip;			/* !< used by the module : SET while a dropped frame runs to its delimiter > */
+	uint32_t		Frames;			/* !< good frames delivered > */
+	uint32_t		CRCErrors;		/* !< frames with a bad CRC > */
+	uint32_t		FormatErrors;	/* !< truncated COBS block, or frame shorter than its CRC > */
+	uint32_t		Oversize;		/* !< frames longer than the Rx ring, or wrapped frames over FrameSize > */
+	uint32_t		TxFull;			/* !< frames cobs_send could not queue > */
+}COBS_Link_t;
+
+/*
+ * APIs, call cobs_send and cobs_poll from one context (the main loop)
+ */
+void cobs_init(COBS_Link_t *pLink, USART_Handle_t *pUSARTHandle, uint8_t *pFrame, uint32_t FrameSize);
+uint8_t cobs_send(COBS_Link_t *pLink, const uint8_t *pPayload, uint32_t Len);
+void cobs_poll(COBS_Link_t *pLink);
+uint16_t cobs_crc16(uint16_t Crc, const uint8_t *pData, uint32_t Len);
+
+/*
+ * Application callback, one call per good frame. pPayload points in to the Rx ring (or
+ * pFrame) and is valid until the callback returns
+ */
+void cobs_frame_callback(COBS_Link_t *pLink, uint8_t *pPayload, uint32_t Len);
+
+#endif /* COBS_H_ */
@@ -0,0 +1,206 @@
+/*
+ * dlog.c
+ *
+ * Deferred binary logger, see dlog.h
+ */
+
+#include "dlog.h"
+
+#define DLOG_RING_MASK		(DLOG_RING_WORDS - 1)
+
+#if (DLOG_RING_WORDS & DLOG_RING_MASK) != 0
+#error "DLOG_RING_WORDS must be a power of two"
+#endif
+
+static void dlog_drain_usart(uint32_t *pTail, uint32_t Head);
+static void dlog_drain_itm(uint32_t *pTail, uint32_t Head);
+
+DLOG_Ring_t DLOG_Ring;
+
+
+/*********************************************************************
+ * @fn      		  - dlog_init
+ *
+ * @brief             - empties the ring and selects the output
+ *
+ * @param[in]         - USART handle with a Tx ring attached (USART_AttachRings), NULL for ITM port 0
+ *
+ * @return            - none
+ *
+ * @Note              - starts the DWT cycle counter used for the time stamps if it is not running
+
+ */
+void dlog_init(USART_Handle_t *pUSARTHandle)
+{
+	DLOG_Ring.Head = 0;
+	DLOG_Ring.Tail = 0;
+	DLOG_Ring.Offset = 0;
+	DLOG_Ring.Seq = 0;
+	DLOG_Ring.Dropped = 0;
+	DLOG_Ring.HighWater = 0;
+	DLOG_Ring.pUSARTHandle = pUSARTHandle;
+
+	if( !(*DWT_CTRL & ( 1 << DWT_CTRL_CYCCNTENA)) )
+	{
+		DWT_CYCCNT_INIT();
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - dlog_write
+ *
+ * @brief             - appends one entry to the ring, use it through DLOG()
+ *
+ * @param[in]         - id of the format string
+ * @param[in]         - argument words
+ * @param[in]         - number of argument words, DLOG_MAX_ARGS max
+ *
+ * @return            - none
+ *
+ * @Note              - Callable from the thread and from any ISR : the entry is reserved and
+ * 						written with interrupts masked, a handful of word stores. When the ring
+ * 						is full the entry is dropped and counted, the caller never waits
+
+ */
+void dlog_write(uint32_t Id, const uint32_t *pArgs, uint32_t NArgs)
+{
+	uint32_t stamp = DWT_CYCCNT_GET();
+	uint32_t primask, head, level, seq;
+
+	IRQ_LOCK(primask);
+
+	seq = DLOG_Ring.Seq++;
+	head = DLOG_Ring.Head;
+	level = head - DLOG_Ring.Tail + 2 + NArgs;
+
+	if(level > DLOG_RING_WORDS)
+	{
+		DLOG_Ring.Dropped++;
+		IRQ_UNLOCK(primask);
+		return;
+	}
+
+	DLOG_Ring.Buffer[head++ & DLOG_RING_MASK] = ( Id << DLOG_HDR_ID ) | ( (seq & 0xFF) << DLOG_HDR_SEQ ) |
+												( DLOG_SYNC << DLOG_HDR_SYNC ) | ( NArgs << DLOG_HDR_NARGS );
+	DLOG_Ring.Buffer[head++ & DLOG_RING_MASK] = stamp;
+
+	for(uint32_t i = 0 ; i < NArgs ; i++)
+	{
+		DLOG_Ring.Buffer[head++ & DLOG_RING_MASK] = pArgs[i];
+	}
+
+	//publish the entry only once it is complete
+	COMPILER_BARRIER();
+	DLOG_Ring.Head = head;
+
+	if(level > DLOG_Ring.HighWater)
+	{
+		DLOG_Ring.HighWater = level;
+	}
+
+	IRQ_UNLOCK(primask);
+}
+
+
+/*********************************************************************
+ * @fn      		  - dlog_drain
+ *
+ * @brief             - moves logged entries to the output, never waits
+ *
+ * @param[in]         - none
+ *
+ * @return            - none
+ *
+ * @Note              - Call it from the main loop (one context only). It stops when the USART Tx
+ * 						ring or the ITM FIFO is full and carries on there at the next call, so
+ * 						the byte stream is never cut. Without a debugger the ITM is disabled and
+ * 						the entries are discarded
+
+ */
+void dlog_drain(void)
+{
+	uint32_t tail = DLOG_Ring.Tail;
+	uint32_t head = DLOG_Ring.Head;
+
+	//Head is read before the entries behind it
+	COMPILER_BARRIER();
+
+	if(tail == head)
+	{
+		return;
+	}
+
+	if(DLOG_Ring.pUSARTHandle)
+	{
+		dlog_drain_usart(&tail,head);
+	}else
+	{
+		dlog_drain_itm(&tail,head);
+	}
+
+	//free the space only once the words are out
+	COMPILER_BARRIER();
+	DLOG_Ring.Tail = tail;
+}
+
+
+//some helper function implementations
+
+static void dlog_drain_usart(uint32_t *pTail, uint32_t Head)
+{
+	uint32_t tail = *pTail;
+	uint32_t index, words, len, sent;
+
+	while(tail != Head)
+	{
+		//contiguous words from Tail up to Head or the end of the storage
+		index = tail & DLOG_RING_MASK;
+		words = Head - tail;
+		if(words > DLOG_RING_WORDS - index)
+		{
+			words = DLOG_RING_WORDS - index;
+		}
+
+		len = 4 * words - DLOG_Ring.Offset;
+		sent = USART_Write(DLOG_Ring.pUSARTHandle,(uint8_t*)&DLOG_Ring.Buffer[index] + DLOG_Ring.Offset,len);
+
+		sent += DLOG_Ring.Offset;
+		tail += sent / 4;
+		DLOG_Ring.Offset = sent % 4;
+
+		if(sent < 4 * words)
+		{
+			//Tx ring is full
+			break;
+		}
+	}
+
+	*pTail = tail;
+}
+
+
+static void dlog_drain_itm(uint32_t *pTail, uint32_t Head)
+{
+	uint32_t tail = *pTail;
+
+	if( !(*ITM_TCR & ( 1 << ITM_TCR_ITMENA)) || !(*ITM_TER & 0x1) )
+	{
+		*pTail = Head;
+		return;
+	}
+
+	while(tail != Head)
+	{
+		//the stimulus port reads 0 while its FIFO is full
+		if(*ITM_STIM0 == 0)
+		{
+			break;
+		}
+
+		*ITM_STIM0 = DLOG_Ring.Buffer[tail & DLOG_RING_MASK];
+		tail++;
+	}
+
+	*pTail = tail;
+}
@@ -0,0 +1,95 @@
+/*
+ * dlog.h
+ *
+ * Deferred binary logger : DLOG() stores the id of its format string, a DWT time stamp and
+ * the raw arguments in a RAM ring, nothing is formatted on the target. dlog_drain() sends
+ * the ring over a USART (Tx ring of the USART driver) or the ITM, tools/dlog.py rebuilds
+ * the text from the format strings kept in the .dlog_fmt section of the ELF.
+ *
+ * 		DLOG("adc ch%u = %d", ch, value);		//from the thread or any ISR
+ * 		dlog_drain();							//from the main loop
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include "stm32f407xx.h"
+
+/*
+ * size of the ring in 32 bit words, a power of two
+ * an entry takes 2 words plus one per argument
+ */
+#ifndef DLOG_RING_WORDS
+#define DLOG_RING_WORDS		256
+#endif
+
+/*
+ * max number of arguments of one DLOG()
+ */
+#define DLOG_MAX_ARGS		6
+
+/*
+ * Entry header word : id of the format string (its offset in .dlog_fmt), sequence number,
+ * sync nibble and number of argument words. The time stamp word and the arguments follow
+ */
+#define DLOG_HDR_ID			16		/* bits 31:16 */
+#define DLOG_HDR_SEQ		8		/* bits 15:8, counts the dropped entries as well */
+#define DLOG_HDR_SYNC		4		/* bits 7:4 */
+#define DLOG_HDR_NARGS		0		/* bits 3:0 */
+
+#define DLOG_SYNC			0xA
+
+/*
+ * Arguments are stored as 32 bit words : integers, chars and pointers. %s only works for
+ * strings the host can read from the ELF (literals and other const data in flash).
+ * 64 bit and floating point arguments are not supported
+ */
+#define DLOG_NARGS_(_0,_1,_2,_3,_4,_5,_6,N,...)		N
+#define DLOG_NARGS(...)			DLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+
+#define DLOG_ARGS_0()
+#define DLOG_ARGS_1(a)					, (uint32_t)(a)
+#define DLOG_ARGS_2(a,b)				DLOG_ARGS_1(a) DLOG_ARGS_1(b)
+#define DLOG_ARGS_3(a,b,c)				DLOG_ARGS_2(a,b) DLOG_ARGS_1(c)
+#define DLOG_ARGS_4(a,b,c,d)			DLOG_ARGS_3(a,b,c) DLOG_ARGS_1(d)
+#define DLOG_ARGS_5(a,b,c,d,e)			DLOG_ARGS_4(a,b,c,d) DLOG_ARGS_1(e)
+#define DLOG_ARGS_6(a,b,c,d,e,f)		DLOG_ARGS_5(a,b,c,d,e) DLOG_ARGS_1(f)
+
+#define DLOG_CAT_(a,b)			a##b
+#define DLOG_CAT(a,b)			DLOG_CAT_(a,b)
+
+/*
+ * The format string goes to .dlog_fmt, which is not loaded (see LinkerScript.ld), so it
+ * costs no flash. Its address is a link time constant and is used as the id
+ */
+#define DLOG(fmt, ...)		do{ \
+		static const char dlog_fmt_[] __attribute__((section(".dlog_fmt"), used)) = fmt; \
+		const uint32_t dlog_args_[] = { 0 DLOG_CAT(DLOG_ARGS_, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__) }; \
+		dlog_write((uint32_t)dlog_fmt_, &dlog_args_[1], DLOG_NARGS(__VA_ARGS__)); \
+	}while(0)
+
+/*
+ * ring and its stats
+ */
+typedef struct
+{
+	uint32_t 		Buffer[DLOG_RING_WORDS];
+	__vo uint32_t 	Head;			/* !< words written since dlog_init > */
+	__vo uint32_t 	Tail;			/* !< words drained since dlog_init > */
+	uint32_t 		Offset;			/* !< bytes of the word at Tail already handed to the USART > */
+	uint32_t 		Seq;			/* !< entries logged or dropped > */
+	uint32_t 		Dropped;		/* !< entries lost because the ring was full > */
+	uint32_t 		HighWater;		/* !< highest fill level seen, in words > */
+	USART_Handle_t 	*pUSARTHandle;	/* !< output, NULL : ITM stimulus port 0 > */
+}DLOG_Ring_t;
+
+extern DLOG_Ring_t DLOG_Ring;
+
+/*
+ * APIs
+ */
+void dlog_init(USART_Handle_t *pUSARTHandle);
+void dlog_write(uint32_t Id, const uint32_t *pArgs, uint32_t NArgs);
+void dlog_drain(void);
+
+#endif /* DLOG_H_ */
@@ -0,0 +1,408 @@
+/*
+ * ds1307.c
+ *
+ *  Created on: May 4, 2019
+ *      Author: admin
+ */
+
+#include<string.h>
+#include "ds1307.h"
+
+/*
+ * Time kept by the driver, binary and 24h. Filled by one burst read of the 7 time registers,
+ * then advanced by the 1Hz SQW edges without touching the bus
+ */
+typedef struct
+{
+	uint8_t seconds;
+	uint8_t minutes;
+	uint8_t hours;
+	uint8_t day;
+	uint8_t date;
+	uint8_t month;
+	uint8_t year;
+	uint8_t format12;		/* RTC runs in 12h mode, get_current_time reports AM/PM */
+	uint32_t timestamp;		/* seconds since 2000-01-01 00:00:00 */
+}ds1307_cache_t;
+
+static uint8_t ds1307_read(uint8_t reg_addr, uint8_t *pBuffer, uint8_t len);
+static uint8_t ds1307_write(uint8_t reg_addr, uint8_t *pData, uint8_t len);
+static void ds1307_decode(uint8_t *pRegs);
+static void ds1307_advance(void);
+static uint8_t ds1307_days_in_month(uint8_t month, uint8_t year);
+static uint8_t binary_to_bcd(uint8_t value);
+
+static I2C_Handle_t *pDS1307_I2C;
+static GPIO_RegDef_t *pDS1307_SQWPort;
+static uint8_t ds1307_sqw_pin;
+
+static ds1307_cache_t ds1307_cache;
+static __vo uint8_t ds1307_cache_valid;
+static __vo uint32_t ds1307_sqw_count;		/* SQW edges, tells the sync that an edge came in between */
+static __vo uint16_t ds1307_ticks;			/* SQW edges since the last sync */
+
+/*
+ * BCD decoding : tens nibble from the table, no multiply or divide per digit
+ */
+static const uint8_t bcd_tens[16] = { 0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150 };
+#define BCD_TO_BINARY(value)	( bcd_tens[(value) >> 4] + ((value) & 0x0F) )
+
+static const uint8_t days_in_month[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+static const uint16_t days_before_month[13] = { 0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+
+/*********************************************************************
+ * @fn      		  - ds1307_init
+ *
+ * @brief             - starts the RTC oscillator and fills the time cache
+ *
+ * @param[in]         - I2C handle, master with PE and ACK set
+ * @param[in]         - port of the pin wired to SQW/OUT, NULL : no SQW, every get reads the RTC
+ * @param[in]         - pin number
+ *
+ * @return            - DS1307_OK, DS1307_ERR_HALTED if the clock was stopped (it is started,
+ * 						but the time has to be set), DS1307_ERR_BUS
+ *
+ * @Note              - SQW/OUT is open drain, the pin gets the internal pull-up. The application
+ * 						enables the EXTI IRQ of the pin and calls ds1307_sqw_handler from it
+
+ */
+uint8_t ds1307_init(I2C_Handle_t *pI2CHandle, GPIO_RegDef_t *pSQWPort, uint8_t SQWPin)
+{
+	GPIO_Handle_t sqw;
+	uint8_t ctrl;
+	uint8_t seconds;
+	uint8_t ret;
+
+	pDS1307_I2C = pI2CHandle;
+	pDS1307_SQWPort = pSQWPort;
+	ds1307_sqw_pin = SQWPin;
+	ds1307_cache_valid = RESET;
+
+	//1. 1Hz square wave on SQW/OUT, or the output off
+	ctrl = pSQWPort ? ( 1 << DS1307_CONTROL_SQWE) : 0;
+	if(ds1307_write(DS1307_ADDR_CONTROL,&ctrl,1) != DS1307_OK)
+		return DS1307_ERR_BUS;
+
+	//2. falling edge interrupt on the SQW pin
+	if(pSQWPort)
+	{
+		memset(&sqw,0,sizeof(sqw));
+		sqw.pGPIOx = pSQWPort;
+		sqw.GPIO_PinConfig.GPIO_PinNumber = SQWPin;
+		sqw.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_FT;
+		sqw.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+		sqw.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+
+		GPIO_PeriClockControl(pSQWPort,ENABLE);
+		GPIO_Init(&sqw);
+	}
+
+	//3. load the cache
+	ret = ds1307_sync();
+
+	//4. CH set : the oscillator is stopped, start it, the seconds keep their value
+	if(ret == DS1307_ERR_HALTED)
+	{
+		seconds = binary_to_bcd(ds1307_cache.seconds);
+		if(ds1307_write(DS1307_ADDR_SEC,&seconds,1) != DS1307_OK)
+			return DS1307_ERR_BUS;
+	}
+
+	return ret;
+}
+
+
+/*********************************************************************
+ * @fn      		  - ds1307_sync
+ *
+ * @brief             - reloads the time cache with one burst read of the 7 time registers
+ *
+ * @param[in]         - none
+ *
+ * @return            - DS1307_OK, DS1307_ERR_HALTED or DS1307_ERR_BUS
+ *
+ * @Note              - done by the get functions when needed, thread mode only
+
+ */
+uint8_t ds1307_sync(void)
+{
+	uint8_t regs[7];
+	uint32_t count;
+	uint32_t primask;
+	uint8_t done;
+
+	do
+	{
+		count = ds1307_sqw_count;
+
+		if(ds1307_read(DS1307_ADDR_SEC,regs,7) != DS1307_OK)
+			return DS1307_ERR_BUS;
+
+		//an edge during the read may or may not be in the registers, read them again
+		IRQ_LOCK(primask);
+		done = (count == ds1307_sqw_count);
+		if(done)
+		{
+			ds1307_decode(regs);
+			ds1307_ticks = 0;
+			ds1307_cache_valid = SET;
+		}
+		IRQ_UNLOCK(primask);
+
+	}while(!done);
+
+	return (regs[DS1307_ADDR_SEC] & ( 1 << DS1307_SEC_CH)) ? DS1307_ERR_HALTED : DS1307_OK;
+}
+
+
+/*********************************************************************
+ * @fn      		  - ds1307_sqw_handler
+ *
+ * @brief             - advances the cached time by one second
+ *
+ * @param[in]         - none
+ *
+ * @return            - none
+ *
+ * @Note              - call it from the EXTIx IRQ handler of the SQW pin, it clears the pending bit
+
+ */
+void ds1307_sqw_handler(void)
+{
+	GPIO_IRQHandling(ds1307_sqw_pin);
+
+	ds1307_sqw_count++;
+
+	if(ds1307_cache_valid)
+	{
+		ds1307_advance();
+
+		//resync from the bus now and then, the next get does it
+		if(++ds1307_ticks >= DS1307_RESYNC_TICKS)
+			ds1307_cache_valid = RESET;
+	}
+}
+
+
+void ds1307_set_current_time(RTC_Time_t *pRTC_Time)
+{
+	uint8_t regs[3];
+
+	//seconds with CH = 0, writing them also restarts the 1Hz countdown
+	regs[0] = binary_to_bcd(pRTC_Time->seconds) & ~( 1 << DS1307_SEC_CH);
+	regs[1] = binary_to_bcd(pRTC_Time->minutes);
+	regs[2] = binary_to_bcd(pRTC_Time->hours);
+
+	if(pRTC_Time->time_format != TIME_FORMAT_24HRS)
+	{
+		regs[2] |= ( 1 << DS1307_HRS_12H);
+		if(pRTC_Time->time_format == TIME_FORMAT_12HRS_PM)
+			regs[2] |= ( 1 << DS1307_HRS_PM);
+	}
+
+	ds1307_write(DS1307_ADDR_SEC,regs,3);
+	ds1307_cache_valid = RESET;
+}
+
+
+void ds1307_set_current_date(RTC_Date_t *pRTC_Date)
+{
+	uint8_t regs[4];
+
+	regs[0] = binary_to_bcd(pRTC_Date->day);
+	regs[1] = binary_to_bcd(pRTC_Date->date);
+	regs[2] = binary_to_bcd(pRTC_Date->month);
+	regs[3] = binary_to_bcd(pRTC_Date->year);
+
+	ds1307_write(DS1307_ADDR_DAY,regs,4);
+	ds1307_cache_valid = RESET;
+}
+
+
+/*********************************************************************
+ * @fn      		  - ds1307_get_current_time
+ *
+ * @brief             - time from the cache
+ *
+ * @param[out]        - time, in the format the RTC runs in
+ *
+ * @return            - none
+ *
+ * @Note              - no bus access unless the cache has to be loaded (first call, after a set,
+ * 						every DS1307_RESYNC_TICKS seconds, always without SQW)
+
+ */
+void ds1307_get_current_time(RTC_Time_t *pRTC_Time)
+{
+	uint32_t primask;
+	uint8_t format12;
+
+	if(!pDS1307_SQWPort || !ds1307_cache_valid)
+		ds1307_sync();
+
+	IRQ_LOCK(primask);
+	pRTC_Time->seconds = ds1307_cache.seconds;
+	pRTC_Time->minutes = ds1307_cache.minutes;
+	pRTC_Time->hours = ds1307_cache.hours;
+	format12 = ds1307_cache.format12;
+	IRQ_UNLOCK(primask);
+
+	if(format12)
+	{
+		pRTC_Time->time_format = (pRTC_Time->hours >= 12) ? TIME_FORMAT_12HRS_PM : TIME_FORMAT_12HRS_AM;
+		pRTC_Time->hours %= 12;
+		if(pRTC_Time->hours == 0)
+			pRTC_Time->hours = 12;
+	}else
+	{
+		pRTC_Time->time_format = TIME_FORMAT_24HRS;
+	}
+}
+
+
+void ds1307_get_current_date(RTC_Date_t *pRTC_Date)
+{
+	uint32_t primask;
+
+	if(!pDS1307_SQWPort || !ds1307_cache_valid)
+		ds1307_sync();
+
+	IRQ_LOCK(primask);
+	pRTC_Date->day = ds1307_cache.day;
+	pRTC_Date->date = ds1307_cache.date;
+	pRTC_Date->month = ds1307_cache.month;
+	pRTC_Date->year = ds1307_cache.year;
+	IRQ_UNLOCK(primask);
+}
+
+
+/*********************************************************************
+ * @fn      		  - ds1307_get_timestamp
+ *
+ * @brief             - seconds since 2000-01-01 00:00:00, for time stamping records
+ *
+ * @param[in]         - none
+ *
+ * @return            - timestamp
+ *
+ * @Note              - a single word read of the cache, same bus rules as ds1307_get_current_time
+
+ */
+uint32_t ds1307_get_timestamp(void)
+{
+	if(!pDS1307_SQWPort || !ds1307_cache_valid)
+		ds1307_sync();
+
+	return ds1307_cache.timestamp;
+}
+
+
+//some helper function implementations
+
+static uint8_t ds1307_read(uint8_t reg_addr, uint8_t *pBuffer, uint8_t len)
+{
+	//register pointer, then a repeated START and the burst read
+	if(I2C_MasterSendData(pDS1307_I2C,&reg_addr,1,DS1307_I2C_ADDRESS,I2C_ENABLE_SR) != I2C_READY)
+		return DS1307_ERR_BUS;
+
+	if(I2C_MasterReceiveData(pDS1307_I2C,pBuffer,len,DS1307_I2C_ADDRESS,I2C_DISABLE_SR) != I2C_READY)
+		return DS1307_ERR_BUS;
+
+	return DS1307_OK;
+}
+
+
+static uint8_t ds1307_write(uint8_t reg_addr, uint8_t *pData, uint8_t len)
+{
+	uint8_t tx[8];
+
+	//register pointer and data in one transfer
+	tx[0] = reg_addr;
+	memcpy(&tx[1],pData,len);
+
+	if(I2C_MasterSendData(pDS1307_I2C,tx,len + 1,DS1307_I2C_ADDRESS,I2C_DISABLE_SR) != I2C_READY)
+		return DS1307_ERR_BUS;
+
+	return DS1307_OK;
+}
+
+
+static void ds1307_decode(uint8_t *pRegs)
+{
+	uint8_t hrs = pRegs[DS1307_ADDR_HRS];
+	uint8_t year;
+	uint32_t days;
+
+	ds1307_cache.seconds = BCD_TO_BINARY(pRegs[DS1307_ADDR_SEC] & 0x7F);
+	ds1307_cache.minutes = BCD_TO_BINARY(pRegs[DS1307_ADDR_MIN] & 0x7F);
+	ds1307_cache.day = pRegs[DS1307_ADDR_DAY] & 0x07;
+	ds1307_cache.date = BCD_TO_BINARY(pRegs[DS1307_ADDR_DATE] & 0x3F);
+	ds1307_cache.month = BCD_TO_BINARY(pRegs[DS1307_ADDR_MONTH] & 0x1F);
+	ds1307_cache.year = BCD_TO_BINARY(pRegs[DS1307_ADDR_YEAR]);
+
+	//hours are kept in 24h
+	ds1307_cache.format12 = (hrs >> DS1307_HRS_12H) & 1;
+	if(ds1307_cache.format12)
+	{
+		ds1307_cache.hours = BCD_TO_BINARY(hrs & 0x1F) % 12;
+		if(hrs & ( 1 << DS1307_HRS_PM))
+			ds1307_cache.hours += 12;
+	}else
+	{
+		ds1307_cache.hours = BCD_TO_BINARY(hrs & 0x3F);
+	}
+
+	//days since 2000-01-01, every 4th year is a leap year up to 2099
+	year = ds1307_cache.year;
+	days = (365UL * year) + ((year + 3) / 4) + days_before_month[ds1307_cache.month % 13] + ds1307_cache.date - 1;
+	if(ds1307_cache.month > 2 && (year % 4) == 0)
+		days++;
+
+	ds1307_cache.timestamp = (days * 86400UL) + (ds1307_cache.hours * 3600UL) +
+							 (ds1307_cache.minutes * 60UL) + ds1307_cache.seconds;
+}
+
+
+static void ds1307_advance(void)
+{
+	ds1307_cache.timestamp++;
+
+	if(++ds1307_cache.seconds < 60)
+		return;
+	ds1307_cache.seconds = 0;
+
+	if(++ds1307_cache.minutes < 60)
+		return;
+	ds1307_cache.minutes = 0;
+
+	if(++ds1307_cache.hours < 24)
+		return;
+	ds1307_cache.hours = 0;
+
+	ds1307_cache.day = (ds1307_cache.day % 7) + 1;
+	if(++ds1307_cache.date <= ds1307_days_in_month(ds1307_cache.month,ds1307_cache.year))
+		return;
+	ds1307_cache.date = 1;
+
+	if(++ds1307_cache.month <= 12)
+		return;
+	ds1307_cache.month = 1;
+
+	ds1307_cache.year = (ds1307_cache.year + 1) % 100;
+}
+
+
+static uint8_t ds1307_days_in_month(uint8_t month, uint8_t year)
+{
+	if(month == 2 && (year % 4) == 0)
+		return 29;
+
+	return days_in_month[month % 13];
+}
+
+
+static uint8_t binary_to_bcd(uint8_t value)
+{
+	return (uint8_t)(((value / 10) << 4) | (value % 10));
+}
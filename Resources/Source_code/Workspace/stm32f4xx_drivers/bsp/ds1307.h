@@ -0,0 +1,101 @@
+/*
+ * ds1307.h
+ *
+ *  Created on: May 4, 2019
+ *      Author: admin
+ */
+
+#ifndef DS1307_H_
+#define DS1307_H_
+
+#include "stm32f407xx.h"
+
+/*
+ * 7 bit DS1307 address is b1101000
+ */
+#define DS1307_I2C_ADDRESS		0x68
+
+/*
+ * Register addresses
+ */
+#define DS1307_ADDR_SEC 		0x00
+#define DS1307_ADDR_MIN 		0x01
+#define DS1307_ADDR_HRS			0x02
+#define DS1307_ADDR_DAY			0x03
+#define DS1307_ADDR_DATE		0x04
+#define DS1307_ADDR_MONTH		0x05
+#define DS1307_ADDR_YEAR		0x06
+#define DS1307_ADDR_CONTROL		0x07
+
+/*
+ * Register bits
+ */
+#define DS1307_SEC_CH			7		/* clock halt */
+#define DS1307_HRS_12H			6
+#define DS1307_HRS_PM			5
+#define DS1307_CONTROL_SQWE		4		/* SQW enable, RS1:0 = 00 gives 1Hz */
+
+/*
+ * @RTC_TimeFormat
+ */
+#define TIME_FORMAT_12HRS_AM	0
+#define TIME_FORMAT_12HRS_PM	1
+#define TIME_FORMAT_24HRS		2
+
+/*
+ * @RTC_Day
+ */
+#define SUNDAY  				1
+#define MONDAY  				2
+#define TUESDAY  				3
+#define WEDNESDAY 				4
+#define THURSDAY  				5
+#define FRIDAY  				6
+#define SATURDAY  				7
+
+/*
+ * the cached time is read again from the RTC after this many SQW ticks
+ * (a missed edge can not make it drift longer than that)
+ */
+#define DS1307_RESYNC_TICKS		3600
+
+/*
+ * Results
+ */
+#define DS1307_OK				0
+#define DS1307_ERR_HALTED		1		/* oscillator stopped (CH set) : time lost, set it again */
+#define DS1307_ERR_BUS			2		/* I2C transfer failed */
+
+typedef struct
+{
+	uint8_t date;			/* 1 to 31 */
+	uint8_t month;			/* 1 to 12 */
+	uint8_t year;			/* 0 to 99, 20xx */
+	uint8_t day;			/* @RTC_Day */
+}RTC_Date_t;
+
+typedef struct
+{
+	uint8_t seconds;
+	uint8_t minutes;
+	uint8_t hours;			/* 0 to 23, 1 to 12 in the 12 hour formats */
+	uint8_t time_format;	/* @RTC_TimeFormat */
+}RTC_Time_t;
+
+/*
+ * APIs, the I2C handle must be initialized with PE and ACK set. The bus is used with the
+ * blocking master APIs, so no I2C interrupt is needed
+ */
+uint8_t ds1307_init(I2C_Handle_t *pI2CHandle, GPIO_RegDef_t *pSQWPort, uint8_t SQWPin);
+
+void ds1307_set_current_time(RTC_Time_t *pRTC_Time);
+void ds1307_get_current_time(RTC_Time_t *pRTC_Time);
+
+void ds1307_set_current_date(RTC_Date_t *pRTC_Date);
+void ds1307_get_current_date(RTC_Date_t *pRTC_Date);
+
+uint32_t ds1307_get_timestamp(void);
+uint8_t ds1307_sync(void);
+void ds1307_sqw_handler(void);
+
+#endif /* DS1307_H_ */
@@ -46,6 +46,43 @@
  */
 #define NO_PR_BITS_IMPLEMENTED  4
 
+/*
+ * ARM Cortex M4 DWT cycle counter, used to time drivers in the benchmark applications
+ */
+#define DEMCR 				((__vo uint32_t*)0xE000EDFC)
+#define DWT_CTRL 			((__vo uint32_t*)0xE0001000)
+#define DWT_CYCCNT 			((__vo uint32_t*)0xE0001004)
+
+#define DEMCR_TRCENA 		24
+#define DWT_CTRL_CYCCNTENA 	0
+
+#define DWT_CYCCNT_INIT()	do{ *DEMCR |= ( 1 << DEMCR_TRCENA); *DWT_CYCCNT = 0; *DWT_CTRL |= ( 1 << DWT_CTRL_CYCCNTENA); }while(0)
+#define DWT_CYCCNT_GET()	(*DWT_CYCCNT)
+
+/*
+ * ARM Cortex M4 ITM, stimulus port 0 is read out over SWO by the debug probe
+ */
+#define ITM_STIM0 			((__vo uint32_t*)0xE0000000)
+#define ITM_TER 			((__vo uint32_t*)0xE0000E00)
+#define ITM_TCR 			((__vo uint32_t*)0xE0000E80)
+
+#define ITM_TCR_ITMENA 		0
+
+/*
+ * PRIMASK save/restore, guards data shared between thread mode and ISRs
+ * (a host build of the drivers provides its own, see host/host_cpu.h)
+ */
+#ifndef IRQ_LOCK
+#define IRQ_LOCK(primask)	do{ __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory"); }while(0)
+#define IRQ_UNLOCK(primask)	do{ __asm volatile ("msr primask, %0" :: "r" (primask) : "memory"); }while(0)
+#endif
+
+/*
+ * keeps the compiler from moving memory accesses across it, enough to publish data from
+ * thread mode to an ISR (or back) on this single core
+ */
+#define COMPILER_BARRIER()	__asm volatile ("" ::: "memory")
+
 /*
  * base addresses of Flash and SRAM memories
  */
@@ -82,6 +119,8 @@
 #define GPIOH_BASEADDR 					 (AHB1PERIPH_BASEADDR + 0x1C00)
 #define GPIOI_BASEADDR 					 (AHB1PERIPH_BASEADDR + 0x2000)
 #define RCC_BASEADDR                     (AHB1PERIPH_BASEADDR + 0x3800)
+#define DMA1_BASEADDR                    (AHB1PERIPH_BASEADDR + 0x6000)
+#define DMA2_BASEADDR                    (AHB1PERIPH_BASEADDR + 0x6400)
 /*
  * Base addresses of peripherals which are hanging on APB1 bus
  * TODO : Complete for all other peripherals
@@ -258,6 +297,31 @@ typedef struct
 	__vo uint32_t GTPR;       /*!< TODO,     										Address offset: 0x18 */
 } USART_RegDef_t;
 
+/*
+ * peripheral register definition structure for one DMA stream
+ */
+typedef struct
+{
+	__vo uint32_t CR;         /*!< stream configuration register,                 Address offset: 0x10 + 0x18 * stream */
+	__vo uint32_t NDTR;       /*!< stream number of data register,                Address offset: 0x14 + 0x18 * stream */
+	__vo uint32_t PAR;        /*!< stream peripheral address register,            Address offset: 0x18 + 0x18 * stream */
+	__vo uint32_t M0AR;       /*!< stream memory 0 address register,              Address offset: 0x1C + 0x18 * stream */
+	__vo uint32_t M1AR;       /*!< stream memory 1 address register,              Address offset: 0x20 + 0x18 * stream */
+	__vo uint32_t FCR;        /*!< stream FIFO control register,                  Address offset: 0x24 + 0x18 * stream */
+} DMA_Stream_RegDef_t;
+
+/*
+ * peripheral register definition structure for DMA
+ */
+typedef struct
+{
+	__vo uint32_t LISR;       /*!< low interrupt status register,     			Address offset: 0x00 */
+	__vo uint32_t HISR;       /*!< high interrupt status register,     			Address offset: 0x04 */
+	__vo uint32_t LIFCR;      /*!< low interrupt flag clear register,  			Address offset: 0x08 */
+	__vo uint32_t HIFCR;      /*!< high interrupt flag clear register, 			Address offset: 0x0C */
+	DMA_Stream_RegDef_t S[8]; /*!< stream 0 to 7,                      			Address offset: 0x10-0xCC */
+} DMA_RegDef_t;
+
 /*
  * peripheral definitions ( Peripheral base addresses typecasted to xxx_RegDef_t)
  */
@@ -276,6 +340,9 @@ typedef struct
 #define EXTI				((EXTI_RegDef_t*)EXTI_BASEADDR)
 #define SYSCFG				((SYSCFG_RegDef_t*)SYSCFG_BASEADDR)
 
+#define DMA1  				((DMA_RegDef_t*)DMA1_BASEADDR)
+#define DMA2  				((DMA_RegDef_t*)DMA2_BASEADDR)
+
 
 #define SPI1  				((SPI_RegDef_t*)SPI1_BASEADDR)
 #define SPI2  				((SPI_RegDef_t*)SPI2_BASEADDR)
@@ -307,6 +374,13 @@ typedef struct
 #define GPIOI_PCLK_EN()		(RCC->AHB1ENR |= (1 << 8))
 
 
+/*
+ * Clock Enable Macros for DMAx peripherals
+ */
+#define DMA1_PCLK_EN()		(RCC->AHB1ENR |= (1 << 21))
+#define DMA2_PCLK_EN()		(RCC->AHB1ENR |= (1 << 22))
+
+
 /*
  * Clock Enable Macros for I2Cx peripherals
  */
@@ -332,7 +406,7 @@ typedef struct
 #define USART3_PCCK_EN() (RCC->APB1ENR |= (1 << 18))
 #define UART4_PCCK_EN()  (RCC->APB1ENR |= (1 << 19))
 #define UART5_PCCK_EN()  (RCC->APB1ENR |= (1 << 20))
-#define USART6_PCCK_EN() (RCC->APB1ENR |= (1 << 5))
+#define USART6_PCCK_EN() (RCC->APB2ENR |= (1 << 5))
 
 /*
  * Clock Enable Macros for SYSCFG peripheral
@@ -345,6 +419,12 @@ typedef struct
  */
 #define GPIOA_PCLK_DI()
 
+/*
+ * Clock Disable Macros for DMAx peripherals
+ */
+#define DMA1_PCLK_DI()		(RCC->AHB1ENR &= ~(1 << 21))
+#define DMA2_PCLK_DI()		(RCC->AHB1ENR &= ~(1 << 22))
+
 /*
  * Clock Disable Macros for SPIx peripherals
  */
@@ -352,6 +432,12 @@ typedef struct
 /*
  * Clock Disable Macros for USARTx peripherals
  */
+#define USART1_PCCK_DI() (RCC->APB2ENR &= ~(1 << 4))
+#define USART2_PCCK_DI() (RCC->APB1ENR &= ~(1 << 17))
+#define USART3_PCCK_DI() (RCC->APB1ENR &= ~(1 << 18))
+#define UART4_PCCK_DI()  (RCC->APB1ENR &= ~(1 << 19))
+#define UART5_PCCK_DI()  (RCC->APB1ENR &= ~(1 << 20))
+#define USART6_PCCK_DI() (RCC->APB2ENR &= ~(1 << 5))
 
 
 /*
@@ -373,6 +459,14 @@ typedef struct
 #define GPIOI_REG_RESET()               do{ (RCC->AHB1RSTR |= (1 << 8)); (RCC->AHB1RSTR &= ~(1 << 8)); }while(0)
 
 
+/*
+ *  Macros to reset SPIx peripherals
+ */
+#define SPI1_REG_RESET()               do{ (RCC->APB2RSTR |= (1 << 12)); (RCC->APB2RSTR &= ~(1 << 12)); }while(0)
+#define SPI2_REG_RESET()               do{ (RCC->APB1RSTR |= (1 << 14)); (RCC->APB1RSTR &= ~(1 << 14)); }while(0)
+#define SPI3_REG_RESET()               do{ (RCC->APB1RSTR |= (1 << 15)); (RCC->APB1RSTR &= ~(1 << 15)); }while(0)
+
+
 /*
  *  returns port code for given GPIOx base address
  */
@@ -415,6 +509,22 @@ typedef struct
 #define IRQ_NO_UART4	    52
 #define IRQ_NO_UART5	    53
 #define IRQ_NO_USART6	    71
+#define IRQ_NO_DMA1_STREAM0	11
+#define IRQ_NO_DMA1_STREAM1	12
+#define IRQ_NO_DMA1_STREAM2	13
+#define IRQ_NO_DMA1_STREAM3	14
+#define IRQ_NO_DMA1_STREAM4	15
+#define IRQ_NO_DMA1_STREAM5	16
+#define IRQ_NO_DMA1_STREAM6	17
+#define IRQ_NO_DMA1_STREAM7	47
+#define IRQ_NO_DMA2_STREAM0	56
+#define IRQ_NO_DMA2_STREAM1	57
+#define IRQ_NO_DMA2_STREAM2	58
+#define IRQ_NO_DMA2_STREAM3	59
+#define IRQ_NO_DMA2_STREAM4	60
+#define IRQ_NO_DMA2_STREAM5	68
+#define IRQ_NO_DMA2_STREAM6	69
+#define IRQ_NO_DMA2_STREAM7	70
 
 
 /*
@@ -482,6 +592,25 @@ typedef struct
 #define SPI_SR_BSY					 	7
 #define SPI_SR_FRE					 	8
 
+/*
+ * Bit position definitions SPI_I2SCFGR
+ */
+#define SPI_I2SCFGR_CHLEN				0
+#define SPI_I2SCFGR_DATLEN				1
+#define SPI_I2SCFGR_CKPOL				3
+#define SPI_I2SCFGR_I2SSTD				4
+#define SPI_I2SCFGR_PCMSYNC				7
+#define SPI_I2SCFGR_I2SCFG				8
+#define SPI_I2SCFGR_I2SE				10
+#define SPI_I2SCFGR_I2SMOD				11
+
+/*
+ * Bit position definitions SPI_I2SPR
+ */
+#define SPI_I2SPR_I2SDIV				0
+#define SPI_I2SPR_ODD					8
+#define SPI_I2SPR_MCKOE					9
+
 /******************************************************************************************
  *Bit position definitions of I2C peripheral
  ******************************************************************************************/
@@ -489,10 +618,18 @@ typedef struct
  * Bit position definitions I2C_CR1
  */
 #define I2C_CR1_PE						0
+#define I2C_CR1_SMBUS					1
+#define I2C_CR1_SMBTYPE					3
+#define I2C_CR1_ENARP					4
+#define I2C_CR1_ENPEC					5
+#define I2C_CR1_ENGC					6
 #define I2C_CR1_NOSTRETCH  				7
 #define I2C_CR1_START 					8
 #define I2C_CR1_STOP  				 	9
 #define I2C_CR1_ACK 				 	10
+#define I2C_CR1_POS 				 	11
+#define I2C_CR1_PEC 				 	12
+#define I2C_CR1_ALERT 				 	13
 #define I2C_CR1_SWRST  				 	15
 
 /*
@@ -502,6 +639,8 @@ typedef struct
 #define I2C_CR2_ITERREN				 	8
 #define I2C_CR2_ITEVTEN				 	9
 #define I2C_CR2_ITBUFEN 			    10
+#define I2C_CR2_DMAEN 			    	11
+#define I2C_CR2_LAST 			    	12
 
 /*
  * Bit position definitions I2C_OAR1
@@ -526,7 +665,9 @@ typedef struct
 #define I2C_SR1_ARLO 					9
 #define I2C_SR1_AF 					 	10
 #define I2C_SR1_OVR 					11
+#define I2C_SR1_PECERR 					12
 #define I2C_SR1_TIMEOUT 				14
+#define I2C_SR1_SMBALERT 				15
 
 /*
  * Bit position definitions I2C_SR2
@@ -536,6 +677,7 @@ typedef struct
 #define I2C_SR2_TRA 					2
 #define I2C_SR2_GENCALL 				4
 #define I2C_SR2_DUALF 					7
+#define I2C_SR2_PEC 					8
 
 /*
  * Bit position definitions I2C_CCR
@@ -613,8 +755,75 @@ typedef struct
 #define USART_SR_LBD        			8
 #define USART_SR_CTS        			9
 
+/******************************************************************************************
+ *Bit position definitions of RCC peripheral
+ ******************************************************************************************/
+
+/*
+ * Bit position definitions RCC_CR
+ */
+#define RCC_CR_PLLI2SON					26
+#define RCC_CR_PLLI2SRDY				27
+
+/*
+ * Bit position definitions RCC_CFGR
+ */
+#define RCC_CFGR_I2SSRC					23
+
+/*
+ * Bit position definitions RCC_PLLI2SCFGR
+ */
+#define RCC_PLLI2SCFGR_PLLI2SN			6
+#define RCC_PLLI2SCFGR_PLLI2SR			28
+
+/******************************************************************************************
+ *Bit position definitions of DMA peripheral
+ ******************************************************************************************/
+
+/*
+ * Bit position definitions DMA_SxCR
+ */
+#define DMA_SxCR_EN						0
+#define DMA_SxCR_DMEIE					1
+#define DMA_SxCR_TEIE					2
+#define DMA_SxCR_HTIE					3
+#define DMA_SxCR_TCIE					4
+#define DMA_SxCR_PFCTRL					5
+#define DMA_SxCR_DIR					6
+#define DMA_SxCR_CIRC					8
+#define DMA_SxCR_PINC					9
+#define DMA_SxCR_MINC					10
+#define DMA_SxCR_PSIZE					11
+#define DMA_SxCR_MSIZE					13
+#define DMA_SxCR_PINCOS					15
+#define DMA_SxCR_PL						16
+#define DMA_SxCR_DBM					18
+#define DMA_SxCR_CT						19
+#define DMA_SxCR_PBURST					21
+#define DMA_SxCR_MBURST					23
+#define DMA_SxCR_CHSEL					25
+
+/*
+ * Bit position definitions DMA_SxFCR
+ */
+#define DMA_SxFCR_FTH					0
+#define DMA_SxFCR_DMDIS					2
+#define DMA_SxFCR_FEIE					7
+
+/*
+ * Bit position definitions of the per stream flags in DMA_LISR/HISR (and LIFCR/HIFCR)
+ * Note : these are relative to the stream's base offset (0, 6, 16 or 22)
+ */
+#define DMA_ISR_FEIF					0
+#define DMA_ISR_DMEIF					2
+#define DMA_ISR_TEIF					3
+#define DMA_ISR_HTIF					4
+#define DMA_ISR_TCIF					5
+
 #include "stm32f407xx_gpio_driver.h"
+#include "stm32f407xx_dma_driver.h"
 #include "stm32f407xx_spi_driver.h"
+#include "stm32f407xx_i2s_driver.h"
 #include "stm32f407xx_i2c_driver.h"
 #include "stm32f407xx_usart_driver.h"
 #include "stm32f407xx_rcc_driver.h"
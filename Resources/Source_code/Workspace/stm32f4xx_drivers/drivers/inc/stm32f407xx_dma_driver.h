@@ -0,0 +1,148 @@
+/*
+ * stm32f407xx_dma_driver.h
+ *
+ *  Created on: Apr 14, 2019
+ *      Author: admin
+ */
+
+#ifndef INC_STM32F407XX_DMA_DRIVER_H_
+#define INC_STM32F407XX_DMA_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+/*
+ * Configuration structure for a DMA stream
+ */
+typedef struct
+{
+	uint8_t DMA_Channel;			/*!< possible values from @DMA_Channel >*/
+	uint8_t DMA_Direction;			/*!< possible values from @DMA_Direction >*/
+	uint8_t DMA_PeriphDataSize;		/*!< possible values from @DMA_DataSize >*/
+	uint8_t DMA_MemDataSize;		/*!< possible values from @DMA_DataSize >*/
+	uint8_t DMA_MemInc;				/*!< ENABLE or DISABLE >*/
+	uint8_t DMA_Mode;				/*!< possible values from @DMA_Mode >*/
+	uint8_t DMA_Priority;			/*!< possible values from @DMA_Priority >*/
+	uint8_t DMA_FIFOMode;			/*!< possible values from @DMA_FIFOMode >*/
+	uint8_t DMA_IntEnable;			/*!< OR of the @DMA_IT macros >*/
+}DMA_Config_t;
+
+/*
+ * Handle structure for a DMA stream
+ */
+typedef struct
+{
+	DMA_RegDef_t 	*pDMAx;			/*!< This holds the base address of DMAx(x:1,2) peripheral >*/
+	uint8_t 		Stream;			/*!< Stream number 0 to 7 >*/
+	DMA_Config_t 	DMAConfig;
+}DMA_Handle_t;
+
+
+/*
+ * @DMA_Channel
+ * request channel selection, refer DMA request mapping table in the RM
+ */
+#define DMA_CHANNEL_0		0
+#define DMA_CHANNEL_1		1
+#define DMA_CHANNEL_2		2
+#define DMA_CHANNEL_3		3
+#define DMA_CHANNEL_4		4
+#define DMA_CHANNEL_5		5
+#define DMA_CHANNEL_6		6
+#define DMA_CHANNEL_7		7
+
+/*
+ * @DMA_Direction
+ */
+#define DMA_DIR_PERIPH_TO_MEM	0
+#define DMA_DIR_MEM_TO_PERIPH	1
+#define DMA_DIR_MEM_TO_MEM		2
+
+/*
+ * @DMA_DataSize
+ */
+#define DMA_DATASIZE_BYTE		0
+#define DMA_DATASIZE_HALFWORD	1
+#define DMA_DATASIZE_WORD		2
+
+/*
+ * @DMA_Mode
+ */
+#define DMA_MODE_NORMAL			0
+#define DMA_MODE_CIRCULAR		1
+
+/*
+ * @DMA_Priority
+ */
+#define DMA_PRIORITY_LOW		0
+#define DMA_PRIORITY_MEDIUM		1
+#define DMA_PRIORITY_HIGH		2
+#define DMA_PRIORITY_VERY_HIGH	3
+
+/*
+ * @DMA_FIFOMode
+ */
+#define DMA_FIFOMODE_DI			0	/* direct mode */
+#define DMA_FIFOMODE_EN			1	/* FIFO enabled, threshold full */
+
+/*
+ * @DMA_IT
+ */
+#define DMA_IT_TE				( 1 << DMA_SxCR_TEIE)
+#define DMA_IT_HT				( 1 << DMA_SxCR_HTIE)
+#define DMA_IT_TC				( 1 << DMA_SxCR_TCIE)
+
+/*
+ * DMA stream status flags definitions
+ * Note : these are stream relative, the driver shifts them to the stream's position in LISR/HISR
+ */
+#define DMA_FLAG_FE				( 1 << DMA_ISR_FEIF)
+#define DMA_FLAG_DME			( 1 << DMA_ISR_DMEIF)
+#define DMA_FLAG_TE				( 1 << DMA_ISR_TEIF)
+#define DMA_FLAG_HT				( 1 << DMA_ISR_HTIF)
+#define DMA_FLAG_TC				( 1 << DMA_ISR_TCIF)
+#define DMA_FLAG_ALL			( DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC )
+
+/*
+ * Maximum number of data items of one stream transfer (NDTR is 16 bits wide)
+ */
+#define DMA_MAX_NDTR			0xFFFF
+
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+/*
+ * Peripheral Clock setup
+ */
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi);
+
+/*
+ * Init and De-init
+ */
+void DMA_Init(DMA_Handle_t *pDMAHandle);
+void DMA_DeInit(DMA_Handle_t *pDMAHandle);
+
+/*
+ * Transfer control
+ */
+void DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len);
+void DMA_StartDoubleBuffer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len);
+void DMA_StopTransfer(DMA_Handle_t *pDMAHandle);
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle);
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle);
+
+/*
+ * IRQ Configuration and ISR handling
+ */
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void DMA_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
+uint8_t DMA_IRQHandling(DMA_Handle_t *pDMAHandle);
+
+/*
+ * Other Peripheral Control APIs
+ */
+uint8_t DMA_GetFlagStatus(DMA_Handle_t *pDMAHandle, uint32_t FlagName);
+void DMA_ClearFlag(DMA_Handle_t *pDMAHandle, uint32_t FlagName);
+
+#endif /* INC_STM32F407XX_DMA_DRIVER_H_ */
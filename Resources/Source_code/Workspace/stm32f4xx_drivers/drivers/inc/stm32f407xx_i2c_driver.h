@@ -10,18 +10,117 @@
 
 #include "stm32f407xx.h"
 
+/*
+ * Clock registers of the I2C for one PCLK1 and SCL speed, see I2C_ComputeTiming / I2C_TIMING_xx
+ */
+typedef struct
+{
+	uint32_t PCLK1;					/*!< APB1 clock in Hz the values are computed for, CR2 FREQ is PCLK1 / 1MHz >*/
+	uint16_t CCR;					/*!< whole CCR register : F/S, DUTY and CCR >*/
+	uint8_t  TRISE;					/*!< TRISE register >*/
+	uint32_t SCLReal;				/*!< resulting SCL frequency in Hz, rise time not included >*/
+}I2C_Timing_t;
+
 /*
  * Configuration structure for I2Cx peripheral
  */
 typedef struct
 {
 	uint32_t I2C_SCLSpeed;
-	uint8_t  I2C_DeviceAddress;
+	uint16_t I2C_DeviceAddress;		/*!< own address, 10 bit with I2C_AddrMode = I2C_ADDRMODE_10BIT >*/
+	uint8_t  I2C_AddrMode;			/*!< possible values from @I2C_AddrMode >*/
 	uint8_t  I2C_AckControl;
 	uint8_t  I2C_FMDutyCycle;
+	const I2C_Timing_t *pI2C_Timing;	/*!< precomputed clock registers, NULL : computed by I2C_Init from the live PCLK1 >*/
+	uint32_t I2C_Timeout;		/*!< max CPU cycles a flag wait or an IT/DMA transfer may stall, 0 : I2C_TIMEOUT_DEFAULT >*/
+	uint8_t  I2C_PEC;			/*!< ENABLE : SMBus PEC sent after the data of a write and checked at the end of a read >*/
+	uint8_t  I2C_ArloRetries;	/*!< retries of a blocking or queued transfer after an arbitration loss, 0 : none >*/
 
 }I2C_Config_t;
 
+/*
+ * One transfer to a device, queued with I2C_QueueTransaction
+ * The structure is owned by the driver until its callback is called
+ */
+typedef struct I2C_Transaction
+{
+	uint8_t 		Type;			/* !< possible values from @I2C_TransType > */
+	uint16_t 		SlaveAddr;		/* !< 7 bit slave address, or I2C_ADDR_10BIT(addr) > */
+	uint16_t 		MemAddr;		/* !< register address, I2C_TRANS_MEM_xxx only > */
+	uint8_t 		MemAddrSize;	/* !< @I2C_MemAddrSize, I2C_TRANS_MEM_xxx only > */
+	uint8_t 		*pBuffer;		/* !< data to send or Rx buffer > */
+	uint32_t 		Len;			/* !< 255 max for I2C_TRANS_READ without DMA, 65535 max with DMA > */
+	void 			(*Callback)(struct I2C_Transaction *pTrans, uint8_t AppEv);	/* !< may be NULL > */
+	void 			*pContext;		/* !< application data for the callback > */
+	struct I2C_Transaction *pNext;	/* !< used by the driver > */
+}I2C_Transaction_t;
+
+/*
+ * One entry of a slave register file, covers the register addresses Addr to Addr + Size - 1
+ */
+typedef struct I2C_Register
+{
+	uint8_t 		Addr;			/* !< first register address of the entry > */
+	uint8_t 		Size;			/* !< number of bytes, at least 1 > */
+	uint8_t 		Access;			/* !< possible values from @I2C_RegAccess > */
+	uint8_t 		*pData;			/* !< Size bytes of application memory, served as is > */
+	void 			(*OnWrite)(struct I2C_Register *pReg);	/* !< called when the last byte of the entry is written, may be NULL > */
+}I2C_Register_t;
+
+/*
+ * Slave register file served by the driver, see I2C_SlaveRegFileInit
+ */
+typedef struct
+{
+	I2C_Register_t	*pTable;		/* !< entries sorted by Addr, not overlapping > */
+	uint8_t 		NumRegs;
+	uint8_t 		Ptr;			/* !< used by the driver : register address of the next byte > */
+	uint8_t 		Idx;			/* !< used by the driver : first entry which ends after Ptr > */
+	uint8_t 		AddrPhase;		/* !< used by the driver : next received byte is a register address > */
+	uint8_t 		Nacked;			/* !< used by the driver : master ended the read, no more bytes to send > */
+}I2C_RegFile_t;
+
+/*
+ * Event trace, compiled in with -DI2C_TRACE
+ * The event/error IRQ handlers log SR1, SR2 and the DWT cycle count of every interrupt into
+ * I2C_Trace, START and STOP requests are logged as marks. Entries are taken in time order under
+ * IRQ_LOCK, without I2C_TRACE the calls compile to nothing. Halt the target, dump the ring
+ * (gdb : dump binary value i2c_trace.bin I2C_Trace) and decode it with tools/i2c_trace.py
+ */
+#ifndef I2C_TRACE_DEPTH
+#define I2C_TRACE_DEPTH			128		/* entries, power of 2 */
+#endif
+
+/*
+ * @I2C_TraceTag
+ * bits 7:4 source, bits 3:0 I2C number (1 to 3)
+ */
+#define I2C_TRACE_EV			0x10
+#define I2C_TRACE_ER			0x20
+#define I2C_TRACE_START			0x30
+#define I2C_TRACE_STOP			0x40
+
+#define I2C_TRACE_SR2_NONE		0xFF	/* SR2 not read : ADDR was pending, reading SR2 would clear it */
+
+typedef struct
+{
+	uint32_t 		Stamp;			/* !< DWT_CYCCNT at the interrupt or the request > */
+	uint16_t 		SR1;			/* !< 0 for the START/STOP marks > */
+	uint8_t 		SR2;			/* !< bits 7:0 of SR2, or I2C_TRACE_SR2_NONE > */
+	uint8_t 		Tag;			/* !< @I2C_TraceTag > */
+}I2C_TraceEntry_t;
+
+typedef struct
+{
+	uint32_t 		Head;			/* !< entries written so far, the next one goes to Head % Depth > */
+	uint32_t 		Depth;			/* !< I2C_TRACE_DEPTH, for the decoder > */
+	I2C_TraceEntry_t Entry[I2C_TRACE_DEPTH];
+}I2C_Trace_t;
+
+#ifdef I2C_TRACE
+extern I2C_Trace_t I2C_Trace;
+#endif
+
 /*
  *Handle structure for I2Cx peripheral
  */
@@ -34,9 +133,35 @@ typedef struct
 	uint32_t 		TxLen;		/* !< To store Tx len > */
 	uint32_t 		RxLen;		/* !< To store Tx len > */
 	uint8_t 		TxRxState;	/* !< To store Communication state > */
-	uint8_t 		DevAddr;	/* !< To store slave/device address > */
+	uint16_t 		DevAddr;	/* !< To store slave/device address > */
     uint32_t        RxSize;		/* !< To store Rx size  > */
     uint8_t         Sr;			/* !< To store repeated start value  > */
+    DMA_Handle_t	*pDMATx;	/* !< DMA stream used for Tx, NULL if Tx DMA is not used > */
+    DMA_Handle_t	*pDMARx;	/* !< DMA stream used for Rx, NULL if Rx DMA is not used > */
+    uint8_t			MemXfer;	/* !< @I2C_MemXfer, register access in progress > */
+    uint16_t		MemAddr;	/* !< register address of I2C_MemRead/I2C_MemWrite > */
+    uint8_t			MemAddrLen;	/* !< register address bytes still to be sent > */
+    I2C_Transaction_t *pQueueHead;	/* !< transaction on the bus, NULL if the queue is idle > */
+    I2C_Transaction_t *pQueueTail;	/* !< last queued transaction > */
+    uint8_t			QueueActive;	/* !< the transfer in flight is the queue head's, not a direct one > */
+    GPIO_RegDef_t	*pSCLPort;	/* !< SCL/SDA pins for the bus clear of I2C_BusRecover, NULL skips it > */
+    uint8_t			SCLPin;
+    GPIO_RegDef_t	*pSDAPort;
+    uint8_t			SDAPin;
+    uint32_t		EvStamp;	/* !< DWT time of the last progress of the IT/DMA transfer > */
+    uint16_t		DMARemaining;	/* !< NDTR of the stream at the last I2C_TimeoutHandling, DMA progress > */
+    I2C_RegFile_t	*pRegFile;	/* !< slave register file serving DATA_REQ/DATA_RCV, NULL : application does > */
+    I2C_Timing_t	Timing;		/* !< clock registers programmed by the last I2C_Init > */
+    uint8_t			Addr10Read;	/* !< 10 bit reception : slave selected, next SB sends the read header > */
+    uint8_t			PECSent;	/* !< PEC requested after the last Tx byte > */
+    uint8_t			PECErr;		/* !< PECERR seen by the error interrupt during the reception > */
+    uint8_t			ArloRetry;	/* !< retries of the queue head so far > */
+    uint32_t		RetryStamp;	/* !< DWT time of the arbitration loss of the queue head > */
+    uint32_t		RetryDelay;	/* !< backoff in CPU cycles before the queue head goes again, 0 : no retry pending > */
+    uint8_t			StopWait;	/* !< queue head waits for the STOP of the previous transfer, since EvStamp > */
+    uint32_t		ArloCount;	/* !< arbitration losses, never reset by the driver > */
+    uint32_t		RetryCount;	/* !< transfers scheduled again after a loss > */
+    uint32_t		LostCount;	/* !< transfers ended with I2C_ERROR_ARLO, out of retries or not retried > */
 }I2C_Handle_t;
 
 
@@ -47,6 +172,46 @@ typedef struct
 #define I2C_BUSY_IN_RX 				1
 #define I2C_BUSY_IN_TX 				2
 
+/*
+ * @I2C_MemXfer
+ */
+#define I2C_MEM_NONE				0
+#define I2C_MEM_WRITE				1
+#define I2C_MEM_READ				2
+
+/*
+ * @I2C_TransType
+ */
+#define I2C_TRANS_WRITE				0
+#define I2C_TRANS_READ				1
+#define I2C_TRANS_MEM_WRITE			2
+#define I2C_TRANS_MEM_READ			3
+
+/*
+ * @I2C_RegAccess
+ * bit 0 : the master may read, bit 1 : the master may write
+ */
+#define I2C_REG_RO					1
+#define I2C_REG_WO					2
+#define I2C_REG_RW					3
+
+/*
+ * @I2C_MemAddrSize
+ * width of the register address sent before the data
+ */
+#define I2C_MEMADD_SIZE_8BIT		1
+#define I2C_MEMADD_SIZE_16BIT		2
+
+/*
+ * @I2C_AddrMode
+ * own address size, a master selects a 10 bit slave with I2C_ADDR_10BIT(addr)
+ */
+#define I2C_ADDRMODE_7BIT			0
+#define I2C_ADDRMODE_10BIT			1
+
+#define I2C_ADDR_10BIT_FLAG			0x8000
+#define I2C_ADDR_10BIT(addr)		( I2C_ADDR_10BIT_FLAG | ((addr) & 0x3FF) )
+
 /*
  * @I2C_SCLSpeed
  */
@@ -64,9 +229,38 @@ typedef struct
 
 /*
  * @I2C_FMDutyCycle
+ * tLOW/tHIGH, AUTO picks the one which gives the SCL closest to the request (I2C_ComputeTiming only)
  */
 #define I2C_FM_DUTY_2        0
 #define I2C_FM_DUTY_16_9     1
+#define I2C_FM_DUTY_AUTO     2
+
+/*
+ * I2C_ComputeTiming / I2C_ValidateTiming / I2C_Init results
+ */
+#define I2C_TIMING_OK			0
+#define I2C_TIMING_ERR_PCLK1	1	/* PCLK1 under 2MHz (Sm) / 4MHz (Fm) or over 50MHz */
+#define I2C_TIMING_ERR_CCR		2	/* CCR out of its 4 (1 in fast mode) to 4095 range */
+#define I2C_TIMING_ERR_SCL		3	/* SCL over 100kHz (Sm) / 400kHz (Fm), or tLOW/tHIGH under the spec minimum */
+#define I2C_TIMING_ERR_TRISE	4	/* TRISE does not match the 1000ns (Sm) / 300ns (Fm) max rise time */
+
+/*
+ * Compile time I2C_Timing_t for a known PCLK1, e.g.
+ * 		const I2C_Timing_t I2C1Timing = I2C_TIMING_FM_16_9(40000000U, I2C_SCL_SPEED_FM4K);
+ * CCR is rounded up so SCL never exceeds the request. Unlike I2C_ComputeTiming these do not
+ * enforce the tLOW/tHIGH minimums, check a new profile once with I2C_ValidateTiming.
+ * Duty 16/9 gives exactly 400kHz when PCLK1 is a multiple of 10MHz
+ */
+#define I2C_CCR_CEIL(pclk1,div)			( ((pclk1) + (div) - 1U) / (div) )
+#define I2C_TRISE_SM(pclk1)				( ((pclk1) / 1000000U) + 1U )
+#define I2C_TRISE_FM(pclk1)				( ((((pclk1) / 1000000U) * 300U) / 1000U) + 1U )
+
+#define I2C_TIMING_SM(pclk1,scl)		{ (pclk1), I2C_CCR_CEIL(pclk1, 2U * (scl)), I2C_TRISE_SM(pclk1), \
+										  (pclk1) / (2U * I2C_CCR_CEIL(pclk1, 2U * (scl))) }
+#define I2C_TIMING_FM(pclk1,scl)		{ (pclk1), ( 1U << I2C_CCR_FS) | I2C_CCR_CEIL(pclk1, 3U * (scl)), I2C_TRISE_FM(pclk1), \
+										  (pclk1) / (3U * I2C_CCR_CEIL(pclk1, 3U * (scl))) }
+#define I2C_TIMING_FM_16_9(pclk1,scl)	{ (pclk1), ( 1U << I2C_CCR_FS) | ( 1U << I2C_CCR_DUTY) | I2C_CCR_CEIL(pclk1, 25U * (scl)), \
+										  I2C_TRISE_FM(pclk1), (pclk1) / (25U * I2C_CCR_CEIL(pclk1, 25U * (scl))) }
 
 
 /*
@@ -84,10 +278,34 @@ typedef struct
 #define I2C_FLAG_BTF  		( 1 << I2C_SR1_BTF)
 #define I2C_FLAG_ADDR 		( 1 << I2C_SR1_ADDR)
 #define I2C_FLAG_TIMEOUT 	( 1 << I2C_SR1_TIMEOUT)
+#define I2C_FLAG_PECERR 	( 1 << I2C_SR1_PECERR)
 
 #define I2C_DISABLE_SR  	RESET
 #define I2C_ENABLE_SR   	SET
 
+/*
+ * default of I2C_Timeout, 6ms at 168MHz, a few bytes at 100kHz with clock stretching
+ */
+#define I2C_TIMEOUT_DEFAULT		1000000U
+
+/*
+ * backoff after an arbitration loss in CPU cycles, powers of 2 : MIN << retry, up to MAX,
+ * plus a random part of up to as much again. 12us to 1.5ms at 168MHz
+ */
+#define I2C_ARLO_BACKOFF_MIN		2048U
+#define I2C_ARLO_BACKOFF_MAX		262144U
+
+/*
+ * most a queued START waits in the ISR for the STOP of the previous transfer to leave the bus,
+ * 4 SCL periods at 100kHz at the max HCLK of 168MHz. Past it the start is left to I2C_TimeoutHandling
+ */
+#define I2C_STOP_WAIT				6720U
+
+/*
+ * SCL half period of the bus clear, 5us (100kHz) at the max HCLK of 168MHz, slower below
+ */
+#define I2C_BUSCLEAR_HALF_PERIOD	840U
+
 
 /*
  * I2C application events macros
@@ -102,6 +320,11 @@ typedef struct
 #define I2C_ERROR_TIMEOUT 		7
 #define I2C_EV_DATA_REQ         8
 #define I2C_EV_DATA_RCV         9
+#define I2C_ERROR_DMA           10
+#define I2C_ERROR_BUS_BUSY      11
+#define I2C_ERROR_BUS_RECOVERED 12
+#define I2C_ERROR_BUS_STUCK     13
+#define I2C_ERROR_PEC           14
 
 /******************************************************************************************
  *								APIs supported by this driver
@@ -115,17 +338,22 @@ void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
 /*
  * Init and De-init
  */
-void I2C_Init(I2C_Handle_t *pI2CHandle);
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle);
 void I2C_DeInit(I2C_RegDef_t *pI2Cx);
 
 
 /*
  * Data Send and Receive
  */
-void I2C_MasterSendData(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint8_t SlaveAddr,uint8_t Sr);
-void I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr,uint8_t Sr);
-uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint8_t SlaveAddr,uint8_t Sr);
-uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MasterSendData(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MemWrite(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t I2C_MemRead(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t I2C_MasterSendDataDMA(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint16_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_MasterReceiveDataDMA(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint16_t Len, uint16_t SlaveAddr,uint8_t Sr);
+uint8_t I2C_QueueTransaction(I2C_Handle_t *pI2CHandle, I2C_Transaction_t *pTrans);
 
 void I2C_CloseReceiveData(I2C_Handle_t *pI2CHandle);
 void I2C_CloseSendData(I2C_Handle_t *pI2CHandle);
@@ -133,6 +361,7 @@ void I2C_CloseSendData(I2C_Handle_t *pI2CHandle);
 
 void I2C_SlaveSendData(I2C_RegDef_t *pI2C,uint8_t data);
 uint8_t I2C_SlaveReceiveData(I2C_RegDef_t *pI2C);
+void I2C_SlaveRegFileInit(I2C_Handle_t *pI2CHandle, I2C_RegFile_t *pRegFile);
 
 /*
  * IRQ Configuration and ISR handling
@@ -141,6 +370,9 @@ void I2C_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
 void I2C_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
 void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle);
 void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_DMATxIRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_DMARxIRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_TimeoutHandling(I2C_Handle_t *pI2CHandle);
 
 
 /*
@@ -149,7 +381,10 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle);
 void I2C_PeripheralControl(I2C_RegDef_t *pI2Cx, uint8_t EnOrDi);
 uint8_t I2C_GetFlagStatus(I2C_RegDef_t *pI2Cx , uint32_t FlagName);
 void I2C_ManageAcking(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
+uint8_t I2C_ComputeTiming(uint32_t PCLK1, uint32_t SCLSpeed, uint8_t FMDutyCycle, I2C_Timing_t *pTiming);
+uint8_t I2C_ValidateTiming(const I2C_Timing_t *pTiming);
 void I2C_GenerateStopCondition(I2C_RegDef_t *pI2Cx);
+uint8_t I2C_BusRecover(I2C_Handle_t *pI2CHandle);
 
 void I2C_SlaveEnableDisableCallbackEvents(I2C_RegDef_t *pI2Cx,uint8_t EnorDi);
 
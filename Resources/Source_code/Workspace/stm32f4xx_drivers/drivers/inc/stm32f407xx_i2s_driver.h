@@ -0,0 +1,158 @@
+/*
+ * stm32f407xx_i2s_driver.h
+ *
+ *  Created on: Apr 18, 2019
+ *      Author: admin
+ */
+
+#ifndef INC_STM32F407XX_I2S_DRIVER_H_
+#define INC_STM32F407XX_I2S_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+/*
+ *  Configuration structure for I2Sx peripheral (SPI2/SPI3 in I2S mode)
+ */
+typedef struct
+{
+	uint8_t I2S_Mode;				/*!< possible values from @I2S_Mode >*/
+	uint8_t I2S_Standard;			/*!< possible values from @I2S_Standard >*/
+	uint8_t I2S_DataFormat;			/*!< possible values from @I2S_DataFormat >*/
+	uint8_t I2S_MCLKOutput;			/*!< ENABLE or DISABLE, master modes only >*/
+	uint8_t I2S_CPOL;				/*!< possible values from @I2S_CPOL >*/
+	uint32_t I2S_AudioFreq;			/*!< sampling frequency in Hz, master modes only >*/
+}I2S_Config_t;
+
+/*
+ * PLLI2S and prescaler settings for one sampling frequency, see I2S_ComputeClock
+ */
+typedef struct
+{
+	uint16_t PLLI2SN;
+	uint8_t  PLLI2SR;
+	uint8_t  I2SDIV;
+	uint8_t  ODD;
+}I2S_Clock_t;
+
+/*
+ *Handle structure for I2Sx peripheral
+ */
+typedef struct
+{
+	SPI_RegDef_t 	*pSPIx;   	/*!< SPI2 or SPI3, the only SPIs with I2S on this device >*/
+	I2S_Config_t 	I2SConfig;
+	DMA_Handle_t	*pDMA;		/* !< SPIx_TX stream for the transmit modes, SPIx_RX stream for the receive modes > */
+	uint16_t		*pBuffer;	/* !< circular buffer being streamed > */
+	uint16_t		Len;		/* !< size of the whole buffer in half words > */
+	uint8_t			State;		/* !< @I2S_State > */
+	uint32_t		AudioFreqReal;	/* !< sampling frequency achieved by I2S_Init, master modes only > */
+}I2S_Handle_t;
+
+
+/*
+ * @I2S_State
+ */
+#define I2S_READY 					0
+#define I2S_BUSY_STREAMING			1
+
+/*
+ * Possible I2S Application events
+ * HALF_CMPLT : the first half of the buffer was played (Tx) or filled (Rx), the application owns it now
+ * CMPLT      : same for the second half, the stream continues with the first half
+ */
+#define I2S_EVENT_HALF_CMPLT   	1
+#define I2S_EVENT_CMPLT   		2
+#define I2S_EVENT_OVR_ERR    	3
+#define I2S_EVENT_UDR_ERR    	4
+#define I2S_EVENT_FRE_ERR    	5
+#define I2S_EVENT_DMA_ERR    	6
+
+
+/*
+ * @I2S_Mode
+ */
+#define I2S_MODE_SLAVE_TX		0
+#define I2S_MODE_SLAVE_RX		1
+#define I2S_MODE_MASTER_TX		2
+#define I2S_MODE_MASTER_RX		3
+
+/*
+ * @I2S_Standard
+ */
+#define I2S_STANDARD_PHILIPS	0
+#define I2S_STANDARD_MSB		1
+#define I2S_STANDARD_LSB		2
+#define I2S_STANDARD_PCM_SHORT	3
+#define I2S_STANDARD_PCM_LONG	4
+
+/*
+ * @I2S_DataFormat
+ * data bits / channel bits
+ */
+#define I2S_DATAFORMAT_16B				0	/* 16 in a 16 bit channel */
+#define I2S_DATAFORMAT_16B_EXTENDED		1	/* 16 in a 32 bit channel */
+#define I2S_DATAFORMAT_24B				2	/* 24 in a 32 bit channel */
+#define I2S_DATAFORMAT_32B				3	/* 32 in a 32 bit channel */
+
+/*
+ * @I2S_CPOL
+ * steady state of the clock line
+ */
+#define I2S_CPOL_LOW 	0
+#define I2S_CPOL_HIGH 	1
+
+/*
+ * 24 and 32 bit samples go through DR as two half words, most significant half word first.
+ * Use this on a uint32_t sample to get the half word order the DMA expects in memory
+ */
+#define I2S_SAMPLE32(x)		( ((uint32_t)(x) << 16) | ((uint32_t)(x) >> 16) )
+
+/*
+ * I2S related status flags definitions
+ */
+#define I2S_TXE_FLAG    ( 1 << SPI_SR_TXE)
+#define I2S_RXNE_FLAG   ( 1 << SPI_SR_RXNE)
+#define I2S_CHSIDE_FLAG ( 1 << SPI_SR_CHSIDE)
+#define I2S_BUSY_FLAG   ( 1 << SPI_SR_BSY)
+
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+/*
+ * Peripheral Clock setup
+ */
+void I2S_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi);
+
+/*
+ * Init and De-init
+ */
+void I2S_Init(I2S_Handle_t *pI2SHandle);
+void I2S_DeInit(SPI_RegDef_t *pSPIx);
+
+/*
+ * Continuous streaming
+ */
+uint8_t I2S_StartStream(I2S_Handle_t *pI2SHandle, uint16_t *pBuffer, uint16_t Len);
+void I2S_StopStream(I2S_Handle_t *pI2SHandle);
+
+/*
+ * ISR handling, the NVIC lines are the SPI ones (SPI_IRQInterruptConfig / DMA_IRQInterruptConfig)
+ */
+void I2S_IRQHandling(I2S_Handle_t *pI2SHandle);
+void I2S_DMAIRQHandling(I2S_Handle_t *pI2SHandle);
+
+/*
+ * Other Peripheral Control APIs
+ */
+uint32_t I2S_ComputeClock(I2S_Config_t *pI2SConfig, I2S_Clock_t *pClock);
+void I2S_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
+uint8_t I2S_GetFlagStatus(SPI_RegDef_t *pSPIx , uint32_t FlagName);
+
+/*
+ * Application callback
+ */
+void I2S_ApplicationEventCallback(I2S_Handle_t *pI2SHandle,uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_I2S_DRIVER_H_ */
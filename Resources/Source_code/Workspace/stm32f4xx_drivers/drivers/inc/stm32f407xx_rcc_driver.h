@@ -18,4 +18,10 @@ uint32_t RCC_GetPCLK2Value(void);
 
 
 uint32_t  RCC_GetPLLOutputClock(void);
+
+//This returns the PLLI2S output (I2SCLK when I2SSRC selects PLLI2S)
+uint32_t  RCC_GetPLLI2SOutputClock(void);
+
+//This reprograms and starts the PLLI2S
+void RCC_PLLI2SConfig(uint16_t PLLI2SN, uint8_t PLLI2SR);
 #endif /* INC_STM32F407XX_RCC_DRIVER_H_ */
@@ -18,13 +18,64 @@ typedef struct
 	uint8_t SPI_DeviceMode;
 	uint8_t SPI_BusConfig;
 	uint8_t SPI_SclkSpeed;
+	uint32_t SPI_SclkHz;			/*!< requested SCLK in Hz, 0 uses SPI_SclkSpeed as is >*/
 	uint8_t SPI_DFF;
 	uint8_t SPI_CPOL;
 	uint8_t SPI_CPHA;
 	uint8_t SPI_SSM;
+	uint8_t SPI_CRC;				/*!< possible values from @SPI_CRC >*/
+	uint16_t SPI_CRCPolynomial;		/*!< CRCPR value, 0 keeps the reset value 7 >*/
+	uint8_t SPI_IRQBurst;			/*!< max TXE/RXNE rounds serviced per SPI interrupt entry, 0 or 1 : one >*/
 }SPI_Config_t;
 
 
+/*
+ * A slave device sharing the bus, with its own chip select and clock settings
+ */
+typedef struct
+{
+	uint8_t 		DeviceId;		/* !< application defined id, not used by the driver > */
+	GPIO_RegDef_t 	*pCSPort;		/* !< GPIO port of the chip select, pin must be an output idling high > */
+	uint8_t 		CSPin;			/* !< GPIO pin number of the chip select > */
+	uint8_t 		SPI_SclkSpeed;	/* !< possible values from @SPI_SclkSpeed > */
+	uint32_t 		SPI_SclkHz;		/* !< requested SCLK in Hz, 0 uses SPI_SclkSpeed as is > */
+	uint8_t 		SPI_DFF;		/* !< possible values from @SPI_DFF > */
+	uint8_t 		SPI_CPOL;		/* !< possible values from @CPOL > */
+	uint8_t 		SPI_CPHA;		/* !< possible values from @CPHA > */
+}SPI_Device_t;
+
+/*
+ * One full duplex transfer to a device, queued with SPI_QueueTransaction
+ * The structure is owned by the driver until its callback is called
+ */
+typedef struct SPI_Transaction
+{
+	SPI_Device_t 	*pDevice;
+	uint8_t 		*pTxBuffer;		/* !< NULL clocks out 0xFF dummy frames > */
+	uint8_t 		*pRxBuffer;		/* !< NULL throws the received frames away > */
+	uint32_t 		Len;
+	void 			(*Callback)(struct SPI_Transaction *pTrans, uint8_t AppEv);	/* !< may be NULL > */
+	void 			*pContext;		/* !< application data for the callback > */
+	struct SPI_Transaction *pNext;	/* !< used by the driver > */
+}SPI_Transaction_t;
+
+/*
+ * Two application buffers for continuous slave reception (SPI_SlaveReceivePingPong)
+ * The hardware fills one of them while the application owns the other
+ */
+typedef struct
+{
+	uint8_t 		*pBuffer[2];	/* !< two buffers of Len bytes each, half word aligned in 16 bit DFF > */
+	uint32_t 		Len;			/* !< size of each buffer in bytes > */
+	uint8_t 		*pReady;		/* !< buffer handed over with the last SPI_EVENT_RX_BUF_READY > */
+	uint32_t 		ReadyLen;		/* !< number of bytes received in pReady > */
+	uint8_t 		Fill;			/* !< used by the driver : index of the buffer being filled > */
+	uint8_t 		M0Buffer;		/* !< used by the driver : index of the buffer in DMA M0AR > */
+	uint32_t 		Count;			/* !< used by the driver : bytes in the fill buffer (IT mode) > */
+	uint8_t 		Owned;			/* !< used by the driver : bit n set while the application owns pBuffer[n] > */
+}SPI_PingPong_t;
+
+
 /*
  *Handle structure for SPIx peripheral
  */
@@ -38,6 +89,14 @@ typedef struct
 	uint32_t 		RxLen;		/* !< To store Tx len > */
 	uint8_t 		TxState;	/* !< To store Tx state > */
 	uint8_t 		RxState;	/* !< To store Rx state > */
+	DMA_Handle_t	*pDMATx;	/* !< DMA stream used for Tx, NULL if Tx DMA is not used > */
+	DMA_Handle_t	*pDMARx;	/* !< DMA stream used for Rx, NULL if Rx DMA is not used > */
+	uint8_t			TxRxLinked;	/* !< Set while Tx and Rx run in lockstep (SPI_TransmitReceiveIT, SPI_TransferDMA) > */
+	uint8_t			CRCPending;	/* !< Set while the CRC frame which follows the data is awaited > */
+	SPI_Transaction_t *pQueueHead;	/* !< transaction on the bus, NULL if the queue is idle > */
+	SPI_Transaction_t *pQueueTail;	/* !< last queued transaction > */
+	SPI_PingPong_t	*pPingPong;	/* !< set while ping-pong slave reception runs > */
+	uint32_t		IRQEntries;	/* !< SPI interrupt entries since the last IT transfer was started > */
 }SPI_Handle_t;
 
 
@@ -48,6 +107,13 @@ typedef struct
 #define SPI_BUSY_IN_RX 				1
 #define SPI_BUSY_IN_TX 				2
 
+/*
+ * SPI request errors, returned in place of the state when a transfer is refused
+ */
+#define SPI_ERR_NO_DMA				3		/* a DMA stream the transfer needs is not attached */
+#define SPI_ERR_LEN					4		/* odd number of bytes in 16 bit DFF, or a ping-pong Len out of range */
+#define SPI_ERR_DFF					5		/* half word API used in 8 bit DFF */
+
 /*
  * Possible SPI Application events
  */
@@ -55,6 +121,10 @@ typedef struct
 #define SPI_EVENT_RX_CMPLT   2
 #define SPI_EVENT_OVR_ERR    3
 #define SPI_EVENT_CRC_ERR    4
+#define SPI_EVENT_DMA_ERR    5
+#define SPI_EVENT_TRANS_CMPLT 6
+#define SPI_EVENT_RX_BUF_READY 7
+#define SPI_EVENT_START_ERR 8
 
 
 
@@ -108,6 +178,13 @@ typedef struct
 #define SPI_SSM_EN     1
 #define SPI_SSM_DI     0
 
+/*
+ * @SPI_CRC
+ * hardware CRC is appended after the last frame (CRCNEXT) and checked on reception
+ */
+#define SPI_CRC_DI     0
+#define SPI_CRC_EN     1
+
 
 /*
  * SPI related status flags definitions
@@ -115,6 +192,7 @@ typedef struct
 #define SPI_TXE_FLAG    ( 1 << SPI_SR_TXE)
 #define SPI_RXNE_FLAG   ( 1 << SPI_SR_RXNE)
 #define SPI_BUSY_FLAG   ( 1 << SPI_SR_BSY)
+#define SPI_CRCERR_FLAG ( 1 << SPI_SR_CRCERR)
 
 
 
@@ -137,11 +215,36 @@ void SPI_DeInit(SPI_RegDef_t *pSPIx);
 /*
  * Data Send and Receive
  */
-void SPI_SendData(SPI_RegDef_t *pSPIx,uint8_t *pTxBuffer, uint32_t Len);
-void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_SendData(SPI_RegDef_t *pSPIx,uint8_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_TransmitReceive(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+
+uint8_t SPI_SendData16(SPI_RegDef_t *pSPIx, uint16_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveData16(SPI_RegDef_t *pSPIx, uint16_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_TransmitReceive16(SPI_RegDef_t *pSPIx, uint16_t *pTxBuffer, uint16_t *pRxBuffer, uint32_t Len);
 
 uint8_t SPI_SendDataIT(SPI_Handle_t *pSPIHandle,uint8_t *pTxBuffer, uint32_t Len);
 uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_TransmitReceiveIT(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_SendData16IT(SPI_Handle_t *pSPIHandle, uint16_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveData16IT(SPI_Handle_t *pSPIHandle, uint16_t *pRxBuffer, uint32_t Len);
+
+uint8_t SPI_SendDataDMA(SPI_Handle_t *pSPIHandle,uint8_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+
+/*
+ * Transaction queue, several devices on one bus
+ */
+uint8_t SPI_QueueTransaction(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pTrans);
+
+/*
+ * Slave continuous reception with two buffers
+ */
+uint8_t SPI_SlaveReceivePingPong(SPI_Handle_t *pSPIHandle, SPI_PingPong_t *pPingPong);
+void SPI_SlaveReleaseBuffer(SPI_Handle_t *pSPIHandle, uint8_t *pBuffer);
+void SPI_SlaveStopPingPong(SPI_Handle_t *pSPIHandle);
+void SPI_SlaveNSSHandling(SPI_Handle_t *pSPIHandle);
 
 /*
  * IRQ Configuration and ISR handling
@@ -149,15 +252,21 @@ uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t
 void SPI_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
 void SPI_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
 void SPI_IRQHandling(SPI_Handle_t *pHandle);
+void SPI_DMATxIRQHandling(SPI_Handle_t *pSPIHandle);
+void SPI_DMARxIRQHandling(SPI_Handle_t *pSPIHandle);
 
 /*
  * Other Peripheral Control APIs
  */
+uint8_t SPI_ComputeSclkSpeed(SPI_RegDef_t *pSPIx, uint32_t SclkHz);
+uint32_t SPI_GetSclkValue(SPI_RegDef_t *pSPIx);
+void SPI_UpdateClock(SPI_Handle_t *pSPIHandle);
 void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 void SPI_SSIConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 void SPI_SSOEConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 uint8_t SPI_GetFlagStatus(SPI_RegDef_t *pSPIx , uint32_t FlagName);
 void SPI_ClearOVRFlag(SPI_RegDef_t *pSPIx);
+void SPI_ClearCRCERRFlag(SPI_RegDef_t *pSPIx);
 void SPI_CloseTransmisson(SPI_Handle_t *pSPIHandle);
 void SPI_CloseReception(SPI_Handle_t *pSPIHandle);
 uint8_t I2C_DeviceMode(I2C_RegDef_t *I2Cx);
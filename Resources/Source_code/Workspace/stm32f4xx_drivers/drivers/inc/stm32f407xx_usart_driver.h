@@ -11,6 +11,18 @@
 #include "stm32f407xx.h"
 
 
+/*
+ * Baud rate register of the USART for one PCLK and baud rate, see USART_ComputeBaud
+ */
+typedef struct
+{
+	uint32_t PCLK;					/*!< APB clock in Hz the values are computed for >*/
+	uint16_t BRR;					/*!< whole BRR register : mantissa and fraction >*/
+	uint8_t  Over8;					/*!< SET : oversampling by 8 (CR1 OVER8) >*/
+	uint32_t BaudReal;				/*!< resulting baud rate >*/
+	int32_t  ErrorPpm;				/*!< (BaudReal - requested) / requested, in ppm >*/
+}USART_Baud_t;
+
 /*
  * Configuration structure for USARTx peripheral
  */
@@ -22,9 +34,40 @@ typedef struct
 	uint8_t USART_WordLength;
 	uint8_t USART_ParityControl;
 	uint8_t USART_HWFlowControl;
+	uint32_t USART_BaudTolerance;	/*!< max baud rate error in ppm, 0 : USART_BAUD_TOLERANCE_DEFAULT >*/
 }USART_Config_t;
 
 
+/*
+ * Circular receive buffer for continuous DMA reception (USART_ReceiveStreamDMA)
+ * The DMA never stops, received bytes are handed over as views in to pBuffer
+ */
+typedef struct
+{
+	uint8_t 		*pBuffer;		/* !< circular buffer written by the DMA > */
+	uint16_t 		Len;			/* !< size of pBuffer in bytes, 2 to 65535 > */
+	uint8_t 		*pChunk;		/* !< start of the bytes handed over with the last USART_EVENT_RX_CHUNK > */
+	uint16_t 		ChunkLen;		/* !< number of bytes at pChunk > */
+	uint16_t 		Tail;			/* !< used by the driver : index of the first byte not yet handed over > */
+}USART_RxStream_t;
+
+
+/*
+ * Single producer / single consumer byte ring (USART_Write, USART_Read)
+ * Head is only written by the producer and Tail only by the consumer, so the thread and
+ * the USART ISR share it without a lock. Both are free running, Head - Tail is the fill level
+ */
+typedef struct
+{
+	uint8_t 		*pBuffer;		/* !< storage, Size bytes > */
+	uint32_t 		Size;			/* !< power of two > */
+	__vo uint32_t 	Head;			/* !< bytes put in since USART_RingInit > */
+	__vo uint32_t 	Tail;			/* !< bytes taken out since USART_RingInit > */
+	uint32_t 		HighWater;		/* !< highest fill level seen, updated by the producer > */
+	uint32_t 		Dropped;		/* !< bytes which did not fit (Tx) or were lost (Rx, ring full or overrun) > */
+}USART_Ring_t;
+
+
 /*
  * Handle structure for USARTx peripheral
  */
@@ -38,6 +81,11 @@ typedef struct
 	uint32_t RxLen;
 	uint8_t TxBusyState;
 	uint8_t RxBusyState;
+	USART_Baud_t Baud;				/* !< baud rate programmed by USART_Init > */
+	DMA_Handle_t *pDMARx;			/* !< DMA stream used for Rx, NULL if Rx DMA is not used > */
+	USART_RxStream_t *pRxStream;	/* !< set while continuous reception runs > */
+	USART_Ring_t *pTxRing;			/* !< set while USART_Write feeds the transmitter > */
+	USART_Ring_t *pRxRing;			/* !< set while the receiver feeds USART_Read > */
 }USART_Handle_t;
 
 
@@ -55,7 +103,7 @@ typedef struct
  *Possible options for USART_Baud
  */
 #define USART_STD_BAUD_1200					1200
-#define USART_STD_BAUD_2400					400
+#define USART_STD_BAUD_2400					2400
 #define USART_STD_BAUD_9600					9600
 #define USART_STD_BAUD_19200 				19200
 #define USART_STD_BAUD_38400 				38400
@@ -65,7 +113,23 @@ typedef struct
 #define USART_STD_BAUD_460800 				460800
 #define USART_STD_BAUD_921600 				921600
 #define USART_STD_BAUD_2M 					2000000
-#define SUART_STD_BAUD_3M 					3000000
+#define USART_STD_BAUD_3M 					3000000
+#define USART_STD_BAUD_4M 					4000000
+#define USART_STD_BAUD_5M25 				5250000		/* PCLK / 8 on APB1 at 42MHz */
+#define USART_STD_BAUD_10M5 				10500000	/* PCLK / 8 on APB2 at 84MHz, USART1/6 only */
+
+/*
+ * USART_ComputeBaud / USART_SetBaudRate / USART_Init results
+ */
+#define USART_BAUD_OK						0
+#define USART_BAUD_ERR_RANGE				1	/* baud rate over PCLK / 8 or under PCLK / 65535 */
+#define USART_BAUD_ERR_TOLERANCE			2	/* the closest divider misses the baud rate by more than the tolerance */
+
+/*
+ * Default USART_BaudTolerance : with 1.5% on each side the total stays under the 3.4%
+ * an 8N1 receiver accepts when it oversamples by 8
+ */
+#define USART_BAUD_TOLERANCE_DEFAULT		15000
 
 
 /*
@@ -111,6 +175,12 @@ typedef struct
 #define USART_FLAG_RXNE 		( 1 << USART_SR_RXNE)
 #define USART_FLAG_TC 			( 1 << USART_SR_TC)
 
+/*
+ * USART_RingInit results
+ */
+#define USART_RING_OK			0
+#define USART_RING_ERR_SIZE		1	/* size is not a power of two */
+
 /*
  * Application states
  */
@@ -127,6 +197,8 @@ typedef struct
 #define		USART_ERR_FE     	5
 #define		USART_ERR_NE    	 6
 #define		USART_ERR_ORE    	7
+#define		USART_EVENT_RX_CHUNK 8
+#define		USART_ERR_DMA    	9
 
 /******************************************************************************************
  *								APIs supported by this driver
@@ -142,7 +214,7 @@ void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi);
 /*
  * Init and De-init
  */
-void USART_Init(USART_Handle_t *pUSARTHandle);
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle);
 void USART_DeInit(USART_Handle_t *pUSARTHandle);
 
 /*
@@ -152,6 +224,19 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
 void  USART_ReceiveData(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uint32_t Len);
 uint8_t USART_SendDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pTxBuffer, uint32_t Len);
 uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uint32_t Len);
+uint8_t USART_ReceiveStreamDMA(USART_Handle_t *pUSARTHandle, USART_RxStream_t *pRxStream);
+void USART_StopReceiveStream(USART_Handle_t *pUSARTHandle);
+
+/*
+ * Non blocking ring buffered Send and Receive
+ */
+uint8_t USART_RingInit(USART_Ring_t *pRing, uint8_t *pBuffer, uint32_t Size);
+uint8_t USART_AttachRings(USART_Handle_t *pUSARTHandle, USART_Ring_t *pTxRing, USART_Ring_t *pRxRing);
+void USART_DetachRings(USART_Handle_t *pUSARTHandle);
+uint32_t USART_Write(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len);
+uint32_t USART_Read(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t Len);
+uint32_t USART_WriteCommit(USART_Handle_t *pUSARTHandle, uint32_t Len);
+void USART_ReadRelease(USART_Handle_t *pUSARTHandle, uint32_t Len);
 
 /*
  * IRQ Configuration and ISR handling
@@ -159,6 +244,7 @@ uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uin
 void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
 void USART_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
 void USART_IRQHandling(USART_Handle_t *pUSARTHandle);
+void USART_DMARxIRQHandling(USART_Handle_t *pUSARTHandle);
 
 /*
  * Other Peripheral Control APIs
@@ -167,7 +253,9 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle);
 uint8_t USART_GetFlagStatus(USART_RegDef_t *pUSARTx, uint8_t StatusFlagName);
 void USART_ClearFlag(USART_RegDef_t *pUSARTx, uint16_t StatusFlagName);
 void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi);
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+uint8_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+uint8_t USART_ComputeBaud(uint32_t PCLK, uint32_t BaudRate, uint32_t TolerancePpm, USART_Baud_t *pBaud);
+uint32_t USART_GetPCLK(USART_RegDef_t *pUSARTx);
 
 
 /*
@@ -0,0 +1,398 @@
+/*
+ * stm32f407xx_dma_driver.c
+ *
+ *  Created on: Apr 14, 2019
+ *      Author: admin
+ */
+
+#include "stm32f407xx.h"
+
+/*
+ * bit offset of each stream's flag group inside LISR/HISR and LIFCR/HIFCR
+ * streams 0-3 live in the low registers, streams 4-7 in the high registers
+ */
+static const uint8_t DMA_FlagOffset[4] = { 0, 6, 16, 22 };
+
+static __vo uint32_t* dma_get_isr(DMA_Handle_t *pDMAHandle);
+static __vo uint32_t* dma_get_ifcr(DMA_Handle_t *pDMAHandle);
+
+static __vo uint32_t* dma_get_isr(DMA_Handle_t *pDMAHandle)
+{
+	return (pDMAHandle->Stream < 4) ? &pDMAHandle->pDMAx->LISR : &pDMAHandle->pDMAx->HISR;
+}
+
+static __vo uint32_t* dma_get_ifcr(DMA_Handle_t *pDMAHandle)
+{
+	return (pDMAHandle->Stream < 4) ? &pDMAHandle->pDMAx->LIFCR : &pDMAHandle->pDMAx->HIFCR;
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_PeriClockControl
+ *
+ * @brief             - This function enables or disables peripheral clock for the given DMA controller
+ *
+ * @param[in]         - base address of the DMA peripheral
+ * @param[in]         - ENABLE or DISABLE macros
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		if(pDMAx == DMA1)
+		{
+			DMA1_PCLK_EN();
+		}else if (pDMAx == DMA2)
+		{
+			DMA2_PCLK_EN();
+		}
+	}
+	else
+	{
+		if(pDMAx == DMA1)
+		{
+			DMA1_PCLK_DI();
+		}else if (pDMAx == DMA2)
+		{
+			DMA2_PCLK_DI();
+		}
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_Init
+ *
+ * @brief             - programs the stream CR and FCR as per the handle configuration
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - none
+ *
+ * @Note              - The stream is left disabled. A stream can only be reprogrammed
+ * 						while EN=0, so an ongoing transfer of this stream is stopped first
+
+ */
+void DMA_Init(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->Stream];
+	uint32_t tempreg = 0;
+
+	//peripheral clock enable
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+
+	//1. disable the stream and wait till the hardware confirms it
+	DMA_StopTransfer(pDMAHandle);
+
+	//2. configure the channel, direction and data sizes
+	tempreg |= (uint32_t)pDMAHandle->DMAConfig.DMA_Channel << DMA_SxCR_CHSEL;
+	tempreg |= (uint32_t)pDMAHandle->DMAConfig.DMA_Direction << DMA_SxCR_DIR;
+	tempreg |= (uint32_t)pDMAHandle->DMAConfig.DMA_PeriphDataSize << DMA_SxCR_PSIZE;
+	tempreg |= (uint32_t)pDMAHandle->DMAConfig.DMA_MemDataSize << DMA_SxCR_MSIZE;
+
+	//3. memory increment, the peripheral address is always fixed
+	if(pDMAHandle->DMAConfig.DMA_MemInc == ENABLE)
+	{
+		tempreg |= ( 1 << DMA_SxCR_MINC);
+	}
+
+	//4. circular mode
+	if(pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_CIRCULAR)
+	{
+		tempreg |= ( 1 << DMA_SxCR_CIRC);
+	}
+
+	//5. priority and interrupts
+	tempreg |= (uint32_t)pDMAHandle->DMAConfig.DMA_Priority << DMA_SxCR_PL;
+	tempreg |= pDMAHandle->DMAConfig.DMA_IntEnable & ( DMA_IT_TE | DMA_IT_HT | DMA_IT_TC );
+
+	pStream->CR = tempreg;
+
+	//6. FIFO configuration
+	if(pDMAHandle->DMAConfig.DMA_FIFOMode == DMA_FIFOMODE_EN)
+	{
+		pStream->FCR = ( 1 << DMA_SxFCR_DMDIS) | ( 0x3 << DMA_SxFCR_FTH);
+	}else
+	{
+		pStream->FCR = 0;
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_DeInit
+ *
+ * @brief             - disables the stream and resets its registers
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void DMA_DeInit(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->Stream];
+
+	DMA_StopTransfer(pDMAHandle);
+
+	pStream->CR = 0;
+	pStream->NDTR = 0;
+	pStream->PAR = 0;
+	pStream->M0AR = 0;
+	pStream->M1AR = 0;
+	pStream->FCR = ( 1 << 5 ); //reset value of FCR (FS = 100 : FIFO empty)
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_StartTransfer
+ *
+ * @brief             - loads the addresses and number of data items and enables the stream
+ *
+ * @param[in]         - handle of the DMA stream
+ * @param[in]         - peripheral address (usually address of the peripheral DR)
+ * @param[in]         - memory address
+ * @param[in]         - number of data items (not bytes) to be transferred
+ *
+ * @return            - none
+ *
+ * @Note              - DMA_Init must have been called. All stale flags of the stream are
+ * 						cleared before enabling, otherwise the stream refuses to start
+
+ */
+void DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->Stream];
+
+	DMA_ClearFlag(pDMAHandle, DMA_FLAG_ALL);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = MemAddr;
+	pStream->NDTR = Len;
+
+	pStream->CR |= ( 1 << DMA_SxCR_EN);
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_StartDoubleBuffer
+ *
+ * @brief             - starts the stream in double buffer mode, the hardware swaps between
+ * 						the two memory areas each time Len data items are transferred
+ *
+ * @param[in]         - handle of the DMA stream
+ * @param[in]         - peripheral address (usually address of the peripheral DR)
+ * @param[in]         - first memory address, filled first (CT=0)
+ * @param[in]         - second memory address
+ * @param[in]         - number of data items (not bytes) of each memory area
+ *
+ * @return            - none
+ *
+ * @Note              - Double buffer mode implies circular mode. TC is raised at every swap,
+ * 						DMA_GetCurrentTarget tells which area the stream is filling now
+
+ */
+void DMA_StartDoubleBuffer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->Stream];
+
+	DMA_ClearFlag(pDMAHandle, DMA_FLAG_ALL);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = Mem0Addr;
+	pStream->M1AR = Mem1Addr;
+	pStream->NDTR = Len;
+
+	pStream->CR &= ~( 1 << DMA_SxCR_CT);
+	pStream->CR |= ( 1 << DMA_SxCR_DBM) | ( 1 << DMA_SxCR_CIRC);
+
+	pStream->CR |= ( 1 << DMA_SxCR_EN);
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_GetCurrentTarget
+ *
+ * @brief             - returns the memory area the stream is accessing in double buffer mode
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - 0 : M0AR , 1 : M1AR
+ *
+ * @Note              - none
+
+ */
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle)
+{
+	return ( pDMAHandle->pDMAx->S[pDMAHandle->Stream].CR >> DMA_SxCR_CT ) & 0x1;
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_StopTransfer
+ *
+ * @brief             - disables the stream
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - none
+ *
+ * @Note              - EN reads back as 1 until the current data item is finished
+
+ */
+void DMA_StopTransfer(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->Stream];
+
+	pStream->CR &= ~( 1 << DMA_SxCR_EN);
+	while( pStream->CR & ( 1 << DMA_SxCR_EN) );
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_GetRemaining
+ *
+ * @brief             - returns the number of data items still to be transferred
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - NDTR value
+ *
+ * @Note              - none
+
+ */
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle)
+{
+	return (uint16_t)pDMAHandle->pDMAx->S[pDMAHandle->Stream].NDTR;
+}
+
+
+uint8_t DMA_GetFlagStatus(DMA_Handle_t *pDMAHandle, uint32_t FlagName)
+{
+	if( *dma_get_isr(pDMAHandle) & ( FlagName << DMA_FlagOffset[pDMAHandle->Stream % 4]) )
+	{
+		return FLAG_SET;
+	}
+	return FLAG_RESET;
+}
+
+
+void DMA_ClearFlag(DMA_Handle_t *pDMAHandle, uint32_t FlagName)
+{
+	//IFCR bits are write 1 to clear, writing 0 has no effect
+	*dma_get_ifcr(pDMAHandle) = ( FlagName << DMA_FlagOffset[pDMAHandle->Stream % 4]);
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_IRQInterruptConfig
+ *
+ * @brief             -
+ *
+ * @param[in]         - IRQ number of the stream, refer @IRQ_NO_DMAx_STREAMy
+ * @param[in]         - ENABLE or DISABLE macros
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+
+	if(EnorDi == ENABLE)
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ISER0 register
+			*NVIC_ISER0 |= ( 1 << IRQNumber );
+
+		}else if(IRQNumber > 31 && IRQNumber < 64 ) //32 to 63
+		{
+			//program ISER1 register
+			*NVIC_ISER1 |= ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ISER2 register //64 to 95
+			*NVIC_ISER2 |= ( 1 << (IRQNumber % 64) );
+		}
+	}else
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ICER0 register
+			*NVIC_ICER0 |= ( 1 << IRQNumber );
+		}else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ICER1 register
+			*NVIC_ICER1 |= ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ICER2 register
+			*NVIC_ICER2 |= ( 1 << (IRQNumber % 64) );
+		}
+	}
+
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_IRQPriorityConfig
+ *
+ * @brief             -
+ *
+ * @param[in]         -
+ * @param[in]         -
+ *
+ * @return            -
+ *
+ * @Note              -
+
+ */
+void DMA_IRQPriorityConfig(uint8_t IRQNumber,uint32_t IRQPriority)
+{
+	//1. first lets find out the ipr register
+	uint8_t iprx = IRQNumber / 4;
+	uint8_t iprx_section  = IRQNumber %4 ;
+
+	uint8_t shift_amount = ( 8 * iprx_section) + ( 8 - NO_PR_BITS_IMPLEMENTED) ;
+
+	*(  NVIC_PR_BASE_ADDR + iprx ) |=  ( IRQPriority << shift_amount );
+
+}
+
+
+/*********************************************************************
+ * @fn      		  - DMA_IRQHandling
+ *
+ * @brief             - reads and clears the pending flags of the stream
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - OR of the @DMA_FLAG macros which were pending
+ *
+ * @Note              - The stream is owned by a peripheral driver (SPI, I2C, USART ..)
+ * 						and that driver decides what to do with the returned events
+
+ */
+uint8_t DMA_IRQHandling(DMA_Handle_t *pDMAHandle)
+{
+	uint8_t shift = DMA_FlagOffset[pDMAHandle->Stream % 4];
+	uint8_t events;
+
+	events = (uint8_t)( ( *dma_get_isr(pDMAHandle) >> shift ) & DMA_FLAG_ALL );
+
+	//clear only what we have seen
+	*dma_get_ifcr(pDMAHandle) = ( (uint32_t)events << shift );
+
+	return events;
+}
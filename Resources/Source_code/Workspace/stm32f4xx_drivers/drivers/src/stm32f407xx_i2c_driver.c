@@ -9,30 +9,80 @@
 
 
 static void  I2C_GenerateStartCondition(I2C_RegDef_t *pI2Cx);
-static void I2C_ExecuteAddressPhaseWrite(I2C_RegDef_t *pI2Cx, uint8_t SlaveAddr);
-static void I2C_ExecuteAddressPhaseRead(I2C_RegDef_t *pI2Cx, uint8_t SlaveAddr);
+static void I2C_ExecuteAddressPhaseWrite(I2C_RegDef_t *pI2Cx, uint16_t SlaveAddr);
+static void I2C_ExecuteAddressPhaseRead(I2C_RegDef_t *pI2Cx, uint16_t SlaveAddr);
 static void I2C_ClearADDRFlag(I2C_Handle_t *pI2CHandle);
+static uint8_t I2C_MasterAddress10(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint8_t Read);
+static uint8_t I2C_PECUsed(I2C_Handle_t *pI2CHandle, uint8_t Sr);
 
 static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle );
 static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle );
 
+static void I2C_ConfigDMAStream(DMA_Handle_t *pDMAHandle, uint8_t Direction);
+static void I2C_DMAAbort(I2C_Handle_t *pI2CHandle);
+
+static void I2C_TransferComplete(I2C_Handle_t *pI2CHandle, uint8_t AppEv);
+static void I2C_HandleError(I2C_Handle_t *pI2CHandle, uint8_t AppEv);
+static uint8_t I2C_QueueStart(I2C_Handle_t *pI2CHandle);
+static void I2C_QueueComplete(I2C_Handle_t *pI2CHandle, uint8_t AppEv);
+
+static uint32_t I2C_GetTimeout(I2C_Handle_t *pI2CHandle);
+static uint8_t I2C_WaitFlag(I2C_Handle_t *pI2CHandle, uint32_t FlagName);
+static uint8_t I2C_WaitBusFree(I2C_Handle_t *pI2CHandle);
+static uint8_t I2C_MasterAbort(I2C_Handle_t *pI2CHandle, uint8_t Error);
+static uint8_t I2C_BusClear(I2C_Handle_t *pI2CHandle);
+static void I2C_PinMode(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Mode);
+static void I2C_DelayCycles(uint32_t Cycles);
+
+static void I2C_RegFileSeek(I2C_RegFile_t *pRegFile, uint8_t RegAddr);
+static void I2C_RegFileNext(I2C_RegFile_t *pRegFile);
+static void I2C_RegFileTransmit(I2C_Handle_t *pI2CHandle);
+static void I2C_RegFileReceive(I2C_Handle_t *pI2CHandle);
+
+static uint8_t I2C_MasterSendOnce(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr);
+static uint8_t I2C_MasterReceiveOnce(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr);
+static uint32_t I2C_ArloBackoff(uint8_t Retry);
+static void I2C_HandleArbitrationLoss(I2C_Handle_t *pI2CHandle);
+
+#ifdef I2C_TRACE
+I2C_Trace_t I2C_Trace = { .Depth = I2C_TRACE_DEPTH };
+
+static inline void I2C_TraceRecord(I2C_RegDef_t *pI2Cx, uint8_t Tag);
+#define I2C_TRACE_RECORD(pI2Cx,Tag)		do{ I2C_TraceRecord(pI2Cx,Tag); }while(0)
+#else
+#define I2C_TRACE_RECORD(pI2Cx,Tag)		do{ }while(0)
+#endif
+
 static void I2C_GenerateStartCondition(I2C_RegDef_t *pI2Cx)
 {
+	I2C_TRACE_RECORD(pI2Cx,I2C_TRACE_START);
 	pI2Cx->CR1 |= ( 1 << I2C_CR1_START);
 }
 
 
 
-static void I2C_ExecuteAddressPhaseWrite(I2C_RegDef_t *pI2Cx, uint8_t SlaveAddr)
+static void I2C_ExecuteAddressPhaseWrite(I2C_RegDef_t *pI2Cx, uint16_t SlaveAddr)
 {
+	if(SlaveAddr & I2C_ADDR_10BIT_FLAG)
+	{
+		//10 bit : header 11110 A9 A8 0, the low address byte follows on ADD10
+		pI2Cx->DR = 0xF0 | ((SlaveAddr >> 7) & 0x6);
+		return;
+	}
 	SlaveAddr = SlaveAddr << 1;
 	SlaveAddr &= ~(1); //SlaveAddr is Slave address + r/nw bit=0
 	pI2Cx->DR = SlaveAddr;
 }
 
 
-static void I2C_ExecuteAddressPhaseRead(I2C_RegDef_t *pI2Cx, uint8_t SlaveAddr)
+static void I2C_ExecuteAddressPhaseRead(I2C_RegDef_t *pI2Cx, uint16_t SlaveAddr)
 {
+	if(SlaveAddr & I2C_ADDR_10BIT_FLAG)
+	{
+		//10 bit : header 11110 A9 A8 1 after the repeated START, the slave is already selected
+		pI2Cx->DR = 0xF1 | ((SlaveAddr >> 7) & 0x6);
+		return;
+	}
 	SlaveAddr = SlaveAddr << 1;
 	SlaveAddr |= 1; //SlaveAddr is Slave address + r/nw bit=1
 	pI2Cx->DR = SlaveAddr;
@@ -53,6 +103,12 @@ static void I2C_ClearADDRFlag(I2C_Handle_t *pI2CHandle )
 				//first disable the ack
 				I2C_ManageAcking(pI2CHandle->pI2Cx,DISABLE);
 
+				//clear the ADDR flag ( read SR1 , read SR2)
+				dummy_read = pI2CHandle->pI2Cx->SR1;
+				dummy_read = pI2CHandle->pI2Cx->SR2;
+				(void)dummy_read;
+			}else
+			{
 				//clear the ADDR flag ( read SR1 , read SR2)
 				dummy_read = pI2CHandle->pI2Cx->SR1;
 				dummy_read = pI2CHandle->pI2Cx->SR2;
@@ -85,6 +141,7 @@ static void I2C_ClearADDRFlag(I2C_Handle_t *pI2CHandle )
 
  void I2C_GenerateStopCondition(I2C_RegDef_t *pI2Cx)
 {
+	I2C_TRACE_RECORD(pI2Cx,I2C_TRACE_STOP);
 	pI2Cx->CR1 |= ( 1 << I2C_CR1_STOP);
 }
 
@@ -175,79 +232,237 @@ void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi)
 /*********************************************************************
  * @fn      		  - I2C_Init
  *
- * @brief             -
+ * @brief             - configures the I2C as per the handle configuration
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - I2C handle
  *
- * @return            -
+ * @return            - I2C_TIMING_OK, or the I2C_TIMING_ERR_xxx of I2C_ComputeTiming / I2C_ValidateTiming
  *
- * @Note              -
+ * @Note              - The clock registers come from I2C_Config.pI2C_Timing when set, otherwise
+ * 						they are computed once from the live PCLK1 (I2C_ComputeTiming). Both are
+ * 						checked first : a timing out of the spec is refused and the registers are
+ * 						not touched. The values are kept in the handle's Timing. I2C_PEC sets
+ * 						ENPEC, the PEC is then appended/checked by every master transfer which
+ * 						ends with a STOP
 
  */
-void I2C_Init(I2C_Handle_t *pI2CHandle)
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle)
 {
 	uint32_t tempreg = 0 ;
+	uint8_t status;
 
 	//enable the clock for the i2cx peripheral
 	I2C_PeriClockControl(pI2CHandle->pI2Cx,ENABLE);
 
+	//the timeouts count CPU cycles
+	*DEMCR |= ( 1 << DEMCR_TRCENA);
+	*DWT_CTRL |= ( 1 << DWT_CTRL_CYCCNTENA);
+
+	//clock registers : precomputed, or computed once from the live PCLK1
+	if(pI2CHandle->I2C_Config.pI2C_Timing)
+	{
+		pI2CHandle->Timing = *pI2CHandle->I2C_Config.pI2C_Timing;
+		status = I2C_ValidateTiming(&pI2CHandle->Timing);
+	}else
+	{
+		status = I2C_ComputeTiming(RCC_GetPCLK1Value(),pI2CHandle->I2C_Config.I2C_SCLSpeed,
+				pI2CHandle->I2C_Config.I2C_FMDutyCycle,&pI2CHandle->Timing);
+	}
+	if(status != I2C_TIMING_OK)
+	{
+		return status;
+	}
+
 	//ack control bit
 	tempreg |= pI2CHandle->I2C_Config.I2C_AckControl << 10;
+
+	//SMBus packet error checking
+	if(pI2CHandle->I2C_Config.I2C_PEC == ENABLE)
+	{
+		tempreg |= ( 1 << I2C_CR1_ENPEC);
+	}
 	pI2CHandle->pI2Cx->CR1 = tempreg;
 
 	//configure the FREQ field of CR2
 	tempreg = 0;
-	tempreg |= RCC_GetPCLK1Value() /1000000U ;
+	tempreg |= pI2CHandle->Timing.PCLK1 /1000000U ;
 	pI2CHandle->pI2Cx->CR2 =  (tempreg & 0x3F);
 
    //program the device own address
 	tempreg = 0;
-	tempreg |= pI2CHandle->I2C_Config.I2C_DeviceAddress << 1;
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDRMODE_10BIT)
+	{
+		tempreg |= pI2CHandle->I2C_Config.I2C_DeviceAddress & 0x3FF;
+		tempreg |= ( 1 << I2C_OAR1_ADDMODE);
+	}else
+	{
+		tempreg |= pI2CHandle->I2C_Config.I2C_DeviceAddress << 1;
+	}
 	tempreg |= ( 1 << 14);
 	pI2CHandle->pI2Cx->OAR1 = tempreg;
 
-	//CCR calculations
-	uint16_t ccr_value = 0;
-	tempreg = 0;
-	if(pI2CHandle->I2C_Config.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
-	{
-		//mode is standard mode
-		ccr_value = (RCC_GetPCLK1Value() / ( 2 * pI2CHandle->I2C_Config.I2C_SCLSpeed ) );
-		tempreg |= (ccr_value & 0xFFF);
-	}else
+	//CCR and TRISE
+	pI2CHandle->pI2Cx->CCR = pI2CHandle->Timing.CCR;
+	pI2CHandle->pI2Cx->TRISE = (pI2CHandle->Timing.TRISE & 0x3F);
+
+	return I2C_TIMING_OK;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_ComputeTiming
+ *
+ * @brief             - computes the CCR/TRISE values for a PCLK1 and an SCL speed
+ *
+ * @param[in]         - PCLK1 in Hz
+ * @param[in]         - SCL speed in Hz, up to 100kHz is standard mode, above is fast mode
+ * @param[in]         - @I2C_FMDutyCycle, fast mode only
+ * @param[out]        - timing
+ *
+ * @return            - I2C_TIMING_OK or the I2C_TIMING_ERR_xxx of I2C_ValidateTiming
+ *
+ * @Note              - CCR is the smallest value which keeps SCL at or under the request and
+ * 						tLOW/tHIGH at or over the spec minimum. It is clamped to its register
+ * 						range, so the result can always be programmed even when it is reported
+ * 						as out of spec. TRISE is computed in MHz, PCLK1 * 300 would overflow
+
+ */
+uint8_t I2C_ComputeTiming(uint32_t PCLK1, uint32_t SCLSpeed, uint8_t FMDutyCycle, I2C_Timing_t *pTiming)
+{
+	I2C_Timing_t other;
+	uint32_t freq = PCLK1 / 1000000U;
+	uint32_t ccr, ccrmin;
+	uint32_t low, high, tlowmin, thighmin;
+
+	//1. duty AUTO : both fast mode duties, keep the faster valid one
+	if(SCLSpeed > I2C_SCL_SPEED_SM && FMDutyCycle == I2C_FM_DUTY_AUTO)
 	{
-		//mode is fast mode
-		tempreg |= ( 1 << 15);
-		tempreg |= (pI2CHandle->I2C_Config.I2C_FMDutyCycle << 14);
-		if(pI2CHandle->I2C_Config.I2C_FMDutyCycle == I2C_FM_DUTY_2)
-		{
-			ccr_value = (RCC_GetPCLK1Value() / ( 3 * pI2CHandle->I2C_Config.I2C_SCLSpeed ) );
-		}else
+		uint8_t err2 = I2C_ComputeTiming(PCLK1,SCLSpeed,I2C_FM_DUTY_2,pTiming);
+		uint8_t err169 = I2C_ComputeTiming(PCLK1,SCLSpeed,I2C_FM_DUTY_16_9,&other);
+
+		if( (err169 == I2C_TIMING_OK && other.SCLReal > pTiming->SCLReal) || (err2 != I2C_TIMING_OK) )
 		{
-			ccr_value = (RCC_GetPCLK1Value() / ( 25 * pI2CHandle->I2C_Config.I2C_SCLSpeed ) );
+			*pTiming = other;
+			return err169;
 		}
-		tempreg |= (ccr_value & 0xFFF);
+		return err2;
+	}
+
+	//2. SCL period in PCLK1 cycles is (low + high) * CCR
+	if(SCLSpeed <= I2C_SCL_SPEED_SM)
+	{
+		low = 1; high = 1;
+		tlowmin = 4700; thighmin = 4000;
+		ccrmin = 4;
+		pTiming->CCR = 0;
+		pTiming->TRISE = freq + 1;
+	}else if(FMDutyCycle == I2C_FM_DUTY_16_9)
+	{
+		low = 16; high = 9;
+		tlowmin = 1300; thighmin = 600;
+		ccrmin = 1;
+		pTiming->CCR = ( 1 << I2C_CCR_FS) | ( 1 << I2C_CCR_DUTY);
+		pTiming->TRISE = ((freq * 300) / 1000) + 1;
+	}else
+	{
+		low = 2; high = 1;
+		tlowmin = 1300; thighmin = 600;
+		ccrmin = 1;
+		pTiming->CCR = ( 1 << I2C_CCR_FS);
+		pTiming->TRISE = ((freq * 300) / 1000) + 1;
 	}
-	pI2CHandle->pI2Cx->CCR = tempreg;
 
-	//TRISE Configuration
-	if(pI2CHandle->I2C_Config.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
+	//3. smallest CCR for the requested SCL, then for tLOW and tHIGH
+	ccr = I2C_CCR_CEIL(PCLK1, (low + high) * SCLSpeed);
+	if( (uint64_t)ccr * low * 1000000000U < (uint64_t)tlowmin * PCLK1 )
 	{
-		//mode is standard mode
+		ccr = (uint32_t)( ((uint64_t)tlowmin * PCLK1 + (uint64_t)low * 1000000000U - 1) / ((uint64_t)low * 1000000000U) );
+	}
+	if( (uint64_t)ccr * high * 1000000000U < (uint64_t)thighmin * PCLK1 )
+	{
+		ccr = (uint32_t)( ((uint64_t)thighmin * PCLK1 + (uint64_t)high * 1000000000U - 1) / ((uint64_t)high * 1000000000U) );
+	}
+
+	//4. register range
+	if(ccr < ccrmin)
+	{
+		ccr = ccrmin;
+	}else if(ccr > 0xFFF)
+	{
+		ccr = 0xFFF;
+	}
+
+	pTiming->PCLK1 = PCLK1;
+	pTiming->CCR |= ccr;
+	pTiming->SCLReal = PCLK1 / ( (low + high) * ccr );
 
-		tempreg = (RCC_GetPCLK1Value() /1000000U) + 1 ;
+	return I2C_ValidateTiming(pTiming);
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_ValidateTiming
+ *
+ * @brief             - checks a timing against the register ranges and the I2C spec
+ *
+ * @param[in]         - timing, from I2C_ComputeTiming or an I2C_TIMING_xx initializer
+ *
+ * @return            - I2C_TIMING_OK or I2C_TIMING_ERR_xxx
+ *
+ * @Note              - Sm : SCL <= 100kHz, tLOW >= 4.7us, tHIGH >= 4.0us, rise time <= 1000ns
+ * 						Fm : SCL <= 400kHz, tLOW >= 1.3us, tHIGH >= 0.6us, rise time <= 300ns
 
+ */
+uint8_t I2C_ValidateTiming(const I2C_Timing_t *pTiming)
+{
+	uint32_t freq = pTiming->PCLK1 / 1000000U;
+	uint32_t ccr = pTiming->CCR & 0xFFF;
+	uint8_t fm = (pTiming->CCR >> I2C_CCR_FS) & 1;
+	uint8_t duty = (pTiming->CCR >> I2C_CCR_DUTY) & 1;
+	uint32_t low, high, tlowmin, thighmin, sclmax, trise;
+
+	if(fm)
+	{
+		low = duty ? 16 : 2;
+		high = duty ? 9 : 1;
+		tlowmin = 1300; thighmin = 600;
+		sclmax = I2C_SCL_SPEED_FM4K;
+		trise = ((freq * 300) / 1000) + 1;
 	}else
 	{
-		//mode is fast mode
-		tempreg = ( (RCC_GetPCLK1Value() * 300) / 1000000000U ) + 1;
+		low = 1; high = 1;
+		tlowmin = 4700; thighmin = 4000;
+		sclmax = I2C_SCL_SPEED_SM;
+		trise = freq + 1;
+	}
+
+	//1. PCLK1
+	if( (freq < (fm ? 4 : 2)) || (freq > 50) )
+	{
+		return I2C_TIMING_ERR_PCLK1;
+	}
+
+	//2. CCR register range
+	if( (ccr < (fm ? 1 : 4)) || (ccr > 0xFFF) )
+	{
+		return I2C_TIMING_ERR_CCR;
+	}
 
+	//3. SCL frequency and the low/high periods in ns
+	if( (pTiming->PCLK1 / ((low + high) * ccr) > sclmax) ||
+		((uint64_t)ccr * low * 1000000000U < (uint64_t)tlowmin * pTiming->PCLK1) ||
+		((uint64_t)ccr * high * 1000000000U < (uint64_t)thighmin * pTiming->PCLK1) )
+	{
+		return I2C_TIMING_ERR_SCL;
 	}
 
-	pI2CHandle->pI2Cx->TRISE = (tempreg & 0x3F);
+	//4. rise time
+	if(pTiming->TRISE != trise)
+	{
+		return I2C_TIMING_ERR_TRISE;
+	}
 
+	return I2C_TIMING_OK;
 }
 
 
@@ -282,131 +497,84 @@ uint8_t I2C_GetFlagStatus(I2C_RegDef_t *pI2Cx , uint32_t FlagName)
 
 
 
-void I2C_MasterSendData(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint8_t SlaveAddr,uint8_t Sr)
-{
-	// 1. Generate the START condition
-	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
-
-	//2. confirm that start generation is completed by checking the SB flag in the SR1
-	//   Note: Until SB is cleared SCL will be stretched (pulled to LOW)
-	while( !  I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_SB)   );
-
-	//3. Send the address of the slave with r/nw bit set to w(0) (total 8 bits )
-	I2C_ExecuteAddressPhaseWrite(pI2CHandle->pI2Cx,SlaveAddr);
-
-	//4. Confirm that address phase is completed by checking the ADDR flag in teh SR1
-	while( !  I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_ADDR)   );
-
-	//5. clear the ADDR flag according to its software sequence
-	//   Note: Until ADDR is cleared SCL will be stretched (pulled to LOW)
-	I2C_ClearADDRFlag(pI2CHandle);
-
-	//6. send the data until len becomes 0
-
-	while(Len > 0)
-	{
-		while(! I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_TXE) ); //Wait till TXE is set
-		pI2CHandle->pI2Cx->DR = *pTxbuffer;
-		pTxbuffer++;
-		Len--;
-	}
-
-	//7. when Len becomes zero wait for TXE=1 and BTF=1 before generating the STOP condition
-	//   Note: TXE=1 , BTF=1 , means that both SR and DR are empty and next transmission should begin
-	//   when BTF=1 SCL will be stretched (pulled to LOW)
-
-	while(! I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_TXE) );
-
-	while(! I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_BTF) );
-
-
-	//8. Generate STOP condition and master need not to wait for the completion of stop condition.
-	//   Note: generating STOP, automatically clears the BTF
-	if(Sr == I2C_DISABLE_SR )
-		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
-
-}
-
+/*********************************************************************
+ * @fn      		  - I2C_MasterSendData
+ *
+ * @brief             - blocking master transmission
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - Tx buffer
+ * @param[in]         - number of bytes to send
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - I2C_ENABLE_SR to keep the bus for a repeated start
+ *
+ * @return            - I2C_READY, or the I2C_ERROR_xxx which ended the transfer
+ *
+ * @Note              - Every wait is bounded by I2C_Timeout. A NACK ends the transfer with a STOP,
+ * 						a timeout or a bus which never gets free runs I2C_BusRecover. A lost
+ * 						arbitration is retried up to I2C_ArloRetries times after I2C_ArloBackoff,
+ * 						only this call is repeated (not the write before a repeated start)
 
-void I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr,uint8_t Sr)
+ */
+uint8_t I2C_MasterSendData(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr)
 {
+	uint8_t err;
+	uint8_t retry = 0;
 
-	//1. Generate the START condition
-	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
-
-	//2. confirm that start generation is completed by checking the SB flag in the SR1
-	//   Note: Until SB is cleared SCL will be stretched (pulled to LOW)
-	while( !  I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_SB)   );
-
-	//3. Send the address of the slave with r/nw bit set to R(1) (total 8 bits )
-	I2C_ExecuteAddressPhaseRead(pI2CHandle->pI2Cx,SlaveAddr);
-
-	//4. wait until address phase is completed by checking the ADDR flag in teh SR1
-	while( !  I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_ADDR)   );
-
-
-	//procedure to read only 1 byte from slave
-	if(Len == 1)
+	//another master won the arbitration : wait for it with an exponential backoff and go again
+	while( (err = I2C_MasterSendOnce(pI2CHandle,pTxbuffer,Len,SlaveAddr,Sr)) == I2C_ERROR_ARLO &&
+		   retry < pI2CHandle->I2C_Config.I2C_ArloRetries )
 	{
-		//Disable Acking
-		I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_DISABLE);
-
-
-		//clear the ADDR flag
-		I2C_ClearADDRFlag(pI2CHandle);
-
-		//wait until  RXNE becomes 1
-		while(! I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_RXNE) );
-
-		//generate STOP condition
-		if(Sr == I2C_DISABLE_SR )
-			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
-
-		//read data in to buffer
-		*pRxBuffer = pI2CHandle->pI2Cx->DR;
-
+		I2C_DelayCycles(I2C_ArloBackoff(retry++));
+		pI2CHandle->RetryCount++;
 	}
 
-
-    //procedure to read data from slave when Len > 1
-	if(Len > 1)
+	if(err == I2C_ERROR_ARLO)
 	{
-		//clear the ADDR flag
-		I2C_ClearADDRFlag(pI2CHandle);
-
-		//read the data until Len becomes zero
-		for ( uint32_t i = Len ; i > 0 ; i--)
-		{
-			//wait until RXNE becomes 1
-			while(! I2C_GetFlagStatus(pI2CHandle->pI2Cx,I2C_FLAG_RXNE) );
-
-			if(i == 2) //if last 2 bytes are remaining
-			{
-				//Disable Acking
-				I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_DISABLE);
-
-				//generate STOP condition
-				if(Sr == I2C_DISABLE_SR )
-					I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		pI2CHandle->LostCount++;
+	}
 
-			}
+	return err;
+}
 
-			//read the data from data register in to buffer
-			*pRxBuffer = pI2CHandle->pI2Cx->DR;
 
-			//increment the buffer address
-			pRxBuffer++;
+/*********************************************************************
+ * @fn      		  - I2C_MasterReceiveData
+ *
+ * @brief             - blocking master reception
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - Rx buffer
+ * @param[in]         - number of bytes to receive
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - I2C_ENABLE_SR to keep the bus for a repeated start
+ *
+ * @return            - I2C_READY, or the I2C_ERROR_xxx which ended the transfer
+ *
+ * @Note              - same timeout and recovery rules as I2C_MasterSendData. With I2C_PEC and no
+ * 						repeated start the PEC byte is read after the data, a mismatch returns
+ * 						I2C_ERROR_PEC (the data is in the buffer anyway)
 
-		}
+ */
+uint8_t I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr)
+{
+	uint8_t err;
+	uint8_t retry = 0;
 
+	//another master won the arbitration : wait for it with an exponential backoff and go again
+	while( (err = I2C_MasterReceiveOnce(pI2CHandle,pRxBuffer,Len,SlaveAddr,Sr)) == I2C_ERROR_ARLO &&
+		   retry < pI2CHandle->I2C_Config.I2C_ArloRetries )
+	{
+		I2C_DelayCycles(I2C_ArloBackoff(retry++));
+		pI2CHandle->RetryCount++;
 	}
 
-	//re-enable ACKing
-	if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+	if(err == I2C_ERROR_ARLO)
 	{
-		I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_ENABLE);
+		pI2CHandle->LostCount++;
 	}
 
+	return err;
 }
 
 
@@ -518,7 +686,7 @@ void I2C_IRQPriorityConfig(uint8_t IRQNumber,uint32_t IRQPriority)
  * @Note              -
 
  */
-uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr,uint8_t Sr)
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxBuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr)
 {
 	uint8_t busystate = pI2CHandle->TxRxState;
 
@@ -529,6 +697,10 @@ uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxBuffer, uint32
 		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
 		pI2CHandle->DevAddr = SlaveAddr;
 		pI2CHandle->Sr = Sr;
+		pI2CHandle->Addr10Read = RESET;
+		pI2CHandle->PECSent = RESET;
+		pI2CHandle->PECErr = RESET;
+		pI2CHandle->EvStamp = DWT_CYCCNT_GET();
 
 		//Implement code to Generate START Condition
 		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
@@ -562,18 +734,21 @@ uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pTxBuffer, uint32
  * @Note              -
 
  */
-uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr,uint8_t Sr)
+uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr)
 {
 	uint8_t busystate = pI2CHandle->TxRxState;
 
 	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
 	{
 		pI2CHandle->pRxBuffer = pRxBuffer;
-		pI2CHandle->RxLen = Len;
+		pI2CHandle->RxLen = Len + I2C_PECUsed(pI2CHandle,Sr);	//SMBus : PEC byte after the data
 		pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
-		pI2CHandle->RxSize = Len;
+		pI2CHandle->RxSize = pI2CHandle->RxLen;
 		pI2CHandle->DevAddr = SlaveAddr;
 		pI2CHandle->Sr = Sr;
+		pI2CHandle->Addr10Read = RESET;
+		pI2CHandle->PECErr = RESET;
+		pI2CHandle->EvStamp = DWT_CYCCNT_GET();
 
 		//Implement code to Generate START Condition
 		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
@@ -591,75 +766,474 @@ uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uin
 	return busystate;
 }
 
-static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle )
+/*********************************************************************
+ * @fn      		  - I2C_MemWrite
+ *
+ * @brief             - writes Len bytes to the registers of a device starting at MemAddr
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - first register address
+ * @param[in]         - @I2C_MemAddrSize
+ * @param[in]         - data to be written
+ * @param[in]         - number of data bytes
+ *
+ * @return            - state before the call, I2C_READY means the transfer is started
+ *
+ * @Note              - START, address+W, register address and data run in one interrupt driven
+ * 						transfer, I2C_EV_TX_CMPLT is raised after the STOP is generated
+
+ */
+uint8_t I2C_MemWrite(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len)
 {
+	uint8_t busystate = pI2CHandle->TxRxState;
 
-	if(pI2CHandle->TxLen > 0)
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
 	{
-		//1. load the data in to DR
-		pI2CHandle->pI2Cx->DR = *(pI2CHandle->pTxBuffer);
-
-		//2. decrement the TxLen
-		pI2CHandle->TxLen--;
-
-		//3. Increment the buffer address
-		pI2CHandle->pTxBuffer++;
+		//1. register address bytes go out first from the TXE handler, then the data
+		pI2CHandle->MemXfer = I2C_MEM_WRITE;
+		pI2CHandle->MemAddr = MemAddr;
+		pI2CHandle->MemAddrLen = MemAddrSize;
 
+		//2. plain interrupt driven transmission, ending with STOP
+		I2C_MasterSendDataIT(pI2CHandle,pTxBuffer,Len,SlaveAddr,I2C_DISABLE_SR);
 	}
 
+	return busystate;
 }
 
-static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle )
-{
-	//We have to do the data reception
-	if(pI2CHandle->RxSize == 1)
-	{
-		*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
-		pI2CHandle->RxLen--;
-
-	}
-
 
-	if(pI2CHandle->RxSize > 1)
-	{
-		if(pI2CHandle->RxLen == 2)
-		{
-			//clear the ack bit
-			I2C_ManageAcking(pI2CHandle->pI2Cx,DISABLE);
-		}
+/*********************************************************************
+ * @fn      		  - I2C_MemRead
+ *
+ * @brief             - reads Len bytes from the registers of a device starting at MemAddr
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - first register address
+ * @param[in]         - @I2C_MemAddrSize
+ * @param[in]         - Rx buffer
+ * @param[in]         - number of bytes to read
+ *
+ * @return            - state before the call, I2C_READY means the transfer is started
+ *
+ * @Note              - The whole START, address+W, register address, repeated START, address+R,
+ * 						data, STOP sequence runs from the event interrupt. Only I2C_EV_RX_CMPLT
+ * 						is raised, the write phase has no event of its own
 
-			//read DR
-			*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
-			pI2CHandle->pRxBuffer++;
-			pI2CHandle->RxLen--;
-	}
+ */
+uint8_t I2C_MemRead(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
 
-	if(pI2CHandle->RxLen == 0 )
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
 	{
-		//close the I2C data reception and notify the application
-
-		//1. generate the stop condition
-		if(pI2CHandle->Sr == I2C_DISABLE_SR)
-			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		//1. the read phase is prepared now and started by the BTF of the write phase
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = Len;
+		pI2CHandle->RxSize = Len;
 
-		//2 . Close the I2C rx
-		I2C_CloseReceiveData(pI2CHandle);
+		pI2CHandle->MemXfer = I2C_MEM_READ;
+		pI2CHandle->MemAddr = MemAddr;
+		pI2CHandle->MemAddrLen = MemAddrSize;
 
-		//3. Notify the application
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_RX_CMPLT);
+		//2. write phase : register address only
+		I2C_MasterSendDataIT(pI2CHandle,NULL,0,SlaveAddr,I2C_ENABLE_SR);
+	}
+
+	return busystate;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_MasterSendDataDMA
+ *
+ * @brief             - starts a DMA driven master transmission
+ *
+ * @param[in]         - I2C handle, pDMATx must point to the Tx stream of this I2C
+ * @param[in]         - Tx buffer
+ * @param[in]         - number of bytes to send, 1 to 65535
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - I2C_ENABLE_SR to keep the bus for a repeated start
+ *
+ * @return            - state before the call, I2C_READY means the transfer is started
+ *
+ * @Note              - SB and ADDR are still served by the event interrupt, the data bytes
+ * 						are moved by the DMA. I2C_EV_TX_CMPLT is raised on BTF after the stream
+ * 						has delivered the last byte. No PEC is sent, even with I2C_PEC
+
+ */
+uint8_t I2C_MasterSendDataDMA(I2C_Handle_t *pI2CHandle,uint8_t *pTxBuffer, uint16_t Len, uint16_t SlaveAddr,uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->pTxBuffer = pTxBuffer;
+		pI2CHandle->TxLen = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->Addr10Read = RESET;
+		pI2CHandle->PECSent = SET;
+		pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+		pI2CHandle->DMARemaining = Len;
+
+		//0. DMA transfers run without PEC, the close functions enable it again
+		pI2CHandle->pI2Cx->CR1 &= ~( 1 << I2C_CR1_ENPEC);
+
+		//1. program the Tx stream, the I2C requests bytes on TXE once the address is acknowledged
+		I2C_ConfigDMAStream(pI2CHandle->pDMATx,DMA_DIR_MEM_TO_PERIPH);
+		DMA_StartTransfer(pI2CHandle->pDMATx,(uint32_t)&pI2CHandle->pI2Cx->DR,(uint32_t)pTxBuffer,Len);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_DMAEN);
+
+		//2. Generate START Condition
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		//3. ITBUFEN stays off, TXE is served by the DMA
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_MasterReceiveDataDMA
+ *
+ * @brief             - starts a DMA driven master reception
+ *
+ * @param[in]         - I2C handle, pDMARx must point to the Rx stream of this I2C
+ * @param[in]         - Rx buffer
+ * @param[in]         - number of bytes to receive, 1 to 65535
+ * @param[in]         - 7 bit slave address, or I2C_ADDR_10BIT(addr)
+ * @param[in]         - I2C_ENABLE_SR to keep the bus for a repeated start
+ *
+ * @return            - state before the call, I2C_READY means the transfer is started
+ *
+ * @Note              - With LAST set the hardware NACKs the byte which completes the stream,
+ * 						so the N-1/N-2 ACK handling of the IT mode is not needed. The whole
+ * 						reception costs the SB, ADDR and stream TC interrupts. No PEC is
+ * 						checked, even with I2C_PEC
+
+ */
+uint8_t I2C_MasterReceiveDataDMA(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint16_t Len, uint16_t SlaveAddr,uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+		pI2CHandle->RxSize = Len;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->Addr10Read = RESET;
+		pI2CHandle->PECErr = RESET;
+		pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+		pI2CHandle->DMARemaining = Len;
+
+		//0. DMA transfers run without PEC, the close functions enable it again
+		pI2CHandle->pI2Cx->CR1 &= ~( 1 << I2C_CR1_ENPEC);
+
+		//1. program the Rx stream
+		I2C_ConfigDMAStream(pI2CHandle->pDMARx,DMA_DIR_PERIPH_TO_MEM);
+		DMA_StartTransfer(pI2CHandle->pDMARx,(uint32_t)&pI2CHandle->pI2Cx->DR,(uint32_t)pRxBuffer,Len);
+
+		//2. ACK all bytes but the last one, a single byte is NACKed from the ADDR event
+		if(Len > 1)
+		{
+			I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_ENABLE);
+			pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_LAST);
+		}
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_DMAEN);
+
+		//3. Generate START Condition
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		//4. ITBUFEN stays off, RXNE is served by the DMA
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_QueueTransaction
+ *
+ * @brief             - appends a transaction to the bus queue and starts it if the bus is idle
+ *
+ * @param[in]         - I2C handle, configured as master with the event and error IRQs enabled
+ * @param[in]         - transaction, must stay valid until its callback reports I2C_EV_TX_CMPLT,
+ * 						I2C_EV_RX_CMPLT or an I2C_ERROR_xxx event
+ *
+ * @return            - I2C_READY if queued, otherwise the busy state of a non queued transfer
+ * 						which holds the bus
+ *
+ * @Note              - Transactions run back to back from the ISRs, each one ends with a STOP.
+ * 						Plain writes/reads use the DMA when pDMATx/pDMARx is set, register
+ * 						accesses always run from the event interrupt. On a bus error or NACK the
+ * 						transaction is ended, its callback gets the error and the next one is
+ * 						started. An arbitration loss is retried first, see I2C_ArloRetries.
+ * 						A retry, and a transaction whose turn comes while the previous STOP is
+ * 						still not on the bus after I2C_STOP_WAIT, are started by I2C_TimeoutHandling.
+ * 						The callback runs in interrupt context
+
+ */
+uint8_t I2C_QueueTransaction(I2C_Handle_t *pI2CHandle, I2C_Transaction_t *pTrans)
+{
+	uint32_t primask;
+	uint8_t idle;
+	uint8_t state = I2C_READY;
+
+	pTrans->pNext = NULL;
+
+	IRQ_LOCK(primask);
+	idle = (pI2CHandle->pQueueHead == NULL);
+	if(idle)
+	{
+		pI2CHandle->pQueueHead = pTrans;
+	}else
+	{
+		pI2CHandle->pQueueTail->pNext = pTrans;
+	}
+	pI2CHandle->pQueueTail = pTrans;
+	IRQ_UNLOCK(primask);
+
+	//nothing in flight, so the ISR can not touch the queue till this transaction is started
+	if(idle)
+	{
+		pI2CHandle->ArloRetry = 0;
+		state = I2C_QueueStart(pI2CHandle);
+		if(state != I2C_READY)
+		{
+			//not started, the caller keeps it. Another context may have appended behind it meanwhile
+			IRQ_LOCK(primask);
+			pI2CHandle->pQueueHead = pTrans->pNext;
+			if(pI2CHandle->pQueueHead == NULL)
+			{
+				pI2CHandle->pQueueTail = NULL;
+			}
+			IRQ_UNLOCK(primask);
+
+			if(pI2CHandle->pQueueHead)
+			{
+				I2C_QueueStart(pI2CHandle);
+			}
+		}
+	}
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_DMATxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the Tx DMA stream
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void I2C_DMATxIRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	uint8_t events = DMA_IRQHandling(pI2CHandle->pDMATx);
+
+	pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+
+	if(events & DMA_FLAG_TE)
+	{
+		I2C_DMAAbort(pI2CHandle);
+		return;
+	}
+
+	if(events & DMA_FLAG_TC)
+	{
+		//the last byte is in DR, the BTF event finishes the transfer
+		//TxLen first : BTF with DMAEN=0 and TxLen!=0 would never be served
+		pI2CHandle->TxLen = 0;
+		pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_DMAEN);
+
+		//BTF may have come first and muted the event interrupt
+		if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+		{
+			pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		}
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_DMARxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the Rx DMA stream
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void I2C_DMARxIRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	uint8_t events = DMA_IRQHandling(pI2CHandle->pDMARx);
+
+	pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+
+	if(events & DMA_FLAG_TE)
+	{
+		I2C_DMAAbort(pI2CHandle);
+		return;
+	}
+
+	if(events & DMA_FLAG_TC)
+	{
+		//1. all bytes are in memory, the last one was NACKed by the hardware
+		//   a single byte reception has already generated its STOP after ADDR
+		if(pI2CHandle->Sr == I2C_DISABLE_SR && pI2CHandle->RxSize > 1)
+			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+		//2. Close the I2C rx, this also clears DMAEN and LAST
+		I2C_CloseReceiveData(pI2CHandle);
+
+		//3. Notify the application
+		I2C_TransferComplete(pI2CHandle,I2C_EV_RX_CMPLT);
+	}
+}
+
+
+static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle )
+{
+
+	if(pI2CHandle->MemAddrLen > 0)
+	{
+		//register address of I2C_MemRead/I2C_MemWrite, MSB first
+		if(pI2CHandle->MemAddrLen == I2C_MEMADD_SIZE_16BIT)
+		{
+			pI2CHandle->pI2Cx->DR = (uint8_t)(pI2CHandle->MemAddr >> 8);
+		}else
+		{
+			pI2CHandle->pI2Cx->DR = (uint8_t)(pI2CHandle->MemAddr);
+		}
+		pI2CHandle->MemAddrLen--;
+
+	}else if(pI2CHandle->TxLen > 0)
+	{
+		//1. load the data in to DR
+		pI2CHandle->pI2Cx->DR = *(pI2CHandle->pTxBuffer);
+
+		//2. decrement the TxLen
+		pI2CHandle->TxLen--;
+
+		//3. Increment the buffer address
+		pI2CHandle->pTxBuffer++;
+
+	}else if(I2C_PECUsed(pI2CHandle,pI2CHandle->Sr) && !pI2CHandle->PECSent)
+	{
+		//SMBus : the last data byte is in the shift register, the PEC follows it
+		pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_PEC);
+		pI2CHandle->PECSent = SET;
+	}
+
+}
+
+static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle )
+{
+	uint8_t pec = I2C_PECUsed(pI2CHandle,pI2CHandle->Sr);
+	uint8_t ev = I2C_EV_RX_CMPLT;
+	uint32_t dummy_read;
+
+	//We have to do the data reception
+	if(pI2CHandle->RxSize == 1)
+	{
+		*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
+		pI2CHandle->RxLen--;
+
+	}
+
+
+	if(pI2CHandle->RxSize > 1)
+	{
+		if(pI2CHandle->RxLen == 2)
+		{
+			//clear the ack bit
+			I2C_ManageAcking(pI2CHandle->pI2Cx,DISABLE);
+
+			//SMBus : the last byte is the PEC, compared by the hardware
+			if(pec)
+				pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_PEC);
+		}
+
+		if(pec && pI2CHandle->RxLen == 1)
+		{
+			//PEC byte, not part of the data
+			dummy_read = pI2CHandle->pI2Cx->DR;
+			(void)dummy_read;
+		}else
+		{
+			//read DR
+			*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
+			pI2CHandle->pRxBuffer++;
+		}
+		pI2CHandle->RxLen--;
+	}
+
+	if(pI2CHandle->RxLen == 0 )
+	{
+		//close the I2C data reception and notify the application
+
+		//1. generate the stop condition
+		if(pI2CHandle->Sr == I2C_DISABLE_SR)
+			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+		//2. PECERR is set with the reception of the PEC byte, or was latched by the error interrupt
+		if(pec && (pI2CHandle->PECErr || (pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_PECERR))))
+		{
+			pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_PECERR);
+			ev = I2C_ERROR_PEC;
+		}
+
+		//3. Close the I2C rx
+		I2C_CloseReceiveData(pI2CHandle);
+
+		//4. Notify the application
+		I2C_TransferComplete(pI2CHandle,ev);
 	}
 }
 
 
 void I2C_CloseReceiveData(I2C_Handle_t *pI2CHandle)
 {
+	//a DMA reception ended early (NACK, error) : stop the stream
+	if(pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_DMAEN))
+	{
+		DMA_StopTransfer(pI2CHandle->pDMARx);
+	}
+	pI2CHandle->pI2Cx->CR2 &= ~( ( 1 << I2C_CR2_DMAEN) | ( 1 << I2C_CR2_LAST) );
+
 	//Implement the code to disable ITBUFEN Control Bit
 	pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITBUFEN);
 
 	//Implement the code to disable ITEVFEN Control Bit
 	pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITEVTEN);
 
+	//PEC is off during DMA transfers
+	if(pI2CHandle->I2C_Config.I2C_PEC == ENABLE)
+	{
+		pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_ENPEC);
+	}
+
 	pI2CHandle->TxRxState = I2C_READY;
+	pI2CHandle->MemXfer = I2C_MEM_NONE;
 	pI2CHandle->pRxBuffer = NULL;
 	pI2CHandle->RxLen = 0;
 	pI2CHandle->RxSize = 0;
@@ -673,6 +1247,13 @@ void I2C_CloseReceiveData(I2C_Handle_t *pI2CHandle)
 
 void I2C_CloseSendData(I2C_Handle_t *pI2CHandle)
 {
+	//a DMA transmission ended early (NACK, error) : stop the stream
+	if(pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_DMAEN))
+	{
+		DMA_StopTransfer(pI2CHandle->pDMATx);
+	}
+	pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_DMAEN);
+
 	//Implement the code to disable ITBUFEN Control Bit
 	pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITBUFEN);
 
@@ -680,7 +1261,15 @@ void I2C_CloseSendData(I2C_Handle_t *pI2CHandle)
 	pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITEVTEN);
 
 
+	//PEC is off during DMA transfers
+	if(pI2CHandle->I2C_Config.I2C_PEC == ENABLE)
+	{
+		pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_ENPEC);
+	}
+
 	pI2CHandle->TxRxState = I2C_READY;
+	pI2CHandle->MemXfer = I2C_MEM_NONE;
+	pI2CHandle->MemAddrLen = 0;
 	pI2CHandle->pTxBuffer = NULL;
 	pI2CHandle->TxLen = 0;
 }
@@ -697,6 +1286,38 @@ uint8_t I2C_SlaveReceiveData(I2C_RegDef_t *pI2C)
 }
 
 
+/*********************************************************************
+ * @fn      		  - I2C_SlaveRegFileInit
+ *
+ * @brief             - lets the driver serve a register file as an I2C slave
+ *
+ * @param[in]         - I2C handle, initialized with its own address, PE and ACK set
+ * @param[in]         - register file with pTable and NumRegs filled in
+ *
+ * @return            - none
+ *
+ * @Note              - Protocol of the usual I2C sensors : the first byte of a write is the register
+ * 						address, the next bytes are written from there on. A read (after a STOP or a
+ * 						repeated START) starts at the current register address. The address auto
+ * 						increments over the whole 8 bit space, unmapped or write only registers read
+ * 						as 0xFF and writes to them or to read only registers are dropped.
+ * 						I2C_EV_DATA_REQ, I2C_EV_DATA_RCV and the NACK ending a read are not passed
+ * 						to the application any more, I2C_EV_STOP still is. OnWrite runs in
+ * 						interrupt context
+
+ */
+void I2C_SlaveRegFileInit(I2C_Handle_t *pI2CHandle, I2C_RegFile_t *pRegFile)
+{
+	pRegFile->AddrPhase = RESET;
+	pRegFile->Nacked = RESET;
+	I2C_RegFileSeek(pRegFile,0);
+
+	pI2CHandle->pRegFile = pRegFile;
+
+	I2C_SlaveEnableDisableCallbackEvents(pI2CHandle->pI2Cx,ENABLE);
+}
+
+
 
 void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 {
@@ -704,6 +1325,11 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 
 	uint32_t temp1, temp2, temp3;
 
+	I2C_TRACE_RECORD(pI2CHandle->pI2Cx,I2C_TRACE_EV);
+
+	//the transfer is alive, see I2C_TimeoutHandling
+	pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+
 	temp1   = pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_ITEVTEN) ;
 	temp2   = pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_ITBUFEN) ;
 
@@ -715,7 +1341,9 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//The interrupt is generated because of SB event
 		//This block will not be executed in slave mode because for slave SB is always zero
 		//In this block lets executed the address phase
-		if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+		//a 10 bit reception selects the slave for writing first
+		if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX ||
+		   ( (pI2CHandle->DevAddr & I2C_ADDR_10BIT_FLAG) && !pI2CHandle->Addr10Read ))
 		{
 			I2C_ExecuteAddressPhaseWrite(pI2CHandle->pI2Cx,pI2CHandle->DevAddr);
 		}else if (pI2CHandle->TxRxState == I2C_BUSY_IN_RX )
@@ -724,14 +1352,45 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		}
 	}
 
+	temp3  = pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_ADD10);
+	//Handle For interrupt generated by ADD10 event (10 bit master only)
+	if(temp1 && temp3)
+	{
+		//header acknowledged, send the low address byte, writing DR clears ADD10
+		pI2CHandle->pI2Cx->DR = (uint8_t)pI2CHandle->DevAddr;
+	}
+
 	temp3  = pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_ADDR);
 	//2. Handle For interrupt generated by ADDR event
 	//Note : When master mode : Address is sent
 	//		 When Slave mode   : Address matched with own address
-	if(temp1 && temp3)
+	if(temp1 && temp3 && (pI2CHandle->DevAddr & I2C_ADDR_10BIT_FLAG) &&
+	   pI2CHandle->TxRxState == I2C_BUSY_IN_RX && !pI2CHandle->Addr10Read)
+	{
+		//10 bit reception : the slave is selected for writing, clear ADDR (SR1 was read above)
+		//and turn around with a repeated START, the SB event then sends the read header
+		temp3 = pI2CHandle->pI2Cx->SR2;
+		pI2CHandle->Addr10Read = SET;
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+	}else if(temp1 && temp3)
 	{
 		// interrupt is generated because of ADDR event
 		I2C_ClearADDRFlag(pI2CHandle);
+
+		//register file : a write starts with the register address, a read with the next byte
+		if(pI2CHandle->pRegFile && !(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_MSL)))
+		{
+			pI2CHandle->pRegFile->AddrPhase = !(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_TRA));
+			pI2CHandle->pRegFile->Nacked = RESET;
+		}
+
+		//single byte DMA reception : ACK is already off, STOP must follow ADDR clearing
+		if( (pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_DMAEN)) && (pI2CHandle->TxRxState == I2C_BUSY_IN_RX) )
+		{
+			if(pI2CHandle->RxSize == 1 && pI2CHandle->Sr == I2C_DISABLE_SR)
+				I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		}
 	}
 
 	temp3  = pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_BTF);
@@ -741,11 +1400,33 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//BTF flag is set
 		if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
 		{
+			if(pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_DMAEN))
+			{
+				//the Tx stream has not seen TC yet and BTF stays set till the next byte,
+				//mute the event interrupt, I2C_DMATxIRQHandling enables it again
+				pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITEVTEN);
+			}
 			//make sure that TXE is also set .
-			if(pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_TXE) )
+			else if(pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_TXE) )
 			{
 				//BTF, TXE = 1
-				if(pI2CHandle->TxLen == 0 )
+				if(pI2CHandle->TxLen == 0 && pI2CHandle->MemAddrLen == 0 && pI2CHandle->MemXfer == I2C_MEM_READ)
+				{
+					//register address is out, turn the bus around with a repeated START
+					//the SB event then sends address+R as the state is now Rx
+					pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+					pI2CHandle->MemXfer = I2C_MEM_NONE;
+					pI2CHandle->Sr = I2C_DISABLE_SR;
+
+					//SMBus : PEC byte after the data, a 10 bit slave only needs the read header
+					pI2CHandle->RxLen += I2C_PECUsed(pI2CHandle,pI2CHandle->Sr);
+					pI2CHandle->RxSize = pI2CHandle->RxLen;
+					pI2CHandle->Addr10Read = SET;
+					pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITBUFEN);
+					I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+				}else if(pI2CHandle->TxLen == 0 && pI2CHandle->MemAddrLen == 0 &&
+						 (pI2CHandle->PECSent || !I2C_PECUsed(pI2CHandle,pI2CHandle->Sr)))
 				{
 					//1. generate the STOP condition
 					if(pI2CHandle->Sr == I2C_DISABLE_SR)
@@ -755,7 +1436,7 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 					I2C_CloseSendData(pI2CHandle);
 
 					//3. notify the application about transmission complete
-					I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_TX_CMPLT);
+					I2C_TransferComplete(pI2CHandle,I2C_EV_TX_CMPLT);
 
 				}
 			}
@@ -801,7 +1482,13 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 			//make sure that the slave is really in transmitter mode
 		    if(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_TRA))
 		    {
-		    	I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_DATA_REQ);
+		    	if(pI2CHandle->pRegFile)
+		    	{
+		    		I2C_RegFileTransmit(pI2CHandle);
+		    	}else
+		    	{
+		    		I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_DATA_REQ);
+		    	}
 		    }
 		}
 	}
@@ -828,7 +1515,13 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 			//make sure that the slave is really in receiver mode
 			if(!(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_TRA)))
 			{
-				I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_DATA_RCV);
+				if(pI2CHandle->pRegFile)
+				{
+					I2C_RegFileReceive(pI2CHandle);
+				}else
+				{
+					I2C_ApplicationEventCallback(pI2CHandle,I2C_EV_DATA_RCV);
+				}
 			}
 		}
 	}
@@ -862,6 +1555,8 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 
 	uint32_t temp1,temp2;
 
+	I2C_TRACE_RECORD(pI2CHandle->pI2Cx,I2C_TRACE_ER);
+
     //Know the status of  ITERREN control bit in the CR2
 	temp2 = (pI2CHandle->pI2Cx->CR2) & ( 1 << I2C_CR2_ITERREN);
 
@@ -876,7 +1571,15 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_BERR);
 
 		//Implement the code to notify the application about the error
-	   I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_BERR);
+		if(pI2CHandle->TxRxState != I2C_READY)
+		{
+			//misplaced START/STOP during our transfer, the peripheral may be left with BUSY set
+			I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_BERR);
+			I2C_BusRecover(pI2CHandle);
+		}else
+		{
+			I2C_HandleError(pI2CHandle,I2C_ERROR_BERR);
+		}
 	}
 
 /***********************Check for arbitration lost error************************************/
@@ -888,8 +1591,8 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the arbitration lost error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_ARLO);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_ARLO);
+		//end the transfer without STOP, retry it or notify the application about the error
+		I2C_HandleArbitrationLoss(pI2CHandle);
 
 	}
 
@@ -903,8 +1606,20 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 	    //Implement the code to clear the ACK failure error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_AF);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_AF);
+		if(pI2CHandle->pRegFile && !(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_MSL)))
+		{
+			//register file read ended by the master. The byte preloaded in DR (TXE clear)
+			//was never sent, so it is read again next time
+			if(!(pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_TXE)))
+			{
+				I2C_RegFileSeek(pI2CHandle->pRegFile,pI2CHandle->pRegFile->Ptr - 1);
+			}
+			pI2CHandle->pRegFile->Nacked = SET;
+		}else
+		{
+			//Implement the code to notify the application about the error
+			I2C_HandleError(pI2CHandle,I2C_ERROR_AF);
+		}
 	}
 
 /***********************Check for Overrun/underrun error************************************/
@@ -917,7 +1632,21 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_OVR);
 
 		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_OVR);
+		I2C_HandleError(pI2CHandle,I2C_ERROR_OVR);
+	}
+
+/***********************Check for PEC error************************************/
+	temp1 = (pI2CHandle->pI2Cx->SR1) & ( 1 << I2C_SR1_PECERR);
+	if(temp1  && temp2)
+	{
+		//The received PEC did not match, the hardware NACKed it
+
+		//clear the PEC error flag, the RXNE handler reports it at the end of the reception
+		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_PECERR);
+		if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
+		{
+			pI2CHandle->PECErr = SET;
+		}
 	}
 
 /***********************Check for Time out error************************************/
@@ -930,12 +1659,877 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_TIMEOUT);
 
 		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_TIMEOUT);
+		I2C_HandleError(pI2CHandle,I2C_ERROR_TIMEOUT);
+	}
+
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_TimeoutHandling
+ *
+ * @brief             - recovers the bus when an IT/DMA transfer made no progress for I2C_Timeout cycles
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - Call it periodically (SysTick, main loop). A slave holding SCL or SDA low
+ * 						stops the events, so the transfer would never end on its own. A DMA
+ * 						transfer counts as progressing while its NDTR moves. It also starts a
+ * 						queued transaction waiting for its backoff after a lost arbitration, or
+ * 						for a STOP which took longer than I2C_STOP_WAIT
+
+ */
+void I2C_TimeoutHandling(I2C_Handle_t *pI2CHandle)
+{
+	uint32_t primask;
+	uint8_t stalled;
+	uint8_t retry;
+
+	IRQ_LOCK(primask);
+	//a DMA transfer raises no event between its start and its TC, NDTR going down is its progress
+	if( (pI2CHandle->TxRxState != I2C_READY) && (pI2CHandle->pI2Cx->CR2 & ( 1 << I2C_CR2_DMAEN)) )
+	{
+		DMA_Handle_t *pDMAHandle = (pI2CHandle->TxRxState == I2C_BUSY_IN_TX) ? pI2CHandle->pDMATx : pI2CHandle->pDMARx;
+
+		if(pDMAHandle && (DMA_GetRemaining(pDMAHandle) != pI2CHandle->DMARemaining))
+		{
+			pI2CHandle->DMARemaining = DMA_GetRemaining(pDMAHandle);
+			pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+		}
+	}
+
+	stalled = ( (pI2CHandle->TxRxState != I2C_READY) || pI2CHandle->StopWait ) &&
+			  ( (DWT_CYCCNT_GET() - pI2CHandle->EvStamp) > I2C_GetTimeout(pI2CHandle) );
+	if(stalled)
+	{
+		//no more events for this transfer, I2C_BusRecover ends it
+		pI2CHandle->pI2Cx->CR2 &= ~( ( 1 << I2C_CR2_ITEVTEN) | ( 1 << I2C_CR2_ITBUFEN) );
+	}
+
+	//queue head waiting for its backoff after a lost arbitration, or for a direct transfer
+	retry = (pI2CHandle->RetryDelay != 0) && pI2CHandle->pQueueHead && !pI2CHandle->QueueActive &&
+			(pI2CHandle->TxRxState == I2C_READY) &&
+			( (DWT_CYCCNT_GET() - pI2CHandle->RetryStamp) >= pI2CHandle->RetryDelay );
+	if(retry)
+	{
+		pI2CHandle->RetryDelay = 0;
+	}
+	IRQ_UNLOCK(primask);
+
+	if(stalled)
+	{
+		I2C_BusRecover(pI2CHandle);
+	}
+
+	if(retry)
+	{
+		//nothing is in flight, so the ISRs do not touch the queue till it is started.
+		//A direct transfer holding the peripheral makes I2C_QueueStart try again on the next call
+		I2C_QueueStart(pI2CHandle);
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_BusRecover
+ *
+ * @brief             - frees a bus held by a slave and brings the peripheral back to its configuration
+ *
+ * @param[in]         - I2C handle, pSCLPort/pSDAPort set for the bus clear
+ *
+ * @return            - I2C_READY if SDA is released, I2C_ERROR_BUS_STUCK if not
+ *
+ * @Note              - 1. the transfer in flight is ended (its DMA stream is stopped)
+ * 						2. with the pins as open drain outputs, up to 9 SCL clocks until the slave
+ * 						   releases SDA, then a STOP
+ * 						3. SWRST, I2C_Init and PE, the pins go back to the I2C
+ * 						The application gets I2C_ERROR_BUS_RECOVERED or I2C_ERROR_BUS_STUCK, so does
+ * 						the callback of the queued transaction which was ended
+
+ */
+uint8_t I2C_BusRecover(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint8_t busy = (pI2CHandle->TxRxState != I2C_READY);
+	uint8_t released;
+	uint8_t ev;
+
+	//1. end the transfer in flight, this also stops its DMA stream
+	if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+	{
+		I2C_CloseSendData(pI2CHandle);
+	}else if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
+	{
+		I2C_CloseReceiveData(pI2CHandle);
+	}
+	pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITERREN);
+	pI2Cx->CR1 &= ~( 1 << I2C_CR1_PE);
+
+	//2. clock the slave out of the byte it is stuck in
+	released = SET;
+	if(pI2CHandle->pSCLPort && pI2CHandle->pSDAPort)
+	{
+		released = I2C_BusClear(pI2CHandle);
+	}
+
+	//3. reset the peripheral, this also clears a BUSY flag latched by a glitch, then program it again
+	pI2Cx->CR1 |= ( 1 << I2C_CR1_SWRST);
+	pI2Cx->CR1 &= ~( 1 << I2C_CR1_SWRST);
+
+	//same configuration, its timing was accepted by the first I2C_Init
+	(void)I2C_Init(pI2CHandle);
+	I2C_PeripheralControl(pI2Cx,ENABLE);
+
+	//ack bit is made 1 after PE=1
+	if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+	{
+		I2C_ManageAcking(pI2Cx,I2C_ACK_ENABLE);
+	}
+
+	//4. notify, the queue then moves on
+	ev = released ? I2C_ERROR_BUS_RECOVERED : I2C_ERROR_BUS_STUCK;
+	I2C_ApplicationEventCallback(pI2CHandle,ev);
+
+	if(busy && pI2CHandle->QueueActive)
+	{
+		I2C_QueueComplete(pI2CHandle,ev);
+	}
+
+	return released ? I2C_READY : I2C_ERROR_BUS_STUCK;
+}
+
+
+//some helper function implementations
+
+static void I2C_ConfigDMAStream(DMA_Handle_t *pDMAHandle, uint8_t Direction)
+{
+	//byte transfers, channel/priority/FIFO are taken from the application's DMA handle
+	pDMAHandle->DMAConfig.DMA_Direction = Direction;
+	pDMAHandle->DMAConfig.DMA_PeriphDataSize = DMA_DATASIZE_BYTE;
+	pDMAHandle->DMAConfig.DMA_MemDataSize = DMA_DATASIZE_BYTE;
+	pDMAHandle->DMAConfig.DMA_MemInc = ENABLE;
+	pDMAHandle->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pDMAHandle->DMAConfig.DMA_IntEnable = DMA_IT_TC | DMA_IT_TE;
+
+	DMA_Init(pDMAHandle);
+}
+
+
+static void I2C_DMAAbort(I2C_Handle_t *pI2CHandle)
+{
+	//release the bus, then stop the stream and notify
+	I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+	if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+	{
+		I2C_CloseSendData(pI2CHandle);
+	}else
+	{
+		I2C_CloseReceiveData(pI2CHandle);
+	}
+
+	I2C_TransferComplete(pI2CHandle,I2C_ERROR_DMA);
+}
+
+
+static void I2C_TransferComplete(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	//a direct transfer may run while the queue head waits for its retry
+	if(pI2CHandle->QueueActive)
+	{
+		//transfer belongs to the transaction queue
+		I2C_QueueComplete(pI2CHandle,AppEv);
+	}else
+	{
+		I2C_ApplicationEventCallback(pI2CHandle,AppEv);
+	}
+}
+
+
+static void I2C_HandleError(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	//for a direct transfer the application decides what to do with it
+	if(!pI2CHandle->QueueActive || pI2CHandle->TxRxState == I2C_READY)
+	{
+		I2C_ApplicationEventCallback(pI2CHandle,AppEv);
+		return;
+	}
+
+	//a queued transfer can not go on : release the bus if we still own it, then move on
+	if(pI2CHandle->pI2Cx->SR2 & ( 1 << I2C_SR2_MSL))
+	{
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+	}
+
+	if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+	{
+		I2C_CloseSendData(pI2CHandle);
+	}else
+	{
+		I2C_CloseReceiveData(pI2CHandle);
+	}
+
+	I2C_QueueComplete(pI2CHandle,AppEv);
+}
+
+
+static uint8_t I2C_QueueStart(I2C_Handle_t *pI2CHandle)
+{
+	I2C_Transaction_t *pTrans = pI2CHandle->pQueueHead;
+	uint32_t primask;
+	uint32_t start;
+	uint8_t state;
+
+	//0. a direct transfer holds the peripheral : I2C_TimeoutHandling tries again later
+	if(pI2CHandle->TxRxState != I2C_READY)
+	{
+		pI2CHandle->RetryStamp = DWT_CYCCNT_GET();
+		pI2CHandle->RetryDelay = 1;
+		return pI2CHandle->TxRxState;
+	}
+
+	//1. the STOP of the previous transfer must be on the bus before the next START (CR1 is
+	//   not written while STOP is pending), this also clears the TXE/BTF left over from it.
+	//   It takes about half an SCL period, so the ISR waits for it, bounded. A STOP which does
+	//   not come in time leaves the start to I2C_TimeoutHandling, which also recovers the bus
+	start = DWT_CYCCNT_GET();
+	while( (pI2CHandle->pI2Cx->CR1 & ( 1 << I2C_CR1_STOP)) && (DWT_CYCCNT_GET() - start) < I2C_STOP_WAIT );
+
+	if(pI2CHandle->pI2Cx->CR1 & ( 1 << I2C_CR1_STOP))
+	{
+		if(!pI2CHandle->StopWait)
+		{
+			pI2CHandle->StopWait = SET;
+			pI2CHandle->EvStamp = DWT_CYCCNT_GET();
+		}
+		pI2CHandle->RetryStamp = DWT_CYCCNT_GET();
+		pI2CHandle->RetryDelay = 1;
+		return I2C_READY;
+	}
+	pI2CHandle->StopWait = RESET;
+
+	//2. start it, register accesses run from the event interrupt, the others may use the DMA.
+	//   Its events go to the queue from now on, a direct transfer could not start in between
+	IRQ_LOCK(primask);
+	pI2CHandle->QueueActive = SET;
+	switch(pTrans->Type)
+	{
+	case I2C_TRANS_WRITE:
+		if(pI2CHandle->pDMATx)
+		{
+			state = I2C_MasterSendDataDMA(pI2CHandle,pTrans->pBuffer,(uint16_t)pTrans->Len,pTrans->SlaveAddr,I2C_DISABLE_SR);
+		}else
+		{
+			state = I2C_MasterSendDataIT(pI2CHandle,pTrans->pBuffer,pTrans->Len,pTrans->SlaveAddr,I2C_DISABLE_SR);
+		}
+		break;
+	case I2C_TRANS_READ:
+		if(pI2CHandle->pDMARx)
+		{
+			state = I2C_MasterReceiveDataDMA(pI2CHandle,pTrans->pBuffer,(uint16_t)pTrans->Len,pTrans->SlaveAddr,I2C_DISABLE_SR);
+		}else
+		{
+			state = I2C_MasterReceiveDataIT(pI2CHandle,pTrans->pBuffer,(uint8_t)pTrans->Len,pTrans->SlaveAddr,I2C_DISABLE_SR);
+		}
+		break;
+	case I2C_TRANS_MEM_WRITE:
+		state = I2C_MemWrite(pI2CHandle,pTrans->SlaveAddr,pTrans->MemAddr,pTrans->MemAddrSize,pTrans->pBuffer,pTrans->Len);
+		break;
+	default:
+		state = I2C_MemRead(pI2CHandle,pTrans->SlaveAddr,pTrans->MemAddr,pTrans->MemAddrSize,pTrans->pBuffer,pTrans->Len);
+		break;
+	}
+	if(state != I2C_READY)
+	{
+		pI2CHandle->QueueActive = RESET;
+	}
+	IRQ_UNLOCK(primask);
+
+	return state;
+}
+
+
+static void I2C_QueueComplete(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	I2C_Transaction_t *pTrans = pI2CHandle->pQueueHead;
+
+	//1. pop it, the thread mode only appends at the tail under IRQ_LOCK
+	pI2CHandle->QueueActive = RESET;
+	pI2CHandle->pQueueHead = pTrans->pNext;
+	if(pI2CHandle->pQueueHead == NULL)
+	{
+		pI2CHandle->pQueueTail = NULL;
+	}
+	pI2CHandle->ArloRetry = 0;
+	pI2CHandle->RetryDelay = 0;
+
+	//2. inform the owner, it may queue (this or another) transaction from here
+	if(pTrans->Callback)
+	{
+		pTrans->Callback(pTrans,AppEv);
+	}
+
+	//3. run the next one back to back, unless queueing from the callback already started it.
+	//   A direct transfer started from the callback makes it wait for I2C_TimeoutHandling
+	if(pI2CHandle->pQueueHead && !pI2CHandle->QueueActive)
+	{
+		I2C_QueueStart(pI2CHandle);
+	}
+}
+
+
+static uint32_t I2C_GetTimeout(I2C_Handle_t *pI2CHandle)
+{
+	return pI2CHandle->I2C_Config.I2C_Timeout ? pI2CHandle->I2C_Config.I2C_Timeout : I2C_TIMEOUT_DEFAULT;
+}
+
+
+static uint8_t I2C_WaitFlag(I2C_Handle_t *pI2CHandle, uint32_t FlagName)
+{
+	uint32_t start = DWT_CYCCNT_GET();
+
+	while( ! I2C_GetFlagStatus(pI2CHandle->pI2Cx,FlagName) )
+	{
+		//the slave did not acknowledge the address or the last byte
+		if(pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_AF))
+		{
+			return I2C_ERROR_AF;
+		}
+
+		//another master won the bus, we are a slave again
+		if(pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_ARLO))
+		{
+			return I2C_ERROR_ARLO;
+		}
+
+		if( (DWT_CYCCNT_GET() - start) > I2C_GetTimeout(pI2CHandle) )
+		{
+			return I2C_ERROR_TIMEOUT;
+		}
+	}
+
+	return I2C_READY;
+}
+
+
+static uint8_t I2C_WaitBusFree(I2C_Handle_t *pI2CHandle)
+{
+	uint32_t start = DWT_CYCCNT_GET();
+	uint32_t sr2;
+
+	//BUSY with MSL is our own bus kept for a repeated start
+	while( ( (sr2 = pI2CHandle->pI2Cx->SR2) & ( 1 << I2C_SR2_BUSY)) && !(sr2 & ( 1 << I2C_SR2_MSL)) )
+	{
+		if( (DWT_CYCCNT_GET() - start) > I2C_GetTimeout(pI2CHandle) )
+		{
+			return I2C_ERROR_BUS_BUSY;
+		}
+	}
+
+	return I2C_READY;
+}
+
+
+static uint8_t I2C_MasterAbort(I2C_Handle_t *pI2CHandle, uint8_t Error)
+{
+	if(Error == I2C_ERROR_AF)
+	{
+		//NACK : the bus is ours and fine, release it
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_AF);
+
+		if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+		{
+			I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_ENABLE);
+		}
+	}else if(Error == I2C_ERROR_ARLO)
+	{
+		//the hardware has released the lines, the other master sends the STOP
+		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_ARLO);
+		pI2CHandle->ArloCount++;
+
+		if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+		{
+			I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_ENABLE);
+		}
+	}else
+	{
+		//a line is held low (or the peripheral is stuck)
+		I2C_BusRecover(pI2CHandle);
+	}
+
+	return Error;
+}
+
+
+static uint8_t I2C_BusClear(I2C_Handle_t *pI2CHandle)
+{
+	GPIO_RegDef_t *pSCL = pI2CHandle->pSCLPort;
+	GPIO_RegDef_t *pSDA = pI2CHandle->pSDAPort;
+	uint8_t released;
+	uint32_t start;
+
+	//1. both lines released, then taken over from the I2C (open drain is kept from the pin setup)
+	GPIO_WriteToOutputPin(pSCL,pI2CHandle->SCLPin,GPIO_PIN_SET);
+	GPIO_WriteToOutputPin(pSDA,pI2CHandle->SDAPin,GPIO_PIN_SET);
+	I2C_PinMode(pSCL,pI2CHandle->SCLPin,GPIO_MODE_OUT);
+	I2C_PinMode(pSDA,pI2CHandle->SDAPin,GPIO_MODE_OUT);
+	I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+
+	//2. up to 9 clocks, the slave shifts out the rest of its byte and releases SDA on the NACK
+	for(uint8_t i = 0 ; i < 9 && ! GPIO_ReadFromInputPin(pSDA,pI2CHandle->SDAPin) ; i++)
+	{
+		GPIO_WriteToOutputPin(pSCL,pI2CHandle->SCLPin,GPIO_PIN_RESET);
+		I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+		GPIO_WriteToOutputPin(pSCL,pI2CHandle->SCLPin,GPIO_PIN_SET);
+
+		//the slave may stretch the clock
+		start = DWT_CYCCNT_GET();
+		while( ! GPIO_ReadFromInputPin(pSCL,pI2CHandle->SCLPin) && (DWT_CYCCNT_GET() - start) < I2C_GetTimeout(pI2CHandle) );
+		I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
 	}
 
+	//3. STOP : SDA low to high while SCL is high
+	GPIO_WriteToOutputPin(pSCL,pI2CHandle->SCLPin,GPIO_PIN_RESET);
+	I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+	GPIO_WriteToOutputPin(pSDA,pI2CHandle->SDAPin,GPIO_PIN_RESET);
+	I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+	GPIO_WriteToOutputPin(pSCL,pI2CHandle->SCLPin,GPIO_PIN_SET);
+	I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+	GPIO_WriteToOutputPin(pSDA,pI2CHandle->SDAPin,GPIO_PIN_SET);
+	I2C_DelayCycles(I2C_BUSCLEAR_HALF_PERIOD);
+
+	released = GPIO_ReadFromInputPin(pSDA,pI2CHandle->SDAPin);
+
+	//4. give the pins back to the I2C
+	I2C_PinMode(pSCL,pI2CHandle->SCLPin,GPIO_MODE_ALTFN);
+	I2C_PinMode(pSDA,pI2CHandle->SDAPin,GPIO_MODE_ALTFN);
+
+	return released;
+}
+
+
+static void I2C_PinMode(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Mode)
+{
+	pGPIOx->MODER = (pGPIOx->MODER & ~( 0x3 << (2 * PinNumber))) | ( (uint32_t)Mode << (2 * PinNumber));
+}
+
+
+static void I2C_DelayCycles(uint32_t Cycles)
+{
+	uint32_t start = DWT_CYCCNT_GET();
+
+	while( (DWT_CYCCNT_GET() - start) < Cycles );
+}
+
+
+static void I2C_RegFileSeek(I2C_RegFile_t *pRegFile, uint8_t RegAddr)
+{
+	//the only search, done once per register address sent by the master
+	pRegFile->Ptr = RegAddr;
+	pRegFile->Idx = 0;
+	while( pRegFile->Idx < pRegFile->NumRegs &&
+		   (uint16_t)pRegFile->pTable[pRegFile->Idx].Addr + pRegFile->pTable[pRegFile->Idx].Size <= RegAddr )
+	{
+		pRegFile->Idx++;
+	}
+}
+
+
+static void I2C_RegFileNext(I2C_RegFile_t *pRegFile)
+{
+	pRegFile->Ptr++;
+
+	if(pRegFile->Ptr == 0)
+	{
+		//wrapped around the 8 bit space
+		pRegFile->Idx = 0;
+	}else if(pRegFile->Idx < pRegFile->NumRegs &&
+			 (uint16_t)pRegFile->pTable[pRegFile->Idx].Addr + pRegFile->pTable[pRegFile->Idx].Size <= pRegFile->Ptr)
+	{
+		pRegFile->Idx++;
+	}
+}
+
+
+static void I2C_RegFileTransmit(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegFile_t *pRegFile = pI2CHandle->pRegFile;
+	I2C_Register_t *pReg = &pRegFile->pTable[pRegFile->Idx];
+	uint8_t data = 0xFF;
+
+	//TXE may come again between the NACK and the STOP, keep the pointer where the master stopped
+	if(pRegFile->Nacked)
+	{
+		pI2CHandle->pI2Cx->DR = data;
+		return;
+	}
+
+	if(pRegFile->Idx < pRegFile->NumRegs && pRegFile->Ptr >= pReg->Addr && (pReg->Access & I2C_REG_RO))
+	{
+		data = pReg->pData[pRegFile->Ptr - pReg->Addr];
+	}
+	pI2CHandle->pI2Cx->DR = data;
+
+	I2C_RegFileNext(pRegFile);
+}
+
+
+static void I2C_RegFileReceive(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegFile_t *pRegFile = pI2CHandle->pRegFile;
+	I2C_Register_t *pReg = &pRegFile->pTable[pRegFile->Idx];
+	uint8_t data = (uint8_t)pI2CHandle->pI2Cx->DR;
+
+	if(pRegFile->AddrPhase)
+	{
+		pRegFile->AddrPhase = RESET;
+		I2C_RegFileSeek(pRegFile,data);
+		return;
+	}
+
+	if(pRegFile->Idx < pRegFile->NumRegs && pRegFile->Ptr >= pReg->Addr && (pReg->Access & I2C_REG_WO))
+	{
+		pReg->pData[pRegFile->Ptr - pReg->Addr] = data;
+
+		//the whole entry is written, let the application act on it
+		if(pRegFile->Ptr == pReg->Addr + pReg->Size - 1 && pReg->OnWrite)
+		{
+			pReg->OnWrite(pReg);
+		}
+	}
+
+	I2C_RegFileNext(pRegFile);
+}
+
+
+static uint8_t I2C_MasterAddress10(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr, uint8_t Read)
+{
+	uint8_t err;
+	uint32_t dummy_read;
+
+	//1. header 11110 A9 A8 0, ADD10 is set once it is acknowledged
+	I2C_ExecuteAddressPhaseWrite(pI2CHandle->pI2Cx,SlaveAddr);
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_ADD10);
+	if(err != I2C_READY)
+		return err;
+
+	//2. low address byte, writing DR clears ADD10. A transmission goes on with ADDR
+	pI2CHandle->pI2Cx->DR = (uint8_t)SlaveAddr;
+	if(!Read)
+		return I2C_READY;
+
+	//3. reception : the slave is selected, clear ADDR and turn around with a repeated START
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_ADDR);
+	if(err != I2C_READY)
+		return err;
+	dummy_read = pI2CHandle->pI2Cx->SR1;
+	dummy_read = pI2CHandle->pI2Cx->SR2;
+	(void)dummy_read;
+
+	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_SB);
+	if(err != I2C_READY)
+		return err;
+
+	//4. read header only, the caller waits for ADDR
+	I2C_ExecuteAddressPhaseRead(pI2CHandle->pI2Cx,SlaveAddr);
+
+	return I2C_READY;
+}
+
+
+static uint8_t I2C_PECUsed(I2C_Handle_t *pI2CHandle, uint8_t Sr)
+{
+	//the PEC ends an SMBus transfer, a repeated start goes on with the same packet
+	return (pI2CHandle->I2C_Config.I2C_PEC == ENABLE) && (Sr == I2C_DISABLE_SR);
+}
+
+
+#ifdef I2C_TRACE
+static inline void I2C_TraceRecord(I2C_RegDef_t *pI2Cx, uint8_t Tag)
+{
+	I2C_TraceEntry_t *pEntry;
+	uint32_t primask;
+	uint16_t sr1 = 0;
+	uint8_t sr2 = I2C_TRACE_SR2_NONE;
+
+	//START/STOP marks come from thread mode too, an interrupt between the read and the
+	//write of Head would take the same slot
+	IRQ_LOCK(primask);
+	pEntry = &I2C_Trace.Entry[I2C_Trace.Head++ & (I2C_TRACE_DEPTH - 1)];
+	pEntry->Stamp = DWT_CYCCNT_GET();
+	IRQ_UNLOCK(primask);
+
+	//the marks only need the time
+	if(Tag < I2C_TRACE_START)
+	{
+		sr1 = pI2Cx->SR1;
+		//SR1 then SR2 clears ADDR, the handler must still see it
+		if(!(sr1 & ( 1 << I2C_SR1_ADDR)))
+			sr2 = pI2Cx->SR2;
+	}
+
+	pEntry->SR1 = sr1;
+	pEntry->SR2 = sr2;
+	//I2C1/2/3 sit at 0x40005400/5800/5C00
+	pEntry->Tag = Tag | (((uint32_t)pI2Cx >> 10) & 0x3);
+}
+#endif
+
+
+static uint8_t I2C_MasterSendOnce(I2C_Handle_t *pI2CHandle,uint8_t *pTxbuffer, uint32_t Len, uint16_t SlaveAddr,uint8_t Sr)
+{
+	uint8_t err;
+
+	// 0. the bus must be free, unless we still own it after a repeated start
+	err = I2C_WaitBusFree(pI2CHandle);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+	// 1. Generate the START condition
+	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+	//2. confirm that start generation is completed by checking the SB flag in the SR1
+	//   Note: Until SB is cleared SCL will be stretched (pulled to LOW)
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_SB);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+	//3. Send the address of the slave with r/nw bit set to w(0) (total 8 bits )
+	//   a 10 bit address takes the header and the ADD10 phase first
+	if(SlaveAddr & I2C_ADDR_10BIT_FLAG)
+	{
+		err = I2C_MasterAddress10(pI2CHandle,SlaveAddr,RESET);
+		if(err != I2C_READY)
+			return I2C_MasterAbort(pI2CHandle,err);
+	}else
+	{
+		I2C_ExecuteAddressPhaseWrite(pI2CHandle->pI2Cx,SlaveAddr);
+	}
+
+	//4. Confirm that address phase is completed by checking the ADDR flag in teh SR1
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_ADDR);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+	//5. clear the ADDR flag according to its software sequence
+	//   Note: Until ADDR is cleared SCL will be stretched (pulled to LOW)
+	I2C_ClearADDRFlag(pI2CHandle);
+
+	//6. send the data until len becomes 0
+
+	while(Len > 0)
+	{
+		err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_TXE); //Wait till TXE is set
+		if(err != I2C_READY)
+			return I2C_MasterAbort(pI2CHandle,err);
+		pI2CHandle->pI2Cx->DR = *pTxbuffer;
+		pTxbuffer++;
+		Len--;
+	}
+
+	//7. when Len becomes zero wait for TXE=1 and BTF=1 before generating the STOP condition
+	//   Note: TXE=1 , BTF=1 , means that both SR and DR are empty and next transmission should begin
+	//   when BTF=1 SCL will be stretched (pulled to LOW)
+
+	//   SMBus : the PEC goes out after the last data byte, before the STOP
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_TXE);
+	if(err == I2C_READY && I2C_PECUsed(pI2CHandle,Sr))
+		pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_PEC);
+	if(err == I2C_READY)
+		err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_BTF);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+
+	//8. Generate STOP condition and master need not to wait for the completion of stop condition.
+	//   Note: generating STOP, automatically clears the BTF
+	if(Sr == I2C_DISABLE_SR )
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+	return I2C_READY;
 }
 
 
+static uint8_t I2C_MasterReceiveOnce(I2C_Handle_t *pI2CHandle,uint8_t *pRxBuffer, uint8_t Len, uint16_t SlaveAddr,uint8_t Sr)
+{
+	uint8_t err;
+	uint8_t pec = I2C_PECUsed(pI2CHandle,Sr);
+	uint32_t total = Len + pec;	//SMBus : the PEC byte is received after the data
+	uint32_t dummy_read;
+
+	//0. the bus must be free, unless we still own it after a repeated start
+	err = I2C_WaitBusFree(pI2CHandle);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+	//1. Generate the START condition
+	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+	//2. confirm that start generation is completed by checking the SB flag in the SR1
+	//   Note: Until SB is cleared SCL will be stretched (pulled to LOW)
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_SB);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+	//3. Send the address of the slave with r/nw bit set to R(1) (total 8 bits )
+	//   a 10 bit address selects the slave for writing first, then turns around with a repeated START
+	if(SlaveAddr & I2C_ADDR_10BIT_FLAG)
+	{
+		err = I2C_MasterAddress10(pI2CHandle,SlaveAddr,SET);
+		if(err != I2C_READY)
+			return I2C_MasterAbort(pI2CHandle,err);
+	}else
+	{
+		I2C_ExecuteAddressPhaseRead(pI2CHandle->pI2Cx,SlaveAddr);
+	}
+
+	//4. wait until address phase is completed by checking the ADDR flag in teh SR1
+	err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_ADDR);
+	if(err != I2C_READY)
+		return I2C_MasterAbort(pI2CHandle,err);
+
+
+	//procedure to read only 1 byte from slave
+	if(total == 1)
+	{
+		//Disable Acking
+		I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_DISABLE);
+
+
+		//clear the ADDR flag
+		I2C_ClearADDRFlag(pI2CHandle);
+
+		//wait until  RXNE becomes 1
+		err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_RXNE);
+		if(err != I2C_READY)
+			return I2C_MasterAbort(pI2CHandle,err);
+
+		//generate STOP condition
+		if(Sr == I2C_DISABLE_SR )
+			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+		//read data in to buffer
+		*pRxBuffer = pI2CHandle->pI2Cx->DR;
+
+	}
+
 
+    //procedure to read data from slave when Len > 1
+	if(total > 1)
+	{
+		//clear the ADDR flag
+		I2C_ClearADDRFlag(pI2CHandle);
 
+		//read the data until Len becomes zero
+		for ( uint32_t i = total ; i > 0 ; i--)
+		{
+			//wait until RXNE becomes 1
+			err = I2C_WaitFlag(pI2CHandle,I2C_FLAG_RXNE);
+			if(err != I2C_READY)
+				return I2C_MasterAbort(pI2CHandle,err);
 
+			if(i == 2) //if last 2 bytes are remaining
+			{
+				//Disable Acking
+				I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_DISABLE);
+
+				//SMBus : the last byte is the PEC, compared by the hardware
+				if(pec)
+					pI2CHandle->pI2Cx->CR1 |= ( 1 << I2C_CR1_PEC);
+
+				//generate STOP condition
+				if(Sr == I2C_DISABLE_SR )
+					I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+
+			}
+
+			if(pec && i == 1)
+			{
+				//PEC byte, not part of the data
+				dummy_read = pI2CHandle->pI2Cx->DR;
+				(void)dummy_read;
+			}else
+			{
+				//read the data from data register in to buffer
+				*pRxBuffer = pI2CHandle->pI2Cx->DR;
+
+				//increment the buffer address
+				pRxBuffer++;
+			}
+
+		}
+
+	}
+
+	//re-enable ACKing
+	if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+	{
+		I2C_ManageAcking(pI2CHandle->pI2Cx,I2C_ACK_ENABLE);
+	}
+
+	//PECERR is set with the reception of the PEC byte
+	if(pec && (pI2CHandle->pI2Cx->SR1 & ( 1 << I2C_SR1_PECERR)))
+	{
+		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_PECERR);
+		return I2C_ERROR_PEC;
+	}
+
+	return I2C_READY;
+}
+
+
+static uint32_t I2C_ArloBackoff(uint8_t Retry)
+{
+	uint32_t delay = I2C_ARLO_BACKOFF_MIN;
+
+	//doubles with every retry up to the max
+	while(Retry-- && delay < I2C_ARLO_BACKOFF_MAX)
+	{
+		delay <<= 1;
+	}
+
+	//plus up to as much again from the cycle counter, so two masters with the same
+	//driver do not collide again on the same schedule
+	return delay + (DWT_CYCCNT_GET() & (delay - 1));
+}
+
+
+static void I2C_HandleArbitrationLoss(I2C_Handle_t *pI2CHandle)
+{
+	pI2CHandle->ArloCount++;
+
+	if(pI2CHandle->TxRxState == I2C_READY)
+	{
+		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_ARLO);
+		return;
+	}
+
+	//1. we are a slave again and the lines are released, the winner ends its transfer
+	//   with its own STOP : close ours without generating one
+	if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+	{
+		I2C_CloseSendData(pI2CHandle);
+	}else
+	{
+		I2C_CloseReceiveData(pI2CHandle);
+	}
+
+	//2. a queued transaction goes again from I2C_TimeoutHandling after its backoff, it is
+	//   off the bus till then
+	if(pI2CHandle->QueueActive && pI2CHandle->ArloRetry < pI2CHandle->I2C_Config.I2C_ArloRetries)
+	{
+		pI2CHandle->QueueActive = RESET;
+		pI2CHandle->RetryStamp = DWT_CYCCNT_GET();
+		pI2CHandle->RetryDelay = I2C_ArloBackoff(pI2CHandle->ArloRetry++);
+		pI2CHandle->RetryCount++;
+		return;
+	}
+
+	//3. no retry left
+	pI2CHandle->LostCount++;
+	I2C_TransferComplete(pI2CHandle,I2C_ERROR_ARLO);
+}
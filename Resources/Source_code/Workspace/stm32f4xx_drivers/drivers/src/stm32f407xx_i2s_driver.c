@@ -0,0 +1,489 @@
+/*
+ * stm32f407xx_i2s_driver.c
+ *
+ *  Created on: Apr 18, 2019
+ *      Author: admin
+ */
+
+#include "stm32f407xx.h"
+
+static uint32_t i2s_fs_divider(I2S_Config_t *pI2SConfig);
+static uint32_t i2s_clock_error(uint32_t I2SClk, uint32_t FsClk, uint16_t *pDiv);
+static uint8_t  i2s_is_transmitter(I2S_Handle_t *pI2SHandle);
+
+/*
+ * I2SSTD and PCMSYNC values of each @I2S_Standard
+ */
+static const uint8_t I2S_StdBits[5] = { 0x0, 0x1, 0x2, 0x3, 0x3 };
+
+/*
+ * DATLEN and CHLEN values of each @I2S_DataFormat
+ */
+static const uint8_t I2S_DatLen[4] = { 0x0, 0x0, 0x1, 0x2 };
+static const uint8_t I2S_ChLen[4]  = { 0, 1, 1, 1 };
+
+
+/*********************************************************************
+ * @fn      		  - I2S_PeriClockControl
+ *
+ * @brief             - This function enables or disables peripheral clock for the given I2S
+ *
+ * @param[in]         - base address of the SPI peripheral (SPI2 or SPI3)
+ * @param[in]         - ENABLE or DISABLE macros
+ *
+ * @return            - none
+ *
+ * @Note              - I2S shares the APB clock gate of its SPI
+
+ */
+void I2S_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
+{
+	SPI_PeriClockControl(pSPIx, EnorDi);
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_Init
+ *
+ * @brief             - puts the SPI in I2S mode as per the handle configuration
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - none
+ *
+ * @Note              - In the master modes the PLLI2S and the prescaler are computed from
+ * 						I2S_AudioFreq and the achieved rate is stored in AudioFreqReal.
+ * 						I2S2 and I2S3 share the PLLI2S, it is kept when it already gives
+ * 						the best rate for this configuration.
+ * 						The peripheral is left disabled, I2S_StartStream enables it
+
+ */
+void I2S_Init(I2S_Handle_t *pI2SHandle)
+{
+	I2S_Config_t *pConfig = &pI2SHandle->I2SConfig;
+	I2S_Clock_t clock;
+	uint32_t tempreg = 0;
+
+	//peripheral clock enable
+	I2S_PeriClockControl(pI2SHandle->pSPIx, ENABLE);
+
+	//1. I2SCFGR can only be changed while I2SE=0
+	pI2SHandle->pSPIx->I2SCFGR &= ~( 1 << SPI_I2SCFGR_I2SE);
+
+	//2. select I2S mode and the master/slave, transmit/receive configuration
+	tempreg |= ( 1 << SPI_I2SCFGR_I2SMOD);
+	tempreg |= (uint32_t)(pConfig->I2S_Mode & 0x3) << SPI_I2SCFGR_I2SCFG;
+
+	//3. standard, PCM frame synchronization
+	tempreg |= (uint32_t)I2S_StdBits[pConfig->I2S_Standard] << SPI_I2SCFGR_I2SSTD;
+	if(pConfig->I2S_Standard == I2S_STANDARD_PCM_LONG)
+	{
+		tempreg |= ( 1 << SPI_I2SCFGR_PCMSYNC);
+	}
+
+	//4. data and channel length
+	tempreg |= (uint32_t)I2S_DatLen[pConfig->I2S_DataFormat] << SPI_I2SCFGR_DATLEN;
+	tempreg |= (uint32_t)I2S_ChLen[pConfig->I2S_DataFormat] << SPI_I2SCFGR_CHLEN;
+
+	//5. clock polarity
+	tempreg |= (uint32_t)pConfig->I2S_CPOL << SPI_I2SCFGR_CKPOL;
+
+	pI2SHandle->pSPIx->I2SCFGR = tempreg;
+
+	//6. clock generation, a slave takes CK and WS from the master
+	if(pConfig->I2S_Mode == I2S_MODE_MASTER_TX || pConfig->I2S_Mode == I2S_MODE_MASTER_RX)
+	{
+		pI2SHandle->AudioFreqReal = I2S_ComputeClock(pConfig, &clock);
+
+		if( ! (RCC->CR & ( 1 << RCC_CR_PLLI2SRDY)) ||
+			( (RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SN) & 0x1FF ) != clock.PLLI2SN ||
+			( (RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SR) & 0x7 ) != clock.PLLI2SR )
+		{
+			RCC_PLLI2SConfig(clock.PLLI2SN, clock.PLLI2SR);
+		}
+
+		tempreg = (uint32_t)clock.I2SDIV << SPI_I2SPR_I2SDIV;
+		tempreg |= (uint32_t)clock.ODD << SPI_I2SPR_ODD;
+		if(pConfig->I2S_MCLKOutput == ENABLE)
+		{
+			tempreg |= ( 1 << SPI_I2SPR_MCKOE);
+		}
+		pI2SHandle->pSPIx->I2SPR = tempreg;
+	}else
+	{
+		pI2SHandle->AudioFreqReal = 0;
+		pI2SHandle->pSPIx->I2SPR = 2; //reset value
+	}
+
+	pI2SHandle->State = I2S_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_DeInit
+ *
+ * @brief             - resets the SPI/I2S peripheral registers
+ *
+ * @param[in]         - base address of the SPI peripheral (SPI2 or SPI3)
+ *
+ * @return            - none
+ *
+ * @Note              - The PLLI2S is left running, the other I2S may use it
+
+ */
+void I2S_DeInit(SPI_RegDef_t *pSPIx)
+{
+	if(pSPIx == SPI2)
+	{
+		SPI2_REG_RESET();
+	}else if (pSPIx == SPI3)
+	{
+		SPI3_REG_RESET();
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_ComputeClock
+ *
+ * @brief             - finds the PLLI2S N/R and the I2S prescaler giving the sampling
+ * 						frequency closest to I2S_AudioFreq
+ *
+ * @param[in]         - configuration (I2S_AudioFreq, I2S_DataFormat, I2S_Standard, I2S_MCLKOutput)
+ * @param[out]        - PLLI2SN, PLLI2SR, I2SDIV and ODD to be programmed
+ *
+ * @return            - achieved sampling frequency in Hz, 0 if the rate can not be reached
+ *
+ * @Note              - Fs = I2SCLK / (frame bits * (2 * I2SDIV + ODD)), with MCLK output the
+ * 						divider is 256 (128 in PCM) instead of the frame bits.
+ * 						I2SCLK = (PLL source / PLLM) * PLLI2SN / PLLI2SR, PLLM is shared with the
+ * 						main PLL and is not changed. The running PLLI2S setting is tried first
+ * 						and only replaced by a strictly better one.
+ * 						This walks about 2300 N/R pairs, call it at init time, not per stream
+
+ */
+uint32_t I2S_ComputeClock(I2S_Config_t *pI2SConfig, I2S_Clock_t *pClock)
+{
+	uint32_t vcoin, i2sclk, fsclk, fsdiv, err;
+	uint32_t besterr = 0xFFFFFFFF, bestclk = 1;
+	uint16_t div, bestdiv = 0;
+	uint32_t pllm;
+
+	//reset values, left as is when no setting fits
+	pClock->PLLI2SN = 192;
+	pClock->PLLI2SR = 2;
+	pClock->I2SDIV = 2;
+	pClock->ODD = 0;
+
+	pllm = RCC->PLLCFGR & 0x3F;
+	if(pllm == 0 || pI2SConfig->I2S_AudioFreq == 0)
+	{
+		return 0;
+	}
+
+	vcoin = ( ( RCC->PLLCFGR & ( 1 << 22) ) ? 8000000 : 16000000 ) / pllm;
+
+	fsdiv = i2s_fs_divider(pI2SConfig);
+	fsclk = fsdiv * pI2SConfig->I2S_AudioFreq;
+
+	//1. current PLLI2S setting, switching it would disturb the other I2S
+	if(RCC->CR & ( 1 << RCC_CR_PLLI2SRDY))
+	{
+		i2sclk = RCC_GetPLLI2SOutputClock();
+		besterr = i2s_clock_error(i2sclk, fsclk, &bestdiv);
+		bestclk = i2sclk;
+		pClock->PLLI2SN = ( RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SN ) & 0x1FF;
+		pClock->PLLI2SR = ( RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SR ) & 0x7;
+	}
+
+	//2. walk all N/R pairs inside the VCO (100 to 432MHz) and output (192MHz max) limits
+	for(uint8_t r = 2 ; r <= 7 && besterr ; r++)
+	{
+		for(uint16_t n = 50 ; n <= 432 ; n++)
+		{
+			if( (vcoin * n) < 100000000 )
+				continue;
+			if( (vcoin * n) > 432000000 || ( (vcoin * n) / r ) > 192000000 )
+				break;
+
+			i2sclk = ( vcoin * n ) / r;
+			err = i2s_clock_error(i2sclk, fsclk, &div);
+
+			//compare the relative errors err/i2sclk
+			if( (uint64_t)err * bestclk < (uint64_t)besterr * i2sclk )
+			{
+				besterr = err;
+				bestclk = i2sclk;
+				bestdiv = div;
+				pClock->PLLI2SN = n;
+				pClock->PLLI2SR = r;
+
+				if(err == 0)
+					break;
+			}
+		}
+	}
+
+	if(besterr == 0xFFFFFFFF)
+	{
+		return 0;
+	}
+
+	pClock->I2SDIV = (uint8_t)(bestdiv / 2);
+	pClock->ODD = bestdiv & 1;
+
+	//3. achieved rate, rounded to the nearest Hz
+	return ( bestclk + ( fsdiv * bestdiv ) / 2 ) / ( fsdiv * bestdiv );
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_StartStream
+ *
+ * @brief             - starts endless circular streaming of pBuffer through the DMA stream
+ *
+ * @param[in]         - I2S handle
+ * @param[in]         - buffer of Len half words, both halves
+ * @param[in]         - number of half words, even (multiple of 4 for 24/32 bit data)
+ *
+ * @return            - state of the handle before the call, I2S_READY means the stream started
+ *
+ * @Note              - I2S_EVENT_HALF_CMPLT hands the first half to the application and
+ * 						I2S_EVENT_CMPLT the second half, each has Len/2 half words and the
+ * 						application has one half buffer time to refill/consume it.
+ * 						Samples are left, right, left, right .. as on the wire
+
+ */
+uint8_t I2S_StartStream(I2S_Handle_t *pI2SHandle, uint16_t *pBuffer, uint16_t Len)
+{
+	uint8_t state = pI2SHandle->State;
+
+	if(state != I2S_READY)
+	{
+		return state;
+	}
+
+	//1. Save the buffer address and length information in the handle
+	pI2SHandle->pBuffer = pBuffer;
+	pI2SHandle->Len = Len;
+	pI2SHandle->State = I2S_BUSY_STREAMING;
+
+	//2. circular half word stream with half transfer and transfer complete interrupts
+	if(i2s_is_transmitter(pI2SHandle))
+	{
+		pI2SHandle->pDMA->DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	}else
+	{
+		pI2SHandle->pDMA->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	}
+	pI2SHandle->pDMA->DMAConfig.DMA_PeriphDataSize = DMA_DATASIZE_HALFWORD;
+	pI2SHandle->pDMA->DMAConfig.DMA_MemDataSize = DMA_DATASIZE_HALFWORD;
+	pI2SHandle->pDMA->DMAConfig.DMA_MemInc = ENABLE;
+	pI2SHandle->pDMA->DMAConfig.DMA_Mode = DMA_MODE_CIRCULAR;
+	pI2SHandle->pDMA->DMAConfig.DMA_IntEnable = DMA_IT_HT | DMA_IT_TC | DMA_IT_TE;
+
+	DMA_Init(pI2SHandle->pDMA);
+	DMA_StartTransfer(pI2SHandle->pDMA, (uint32_t)&pI2SHandle->pSPIx->DR, (uint32_t)pBuffer, Len);
+
+	//3. let the I2S request the DMA, errors (UDR/OVR/FRE) come through the SPI interrupt
+	if(i2s_is_transmitter(pI2SHandle))
+	{
+		pI2SHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXDMAEN);
+	}else
+	{
+		pI2SHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXDMAEN);
+	}
+	pI2SHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_ERRIE);
+
+	//4. the master starts clocking now, a slave waits for the master's WS
+	I2S_PeripheralControl(pI2SHandle->pSPIx, ENABLE);
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_StopStream
+ *
+ * @brief             - stops the stream started with I2S_StartStream
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - none
+ *
+ * @Note              - A master transmitter finishes the frame on the wire before I2SE
+ * 						is cleared, the receive modes may lose the last sample
+
+ */
+void I2S_StopStream(I2S_Handle_t *pI2SHandle)
+{
+	if(pI2SHandle->State != I2S_BUSY_STREAMING)
+	{
+		return;
+	}
+
+	DMA_StopTransfer(pI2SHandle->pDMA);
+
+	if(pI2SHandle->I2SConfig.I2S_Mode == I2S_MODE_MASTER_TX)
+	{
+		while( I2S_GetFlagStatus(pI2SHandle->pSPIx,I2S_TXE_FLAG) == FLAG_RESET );
+		while( I2S_GetFlagStatus(pI2SHandle->pSPIx,I2S_BUSY_FLAG) );
+	}
+
+	I2S_PeripheralControl(pI2SHandle->pSPIx, DISABLE);
+
+	pI2SHandle->pSPIx->CR2 &= ~( ( 1 << SPI_CR2_TXDMAEN) | ( 1 << SPI_CR2_RXDMAEN) | ( 1 << SPI_CR2_ERRIE) );
+
+	pI2SHandle->pBuffer = NULL;
+	pI2SHandle->Len = 0;
+	pI2SHandle->State = I2S_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_DMAIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the I2S DMA stream
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - none
+ *
+ * @Note              - If HT and TC are found pending together the application was late
+ * 						by a half buffer, both events are still reported in order
+
+ */
+void I2S_DMAIRQHandling(I2S_Handle_t *pI2SHandle)
+{
+	uint8_t events = DMA_IRQHandling(pI2SHandle->pDMA);
+
+	if(events & DMA_FLAG_TE)
+	{
+		I2S_StopStream(pI2SHandle);
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_DMA_ERR);
+		return;
+	}
+
+	if(events & DMA_FLAG_HT)
+	{
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_HALF_CMPLT);
+	}
+
+	if(events & DMA_FLAG_TC)
+	{
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_CMPLT);
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2S_IRQHandling
+ *
+ * @brief             - to be called from the SPIx IRQ handler, reports the I2S errors
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - none
+ *
+ * @Note              - The stream keeps running, the application decides whether
+ * 						to restart it (e.g. a slave losing the WS alignment)
+
+ */
+void I2S_IRQHandling(I2S_Handle_t *pI2SHandle)
+{
+	uint32_t sr = pI2SHandle->pSPIx->SR;
+	uint32_t dummy;
+
+	if( ! (pI2SHandle->pSPIx->CR2 & ( 1 << SPI_CR2_ERRIE)) )
+	{
+		return;
+	}
+
+	if(sr & ( 1 << SPI_SR_OVR))
+	{
+		//cleared by a read of DR followed by a read of SR
+		dummy = pI2SHandle->pSPIx->DR;
+		dummy = pI2SHandle->pSPIx->SR;
+		(void)dummy;
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_OVR_ERR);
+	}
+
+	//UDR and FRE are cleared by the read of SR above
+	if(sr & ( 1 << SPI_SR_UDR))
+	{
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_UDR_ERR);
+	}
+
+	if(sr & ( 1 << SPI_SR_FRE))
+	{
+		I2S_ApplicationEventCallback(pI2SHandle,I2S_EVENT_FRE_ERR);
+	}
+}
+
+
+void I2S_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pSPIx->I2SCFGR |=  (1 << SPI_I2SCFGR_I2SE);
+	}else
+	{
+		pSPIx->I2SCFGR &=  ~(1 << SPI_I2SCFGR_I2SE);
+	}
+}
+
+
+uint8_t I2S_GetFlagStatus(SPI_RegDef_t *pSPIx , uint32_t FlagName)
+{
+	if(pSPIx->SR & FlagName)
+	{
+		return FLAG_SET;
+	}
+	return FLAG_RESET;
+}
+
+
+//some helper function implementations
+
+static uint32_t i2s_fs_divider(I2S_Config_t *pI2SConfig)
+{
+	uint32_t chbits = I2S_ChLen[pI2SConfig->I2S_DataFormat] ? 32 : 16;
+	uint8_t pcm = (pI2SConfig->I2S_Standard >= I2S_STANDARD_PCM_SHORT);
+
+	if(pI2SConfig->I2S_MCLKOutput == ENABLE)
+	{
+		return pcm ? 128 : 256;
+	}
+
+	//a PCM frame carries one channel slot, the other standards two
+	return pcm ? chbits : 2 * chbits;
+}
+
+
+static uint32_t i2s_clock_error(uint32_t I2SClk, uint32_t FsClk, uint16_t *pDiv)
+{
+	//nearest 2 * I2SDIV + ODD, I2SDIV must be 2 to 255
+	uint32_t div = ( I2SClk + FsClk / 2 ) / FsClk;
+
+	if(div < 4 || div > 511)
+	{
+		return 0xFFFFFFFF;
+	}
+
+	*pDiv = (uint16_t)div;
+
+	return ( I2SClk > div * FsClk ) ? ( I2SClk - div * FsClk ) : ( div * FsClk - I2SClk );
+}
+
+
+static uint8_t i2s_is_transmitter(I2S_Handle_t *pI2SHandle)
+{
+	return ( pI2SHandle->I2SConfig.I2S_Mode == I2S_MODE_SLAVE_TX || pI2SHandle->I2SConfig.I2S_Mode == I2S_MODE_MASTER_TX );
+}
+
+
+__weak void I2S_ApplicationEventCallback(I2S_Handle_t *pI2SHandle,uint8_t AppEv)
+{
+
+	//This is a weak implementation . the user application may override this function.
+}
@@ -11,6 +11,7 @@
 
 uint16_t AHB_PreScaler[8] = {2,4,8,16,64,128,256,512};
 uint8_t APB1_PreScaler[4] = { 2, 4 , 8, 16};
+uint8_t PLL_P_Division[4] = { 2, 4 , 6, 8};
 
 
 
@@ -88,9 +89,12 @@ uint32_t RCC_GetPCLK2Value(void)
 	if(clk_src == 0)
 	{
 		SystemClock = 16000000;
-	}else
+	}else if(clk_src == 1)
 	{
 		SystemClock = 8000000;
+	}else
+	{
+		SystemClock = RCC_GetPLLOutputClock();
 	}
 	tmp = (RCC->CFGR >> 4 ) & 0xF;
 
@@ -116,9 +120,100 @@ uint32_t RCC_GetPCLK2Value(void)
 	return pclk2;
 }
 
-uint32_t  RCC_GetPLLOutputClock()
+/*********************************************************************
+ * @fn      		  - RCC_GetPLLOutputClock
+ *
+ * @brief             - main PLL output (PLLCLK) as programmed in RCC_PLLCFGR
+ *
+ * @param[in]         - none
+ *
+ * @return            - PLLCLK in Hz
+ *
+ * @Note              - PLLCLK = (PLL source / PLLM) * PLLN / PLLP, HSE is taken as 8MHz
+ * 						(discovery board crystal)
+
+ */
+uint32_t  RCC_GetPLLOutputClock(void)
 {
+	uint32_t pllsrc, pllm, plln, pllp;
+
+	//PLLSRC : 0 HSI , 1 HSE
+	pllsrc = ( RCC->PLLCFGR & ( 1 << 22) ) ? 8000000 : 16000000;
+
+	pllm = RCC->PLLCFGR & 0x3F;
+	plln = ( RCC->PLLCFGR >> 6 ) & 0x1FF;
+	pllp = PLL_P_Division[( RCC->PLLCFGR >> 16 ) & 0x3];
 
-	return 0;
+	if(pllm == 0)
+	{
+		return 0;
+	}
+
+	//VCO input is 1 to 2MHz, so dividing first does not lose precision
+	return ( (pllsrc / pllm) * plln ) / pllp;
 }
 
+
+/*********************************************************************
+ * @fn      		  - RCC_GetPLLI2SOutputClock
+ *
+ * @brief             - PLLI2S output (PLLI2SCLK) as programmed in RCC_PLLI2SCFGR
+ *
+ * @param[in]         - none
+ *
+ * @return            - PLLI2SCLK in Hz
+ *
+ * @Note              - PLLI2S shares the source and PLLM divider with the main PLL
+ * 						PLLI2SCLK = (PLL source / PLLM) * PLLI2SN / PLLI2SR
+
+ */
+uint32_t  RCC_GetPLLI2SOutputClock(void)
+{
+	uint32_t pllsrc, pllm, plln, pllr;
+
+	pllsrc = ( RCC->PLLCFGR & ( 1 << 22) ) ? 8000000 : 16000000;
+	pllm = RCC->PLLCFGR & 0x3F;
+
+	plln = ( RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SN ) & 0x1FF;
+	pllr = ( RCC->PLLI2SCFGR >> RCC_PLLI2SCFGR_PLLI2SR ) & 0x7;
+
+	if(pllm == 0 || pllr < 2)
+	{
+		return 0;
+	}
+
+	return ( (pllsrc / pllm) * plln ) / pllr;
+}
+
+
+/*********************************************************************
+ * @fn      		  - RCC_PLLI2SConfig
+ *
+ * @brief             - stops the PLLI2S, programs N and R and waits till it locks again
+ *
+ * @param[in]         - PLLI2SN multiplier, 50 to 432
+ * @param[in]         - PLLI2SR divider, 2 to 7
+ *
+ * @return            - none
+ *
+ * @Note              - The VCO output (input * N) must stay within 100 to 432MHz and the
+ * 						output below 192MHz, the caller picks N and R accordingly.
+ * 						Any I2S running from the PLLI2S loses its clock meanwhile
+
+ */
+void RCC_PLLI2SConfig(uint16_t PLLI2SN, uint8_t PLLI2SR)
+{
+	//1. N and R can only be written while the PLL is off
+	RCC->CR &= ~( 1 << RCC_CR_PLLI2SON);
+	while( RCC->CR & ( 1 << RCC_CR_PLLI2SRDY) );
+
+	RCC->PLLI2SCFGR = ( (uint32_t)(PLLI2SN & 0x1FF) << RCC_PLLI2SCFGR_PLLI2SN ) |
+					  ( (uint32_t)(PLLI2SR & 0x7) << RCC_PLLI2SCFGR_PLLI2SR );
+
+	//2. I2S kernel clock comes from the PLLI2S, not from the I2S_CKIN pin
+	RCC->CFGR &= ~( 1 << RCC_CFGR_I2SSRC);
+
+	//3. start and wait for lock
+	RCC->CR |= ( 1 << RCC_CR_PLLI2SON);
+	while( ! (RCC->CR & ( 1 << RCC_CR_PLLI2SRDY)) );
+}
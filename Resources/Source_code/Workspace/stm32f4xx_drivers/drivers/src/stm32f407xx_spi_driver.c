@@ -10,6 +10,33 @@
 static void  spi_txe_interrupt_handle(SPI_Handle_t *pSPIHandle);
 static void  spi_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle);
 static void  spi_ovr_err_interrupt_handle(SPI_Handle_t *pSPIHandle);
+static void  spi_txrx_txe_interrupt_handle(SPI_Handle_t *pSPIHandle);
+static void  spi_txrx_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle);
+static void  spi_txrx_complete(SPI_Handle_t *pSPIHandle, uint8_t crcerr);
+static void  spi_crc_reset(SPI_RegDef_t *pSPIx, uint8_t WaitIdle);
+static uint8_t spi_len_invalid(SPI_RegDef_t *pSPIx, uint32_t Len);
+static uint8_t spi_crc_check(SPI_RegDef_t *pSPIx);
+static uint8_t spi_queue_start(SPI_Handle_t *pSPIHandle);
+static void  spi_queue_complete(SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+static void  spi_queue_pop(SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+static void  spi_queue_next(SPI_Handle_t *pSPIHandle);
+
+static void  spi_dma_config_stream(SPI_Handle_t *pSPIHandle, DMA_Handle_t *pDMAHandle, uint8_t Direction, uint8_t MemInc, uint8_t IntEnable);
+static void  spi_dma_start_tx(SPI_Handle_t *pSPIHandle);
+static void  spi_dma_start_rx(SPI_Handle_t *pSPIHandle);
+static void  spi_dma_abort(SPI_Handle_t *pSPIHandle);
+static void  spi_dma_tx_drain_handle(SPI_Handle_t *pSPIHandle);
+
+static void  spi_pingpong_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle);
+static void  spi_pingpong_dma_start(SPI_Handle_t *pSPIHandle);
+static void  spi_pingpong_handover(SPI_Handle_t *pSPIHandle, uint32_t Len);
+static uint8_t spi_pingpong_dma_swapped(SPI_Handle_t *pSPIHandle);
+
+//source of the dummy frames clocked out by a master which only wants to receive
+static uint16_t spi_dma_dummy = 0xFFFF;
+
+//destination of the frames received by a transfer which has no Rx buffer
+static uint16_t spi_dma_sink;
 
 /*********************************************************************
  * @fn      		  - SPI_PeriClockControl
@@ -94,7 +121,11 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
 		tempreg |= ( 1 << SPI_CR1_RXONLY);
 	}
 
-	// 3. Configure the spi serial clock speed (baud rate)
+	// 3. Configure the spi serial clock speed (baud rate), from the live bus clock if a frequency is given
+	if(pSPIHandle->SPIConfig.SPI_SclkHz)
+	{
+		pSPIHandle->SPIConfig.SPI_SclkSpeed = SPI_ComputeSclkSpeed(pSPIHandle->pSPIx,pSPIHandle->SPIConfig.SPI_SclkHz);
+	}
 	tempreg |= pSPIHandle->SPIConfig.SPI_SclkSpeed << SPI_CR1_BR;
 
 	//4.  Configure the DFF
@@ -108,6 +139,16 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
 
 	tempreg |= pSPIHandle->SPIConfig.SPI_SSM << SPI_CR1_SSM;
 
+	//7. hardware CRC
+	if(pSPIHandle->SPIConfig.SPI_CRC == SPI_CRC_EN)
+	{
+		if(pSPIHandle->SPIConfig.SPI_CRCPolynomial)
+		{
+			pSPIHandle->pSPIx->CRCPR = pSPIHandle->SPIConfig.SPI_CRCPolynomial;
+		}
+		tempreg |= ( 1 << SPI_CR1_CRCEN);
+	}
+
 	pSPIHandle->pSPIx->CR1 = tempreg;
 
 }
@@ -149,36 +190,47 @@ uint8_t SPI_GetFlagStatus(SPI_RegDef_t *pSPIx , uint32_t FlagName)
  * @param[in]         -
  * @param[in]         -
  *
- * @return            -
+ * @return            - SPI_READY once the frames are written, SPI_ERR_LEN if Len is odd in 16 bit DFF
  *
- * @Note              - This is blocking call
+ * @Note              - This is blocking call. With SPI_CRC_EN the CRC frame is
+ * 						appended after the last data frame. In 16 bit DFF Len must be even
+ * 						and pTxBuffer half word aligned
 
  */
-void SPI_SendData(SPI_RegDef_t *pSPIx,uint8_t *pTxBuffer, uint32_t Len)
+uint8_t SPI_SendData(SPI_RegDef_t *pSPIx,uint8_t *pTxBuffer, uint32_t Len)
 {
+	//check the DFF bit in CR1 once, not per frame
+	if( (pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
+	{
+		if(Len & 1)
+		{
+			return SPI_ERR_LEN;
+		}
+
+		//16 bit DFF : Len/2 half words
+		return SPI_SendData16(pSPIx,(uint16_t*)pTxBuffer,Len / 2);
+	}
+
+	spi_crc_reset(pSPIx,ENABLE);
+
 	while(Len > 0)
 	{
 		//1. wait until TXE is set
 		while(SPI_GetFlagStatus(pSPIx,SPI_TXE_FLAG)  == FLAG_RESET );
 
-		//2. check the DFF bit in CR1
-		if( (pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
-		{
-			//16 bit DFF
-			//1. load the data in to the DR
-			pSPIx->DR =   *((uint16_t*)pTxBuffer);
-			Len--;
-			Len--;
-			(uint16_t*)pTxBuffer++;
-		}else
-		{
-			//8 bit DFF
-			pSPIx->DR =   *pTxBuffer;
-			Len--;
-			pTxBuffer++;
-		}
+		//2. 8 bit DFF
+		pSPIx->DR =   *pTxBuffer;
+		Len--;
+		pTxBuffer++;
 	}
 
+	//CRC goes out right after the last data frame
+	if(pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		pSPIx->CR1 |= ( 1 << SPI_CR1_CRCNEXT);
+	}
+
+	return SPI_READY;
 }
 
 /*********************************************************************
@@ -190,36 +242,351 @@ void SPI_SendData(SPI_RegDef_t *pSPIx,uint8_t *pTxBuffer, uint32_t Len)
  * @param[in]         -
  * @param[in]         -
  *
- * @return            -
+ * @return            - SPI_READY once the frames are read, SPI_ERR_LEN if Len is odd in 16 bit DFF
  *
- * @Note              -
+ * @Note              - This is blocking call. With SPI_CRC_EN the CRC frame is consumed
+ * 						after the data, check SPI_CRCERR_FLAG afterwards. In 16 bit DFF Len
+ * 						must be even and pRxBuffer half word aligned
+
+ */
+uint8_t SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len)
+{
+	//check the DFF bit in CR1 once, not per frame
+	if( (pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
+	{
+		if(Len & 1)
+		{
+			return SPI_ERR_LEN;
+		}
+
+		//16 bit DFF : Len/2 half words
+		return SPI_ReceiveData16(pSPIx,(uint16_t*)pRxBuffer,Len / 2);
+	}
+
+	spi_crc_reset(pSPIx,ENABLE);
+
+	while(Len > 0)
+	{
+		//1. wait until RXNE is set
+		while(SPI_GetFlagStatus(pSPIx,SPI_RXNE_FLAG)  == (uint8_t)FLAG_RESET );
+
+		//2. 8 bit DFF
+		*(pRxBuffer) = pSPIx->DR ;
+		Len--;
+		pRxBuffer++;
+	}
+
+	//the CRC frame follows the data, CRCERR is left in SR for the caller
+	if(pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		while(SPI_GetFlagStatus(pSPIx,SPI_RXNE_FLAG)  == (uint8_t)FLAG_RESET );
+		(void)pSPIx->DR;
+	}
+
+	return SPI_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SendData16
+ *
+ * @brief             - sends Len half words, SPI must be configured with SPI_DFF_16BITS
+ *
+ * @param[in]         - base address of the SPI peripheral
+ * @param[in]         - Tx buffer of half words
+ * @param[in]         - number of half words (frames, not bytes)
+ *
+ * @return            - SPI_READY once the frames are written, SPI_ERR_DFF if the SPI is in 8 bit DFF
+ *
+ * @Note              - This is blocking call. One DR write moves 2 bytes, so the frame
+ * 						rate is half of the 8 bit DFF for the same byte throughput
+
+ */
+uint8_t SPI_SendData16(SPI_RegDef_t *pSPIx, uint16_t *pTxBuffer, uint32_t Len)
+{
+	if( ! (pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) )
+	{
+		return SPI_ERR_DFF;
+	}
+
+	spi_crc_reset(pSPIx,ENABLE);
+
+	while(Len > 0)
+	{
+		//1. wait until TXE is set
+		while(SPI_GetFlagStatus(pSPIx,SPI_TXE_FLAG)  == FLAG_RESET );
+
+		//2. load the half word in to the DR
+		pSPIx->DR = *pTxBuffer++;
+		Len--;
+	}
+
+	//CRC goes out right after the last data frame
+	if(pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		pSPIx->CR1 |= ( 1 << SPI_CR1_CRCNEXT);
+	}
+
+	return SPI_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_ReceiveData16
+ *
+ * @brief             - receives Len half words, SPI must be configured with SPI_DFF_16BITS
+ *
+ * @param[in]         - base address of the SPI peripheral
+ * @param[in]         - Rx buffer of half words
+ * @param[in]         - number of half words (frames, not bytes)
+ *
+ * @return            - SPI_READY once the frames are read, SPI_ERR_DFF if the SPI is in 8 bit DFF
+ *
+ * @Note              - This is blocking call
 
  */
-void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len)
+uint8_t SPI_ReceiveData16(SPI_RegDef_t *pSPIx, uint16_t *pRxBuffer, uint32_t Len)
 {
+	if( ! (pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) )
+	{
+		return SPI_ERR_DFF;
+	}
+
+	spi_crc_reset(pSPIx,ENABLE);
+
 	while(Len > 0)
+	{
+		//1. wait until RXNE is set
+		while(SPI_GetFlagStatus(pSPIx,SPI_RXNE_FLAG)  == (uint8_t)FLAG_RESET );
+
+		//2. load the data from DR to Rxbuffer address
+		*pRxBuffer++ = (uint16_t)pSPIx->DR;
+		Len--;
+	}
+
+	//the CRC frame follows the data, CRCERR is left in SR for the caller
+	if(pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		while(SPI_GetFlagStatus(pSPIx,SPI_RXNE_FLAG)  == (uint8_t)FLAG_RESET );
+		(void)pSPIx->DR;
+	}
+
+	return SPI_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_TransmitReceive
+ *
+ * @brief             - full duplex transfer, every frame sent clocks one frame in
+ *
+ * @param[in]         - base address of the SPI peripheral
+ * @param[in]         - Tx buffer, NULL clocks out 0xFF dummy frames
+ * @param[in]         - Rx buffer, NULL throws the received frames away
+ * @param[in]         - number of bytes (even number in 16 bit DFF)
+ *
+ * @return            - SPI_READY once the frames are exchanged, SPI_ERR_LEN if Len is odd in 16 bit DFF
+ *
+ * @Note              - This is blocking call. TXE and RXNE are serviced in the same loop and
+ * 						DR is refilled while the previous frame is still shifting, so there are
+ * 						no idle SCLK gaps between frames. At most 2 frames are in flight, which
+ * 						guarantees that RXNE is always read before the next frame lands (no OVR).
+ * 						With SPI_CRC_EN check SPI_CRCERR_FLAG afterwards
+
+ */
+uint8_t SPI_TransmitReceive(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t dff16 = ( pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) ? 1 : 0;
+	uint32_t frames = dff16 ? (Len / 2) : Len;
+	uint32_t txcnt = 0, rxcnt = 0;
+	uint16_t data;
+
+	if(spi_len_invalid(pSPIx,Len))
+	{
+		return SPI_ERR_LEN;
+	}
+
+	//drop a stale frame so that the first RXNE belongs to this transfer
+	SPI_ClearOVRFlag(pSPIx);
+	spi_crc_reset(pSPIx,ENABLE);
+
+	while(rxcnt < frames)
+	{
+		//1. refill DR as soon as TXE is set, but never run more than 2 frames ahead of Rx
+		if( (txcnt < frames) && ( (txcnt - rxcnt) < 2 ) && ( pSPIx->SR & ( 1 << SPI_SR_TXE) ) )
 		{
-			//1. wait until RXNE is set
-			while(SPI_GetFlagStatus(pSPIx,SPI_RXNE_FLAG)  == (uint8_t)FLAG_RESET );
+			data = 0xFFFF;
+			if(pTxBuffer)
+			{
+				data = dff16 ? ((uint16_t*)pTxBuffer)[txcnt] : pTxBuffer[txcnt];
+			}
+			pSPIx->DR = data;
+			txcnt++;
 
-			//2. check the DFF bit in CR1
-			if( (pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
+			if( (txcnt == frames) && (pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN)) )
 			{
-				//16 bit DFF
-				//1. load the data from DR to Rxbuffer address
-				 *((uint16_t*)pRxBuffer) = pSPIx->DR ;
-				Len--;
-				Len--;
-				(uint16_t*)pRxBuffer++;
-			}else
+				pSPIx->CR1 |= ( 1 << SPI_CR1_CRCNEXT);
+			}
+		}
+
+		//2. collect the frame which just finished shifting
+		if( pSPIx->SR & ( 1 << SPI_SR_RXNE) )
+		{
+			data = (uint16_t)pSPIx->DR;
+			if(pRxBuffer)
 			{
-				//8 bit DFF
-				*(pRxBuffer) = pSPIx->DR ;
-				Len--;
-				pRxBuffer++;
+				if(dff16)
+				{
+					((uint16_t*)pRxBuffer)[rxcnt] = data;
+				}else
+				{
+					pRxBuffer[rxcnt] = (uint8_t)data;
+				}
 			}
+			rxcnt++;
 		}
+	}
+
+	//the CRC frame follows the data, CRCERR is left in SR for the caller
+	if(pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		while( ! ( pSPIx->SR & ( 1 << SPI_SR_RXNE) ) );
+		(void)pSPIx->DR;
+	}
+
+	return SPI_READY;
+}
+
+/*********************************************************************
+ * @fn      		  - SPI_TransmitReceive16
+ *
+ * @brief             - full duplex transfer of Len half words, SPI must be configured with SPI_DFF_16BITS
+ *
+ * @param[in]         - base address of the SPI peripheral
+ * @param[in]         - Tx buffer of half words, NULL clocks out 0xFFFF dummy frames
+ * @param[in]         - Rx buffer of half words, NULL throws the received frames away
+ * @param[in]         - number of half words (frames, not bytes)
+ *
+ * @return            - SPI_READY once the frames are exchanged, SPI_ERR_DFF if the SPI is in 8 bit DFF
+ *
+ * @Note              - This is blocking call, see SPI_TransmitReceive
+
+ */
+uint8_t SPI_TransmitReceive16(SPI_RegDef_t *pSPIx, uint16_t *pTxBuffer, uint16_t *pRxBuffer, uint32_t Len)
+{
+	if( ! (pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) )
+	{
+		return SPI_ERR_DFF;
+	}
+
+	return SPI_TransmitReceive(pSPIx,(uint8_t*)pTxBuffer,(uint8_t*)pRxBuffer,2 * Len);
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_ComputeSclkSpeed
+ *
+ * @brief             - finds the fastest prescaler whose SCLK does not exceed SclkHz
+ *
+ * @param[in]         - base address of the SPI peripheral
+ * @param[in]         - requested SCLK in Hz
+ *
+ * @return            - @SPI_SclkSpeed value
+ *
+ * @Note              - SPI1 is clocked from PCLK2, SPI2/SPI3 from PCLK1. The bus clock is read
+ * 						from RCC at the time of the call. If even PCLK/256 is too fast,
+ * 						SPI_SCLK_SPEED_DIV256 is returned
+
+ */
+uint8_t SPI_ComputeSclkSpeed(SPI_RegDef_t *pSPIx, uint32_t SclkHz)
+{
+	uint32_t pclk;
+	uint8_t br = SPI_SCLK_SPEED_DIV2;
+
+	if(pSPIx == SPI1)
+	{
+		pclk = RCC_GetPCLK2Value();
+	}else
+	{
+		pclk = RCC_GetPCLK1Value();
+	}
+
+	//SCLK = PCLK / 2^(BR+1)
+	while( (br < SPI_SCLK_SPEED_DIV256) && ( (pclk >> (br + 1)) > SclkHz ) )
+	{
+		br++;
+	}
+
+	return br;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_GetSclkValue
+ *
+ * @brief             - SCLK the peripheral generates with the current CR1 and bus clock
+ *
+ * @param[in]         - base address of the SPI peripheral
+ *
+ * @return            - SCLK in Hz
+ *
+ * @Note              - none
+
+ */
+uint32_t SPI_GetSclkValue(SPI_RegDef_t *pSPIx)
+{
+	uint32_t pclk;
+
+	if(pSPIx == SPI1)
+	{
+		pclk = RCC_GetPCLK2Value();
+	}else
+	{
+		pclk = RCC_GetPCLK1Value();
+	}
+
+	return pclk >> ( ( ( pSPIx->CR1 >> SPI_CR1_BR ) & 0x7 ) + 1 );
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_UpdateClock
+ *
+ * @brief             - recomputes the prescaler from SPI_SclkHz after the clock tree changed
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - Call it for every SPI handle after switching SYSCLK source or changing
+ * 						the AHB/APB prescalers. Nothing happens for handles with SPI_SclkHz = 0.
+ * 						An ongoing frame is finished before the peripheral is briefly disabled
+
+ */
+void SPI_UpdateClock(SPI_Handle_t *pSPIHandle)
+{
+	uint8_t br;
+	uint32_t spe;
+
+	if(pSPIHandle->SPIConfig.SPI_SclkHz == 0)
+	{
+		return;
+	}
+
+	br = SPI_ComputeSclkSpeed(pSPIHandle->pSPIx,pSPIHandle->SPIConfig.SPI_SclkHz);
+	pSPIHandle->SPIConfig.SPI_SclkSpeed = br;
+
+	if( ( ( pSPIHandle->pSPIx->CR1 >> SPI_CR1_BR ) & 0x7 ) == br )
+	{
+		return;
+	}
 
+	//BR may only change while SPE=0
+	while( SPI_GetFlagStatus(pSPIHandle->pSPIx,SPI_BUSY_FLAG) );
+	spe = pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_SPE);
+	pSPIHandle->pSPIx->CR1 &= ~( 1 << SPI_CR1_SPE);
+	pSPIHandle->pSPIx->CR1 = ( pSPIHandle->pSPIx->CR1 & ~( 0x7 << SPI_CR1_BR) ) | ( (uint32_t)br << SPI_CR1_BR);
+	pSPIHandle->pSPIx->CR1 |= spe;
 }
 
 
@@ -396,12 +763,20 @@ uint8_t SPI_SendDataIT(SPI_Handle_t *pSPIHandle,uint8_t *pTxBuffer, uint32_t Len
 
 	if(state != SPI_BUSY_IN_TX)
 	{
+		if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+		{
+			return SPI_ERR_LEN;
+		}
+
 		//1 . Save the Tx buffer address and Len information in some global variables
 		pSPIHandle->pTxBuffer = pTxBuffer;
 		pSPIHandle->TxLen = Len;
+		pSPIHandle->TxRxLinked = RESET;
+		spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
 		//2.  Mark the SPI state as busy in transmission so that
 		//    no other code can take over same SPI peripheral until transmission is over
 		pSPIHandle->TxState = SPI_BUSY_IN_TX;
+		pSPIHandle->IRQEntries = 0;
 
 		//3. Enable the TXEIE control bit to get interrupt whenever TXE flag is set in SR
 		pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXEIE );
@@ -419,12 +794,21 @@ uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t
 
 	if(state != SPI_BUSY_IN_RX)
 	{
+		if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+		{
+			return SPI_ERR_LEN;
+		}
+
 		//1 . Save the Rx buffer address and Len information in some global variables
 		pSPIHandle->pRxBuffer = pRxBuffer;
 		pSPIHandle->RxLen = Len;
+		pSPIHandle->TxRxLinked = RESET;
+		pSPIHandle->CRCPending = RESET;
+		spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
 		//2.  Mark the SPI state as busy in reception so that
 		//    no other code can take over same SPI peripheral until reception is over
 		pSPIHandle->RxState = SPI_BUSY_IN_RX;
+		pSPIHandle->IRQEntries = 0;
 
 		//3. Enable the RXNEIE control bit to get interrupt whenever RXNEIE flag is set in SR
 		pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXNEIE );
@@ -438,101 +822,840 @@ uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t
 
 
 
+/*********************************************************************
+ * @fn      		  - SPI_SendData16IT
+ *
+ * @brief             - interrupt driven transmission of Len half words (SPI_DFF_16BITS)
+ *
+ * @param[in]         - SPI handle
+ * @param[in]         - Tx buffer of half words
+ * @param[in]         - number of half words (frames, not bytes)
+ *
+ * @return            - state of the Tx side before the call, SPI_READY means the transfer is started,
+ * 						SPI_ERR_DFF if the SPI is in 8 bit DFF
+ *
+ * @Note              - The handle keeps byte counts, so this is SPI_SendDataIT with 2*Len bytes
 
-
-void SPI_IRQHandling(SPI_Handle_t *pHandle)
+ */
+uint8_t SPI_SendData16IT(SPI_Handle_t *pSPIHandle, uint16_t *pTxBuffer, uint32_t Len)
 {
-
-	uint8_t temp1 , temp2;
-	//first lets check for TXE
-	temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_TXE);
-	temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_TXEIE);
-
-	if( temp1 && temp2)
+	if( ! (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) )
 	{
-		//handle TXE
-		spi_txe_interrupt_handle(pHandle);
+		return SPI_ERR_DFF;
 	}
 
-	// check for RXNE
-	temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_RXNE);
-	temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_RXNEIE);
+	return SPI_SendDataIT(pSPIHandle,(uint8_t*)pTxBuffer,2 * Len);
+}
 
-	if( temp1 && temp2)
-	{
-		//handle RXNE
-		spi_rxne_interrupt_handle(pHandle);
-	}
 
-	// check for ovr flag
-	temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_OVR);
-	temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_ERRIE);
+/*********************************************************************
+ * @fn      		  - SPI_ReceiveData16IT
+ *
+ * @brief             - interrupt driven reception of Len half words (SPI_DFF_16BITS)
+ *
+ * @param[in]         - SPI handle
+ * @param[in]         - Rx buffer of half words
+ * @param[in]         - number of half words (frames, not bytes)
+ *
+ * @return            - state of the Rx side before the call, SPI_READY means the transfer is started,
+ * 						SPI_ERR_DFF if the SPI is in 8 bit DFF
+ *
+ * @Note              - The handle keeps byte counts, so this is SPI_ReceiveDataIT with 2*Len bytes
 
-	if( temp1 && temp2)
+ */
+uint8_t SPI_ReceiveData16IT(SPI_Handle_t *pSPIHandle, uint16_t *pRxBuffer, uint32_t Len)
+{
+	if( ! (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) )
 	{
-		//handle ovr error
-		spi_ovr_err_interrupt_handle(pHandle);
+		return SPI_ERR_DFF;
 	}
 
-
+	return SPI_ReceiveDataIT(pSPIHandle,(uint8_t*)pRxBuffer,2 * Len);
 }
 
 
-//some helper function implementations
+/*********************************************************************
+ * @fn      		  - SPI_TransmitReceiveIT
+ *
+ * @brief             - interrupt driven full duplex transfer
+ *
+ * @param[in]         - SPI handle
+ * @param[in]         - Tx buffer, NULL clocks out 0xFF dummy frames
+ * @param[in]         - Rx buffer, NULL throws the received frames away
+ * @param[in]         - number of bytes (even number in 16 bit DFF)
+ *
+ * @return            - SPI_READY if the transfer is started, otherwise the busy state,
+ * 						SPI_ERR_LEN if Len is odd in 16 bit DFF
+ *
+ * @Note              - TXEIE is masked whenever 2 frames are in flight and unmasked again from
+ * 						the RXNE interrupt, so Tx never runs away from Rx. SPI_EVENT_TX_CMPLT when
+ * 						pTxBuffer is given, followed by SPI_EVENT_RX_CMPLT when pRxBuffer is given,
+ * 						ends the transfer
 
-static void  spi_txe_interrupt_handle(SPI_Handle_t *pSPIHandle)
+ */
+uint8_t SPI_TransmitReceiveIT(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
 {
-	// check the DFF bit in CR1
-	if( (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
-	{
-		//16 bit DFF
-		//1. load the data in to the DR
-		pSPIHandle->pSPIx->DR =   *((uint16_t*)pSPIHandle->pTxBuffer);
-		pSPIHandle->TxLen--;
-		pSPIHandle->TxLen--;
-		(uint16_t*)pSPIHandle->pTxBuffer++;
-	}else
+	if(pSPIHandle->TxState == SPI_BUSY_IN_TX)
 	{
-		//8 bit DFF
-		pSPIHandle->pSPIx->DR =   *pSPIHandle->pTxBuffer;
-		pSPIHandle->TxLen--;
-		pSPIHandle->pTxBuffer++;
+		return SPI_BUSY_IN_TX;
 	}
 
-	if(! pSPIHandle->TxLen)
+	if(pSPIHandle->RxState == SPI_BUSY_IN_RX)
 	{
-		//TxLen is zero , so close the spi transmission and inform the application that
-		//TX is over.
+		return SPI_BUSY_IN_RX;
+	}
 
-		//this prevents interrupts from setting up of TXE flag
-		SPI_CloseTransmisson(pSPIHandle);
-		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_TX_CMPLT);
+	if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+	{
+		return SPI_ERR_LEN;
 	}
 
+	//1 . Save the buffer addresses and Len information
+	pSPIHandle->pTxBuffer = pTxBuffer;
+	pSPIHandle->pRxBuffer = pRxBuffer;
+	pSPIHandle->TxLen = Len;
+	pSPIHandle->RxLen = Len;
+	pSPIHandle->TxRxLinked = SET;
+
+	//2.  Mark both sides busy
+	pSPIHandle->TxState = SPI_BUSY_IN_TX;
+	pSPIHandle->RxState = SPI_BUSY_IN_RX;
+	pSPIHandle->IRQEntries = 0;
+
+	//3. drop any stale frame so that the first RXNE belongs to this transfer
+	SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+	pSPIHandle->CRCPending = RESET;
+	spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
+
+	//4. RXNEIE first, so that the first frame can never be missed
+	pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXNEIE );
+	pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXEIE );
+
+	return SPI_READY;
 }
 
 
-static void  spi_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle)
-{
+/*********************************************************************
+ * @fn      		  - SPI_QueueTransaction
+ *
+ * @brief             - appends a transaction to the bus queue and starts it if the bus is idle
+ *
+ * @param[in]         - SPI handle, configured as master with SSM=1 and SSI=1
+ * @param[in]         - transaction, must stay valid until its callback reports SPI_EVENT_TRANS_CMPLT,
+ * 						SPI_EVENT_CRC_ERR, SPI_EVENT_DMA_ERR or SPI_EVENT_START_ERR
+ *
+ * @return            - SPI_READY if queued, otherwise the busy state of a non queued transfer
+ * 						which holds the bus
+ *
+ * @Note              - Transactions run back to back from the ISR. They use SPI_TransferDMA when
+ * 						both pDMATx and pDMARx are set, else SPI_TransmitReceiveIT. CR1 is only
+ * 						reprogrammed when the next device needs a different speed/DFF/CPOL/CPHA.
+ * 						A queued transaction which can not be started when its turn comes is
+ * 						completed with SPI_EVENT_START_ERR. The callback runs in interrupt context
+
+ */
+uint8_t SPI_QueueTransaction(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pTrans)
+{
+	uint32_t primask;
+	uint8_t idle;
+	uint8_t state = SPI_READY;
+
+	pTrans->pNext = NULL;
+
+	IRQ_LOCK(primask);
+	idle = (pSPIHandle->pQueueHead == NULL);
+	if(idle)
+	{
+		pSPIHandle->pQueueHead = pTrans;
+	}else
+	{
+		pSPIHandle->pQueueTail->pNext = pTrans;
+	}
+	pSPIHandle->pQueueTail = pTrans;
+	IRQ_UNLOCK(primask);
+
+	//nothing in flight, so the ISR can not touch the queue till this transaction is started
+	if(idle)
+	{
+		state = spi_queue_start(pSPIHandle);
+		if(state != SPI_READY)
+		{
+			//not started, the caller keeps it. Another context may have appended behind it meanwhile
+			IRQ_LOCK(primask);
+			pSPIHandle->pQueueHead = pTrans->pNext;
+			if(pSPIHandle->pQueueHead == NULL)
+			{
+				pSPIHandle->pQueueTail = NULL;
+			}
+			IRQ_UNLOCK(primask);
+
+			spi_queue_next(pSPIHandle);
+		}
+	}
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveReceivePingPong
+ *
+ * @brief             - starts continuous slave reception in to two alternating buffers
+ *
+ * @param[in]         - SPI handle of a slave, pDMARx selects DMA (double buffer mode) over RXNE interrupts
+ * @param[in]         - ping-pong descriptor with pBuffer[0], pBuffer[1] and Len filled in
+ *
+ * @return            - state of the Rx side before the call, SPI_READY means reception is started,
+ * 						SPI_ERR_LEN if Len is 0, odd in 16 bit DFF or over 65535 frames in DMA mode
+ *
+ * @Note              - A buffer is handed over with SPI_EVENT_RX_BUF_READY (pReady/ReadyLen) when it
+ * 						is full or when the master releases NSS (SPI_SlaveNSSHandling from the EXTI
+ * 						handler of the NSS pin). Nothing is copied, the application gives the buffer
+ * 						back with SPI_SlaveReleaseBuffer. If the hardware has to switch to a buffer the
+ * 						application still owns, SPI_EVENT_OVR_ERR is raised.
+ * 						Len is limited to 65535 frames in DMA mode. CRC is not used in this mode
+
+ */
+uint8_t SPI_SlaveReceivePingPong(SPI_Handle_t *pSPIHandle, SPI_PingPong_t *pPingPong)
+{
+	uint8_t state = pSPIHandle->RxState;
+	uint32_t frames;
+
+	if(state != SPI_BUSY_IN_RX)
+	{
+		//0. whole frames only, and no more than NDTR counts in DMA mode
+		frames = (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) ? (pPingPong->Len / 2) : pPingPong->Len;
+		if( (frames == 0) || spi_len_invalid(pSPIHandle->pSPIx,pPingPong->Len) ||
+			(pSPIHandle->pDMARx && frames > 0xFFFF) )
+		{
+			return SPI_ERR_LEN;
+		}
+
+		//1. buffer 0 is filled first, the application owns none
+		pPingPong->Fill = 0;
+		pPingPong->Count = 0;
+		pPingPong->Owned = 0;
+		pPingPong->pReady = NULL;
+		pPingPong->ReadyLen = 0;
+
+		pSPIHandle->pPingPong = pPingPong;
+		pSPIHandle->TxRxLinked = RESET;
+
+		//2.  Mark the SPI state as busy in reception
+		pSPIHandle->RxState = SPI_BUSY_IN_RX;
+		pSPIHandle->IRQEntries = 0;
+
+		SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+
+		//3. let the DMA swap the buffers in hardware, or take every frame by interrupt
+		if(pSPIHandle->pDMARx)
+		{
+			spi_dma_config_stream(pSPIHandle,pSPIHandle->pDMARx,DMA_DIR_PERIPH_TO_MEM,ENABLE,DMA_IT_TC | DMA_IT_TE);
+			pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXDMAEN);
+			spi_pingpong_dma_start(pSPIHandle);
+		}else
+		{
+			pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXNEIE );
+		}
+	}
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveReleaseBuffer
+ *
+ * @brief             - gives a buffer received with SPI_EVENT_RX_BUF_READY back to the driver
+ *
+ * @param[in]         - SPI handle
+ * @param[in]         - pReady of the event
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void SPI_SlaveReleaseBuffer(SPI_Handle_t *pSPIHandle, uint8_t *pBuffer)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+	uint32_t primask;
+
+	if(pPingPong == NULL)
+	{
+		return;
+	}
+
+	IRQ_LOCK(primask);
+	if(pBuffer == pPingPong->pBuffer[0])
+	{
+		pPingPong->Owned &= ~( 1 << 0);
+	}else if(pBuffer == pPingPong->pBuffer[1])
+	{
+		pPingPong->Owned &= ~( 1 << 1);
+	}
+	IRQ_UNLOCK(primask);
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveStopPingPong
+ *
+ * @brief             - stops ping-pong reception, data not yet handed over is dropped
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void SPI_SlaveStopPingPong(SPI_Handle_t *pSPIHandle)
+{
+	if(pSPIHandle->pPingPong == NULL)
+	{
+		return;
+	}
+
+	if(pSPIHandle->pDMARx)
+	{
+		pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_RXDMAEN);
+		DMA_StopTransfer(pSPIHandle->pDMARx);
+		DMA_ClearFlag(pSPIHandle->pDMARx,DMA_FLAG_ALL);
+	}
+
+	SPI_CloseReception(pSPIHandle);
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveNSSHandling
+ *
+ * @brief             - hands over the partially filled buffer at the end of a master transaction
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - To be called from the EXTI handler of the NSS pin, configured for the rising
+ * 						edge (GPIO_Init with GPIO_MODE_ALTFN, then again with GPIO_MODE_IT_RT).
+ * 						Keep the EXTI and the Rx DMA stream interrupts at the same priority
+
+ */
+void SPI_SlaveNSSHandling(SPI_Handle_t *pSPIHandle)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+	uint32_t count;
+
+	if(pPingPong == NULL)
+	{
+		return;
+	}
+
+	if(pSPIHandle->pDMARx)
+	{
+		//1. freeze the stream, disabling it also sets TCIF which is not a real swap
+		DMA_StopTransfer(pSPIHandle->pDMARx);
+		DMA_ClearFlag(pSPIHandle->pDMARx,DMA_FLAG_ALL);
+
+		//2. a swap not serviced yet by the DMA interrupt is handed over first
+		if(spi_pingpong_dma_swapped(pSPIHandle))
+		{
+			spi_pingpong_handover(pSPIHandle,pPingPong->Len);
+		}
+
+		//3. what is in the fill buffer now
+		count = DMA_GetRemaining(pSPIHandle->pDMARx);
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+		{
+			count *= 2;
+		}
+		count = pPingPong->Len - count;
+
+		if(count)
+		{
+			spi_pingpong_handover(pSPIHandle,count);
+		}
+
+		//4. next transaction starts at the beginning of the fill buffer
+		spi_pingpong_dma_start(pSPIHandle);
+	}else
+	{
+		if(pPingPong->Count)
+		{
+			spi_pingpong_handover(pSPIHandle,pPingPong->Count);
+		}
+	}
+}
+
+
+
+/*********************************************************************
+ * @fn      		  - SPI_SendDataDMA
+ *
+ * @brief             - starts a DMA driven transmission of Len bytes
+ *
+ * @param[in]         - SPI handle, pDMATx must point to the Tx stream of this SPI
+ * @param[in]         - Tx buffer
+ * @param[in]         - number of bytes to send (even number in 16 bit DFF)
+ *
+ * @return            - state of the Tx side before the call, SPI_READY means the transfer is started,
+ * 						SPI_ERR_NO_DMA if pDMATx is not set, SPI_ERR_LEN if Len is odd in 16 bit DFF
+ *
+ * @Note              - SPI_EVENT_TX_CMPLT is raised once the last frame has left the shift register.
+ * 						A full duplex master with pDMARx attached (and free) runs the transfer
+ * 						with the Rx stream throwing the received frames away, and completes from
+ * 						SPI_DMARxIRQHandling. Otherwise a master completes from SPI_IRQHandling on
+ * 						the TXE which follows the Tx stream, so the SPI interrupt must be enabled
+
+ */
+uint8_t SPI_SendDataDMA(SPI_Handle_t *pSPIHandle,uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint8_t state = pSPIHandle->TxState;
+	uint32_t cr1 = pSPIHandle->pSPIx->CR1;
+
+	if(state != SPI_BUSY_IN_TX)
+	{
+		if(pSPIHandle->pDMATx == NULL)
+		{
+			return SPI_ERR_NO_DMA;
+		}
+
+		if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+		{
+			return SPI_ERR_LEN;
+		}
+
+		//the Rx stream TC marks the end of the last frame, nothing has to wait for BSY then
+		if( pSPIHandle->pDMARx && (pSPIHandle->RxState == SPI_READY) && (cr1 & ( 1 << SPI_CR1_MSTR)) &&
+				!(cr1 & ( ( 1 << SPI_CR1_RXONLY) | ( 1 << SPI_CR1_BIDIMODE) )) )
+		{
+			return SPI_TransferDMA(pSPIHandle,pTxBuffer,NULL,Len);
+		}
+
+		//1 . Save the Tx buffer address and Len information
+		pSPIHandle->pTxBuffer = pTxBuffer;
+		pSPIHandle->TxLen = Len;
+		pSPIHandle->TxRxLinked = RESET;
+		spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
+
+		//2.  Mark the SPI state as busy in transmission
+		pSPIHandle->TxState = SPI_BUSY_IN_TX;
+
+		//3. program the Tx stream : memory -> DR, interrupt on completion and on error
+		spi_dma_config_stream(pSPIHandle,pSPIHandle->pDMATx,DMA_DIR_MEM_TO_PERIPH,ENABLE,DMA_IT_TC | DMA_IT_TE);
+
+		//4. enable the stream and then TXDMAEN
+		spi_dma_start_tx(pSPIHandle);
+	}
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_ReceiveDataDMA
+ *
+ * @brief             - starts a DMA driven reception of Len bytes
+ *
+ * @param[in]         - SPI handle, pDMARx must point to the Rx stream of this SPI
+ * @param[in]         - Rx buffer
+ * @param[in]         - number of bytes to receive (even number in 16 bit DFF)
+ *
+ * @return            - state of the Rx side before the call, SPI_READY means the transfer is started,
+ * 						SPI_ERR_NO_DMA if a stream it needs is not set, SPI_ERR_LEN if Len is odd in 16 bit DFF
+ *
+ * @Note              - A full duplex master only generates SCLK while it transmits, so in that
+ * 						case dummy frames are clocked out through pDMATx (see SPI_TransferDMA)
+ * 						and pDMATx is required as well
+
+ */
+uint8_t SPI_ReceiveDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t state = pSPIHandle->RxState;
+	uint32_t cr1 = pSPIHandle->pSPIx->CR1;
+
+	if(state != SPI_BUSY_IN_RX)
+	{
+		if(pSPIHandle->pDMARx == NULL)
+		{
+			return SPI_ERR_NO_DMA;
+		}
+
+		if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+		{
+			return SPI_ERR_LEN;
+		}
+
+		if( (cr1 & ( 1 << SPI_CR1_MSTR)) && !(cr1 & ( ( 1 << SPI_CR1_RXONLY) | ( 1 << SPI_CR1_BIDIMODE) )) )
+		{
+			return SPI_TransferDMA(pSPIHandle,NULL,pRxBuffer,Len);
+		}
+
+		//1 . Save the Rx buffer address and Len information
+		pSPIHandle->pRxBuffer = pRxBuffer;
+		pSPIHandle->RxLen = Len;
+		pSPIHandle->TxRxLinked = RESET;
+		spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
+
+		//2.  Mark the SPI state as busy in reception
+		pSPIHandle->RxState = SPI_BUSY_IN_RX;
+
+		//3. program the Rx stream : DR -> memory, interrupt on completion and on error
+		spi_dma_config_stream(pSPIHandle,pSPIHandle->pDMARx,DMA_DIR_PERIPH_TO_MEM,(pRxBuffer != NULL) ? ENABLE : DISABLE,DMA_IT_TC | DMA_IT_TE);
+
+		//4. enable the stream and then RXDMAEN
+		spi_dma_start_rx(pSPIHandle);
+	}
+
+	return state;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_TransferDMA
+ *
+ * @brief             - full duplex DMA transfer, Len bytes out of pTxBuffer and Len bytes in to pRxBuffer
+ *
+ * @param[in]         - SPI handle, both pDMATx and pDMARx must be set
+ * @param[in]         - Tx buffer, NULL clocks out 0xFF dummy frames
+ * @param[in]         - Rx buffer, NULL throws the received frames away
+ * @param[in]         - number of bytes (even number in 16 bit DFF)
+ *
+ * @return            - SPI_READY if the transfer is started, otherwise the busy state,
+ * 						SPI_ERR_NO_DMA if pDMATx or pDMARx is not set, SPI_ERR_LEN if Len is odd in 16 bit DFF
+ *
+ * @Note              - Only the Rx stream interrupts on completion, since the last frame
+ * 						received is also the last frame sent. Transfers longer than 65535
+ * 						frames are split, both streams are reloaded together from the Rx interrupt.
+ * 						With SPI_CRC_EN the hardware sends the CRC after every Tx stream run,
+ * 						so keep CRC transfers within 65535 frames
+
+ */
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	if(pSPIHandle->TxState == SPI_BUSY_IN_TX)
+	{
+		return SPI_BUSY_IN_TX;
+	}
+
+	if(pSPIHandle->RxState == SPI_BUSY_IN_RX)
+	{
+		return SPI_BUSY_IN_RX;
+	}
+
+	if(spi_len_invalid(pSPIHandle->pSPIx,Len))
+	{
+		return SPI_ERR_LEN;
+	}
+
+	if( (pSPIHandle->pDMATx == NULL) || (pSPIHandle->pDMARx == NULL) )
+	{
+		return SPI_ERR_NO_DMA;
+	}
+
+	//1 . Save the buffer addresses and Len information
+	pSPIHandle->pTxBuffer = pTxBuffer;
+	pSPIHandle->pRxBuffer = pRxBuffer;
+	pSPIHandle->TxLen = Len;
+	pSPIHandle->RxLen = Len;
+	pSPIHandle->TxRxLinked = SET;
+
+	//2.  Mark both sides busy
+	pSPIHandle->TxState = SPI_BUSY_IN_TX;
+	pSPIHandle->RxState = SPI_BUSY_IN_RX;
+
+	//3. drop any stale frame so that the first Rx request belongs to this transfer
+	SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+	spi_crc_reset(pSPIHandle->pSPIx,DISABLE);
+
+	//4. program both streams, the Tx stream only reports errors
+	spi_dma_config_stream(pSPIHandle,pSPIHandle->pDMATx,DMA_DIR_MEM_TO_PERIPH,(pTxBuffer != NULL) ? ENABLE : DISABLE,DMA_IT_TE);
+	spi_dma_config_stream(pSPIHandle,pSPIHandle->pDMARx,DMA_DIR_PERIPH_TO_MEM,(pRxBuffer != NULL) ? ENABLE : DISABLE,DMA_IT_TC | DMA_IT_TE);
+
+	//5. RM sequence : RXDMAEN , enable the streams , TXDMAEN
+	spi_dma_start_rx(pSPIHandle);
+	spi_dma_start_tx(pSPIHandle);
+
+	return SPI_READY;
+}
+
+
+
+
+void SPI_IRQHandling(SPI_Handle_t *pHandle)
+{
+
+	uint8_t temp1 , temp2;
+	uint8_t serviced;
+	uint8_t budget = pHandle->SPIConfig.SPI_IRQBurst;
+
+	pHandle->IRQEntries++;
+
+	if(budget == 0)
+	{
+		budget = 1;
+	}
+
+	//keep servicing while TXE/RXNE stay set, this saves the exception entry/exit per frame
+	do
+	{
+		serviced = 0;
+
+		//first lets check for TXE
+		temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_TXE);
+		temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_TXEIE);
+
+		if( temp1 && temp2)
+		{
+			//handle TXE
+			if(pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_TXDMAEN))
+			{
+				//the Tx stream is done and its last frame is in the shift register
+				spi_dma_tx_drain_handle(pHandle);
+			}else if(pHandle->TxRxLinked)
+			{
+				spi_txrx_txe_interrupt_handle(pHandle);
+			}else
+			{
+				spi_txe_interrupt_handle(pHandle);
+			}
+			serviced = 1;
+		}
+
+		// check for RXNE
+		temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_RXNE);
+		temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_RXNEIE);
+
+		if( temp1 && temp2)
+		{
+			//handle RXNE
+			if(pHandle->pPingPong)
+			{
+				spi_pingpong_rxne_interrupt_handle(pHandle);
+			}else if(pHandle->TxRxLinked)
+			{
+				spi_txrx_rxne_interrupt_handle(pHandle);
+			}else
+			{
+				spi_rxne_interrupt_handle(pHandle);
+			}
+			serviced = 1;
+		}
+
+	}while(serviced && --budget);
+
+	// check for ovr flag
+	temp1 = pHandle->pSPIx->SR & ( 1 << SPI_SR_OVR);
+	temp2 = pHandle->pSPIx->CR2 & ( 1 << SPI_CR2_ERRIE);
+
+	if( temp1 && temp2)
+	{
+		//handle ovr error
+		spi_ovr_err_interrupt_handle(pHandle);
+	}
+
+
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_DMATxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the Tx DMA stream
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void SPI_DMATxIRQHandling(SPI_Handle_t *pSPIHandle)
+{
+	uint8_t events = DMA_IRQHandling(pSPIHandle->pDMATx);
+
+	if(events & DMA_FLAG_TE)
+	{
+		spi_dma_abort(pSPIHandle);
+		return;
+	}
+
+	//in lockstep mode the Rx stream completes the transfer
+	if( (events & DMA_FLAG_TC) && !pSPIHandle->TxRxLinked )
+	{
+		if(pSPIHandle->TxLen)
+		{
+			//more than 65535 frames were requested, continue with the next chunk
+			spi_dma_start_tx(pSPIHandle);
+			return;
+		}
+
+		//the last frame is only in DR now, SPI_IRQHandling finishes once it is in the shift register
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_MSTR))
+		{
+			pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXEIE);
+			return;
+		}
+
+		pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_TXDMAEN);
+
+		//nobody has read the Rx side, so clear the overrun caused by this transmission
+		if(pSPIHandle->RxState != SPI_BUSY_IN_RX)
+		{
+			SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+		}
+
+		SPI_CloseTransmisson(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_TX_CMPLT);
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - SPI_DMARxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the Rx DMA stream
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void SPI_DMARxIRQHandling(SPI_Handle_t *pSPIHandle)
+{
+	uint8_t events = DMA_IRQHandling(pSPIHandle->pDMARx);
+	uint8_t crcerr = 0;
+
+	if(events & DMA_FLAG_TE)
+	{
+		spi_dma_abort(pSPIHandle);
+		return;
+	}
+
+	if(pSPIHandle->pPingPong)
+	{
+		//double buffer mode : the hardware has already switched to the other buffer
+		if( (events & DMA_FLAG_TC) && spi_pingpong_dma_swapped(pSPIHandle) )
+		{
+			spi_pingpong_handover(pSPIHandle,pSPIHandle->pPingPong->Len);
+		}
+		return;
+	}
+
+	if(events & DMA_FLAG_TC)
+	{
+		if(pSPIHandle->RxLen)
+		{
+			//more than 65535 frames were requested, continue with the next chunk
+			spi_dma_start_rx(pSPIHandle);
+			if(pSPIHandle->TxRxLinked)
+			{
+				spi_dma_start_tx(pSPIHandle);
+			}
+			return;
+		}
+
+		pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_RXDMAEN);
+
+		//the stream only counted data, the CRC frame is still to come
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+		{
+			while( SPI_GetFlagStatus(pSPIHandle->pSPIx,SPI_RXNE_FLAG) == FLAG_RESET );
+			crcerr = spi_crc_check(pSPIHandle->pSPIx);
+		}
+
+		if(pSPIHandle->TxRxLinked)
+		{
+			//last frame in is also the last frame out, so the Tx side is complete as well
+			pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_TXDMAEN);
+			spi_txrx_complete(pSPIHandle,crcerr);
+		}else
+		{
+			SPI_CloseReception(pSPIHandle);
+			SPI_ApplicationEventCallback(pSPIHandle,crcerr ? SPI_EVENT_CRC_ERR : SPI_EVENT_RX_CMPLT);
+		}
+	}
+}
+
+
+//some helper function implementations
+
+static void  spi_txe_interrupt_handle(SPI_Handle_t *pSPIHandle)
+{
+	// check the DFF bit in CR1
+	if( (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF) ) )
+	{
+		//16 bit DFF
+		//1. load the data in to the DR
+		pSPIHandle->pSPIx->DR =   *((uint16_t*)pSPIHandle->pTxBuffer);
+		pSPIHandle->TxLen -= 2;
+		pSPIHandle->pTxBuffer += 2;
+	}else
+	{
+		//8 bit DFF
+		pSPIHandle->pSPIx->DR =   *pSPIHandle->pTxBuffer;
+		pSPIHandle->TxLen--;
+		pSPIHandle->pTxBuffer++;
+	}
+
+	if(! pSPIHandle->TxLen)
+	{
+		//CRC goes out right after the last data frame
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+		{
+			pSPIHandle->pSPIx->CR1 |= ( 1 << SPI_CR1_CRCNEXT);
+		}
+
+		//TxLen is zero , so close the spi transmission and inform the application that
+		//TX is over.
+
+		//this prevents interrupts from setting up of TXE flag
+		SPI_CloseTransmisson(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_TX_CMPLT);
+	}
+
+}
+
+
+static void  spi_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle)
+{
+	if(pSPIHandle->CRCPending)
+	{
+		//this frame is the CRC, the hardware has compared it already
+		pSPIHandle->CRCPending = RESET;
+		SPI_CloseReception(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle,spi_crc_check(pSPIHandle->pSPIx) ? SPI_EVENT_CRC_ERR : SPI_EVENT_RX_CMPLT);
+		return;
+	}
+
 	//do rxing as per the dff
-	if(pSPIHandle->pSPIx->CR1 & ( 1 << 11))
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
 	{
 		//16 bit
 		*((uint16_t*)pSPIHandle->pRxBuffer) = (uint16_t) pSPIHandle->pSPIx->DR;
 		pSPIHandle->RxLen -= 2;
-		pSPIHandle->pRxBuffer--;
-		pSPIHandle->pRxBuffer--;
+		pSPIHandle->pRxBuffer += 2;
 
 	}else
 	{
 		//8 bit
 		*(pSPIHandle->pRxBuffer) = (uint8_t) pSPIHandle->pSPIx->DR;
 		pSPIHandle->RxLen--;
-		pSPIHandle->pRxBuffer--;
+		pSPIHandle->pRxBuffer++;
 	}
 
 	if(! pSPIHandle->RxLen)
 	{
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+		{
+			//wait for one more RXNE, which brings the CRC frame
+			pSPIHandle->CRCPending = SET;
+			return;
+		}
+
 		//reception is complete
 		SPI_CloseReception(pSPIHandle);
 		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_RX_CMPLT);
@@ -557,6 +1680,481 @@ static void  spi_ovr_err_interrupt_handle(SPI_Handle_t *pSPIHandle)
 
 }
 
+static void  spi_txrx_txe_interrupt_handle(SPI_Handle_t *pSPIHandle)
+{
+	uint8_t framesize = 1;
+	uint16_t data = 0xFFFF;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		framesize = 2;
+	}
+
+	if(pSPIHandle->pTxBuffer)
+	{
+		data = (framesize == 2) ? *((uint16_t*)pSPIHandle->pTxBuffer) : *pSPIHandle->pTxBuffer;
+		pSPIHandle->pTxBuffer += framesize;
+	}
+	pSPIHandle->pSPIx->DR = data;
+	pSPIHandle->TxLen -= framesize;
+
+	if( (pSPIHandle->TxLen == 0) && (pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN)) )
+	{
+		pSPIHandle->pSPIx->CR1 |= ( 1 << SPI_CR1_CRCNEXT);
+	}
+
+	//one frame shifting and one waiting in DR is enough, the RXNE interrupt unmasks TXE again
+	if( (pSPIHandle->TxLen == 0) || ( (pSPIHandle->RxLen - pSPIHandle->TxLen) >= (uint32_t)(2 * framesize) ) )
+	{
+		pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_TXEIE);
+	}
+}
+
+
+static void  spi_txrx_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle)
+{
+	uint8_t framesize = 1;
+	uint16_t data;
+
+	if(pSPIHandle->CRCPending)
+	{
+		//this frame is the CRC, the hardware has compared it already
+		pSPIHandle->CRCPending = RESET;
+		spi_txrx_complete(pSPIHandle,spi_crc_check(pSPIHandle->pSPIx));
+		return;
+	}
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		framesize = 2;
+	}
+
+	data = (uint16_t)pSPIHandle->pSPIx->DR;
+	if(pSPIHandle->pRxBuffer)
+	{
+		if(framesize == 2)
+		{
+			*((uint16_t*)pSPIHandle->pRxBuffer) = data;
+		}else
+		{
+			*pSPIHandle->pRxBuffer = (uint8_t)data;
+		}
+		pSPIHandle->pRxBuffer += framesize;
+	}
+	pSPIHandle->RxLen -= framesize;
+
+	if(pSPIHandle->TxLen)
+	{
+		//a slot is free again, let TXE refill DR
+		pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXEIE);
+	}
+
+	if(! pSPIHandle->RxLen)
+	{
+		if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN))
+		{
+			//wait for one more RXNE, which brings the CRC frame
+			pSPIHandle->CRCPending = SET;
+			return;
+		}
+
+		//last frame in is also the last frame out
+		spi_txrx_complete(pSPIHandle,0);
+	}
+}
+
+
+static void  spi_txrx_complete(SPI_Handle_t *pSPIHandle, uint8_t crcerr)
+{
+	uint8_t txdata = (pSPIHandle->pTxBuffer != NULL);
+	uint8_t rxdata = (pSPIHandle->pRxBuffer != NULL);
+
+	pSPIHandle->TxRxLinked = RESET;
+	SPI_CloseTransmisson(pSPIHandle);
+	SPI_CloseReception(pSPIHandle);
+
+	if(pSPIHandle->pQueueHead)
+	{
+		//transfer belongs to the transaction queue
+		spi_queue_complete(pSPIHandle,crcerr ? SPI_EVENT_CRC_ERR : SPI_EVENT_TRANS_CMPLT);
+		return;
+	}
+
+	if(txdata)
+	{
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_TX_CMPLT);
+	}
+
+	//frames thrown away (SPI_SendDataDMA through the Rx stream) are not reported as received
+	if(crcerr)
+	{
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_CRC_ERR);
+	}else if(rxdata || !txdata)
+	{
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_RX_CMPLT);
+	}
+}
+
+
+static void  spi_crc_reset(SPI_RegDef_t *pSPIx, uint8_t WaitIdle)
+{
+	uint32_t spe;
+
+	if( ! (pSPIx->CR1 & ( 1 << SPI_CR1_CRCEN)) )
+	{
+		return;
+	}
+
+	//blocking sends return with their last frames still shifting, so they wait for the bus here.
+	//IT/DMA starts never spin as they may run from an ISR (queued starts), after a Tx only IT
+	//transfer the application waits for BSY before it starts the next CRC transfer
+	if(WaitIdle == ENABLE)
+	{
+		while( SPI_GetFlagStatus(pSPIx,SPI_BUSY_FLAG) );
+	}
+
+	//CRC registers are only cleared by toggling CRCEN, which is allowed while SPE=0
+	spe = pSPIx->CR1 & ( 1 << SPI_CR1_SPE);
+	pSPIx->CR1 &= ~( 1 << SPI_CR1_SPE);
+	pSPIx->CR1 &= ~( 1 << SPI_CR1_CRCEN);
+	pSPIx->CR1 |= ( 1 << SPI_CR1_CRCEN);
+	pSPIx->CR1 |= spe;
+
+	SPI_ClearCRCERRFlag(pSPIx);
+}
+
+
+static uint8_t spi_len_invalid(SPI_RegDef_t *pSPIx, uint32_t Len)
+{
+	//a 16 bit frame moves 2 bytes, an odd byte count would leave half a frame behind
+	return ( (pSPIx->CR1 & ( 1 << SPI_CR1_DFF)) && (Len & 1) );
+}
+
+
+static uint8_t spi_crc_check(SPI_RegDef_t *pSPIx)
+{
+	uint8_t crcerr = 0;
+
+	//reading the CRC frame clears RXNE
+	(void)pSPIx->DR;
+
+	if(pSPIx->SR & ( 1 << SPI_SR_CRCERR))
+	{
+		crcerr = 1;
+		SPI_ClearCRCERRFlag(pSPIx);
+	}
+
+	return crcerr;
+}
+
+
+static uint8_t spi_queue_start(SPI_Handle_t *pSPIHandle)
+{
+	SPI_Transaction_t *pTrans = pSPIHandle->pQueueHead;
+	SPI_Device_t *pDev = pTrans->pDevice;
+	uint32_t mask, cr1;
+	uint8_t state;
+
+	//0. a direct transfer holds the bus : CR1 and the chip selects are left alone
+	if(pSPIHandle->RxState != SPI_READY)
+	{
+		return pSPIHandle->RxState;
+	}
+	if(pSPIHandle->TxState != SPI_READY)
+	{
+		return pSPIHandle->TxState;
+	}
+
+	//1. clock settings of this device
+	if(pDev->SPI_SclkHz)
+	{
+		pDev->SPI_SclkSpeed = SPI_ComputeSclkSpeed(pSPIHandle->pSPIx,pDev->SPI_SclkHz);
+	}
+	mask = ( 1 << SPI_CR1_CPHA) | ( 1 << SPI_CR1_CPOL) | ( 0x7 << SPI_CR1_BR) | ( 1 << SPI_CR1_DFF);
+	cr1  = (uint32_t)pDev->SPI_CPHA << SPI_CR1_CPHA;
+	cr1 |= (uint32_t)pDev->SPI_CPOL << SPI_CR1_CPOL;
+	cr1 |= (uint32_t)pDev->SPI_SclkSpeed << SPI_CR1_BR;
+	cr1 |= (uint32_t)pDev->SPI_DFF << SPI_CR1_DFF;
+
+	//2. these bits may only change while SPE=0, so touch CR1 only if the device really differs.
+	//   The previous transfer has received its last frame, the bus is not busy any more
+	if( (pSPIHandle->pSPIx->CR1 & mask) != cr1 )
+	{
+		pSPIHandle->pSPIx->CR1 &= ~( 1 << SPI_CR1_SPE);
+		pSPIHandle->pSPIx->CR1 = (pSPIHandle->pSPIx->CR1 & ~mask) | cr1;
+	}
+	pSPIHandle->pSPIx->CR1 |= ( 1 << SPI_CR1_SPE);
+
+	//3. select the device and start the transfer
+	GPIO_WriteToOutputPin(pDev->pCSPort,pDev->CSPin,GPIO_PIN_RESET);
+
+	if(pSPIHandle->pDMATx && pSPIHandle->pDMARx)
+	{
+		state = SPI_TransferDMA(pSPIHandle,pTrans->pTxBuffer,pTrans->pRxBuffer,pTrans->Len);
+	}else
+	{
+		state = SPI_TransmitReceiveIT(pSPIHandle,pTrans->pTxBuffer,pTrans->pRxBuffer,pTrans->Len);
+	}
+
+	if(state != SPI_READY)
+	{
+		GPIO_WriteToOutputPin(pDev->pCSPort,pDev->CSPin,GPIO_PIN_SET);
+	}
+
+	return state;
+}
+
+
+static void  spi_queue_complete(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	spi_queue_pop(pSPIHandle,AppEv);
+
+	//run the next one back to back, unless queueing from the callback already started it
+	spi_queue_next(pSPIHandle);
+}
+
+
+static void  spi_queue_pop(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	SPI_Transaction_t *pTrans = pSPIHandle->pQueueHead;
+
+	//1. the last frame is received, release the device
+	GPIO_WriteToOutputPin(pTrans->pDevice->pCSPort,pTrans->pDevice->CSPin,GPIO_PIN_SET);
+
+	//2. pop it, the thread mode only appends at the tail under IRQ_LOCK
+	pSPIHandle->pQueueHead = pTrans->pNext;
+	if(pSPIHandle->pQueueHead == NULL)
+	{
+		pSPIHandle->pQueueTail = NULL;
+	}
+
+	//3. inform the owner, it may queue (this or another) transaction from here
+	if(pTrans->Callback)
+	{
+		pTrans->Callback(pTrans,AppEv);
+	}
+}
+
+
+static void  spi_queue_next(SPI_Handle_t *pSPIHandle)
+{
+	//a transaction which can not start is completed with an error, so the ones behind it still run
+	while( pSPIHandle->pQueueHead && (pSPIHandle->RxState == SPI_READY) )
+	{
+		if(spi_queue_start(pSPIHandle) == SPI_READY)
+		{
+			break;
+		}
+		spi_queue_pop(pSPIHandle,SPI_EVENT_START_ERR);
+	}
+}
+
+
+static void  spi_pingpong_rxne_interrupt_handle(SPI_Handle_t *pSPIHandle)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+	uint8_t *pRx = pPingPong->pBuffer[pPingPong->Fill] + pPingPong->Count;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		*((uint16_t*)pRx) = (uint16_t)pSPIHandle->pSPIx->DR;
+		pPingPong->Count += 2;
+	}else
+	{
+		*pRx = (uint8_t)pSPIHandle->pSPIx->DR;
+		pPingPong->Count++;
+	}
+
+	if(pPingPong->Count >= pPingPong->Len)
+	{
+		spi_pingpong_handover(pSPIHandle,pPingPong->Len);
+	}
+}
+
+
+static void  spi_pingpong_dma_start(SPI_Handle_t *pSPIHandle)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+	uint32_t frames = pPingPong->Len;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		frames = pPingPong->Len / 2;
+	}
+
+	//the fill buffer goes to M0AR, CT restarts from 0
+	pPingPong->M0Buffer = pPingPong->Fill;
+	DMA_StartDoubleBuffer(pSPIHandle->pDMARx,(uint32_t)&pSPIHandle->pSPIx->DR,
+			(uint32_t)pPingPong->pBuffer[pPingPong->Fill],(uint32_t)pPingPong->pBuffer[pPingPong->Fill ^ 1],(uint16_t)frames);
+}
+
+
+static uint8_t spi_pingpong_dma_swapped(SPI_Handle_t *pSPIHandle)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+
+	//the buffer the hardware writes to differs from the one the driver thinks is filled
+	return ( (pPingPong->M0Buffer ^ DMA_GetCurrentTarget(pSPIHandle->pDMARx)) != pPingPong->Fill );
+}
+
+
+static void  spi_pingpong_handover(SPI_Handle_t *pSPIHandle, uint32_t Len)
+{
+	SPI_PingPong_t *pPingPong = pSPIHandle->pPingPong;
+
+	pPingPong->pReady = pPingPong->pBuffer[pPingPong->Fill];
+	pPingPong->ReadyLen = Len;
+	pPingPong->Owned |= ( 1 << pPingPong->Fill);
+
+	pPingPong->Fill ^= 1;
+	pPingPong->Count = 0;
+
+	SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_RX_BUF_READY);
+
+	//the other buffer is being written already, tell the application if it still holds it
+	if(pPingPong->Owned & ( 1 << pPingPong->Fill))
+	{
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_OVR_ERR);
+	}
+}
+
+
+
+static void  spi_dma_config_stream(SPI_Handle_t *pSPIHandle, DMA_Handle_t *pDMAHandle, uint8_t Direction, uint8_t MemInc, uint8_t IntEnable)
+{
+	uint8_t datasize = DMA_DATASIZE_BYTE;
+
+	//DMA data size follows the DFF, channel/priority/FIFO are taken from the application's DMA handle
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		datasize = DMA_DATASIZE_HALFWORD;
+	}
+
+	pDMAHandle->DMAConfig.DMA_Direction = Direction;
+	pDMAHandle->DMAConfig.DMA_PeriphDataSize = datasize;
+	pDMAHandle->DMAConfig.DMA_MemDataSize = datasize;
+	pDMAHandle->DMAConfig.DMA_MemInc = MemInc;
+	pDMAHandle->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pDMAHandle->DMAConfig.DMA_IntEnable = IntEnable;
+
+	DMA_Init(pDMAHandle);
+}
+
+
+static uint16_t spi_dma_chunk(SPI_Handle_t *pSPIHandle, uint32_t Len)
+{
+	uint32_t frames = Len;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		frames = Len / 2;
+	}
+
+	if(frames > DMA_MAX_NDTR)
+	{
+		frames = DMA_MAX_NDTR;
+	}
+
+	return (uint16_t)frames;
+}
+
+
+static void  spi_dma_start_tx(SPI_Handle_t *pSPIHandle)
+{
+	uint16_t frames = spi_dma_chunk(pSPIHandle,pSPIHandle->TxLen);
+	uint32_t bytes = frames;
+	uint32_t memaddr = (uint32_t)&spi_dma_dummy;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		bytes = 2 * frames;
+	}
+
+	if(pSPIHandle->pTxBuffer)
+	{
+		memaddr = (uint32_t)pSPIHandle->pTxBuffer;
+		pSPIHandle->pTxBuffer += bytes;
+	}
+	pSPIHandle->TxLen -= bytes;
+
+	//TXE is already set, drop TXDMAEN while the stream is reloaded so the request is seen by the new chunk
+	pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_TXDMAEN);
+	DMA_StartTransfer(pSPIHandle->pDMATx,(uint32_t)&pSPIHandle->pSPIx->DR,memaddr,frames);
+	pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_TXDMAEN);
+}
+
+
+static void  spi_dma_start_rx(SPI_Handle_t *pSPIHandle)
+{
+	uint16_t frames = spi_dma_chunk(pSPIHandle,pSPIHandle->RxLen);
+	uint32_t bytes = frames;
+	uint32_t memaddr = (uint32_t)&spi_dma_sink;
+
+	if(pSPIHandle->pSPIx->CR1 & ( 1 << SPI_CR1_DFF))
+	{
+		bytes = 2 * frames;
+	}
+
+	//without a buffer every frame lands on the sink word, the stream does not increment then
+	if(pSPIHandle->pRxBuffer)
+	{
+		memaddr = (uint32_t)pSPIHandle->pRxBuffer;
+		pSPIHandle->pRxBuffer += bytes;
+	}
+	pSPIHandle->RxLen -= bytes;
+
+	pSPIHandle->pSPIx->CR2 |= ( 1 << SPI_CR2_RXDMAEN);
+	DMA_StartTransfer(pSPIHandle->pDMARx,(uint32_t)&pSPIHandle->pSPIx->DR,memaddr,frames);
+}
+
+
+static void  spi_dma_abort(SPI_Handle_t *pSPIHandle)
+{
+	uint32_t cr2 = pSPIHandle->pSPIx->CR2;
+
+	pSPIHandle->pSPIx->CR2 &= ~( ( 1 << SPI_CR2_TXDMAEN) | ( 1 << SPI_CR2_RXDMAEN) );
+
+	if(cr2 & ( 1 << SPI_CR2_TXDMAEN))
+	{
+		DMA_StopTransfer(pSPIHandle->pDMATx);
+		SPI_CloseTransmisson(pSPIHandle);
+	}
+
+	if(cr2 & ( 1 << SPI_CR2_RXDMAEN))
+	{
+		DMA_StopTransfer(pSPIHandle->pDMARx);
+		SPI_CloseReception(pSPIHandle);
+	}
+
+	pSPIHandle->TxRxLinked = RESET;
+
+	if(pSPIHandle->pQueueHead)
+	{
+		spi_queue_complete(pSPIHandle,SPI_EVENT_DMA_ERR);
+	}else
+	{
+		SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_DMA_ERR);
+	}
+}
+
+
+static void  spi_dma_tx_drain_handle(SPI_Handle_t *pSPIHandle)
+{
+	pSPIHandle->pSPIx->CR2 &= ~( ( 1 << SPI_CR2_TXEIE) | ( 1 << SPI_CR2_TXDMAEN) );
+
+	//only the frame in the shift register is left, so this wait is bounded by one frame time
+	while( SPI_GetFlagStatus(pSPIHandle->pSPIx,SPI_BUSY_FLAG) );
+
+	//nobody has read the Rx side, so clear the overrun caused by this transmission
+	if(pSPIHandle->RxState != SPI_BUSY_IN_RX)
+	{
+		SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+	}
+
+	SPI_CloseTransmisson(pSPIHandle);
+	SPI_ApplicationEventCallback(pSPIHandle,SPI_EVENT_TX_CMPLT);
+}
+
 
 void SPI_CloseTransmisson(SPI_Handle_t *pSPIHandle)
 {
@@ -570,6 +2168,7 @@ void SPI_CloseTransmisson(SPI_Handle_t *pSPIHandle)
 void SPI_CloseReception(SPI_Handle_t *pSPIHandle)
 {
 	pSPIHandle->pSPIx->CR2 &= ~( 1 << SPI_CR2_RXNEIE);
+	pSPIHandle->pPingPong = NULL;
 	pSPIHandle->pRxBuffer = NULL;
 	pSPIHandle->RxLen = 0;
 	pSPIHandle->RxState = SPI_READY;
@@ -589,6 +2188,14 @@ void SPI_ClearOVRFlag(SPI_RegDef_t *pSPIx)
 
 
 
+void SPI_ClearCRCERRFlag(SPI_RegDef_t *pSPIx)
+{
+	//CRCERR is cleared by writing 0, the other SR bits ignore the write
+	pSPIx->SR = ~( 1 << SPI_SR_CRCERR);
+}
+
+
+
 __weak void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
 {
 
@@ -1,109 +1,176 @@
 
 
+#include<string.h>
 #include "stm32f407xx_usart_driver.h"
 
+static void  usart_apply_baud(USART_RegDef_t *pUSARTx, const USART_Baud_t *pBaud);
+static void  usart_rxstream_flush(USART_Handle_t *pUSARTHandle);
+static void  usart_rxstream_handover(USART_Handle_t *pUSARTHandle, uint16_t Len);
+static void  usart_rxstream_halt(USART_Handle_t *pUSARTHandle);
+static void  usart_txring_txe_handle(USART_Handle_t *pUSARTHandle);
+static void  usart_rxring_rxne_handle(USART_Handle_t *pUSARTHandle);
+
 /*********************************************************************
- * @fn      		  - USART_SetBaudRate
+ * @fn      		  - USART_GetPCLK
  *
- * @brief             -
+ * @brief             - returns the clock of the APB bus the USART hangs on
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - base address of the USART peripheral
  *
- * @return            -
+ * @return            - PCLK2 for USART1 and USART6, PCLK1 for the others
  *
- * @Note              -
+ * @Note              - none
 
  */
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate)
+uint32_t USART_GetPCLK(USART_RegDef_t *pUSARTx)
 {
+	if(pUSARTx == USART1 || pUSARTx == USART6)
+	{
+		//USART1 and USART6 are hanging on APB2 bus
+		return RCC_GetPCLK2Value();
+	}
 
-	//Variable to hold the APB clock
-	uint32_t PCLKx;
+	return RCC_GetPCLK1Value();
+}
 
-	uint32_t usartdiv;
 
-	//variables to hold Mantissa and Fraction values
-	uint32_t M_part,F_part;
+/*********************************************************************
+ * @fn      		  - USART_ComputeBaud
+ *
+ * @brief             - computes BRR and OVER8 for a PCLK and a baud rate
+ *
+ * @param[in]         - APB clock of the USART in Hz
+ * @param[in]         - baud rate
+ * @param[in]         - max error in ppm, 0 : USART_BAUD_TOLERANCE_DEFAULT
+ * @param[in]         - result, filled in even when the tolerance is missed
+ *
+ * @return            - USART_BAUD_OK, USART_BAUD_ERR_RANGE or USART_BAUD_ERR_TOLERANCE
+ *
+ * @Note              - BRR holds USARTDIV in 1/16 (OVER8=0) or 1/8 (OVER8=1) units, so in both
+ * 						modes the baud rate is PCLK / D with D = 16 * USARTDIV or 8 * USARTDIV.
+ * 						D is the integer on either side of PCLK / BaudRate which gives the smaller
+ * 						error. Both modes reach the same D, oversampling by 16 is kept whenever
+ * 						D >= 16 for its better noise and clock tolerance, by 8 only above PCLK / 16.
+ * 						Up to PCLK / 8 : 10.5Mbaud on APB2 at 84MHz, 5.25Mbaud on APB1 at 42MHz
 
-  uint32_t tempreg=0;
+ */
+uint8_t USART_ComputeBaud(uint32_t PCLK, uint32_t BaudRate, uint32_t TolerancePpm, USART_Baud_t *pBaud)
+{
+	uint32_t div, frac;
+	int64_t err, errnext;
 
-  //Get the value of APB bus clock in to the variable PCLKx
-  if(pUSARTx == USART1 || pUSARTx == USART6)
-  {
-	   //USART1 and USART6 are hanging on APB2 bus
-	   PCLKx = RCC_GetPCLK2Value();
-  }else
-  {
-	   PCLKx = RCC_GetPCLK1Value();
-  }
+	if(TolerancePpm == 0)
+	{
+		TolerancePpm = USART_BAUD_TOLERANCE_DEFAULT;
+	}
 
-  //Check for OVER8 configuration bit
-  if(pUSARTx->CR1 & (1 << USART_CR1_OVER8))
-  {
-	   //OVER8 = 1 , over sampling by 8
-	   usartdiv = ((25 * PCLKx) / (2 *BaudRate));
-  }else
-  {
-	   //over sampling by 16
-	   usartdiv = ((25 * PCLKx) / (4 *BaudRate));
-  }
+	pBaud->PCLK = PCLK;
+	pBaud->BRR = 0;
+	pBaud->Over8 = RESET;
+	pBaud->BaudReal = 0;
+	pBaud->ErrorPpm = 0;
 
-  //Calculate the Mantissa part
-  M_part = usartdiv/100;
+	if( (BaudRate == 0) || (PCLK / BaudRate < 8) || (PCLK / BaudRate > 0xFFFF) )
+	{
+		return USART_BAUD_ERR_RANGE;
+	}
 
-  //Place the Mantissa part in appropriate bit position . refer USART_BRR
-  tempreg |= M_part << 4;
+	//1. D rounded down, then keep D + 1 if it is closer (the error is not symmetric in D)
+	div = PCLK / BaudRate;
+	err = ( (int64_t)PCLK * 1000000 ) / div - (int64_t)BaudRate * 1000000;
+	errnext = ( (int64_t)PCLK * 1000000 ) / (div + 1) - (int64_t)BaudRate * 1000000;
+	if( (div < 0xFFFF) && (-errnext < err) )
+	{
+		div++;
+		err = errnext;
+	}
+
+	//2. BRR : 12 bit mantissa, 4 bit fraction (3 bits with OVER8, bit 3 kept clear)
+	if(div >= 16)
+	{
+		pBaud->BRR = (uint16_t)div;
+	}else
+	{
+		frac = div & 0x7;
+		pBaud->BRR = (uint16_t)( ( (div >> 3) << 4 ) | frac );
+		pBaud->Over8 = SET;
+	}
 
-  //Extract the fraction part
-  F_part = (usartdiv - (M_part * 100));
+	pBaud->BaudReal = PCLK / div;
+	pBaud->ErrorPpm = (int32_t)( err / BaudRate );
+
+	if( (pBaud->ErrorPpm > (int32_t)TolerancePpm) || (pBaud->ErrorPpm < -(int32_t)TolerancePpm) )
+	{
+		return USART_BAUD_ERR_TOLERANCE;
+	}
+
+	return USART_BAUD_OK;
+}
 
-  //Calculate the final fractional
-  if(pUSARTx->CR1 & ( 1 << USART_CR1_OVER8))
-   {
-	  //OVER8 = 1 , over sampling by 8
-	  F_part = ((( F_part * 8)+ 50) / 100)& ((uint8_t)0x07);
 
-   }else
-   {
-	   //over sampling by 16
-	   F_part = ((( F_part * 16)+ 50) / 100) & ((uint8_t)0x0F);
+/*********************************************************************
+ * @fn      		  - USART_SetBaudRate
+ *
+ * @brief             - programs the baud rate from the live APB clock
+ *
+ * @param[in]         - base address of the USART peripheral
+ * @param[in]         - baud rate
+ *
+ * @return            - USART_BAUD_OK, otherwise the baud rate is left unchanged
+ *
+ * @Note              - USART_BAUD_TOLERANCE_DEFAULT applies. Call it while the USART is idle,
+ * 						UE is dropped while OVER8 and BRR are changed
 
-   }
+ */
+uint8_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate)
+{
+	USART_Baud_t baud;
+	uint8_t status;
 
-  //Place the fractional part in appropriate bit position . refer USART_BRR
-  tempreg |= F_part;
+	status = USART_ComputeBaud(USART_GetPCLK(pUSARTx),BaudRate,0,&baud);
+	if(status == USART_BAUD_OK)
+	{
+		usart_apply_baud(pUSARTx,&baud);
+	}
 
-  //copy the value of tempreg in to BRR register
-  pUSARTx->BRR = tempreg;
+	return status;
 }
 
+
 /*********************************************************************
  * @fn      		  - USART_Init
  *
- * @brief             -
+ * @brief             - configures the USART as per the handle configuration
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - USART handle
  *
- * @return            -
+ * @return            - USART_BAUD_OK, or the USART_BAUD_ERR_xxx of USART_ComputeBaud
  *
- * @Note              -
+ * @Note              - The baud rate is checked first : a configuration the APB clock can not
+ * 						produce within USART_BaudTolerance is refused and the registers are not
+ * 						touched. The achieved baud rate and its error are left in pUSARTHandle->Baud
 
  */
-void USART_Init(USART_Handle_t *pUSARTHandle)
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle)
 {
 
 	//Temporary variable
 	uint32_t tempreg=0;
-
-/******************************** Configuration of CR1******************************************/
+	uint8_t status;
 
 	//Implement the code to enable the Clock for given USART peripheral
 	 USART_PeriClockControl(pUSARTHandle->pUSARTx,ENABLE);
 
+	//BRR and OVER8 for the live APB clock, refuse what is out of tolerance
+	status = USART_ComputeBaud(USART_GetPCLK(pUSARTHandle->pUSARTx),pUSARTHandle->USART_Config.USART_Baud,
+			pUSARTHandle->USART_Config.USART_BaudTolerance,&pUSARTHandle->Baud);
+	if(status != USART_BAUD_OK)
+	{
+		return status;
+	}
+
+/******************************** Configuration of CR1******************************************/
+
 	//Enable USART Tx and Rx engines according to the USART_Mode configuration item
 	if ( pUSARTHandle->USART_Config.USART_Mode == USART_MODE_ONLY_RX)
 	{
@@ -185,9 +252,9 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 /******************************** Configuration of BRR(Baudrate register)******************************************/
 
 	//Implement the code to configure the baud rate
-	//We will cover this in the lecture. No action required here
-	USART_SetBaudRate(pUSARTHandle->pUSARTx,pUSARTHandle->USART_Config.USART_Baud);
+	usart_apply_baud(pUSARTHandle->pUSARTx,&pUSARTHandle->Baud);
 
+	return USART_BAUD_OK;
 }
 
 
@@ -222,17 +289,16 @@ void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t Cmd)
 
 
 /*********************************************************************
- * @fn      		  - I2C_PeriClockControl
+ * @fn      		  - USART_PeriClockControl
  *
- * @brief             -
+ * @brief             - This function enables or disables peripheral clock for the given USART
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - base address of the USART peripheral
+ * @param[in]         - ENABLE or DISABLE macros
  *
- * @return            -
+ * @return            - none
  *
- * @Note              -
+ * @Note              - none
 
  */
 void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
@@ -253,10 +319,39 @@ void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
 		{
 			UART4_PCCK_EN();
 		}
+		else if (pUSARTx == UART5)
+		{
+			UART5_PCCK_EN();
+		}
+		else if (pUSARTx == USART6)
+		{
+			USART6_PCCK_EN();
+		}
 	}
 	else
 	{
-		//TODO
+		if(pUSARTx == USART1)
+		{
+			USART1_PCCK_DI();
+		}else if (pUSARTx == USART2)
+		{
+			USART2_PCCK_DI();
+		}else if (pUSARTx == USART3)
+		{
+			USART3_PCCK_DI();
+		}
+		else if (pUSARTx == UART4)
+		{
+			UART4_PCCK_DI();
+		}
+		else if (pUSARTx == UART5)
+		{
+			UART5_PCCK_DI();
+		}
+		else if (pUSARTx == USART6)
+		{
+			USART6_PCCK_DI();
+		}
 	}
 
 }
@@ -495,6 +590,385 @@ uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uin
 }
 
 
+/*********************************************************************
+ * @fn      		  - USART_ReceiveStreamDMA
+ *
+ * @brief             - starts continuous reception in to a circular DMA buffer
+ *
+ * @param[in]         - USART handle, pDMARx must point to the Rx stream of this USART
+ * @param[in]         - stream descriptor with pBuffer and Len filled in
+ *
+ * @return            - state of the Rx side before the call, USART_READY means reception is started
+ *
+ * @Note              - Reception is never re-armed. The bytes received so far are handed over with
+ * 						USART_EVENT_RX_CHUNK (pChunk/ChunkLen) when the DMA passes the half and the
+ * 						end of the buffer and when the line goes idle, followed by USART_EVENT_IDLE in
+ * 						the last case. A chunk is a view in to pBuffer, not a copy : it stays valid
+ * 						until the DMA has written about Len/2 more bytes. Data crossing the end of the
+ * 						buffer comes as two chunks.
+ * 						The USART and the DMA stream interrupts must have the same priority.
+ * 						One byte per frame : with parity the parity bit is not masked off
+
+ */
+uint8_t USART_ReceiveStreamDMA(USART_Handle_t *pUSARTHandle, USART_RxStream_t *pRxStream)
+{
+	uint8_t rxstate = pUSARTHandle->RxBusyState;
+	DMA_Handle_t *pDMAHandle = pUSARTHandle->pDMARx;
+
+	if(rxstate != USART_BUSY_IN_RX)
+	{
+		//1. nothing is handed over yet, the DMA fills the buffer from its start
+		pRxStream->Tail = 0;
+		pRxStream->pChunk = NULL;
+		pRxStream->ChunkLen = 0;
+
+		pUSARTHandle->pRxStream = pRxStream;
+		pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+
+		//2. program the Rx stream : DR -> buffer, circular, interrupt at both halves and on error
+		pDMAHandle->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+		pDMAHandle->DMAConfig.DMA_PeriphDataSize = DMA_DATASIZE_BYTE;
+		pDMAHandle->DMAConfig.DMA_MemDataSize = DMA_DATASIZE_BYTE;
+		pDMAHandle->DMAConfig.DMA_MemInc = ENABLE;
+		pDMAHandle->DMAConfig.DMA_Mode = DMA_MODE_CIRCULAR;
+		pDMAHandle->DMAConfig.DMA_IntEnable = DMA_IT_HT | DMA_IT_TC | DMA_IT_TE;
+		DMA_Init(pDMAHandle);
+
+		//3. SR then DR read drops a stale byte and a stale IDLE flag
+		(void)pUSARTHandle->pUSARTx->SR;
+		(void)pUSARTHandle->pUSARTx->DR;
+
+		//4. enable the stream and then DMAR, so no request is lost
+		DMA_StartTransfer(pDMAHandle,(uint32_t)&pUSARTHandle->pUSARTx->DR,(uint32_t)pRxStream->pBuffer,pRxStream->Len);
+		pUSARTHandle->pUSARTx->CR3 |= ( 1 << USART_CR3_DMAR);
+
+		//5. IDLE closes a burst which did not reach a half of the buffer
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_IDLEIE);
+	}
+
+	return rxstate;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_StopReceiveStream
+ *
+ * @brief             - stops the continuous reception started with USART_ReceiveStreamDMA
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - bytes received but not yet handed over come with a last USART_EVENT_RX_CHUNK
+
+ */
+void USART_StopReceiveStream(USART_Handle_t *pUSARTHandle)
+{
+	if(pUSARTHandle->pRxStream == NULL)
+	{
+		return;
+	}
+
+	//NDTR is frozen from here on, and neither interrupt hands over anything any more
+	usart_rxstream_halt(pUSARTHandle);
+	DMA_ClearFlag(pUSARTHandle->pDMARx,DMA_FLAG_ALL);
+
+	usart_rxstream_flush(pUSARTHandle);
+
+	pUSARTHandle->pRxStream = NULL;
+	pUSARTHandle->RxBusyState = USART_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_RingInit
+ *
+ * @brief             - prepares an empty ring over pBuffer
+ *
+ * @param[in]         - ring
+ * @param[in]         - storage of the ring
+ * @param[in]         - size of pBuffer in bytes, a power of two
+ *
+ * @return            - USART_RING_OK or USART_RING_ERR_SIZE
+ *
+ * @Note              - the power of two size turns the index wrap in to a mask
+
+ */
+uint8_t USART_RingInit(USART_Ring_t *pRing, uint8_t *pBuffer, uint32_t Size)
+{
+	if( (Size == 0) || (Size & (Size - 1)) )
+	{
+		return USART_RING_ERR_SIZE;
+	}
+
+	pRing->pBuffer = pBuffer;
+	pRing->Size = Size;
+	pRing->Head = 0;
+	pRing->Tail = 0;
+	pRing->HighWater = 0;
+	pRing->Dropped = 0;
+
+	return USART_RING_OK;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_AttachRings
+ *
+ * @brief             - hands the transmitter and/or the receiver over to the rings
+ *
+ * @param[in]         - USART handle
+ * @param[in]         - ring drained by the TXE interrupt, NULL leaves the Tx side alone
+ * @param[in]         - ring filled by the RXNE interrupt, NULL leaves the Rx side alone
+ *
+ * @return            - USART_READY if attached, otherwise the busy state which prevented it
+ *
+ * @Note              - From here on USART_Write/USART_Read are used instead of the Send/Receive
+ * 						APIs of that side. Frames are bytes, 9 bit words without parity are not
+ * 						supported. The USART interrupt must be enabled in the NVIC
+
+ */
+uint8_t USART_AttachRings(USART_Handle_t *pUSARTHandle, USART_Ring_t *pTxRing, USART_Ring_t *pRxRing)
+{
+	if( pTxRing && (pUSARTHandle->TxBusyState == USART_BUSY_IN_TX) )
+	{
+		return USART_BUSY_IN_TX;
+	}
+
+	if( pRxRing && (pUSARTHandle->RxBusyState == USART_BUSY_IN_RX) )
+	{
+		return USART_BUSY_IN_RX;
+	}
+
+	if(pTxRing)
+	{
+		//TXEIE is set by USART_Write whenever there is something to send
+		pUSARTHandle->pTxRing = pTxRing;
+		pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
+	}
+
+	if(pRxRing)
+	{
+		pUSARTHandle->pRxRing = pRxRing;
+		pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+
+		//SR then DR read drops a stale byte and clears ORE
+		(void)pUSARTHandle->pUSARTx->SR;
+		(void)pUSARTHandle->pUSARTx->DR;
+
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_RXNEIE);
+	}
+
+	return USART_READY;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_DetachRings
+ *
+ * @brief             - gives the transmitter and the receiver back to the Send/Receive APIs
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - bytes still in the Tx ring are not sent, the rings keep their content and stats
+
+ */
+void USART_DetachRings(USART_Handle_t *pUSARTHandle)
+{
+	if(pUSARTHandle->pTxRing)
+	{
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
+		pUSARTHandle->pTxRing = NULL;
+		pUSARTHandle->TxBusyState = USART_READY;
+	}
+
+	if(pUSARTHandle->pRxRing)
+	{
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_RXNEIE);
+		pUSARTHandle->pRxRing = NULL;
+		pUSARTHandle->RxBusyState = USART_READY;
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_Write
+ *
+ * @brief             - copies data in to the Tx ring and returns, the TXE interrupt sends it
+ *
+ * @param[in]         - USART handle with a Tx ring attached
+ * @param[in]         - data to send
+ * @param[in]         - number of bytes
+ *
+ * @return            - number of bytes taken, less than Len if the ring is full
+ *
+ * @Note              - Single producer : call it from one context only (thread or one ISR).
+ * 						The bytes which do not fit are counted in Dropped
+
+ */
+uint32_t USART_Write(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pTxRing;
+	uint32_t head = pRing->Head;
+	uint32_t level = head - pRing->Tail;
+	uint32_t index = head & (pRing->Size - 1);
+	uint32_t count, first;
+
+	//1. take what fits
+	count = pRing->Size - level;
+	if(count > Len)
+	{
+		count = Len;
+	}
+
+	//2. copy up to the end of the storage, the rest to its start
+	first = pRing->Size - index;
+	if(first > count)
+	{
+		first = count;
+	}
+	memcpy(&pRing->pBuffer[index],pData,first);
+	memcpy(pRing->pBuffer,&pData[first],count - first);
+
+	//3. publish the bytes only once they are in the ring
+	COMPILER_BARRIER();
+	pRing->Head = head + count;
+
+	level += count;
+	if(level > pRing->HighWater)
+	{
+		pRing->HighWater = level;
+	}
+	pRing->Dropped += Len - count;
+
+	//4. let the TXE interrupt drain the ring, it clears TXEIE itself once the ring is empty
+	if(count)
+	{
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TXEIE);
+	}
+
+	return count;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_Read
+ *
+ * @brief             - takes received data out of the Rx ring, never waits
+ *
+ * @param[in]         - USART handle with an Rx ring attached
+ * @param[in]         - destination
+ * @param[in]         - max number of bytes
+ *
+ * @return            - number of bytes copied, 0 if nothing was received
+ *
+ * @Note              - Single consumer : call it from one context only
+
+ */
+uint32_t USART_Read(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t Len)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pRxRing;
+	uint32_t tail = pRing->Tail;
+	uint32_t index = tail & (pRing->Size - 1);
+	uint32_t count, first;
+
+	count = pRing->Head - tail;
+	if(count > Len)
+	{
+		count = Len;
+	}
+
+	//Head is read before the data, so every byte copied here is complete
+	COMPILER_BARRIER();
+
+	first = pRing->Size - index;
+	if(first > count)
+	{
+		first = count;
+	}
+	memcpy(pData,&pRing->pBuffer[index],first);
+	memcpy(&pData[first],pRing->pBuffer,count - first);
+
+	//free the space only after the copy
+	COMPILER_BARRIER();
+	pRing->Tail = tail + count;
+
+	return count;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_WriteCommit
+ *
+ * @brief             - sends bytes the caller has placed in the Tx ring storage itself
+ *
+ * @param[in]         - USART handle with a Tx ring attached
+ * @param[in]         - number of bytes written at pBuffer[(Head + i) & (Size - 1)]
+ *
+ * @return            - number of bytes committed, less than Len if that would overflow the ring
+ *
+ * @Note              - Zero copy counterpart of USART_Write for encoders which produce their
+ * 						output straight in the ring : check the free space (Size - (Head - Tail))
+ * 						first, fill it, then commit. Same single producer rule as USART_Write
+
+ */
+uint32_t USART_WriteCommit(USART_Handle_t *pUSARTHandle, uint32_t Len)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pTxRing;
+	uint32_t head = pRing->Head;
+	uint32_t level = head - pRing->Tail;
+
+	if(Len > pRing->Size - level)
+	{
+		Len = pRing->Size - level;
+	}
+
+	//the caller's stores to the storage happen before the bytes are published
+	COMPILER_BARRIER();
+	pRing->Head = head + Len;
+
+	level += Len;
+	if(level > pRing->HighWater)
+	{
+		pRing->HighWater = level;
+	}
+
+	if(Len)
+	{
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TXEIE);
+	}
+
+	return Len;
+}
+
+
+/*********************************************************************
+ * @fn      		  - USART_ReadRelease
+ *
+ * @brief             - frees bytes of the Rx ring the caller has consumed in place
+ *
+ * @param[in]         - USART handle with an Rx ring attached
+ * @param[in]         - number of bytes from Tail on, at most Head - Tail
+ *
+ * @return            - none
+ *
+ * @Note              - Zero copy counterpart of USART_Read : the bytes between Tail and Head
+ * 						belong to the consumer, it may parse and even rewrite them in
+ * 						pBuffer[(Tail + i) & (Size - 1)] before giving the space back
+
+ */
+void USART_ReadRelease(USART_Handle_t *pUSARTHandle, uint32_t Len)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pRxRing;
+
+	//done with the bytes before the ISR may overwrite them
+	COMPILER_BARRIER();
+	pRing->Tail += Len;
+}
+
+
 /*********************************************************************
  * @fn      		  - USART_ClearFlag
  *
@@ -550,7 +1024,7 @@ void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
 		else if(IRQNumber >= 64 && IRQNumber < 96 )
 		{
 			//program ISER2 register //64 to 95
-			*NVIC_ISER3 |= ( 1 << (IRQNumber % 64) );
+			*NVIC_ISER2 |= ( 1 << (IRQNumber % 64) );
 		}
 	}else
 	{
@@ -563,10 +1037,10 @@ void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
 			//program ICER1 register
 			*NVIC_ICER1 |= ( 1 << (IRQNumber % 32) );
 		}
-		else if(IRQNumber >= 6 && IRQNumber < 96 )
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
 		{
 			//program ICER2 register
-			*NVIC_ICER3 |= ( 1 << (IRQNumber % 64) );
+			*NVIC_ICER2 |= ( 1 << (IRQNumber % 64) );
 		}
 	}
 
@@ -671,7 +1145,11 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
 	{
 		//this interrupt is because of TXE
 
-		if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
+		if(pUSARTHandle->pTxRing)
+		{
+			usart_txring_txe_handle(pUSARTHandle);
+		}
+		else if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
 		{
 			//Keep sending data until Txlen reaches to zero
 			if(pUSARTHandle->TxLen > 0)
@@ -729,8 +1207,11 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
 	if(temp1 && temp2 )
 	{
 		//this interrupt is because of rxne
-		//this interrupt is because of txe
-		if(pUSARTHandle->RxBusyState == USART_BUSY_IN_RX)
+		if(pUSARTHandle->pRxRing)
+		{
+			usart_rxring_rxne_handle(pUSARTHandle);
+		}
+		else if(pUSARTHandle->RxBusyState == USART_BUSY_IN_RX)
 		{
 			//TXE is set so send data
 			if(pUSARTHandle->RxLen > 0)
@@ -837,7 +1318,14 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
 	if(temp1 && temp2)
 	{
 		//Implement the code to clear the IDLE flag. Refer to the RM to understand the clear sequence
-		temp1 = pUSARTHandle->pUSARTx->SR &= ~( 1 << USART_SR_IDLE);
+		//SR is read above, the DR read completes the sequence (the line is idle, no byte is lost)
+		(void)pUSARTHandle->pUSARTx->DR;
+
+		//the burst is over, hand over what the DMA has written since the last chunk
+		if(pUSARTHandle->pRxStream)
+		{
+			usart_rxstream_flush(pUSARTHandle);
+		}
 
 		//this interrupt is because of idle
 		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_IDLE);
@@ -846,10 +1334,10 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
 /*************************Check for Overrun detection flag ********************************************/
 
 	//Implement the code to check the status of ORE flag  in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & USART_SR_ORE;
+	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_ORE);
 
 	//Implement the code to check the status of RXNEIE  bit in the CR1
-	temp2 = pUSARTHandle->pUSARTx->CR1 & USART_CR1_RXNEIE;
+	temp2 = pUSARTHandle->pUSARTx->CR1 & ( 1 << USART_CR1_RXNEIE);
 
 
 	if(temp1  && temp2 )
@@ -904,6 +1392,45 @@ void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
 
 
 
+/*********************************************************************
+ * @fn      		  - USART_DMARxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the Rx DMA stream
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - none
+
+ */
+void USART_DMARxIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	uint8_t events = DMA_IRQHandling(pUSARTHandle->pDMARx);
+
+	if(pUSARTHandle->pRxStream == NULL)
+	{
+		return;
+	}
+
+	if(events & DMA_FLAG_TE)
+	{
+		//the hardware has disabled the stream
+		usart_rxstream_halt(pUSARTHandle);
+		pUSARTHandle->pRxStream = NULL;
+		pUSARTHandle->RxBusyState = USART_READY;
+		USART_ApplicationEventCallback(pUSARTHandle,USART_ERR_DMA);
+		return;
+	}
+
+	if(events & ( DMA_FLAG_HT | DMA_FLAG_TC ))
+	{
+		usart_rxstream_flush(pUSARTHandle);
+	}
+}
+
+
+
 /*********************************************************************
  * @fn      		  - USART_ApplicationEventCallback
  *
@@ -922,3 +1449,135 @@ __weak void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle,uint8_t
 {
 
 }
+
+
+
+//some helper function implementations
+
+static void  usart_apply_baud(USART_RegDef_t *pUSARTx, const USART_Baud_t *pBaud)
+{
+	uint32_t cr1 = pUSARTx->CR1;
+
+	pUSARTx->CR1 = cr1 & ~( 1 << USART_CR1_UE);
+
+	if(pBaud->Over8)
+	{
+		cr1 |= ( 1 << USART_CR1_OVER8);
+	}else
+	{
+		cr1 &= ~( 1 << USART_CR1_OVER8);
+	}
+
+	pUSARTx->BRR = pBaud->BRR;
+	pUSARTx->CR1 = cr1;
+}
+
+
+static void  usart_rxstream_flush(USART_Handle_t *pUSARTHandle)
+{
+	USART_RxStream_t *pRxStream = pUSARTHandle->pRxStream;
+	uint16_t head = pRxStream->Len - DMA_GetRemaining(pUSARTHandle->pDMARx);
+
+	//NDTR reloads to Len right after the last byte of a lap
+	if(head >= pRxStream->Len)
+	{
+		head = 0;
+	}
+
+	if(head < pRxStream->Tail)
+	{
+		//the DMA has wrapped, first the bytes up to the end of the buffer
+		usart_rxstream_handover(pUSARTHandle,pRxStream->Len - pRxStream->Tail);
+	}
+
+	if(head > pRxStream->Tail)
+	{
+		usart_rxstream_handover(pUSARTHandle,head - pRxStream->Tail);
+	}
+}
+
+
+static void  usart_rxstream_handover(USART_Handle_t *pUSARTHandle, uint16_t Len)
+{
+	USART_RxStream_t *pRxStream = pUSARTHandle->pRxStream;
+
+	pRxStream->pChunk = pRxStream->pBuffer + pRxStream->Tail;
+	pRxStream->ChunkLen = Len;
+
+	pRxStream->Tail += Len;
+	if(pRxStream->Tail == pRxStream->Len)
+	{
+		pRxStream->Tail = 0;
+	}
+
+	USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_RX_CHUNK);
+}
+
+
+static void  usart_rxstream_halt(USART_Handle_t *pUSARTHandle)
+{
+	pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_IDLEIE);
+	pUSARTHandle->pUSARTx->CR3 &= ~( 1 << USART_CR3_DMAR);
+	DMA_StopTransfer(pUSARTHandle->pDMARx);
+}
+
+
+static void  usart_txring_txe_handle(USART_Handle_t *pUSARTHandle)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pTxRing;
+	uint32_t tail = pRing->Tail;
+
+	if(pRing->Head == tail)
+	{
+		//ring is empty, USART_Write sets TXEIE again with the next data
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
+		return;
+	}
+
+	pUSARTHandle->pUSARTx->DR = pRing->pBuffer[tail & (pRing->Size - 1)];
+
+	COMPILER_BARRIER();
+	pRing->Tail = tail + 1;
+}
+
+
+static void  usart_rxring_rxne_handle(USART_Handle_t *pUSARTHandle)
+{
+	USART_Ring_t *pRing = pUSARTHandle->pRxRing;
+	uint32_t head = pRing->Head;
+	uint32_t level = head - pRing->Tail;
+	uint32_t sr = pUSARTHandle->pUSARTx->SR;
+	uint8_t data;
+
+	//SR then DR read also clears ORE
+	data = (uint8_t)pUSARTHandle->pUSARTx->DR;
+
+	//8 bit words with parity carry 7 bits of data
+	if( (pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_8BITS) &&
+		(pUSARTHandle->USART_Config.USART_ParityControl != USART_PARITY_DISABLE) )
+	{
+		data &= 0x7F;
+	}
+
+	if(sr & ( 1 << USART_SR_ORE))
+	{
+		//at least one byte was lost in the shift register
+		pRing->Dropped++;
+	}
+
+	if(level == pRing->Size)
+	{
+		pRing->Dropped++;
+		return;
+	}
+
+	pRing->pBuffer[head & (pRing->Size - 1)] = data;
+
+	COMPILER_BARRIER();
+	pRing->Head = head + 1;
+
+	if(level + 1 > pRing->HighWater)
+	{
+		pRing->HighWater = level + 1;
+	}
+}
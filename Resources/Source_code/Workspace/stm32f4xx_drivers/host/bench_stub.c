@@ -0,0 +1,19 @@
+/*
+ * bench_stub.c
+ *
+ * What the applications take from the target run time, for their host build (make bench) :
+ * semihosting needs no set up, and the run ends once the application idles in its while(1);
+ */
+
+#include "mcu_model.h"
+
+#define BENCH_IDLE_CYCLES	4000000
+
+void initialise_monitor_handles(void)
+{
+}
+
+__attribute__((constructor)) static void bench_init(void)
+{
+	model_exit_when_idle(BENCH_IDLE_CYCLES);
+}
@@ -0,0 +1,317 @@
+/*
+ * cobs_test.c
+ *
+ * COBS framing tests on the host (make -C host test)
+ *
+ * USART2 with a Tx and an Rx ring attached, no interrupts : the test is the wire, it moves
+ * the bytes cobs_send committed to the Tx ring in to the Rx ring, a few at a time, and calls
+ * cobs_poll after each chunk. Its register accesses (CR1, SR, DR) land in plain memory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "stm32f407xx.h"
+#include "mcu_model.h"
+#include "cobs.h"
+
+#define TEST_RING_SIZE		512			/* holds the largest encoded frame tested, and then some */
+#define TEST_FRAMES_MAX		4
+#define TEST_PAYLOAD_MAX	300
+#define TEST_CHUNK			7			/* bytes per wire transfer, frames arrive in pieces */
+#define TEST_NO_CORRUPT		0xFFFFFFFF
+
+#define CHECK(cond)		do{ if(!(cond)) { printf("  FAIL %s:%d: %s\n",__func__,__LINE__,#cond); Failures++; } }while(0)
+
+USART_Handle_t USART2handle;
+USART_Ring_t TxRing;
+USART_Ring_t RxRing;
+COBS_Link_t Link;
+
+static uint8_t TxStorage[TEST_RING_SIZE];
+static uint8_t RxStorage[TEST_RING_SIZE];
+static uint8_t FrameBuff[TEST_PAYLOAD_MAX];
+
+static uint8_t Payload[TEST_PAYLOAD_MAX];
+
+//what cobs_frame_callback got
+static uint32_t RxCount;
+static uint32_t RxLen[TEST_FRAMES_MAX];
+static uint8_t RxData[TEST_FRAMES_MAX][TEST_PAYLOAD_MAX];
+static uint8_t RxFromFrame[TEST_FRAMES_MAX];
+
+static uint32_t Failures;
+
+
+/*
+ * Start is where both rings begin counting, to put a frame across the end of the storage
+ */
+static void test_setup(uint32_t Start, uint8_t *pFrame, uint32_t FrameSize)
+{
+	model_reset();
+
+	memset(&USART2handle,0,sizeof(USART2handle));
+	memset(TxStorage,0,sizeof(TxStorage));
+	memset(RxStorage,0,sizeof(RxStorage));
+
+	RxCount = 0;
+
+	USART2handle.pUSARTx = USART2;
+
+	USART_RingInit(&TxRing,TxStorage,sizeof(TxStorage));
+	USART_RingInit(&RxRing,RxStorage,sizeof(RxStorage));
+	TxRing.Head = TxRing.Tail = Start;
+	RxRing.Head = RxRing.Tail = Start;
+
+	USART_AttachRings(&USART2handle,&TxRing,&RxRing);
+
+	cobs_init(&Link,&USART2handle,pFrame,FrameSize);
+}
+
+
+/*
+ * moves everything queued in the Tx ring to the Rx ring, TEST_CHUNK bytes at a time with a
+ * cobs_poll after each. Byte number Corrupt (counted from the first byte moved) is xor'ed
+ * with Xor on the way
+ */
+static void test_wire(uint32_t Corrupt, uint8_t Xor)
+{
+	uint32_t moved = 0;
+	uint8_t byte;
+
+	while(TxRing.Head != TxRing.Tail)
+	{
+		for(uint8_t i = 0 ; (i < TEST_CHUNK) && (TxRing.Head != TxRing.Tail) ; i++)
+		{
+			byte = TxRing.pBuffer[TxRing.Tail++ & (TxRing.Size - 1)];
+
+			if(moved++ == Corrupt)
+			{
+				byte ^= Xor;
+			}
+
+			//the Rx ring never fills here, cobs_poll releases every frame it ends
+			RxRing.pBuffer[RxRing.Head & (RxRing.Size - 1)] = byte;
+			RxRing.Head++;
+		}
+
+		cobs_poll(&Link);
+	}
+}
+
+
+static void test_fill(uint32_t Len, uint8_t Seed)
+{
+	for(uint32_t i = 0 ; i < Len ; i++)
+	{
+		//a 0x00 every 256 bytes, the first one at i = 73 for Seed 1
+		Payload[i] = (uint8_t)(i * 7 + Seed);
+	}
+}
+
+
+static uint8_t test_received(uint32_t Index, uint32_t Len)
+{
+	return (Index < RxCount) && (RxLen[Index] == Len) && (memcmp(RxData[Index],Payload,Len) == 0);
+}
+
+
+/*
+ * 253, 254 and 255 put the payload with its CRC either side of a full 254 byte block
+ */
+static void test_lengths(void)
+{
+	static const uint32_t Lengths[] = { 0, 1, 73, 74, 252, 253, 254, 255 };
+
+	for(uint8_t i = 0 ; i < sizeof(Lengths) / sizeof(Lengths[0]) ; i++)
+	{
+		test_setup(0,NULL,0);
+		test_fill(Lengths[i],1);
+
+		CHECK(cobs_send(&Link,Payload,Lengths[i]) == COBS_OK);
+		CHECK(TxRing.Head - TxRing.Tail <= COBS_ENCODED_MAX(Lengths[i]));
+		test_wire(TEST_NO_CORRUPT,0);
+
+		CHECK(Link.Frames == 1);
+		CHECK(test_received(0,Lengths[i]));
+		CHECK(Link.CRCErrors == 0 && Link.FormatErrors == 0 && Link.Oversize == 0);
+		CHECK(RxRing.Tail == RxRing.Head);
+	}
+}
+
+
+static void test_all_zero(void)
+{
+	static const uint32_t Lengths[] = { 1, 2, 254, 255 };
+
+	for(uint8_t i = 0 ; i < sizeof(Lengths) / sizeof(Lengths[0]) ; i++)
+	{
+		test_setup(0,NULL,0);
+		memset(Payload,0x00,Lengths[i]);
+
+		CHECK(cobs_send(&Link,Payload,Lengths[i]) == COBS_OK);
+
+		//a code byte per 0x00, none of them 0x00 : the delimiter is the only one on the wire
+		for(uint32_t n = TxRing.Tail ; n != TxRing.Head - 1 ; n++)
+		{
+			CHECK(TxRing.pBuffer[n & (TxRing.Size - 1)] != 0x00);
+		}
+		test_wire(TEST_NO_CORRUPT,0);
+
+		CHECK(Link.Frames == 1);
+		CHECK(test_received(0,Lengths[i]));
+	}
+}
+
+
+static void test_zero_free(void)
+{
+	static const uint32_t Lengths[] = { 253, 254, 255 };
+
+	for(uint8_t i = 0 ; i < sizeof(Lengths) / sizeof(Lengths[0]) ; i++)
+	{
+		test_setup(0,NULL,0);
+		for(uint32_t n = 0 ; n < Lengths[i] ; n++)
+		{
+			Payload[n] = (uint8_t)(n % 255 + 1);
+		}
+
+		CHECK(cobs_send(&Link,Payload,Lengths[i]) == COBS_OK);
+
+		//the first block is full : code 0xFF, 254 data bytes, no 0x00 implied after them
+		CHECK(TxRing.pBuffer[TxRing.Tail & (TxRing.Size - 1)] == 0xFF);
+		test_wire(TEST_NO_CORRUPT,0);
+
+		CHECK(Link.Frames == 1);
+		CHECK(test_received(0,Lengths[i]));
+	}
+}
+
+
+/*
+ * both rings start 20 bytes before the end of the storage, and before the 32 bit counters
+ * wrap : the frame runs across both
+ */
+static void test_wrap(void)
+{
+	test_setup(0U - 20,FrameBuff,sizeof(FrameBuff));
+	test_fill(100,3);
+
+	CHECK(cobs_send(&Link,Payload,100) == COBS_OK);
+	test_wire(TEST_NO_CORRUPT,0);
+
+	CHECK(Link.Frames == 1);
+	CHECK(test_received(0,100));
+	CHECK(RxFromFrame[0] == SET);
+
+	//the next frame starts at the front of the storage again, decoded in place
+	test_fill(50,5);
+	CHECK(cobs_send(&Link,Payload,50) == COBS_OK);
+	test_wire(TEST_NO_CORRUPT,0);
+
+	CHECK(Link.Frames == 2);
+	CHECK(test_received(1,50));
+	CHECK(RxFromFrame[1] == RESET);
+
+	//no pFrame : a wrapped frame is dropped, the link goes on
+	test_setup(0U - 20,NULL,0);
+	test_fill(100,3);
+
+	CHECK(cobs_send(&Link,Payload,100) == COBS_OK);
+	test_fill(50,5);
+	CHECK(cobs_send(&Link,Payload,50) == COBS_OK);
+	test_wire(TEST_NO_CORRUPT,0);
+
+	CHECK(Link.Oversize == 1);
+	CHECK(Link.Frames == 1);
+	CHECK(test_received(0,50));
+}
+
+
+/*
+ * three frames, the middle one damaged on the wire : the first and the last still come in
+ */
+static void test_corrupt(void)
+{
+	uint32_t first;
+
+	//a data byte changed : CRC error
+	test_setup(0,NULL,0);
+	test_fill(40,1);
+	CHECK(cobs_send(&Link,Payload,40) == COBS_OK);
+	first = TxRing.Head - TxRing.Tail;
+	CHECK(cobs_send(&Link,Payload,40) == COBS_OK);
+	CHECK(cobs_send(&Link,Payload,40) == COBS_OK);
+	test_wire(first + 10,0x5A);
+
+	CHECK(Link.Frames == 2);
+	CHECK(Link.CRCErrors == 1);
+	CHECK(Link.FormatErrors == 0);
+	CHECK(test_received(0,40) && test_received(1,40));
+
+	//a data byte turned in to a delimiter : the frame is cut in two, both halves rejected
+	test_setup(0,NULL,0);
+	test_fill(100,1);
+	CHECK(cobs_send(&Link,Payload,100) == COBS_OK);
+	first = TxRing.Head - TxRing.Tail;
+	CHECK(cobs_send(&Link,Payload,100) == COBS_OK);
+	CHECK(cobs_send(&Link,Payload,100) == COBS_OK);
+	test_wire(first + 30,TxRing.pBuffer[(TxRing.Tail + first + 30) & (TxRing.Size - 1)]);
+
+	CHECK(Link.Frames == 2);
+	CHECK(Link.CRCErrors + Link.FormatErrors >= 1);
+	CHECK(test_received(0,100) && test_received(1,100));
+	CHECK(RxRing.Tail == RxRing.Head);
+}
+
+
+static void test_tx_full(void)
+{
+	test_setup(0,NULL,0);
+	test_fill(255,1);
+
+	CHECK(cobs_send(&Link,Payload,255) == COBS_OK);
+	CHECK(cobs_send(&Link,Payload,255) == COBS_ERR_FULL);
+	CHECK(Link.TxFull == 1);
+
+	//nothing of the refused frame went out
+	test_wire(TEST_NO_CORRUPT,0);
+	CHECK(Link.Frames == 1);
+	CHECK(test_received(0,255));
+}
+
+
+int main(void)
+{
+	static void (*const Tests[])(void) =
+	{
+		test_lengths,
+		test_all_zero,
+		test_zero_free,
+		test_wrap,
+		test_corrupt,
+		test_tx_full,
+	};
+
+	setvbuf(stdout,NULL,_IONBF,0);
+
+	for(uint8_t i = 0 ; i < sizeof(Tests) / sizeof(Tests[0]) ; i++)
+	{
+		Tests[i]();
+	}
+
+	printf("cobs_test: %u failure(s)\n",Failures);
+
+	return Failures ? 1 : 0;
+}
+
+
+void cobs_frame_callback(COBS_Link_t *pLink, uint8_t *pPayload, uint32_t Len)
+{
+	if(RxCount < TEST_FRAMES_MAX && Len <= TEST_PAYLOAD_MAX)
+	{
+		RxLen[RxCount] = Len;
+		RxFromFrame[RxCount] = (pPayload == FrameBuff);
+		memcpy(RxData[RxCount],pPayload,Len);
+	}
+	RxCount++;
+}
@@ -0,0 +1,24 @@
+/*
+ * host_cpu.h
+ *
+ * Forced in to every file of the host build (-include host_cpu.h) ahead of stm32f407xx.h.
+ * Replaces the Cortex-M4 specific pieces of stm32f407xx.h with calls in to the register
+ * model, everything else (register maps, drivers, applications) is compiled unchanged.
+ */
+
+#ifndef HOST_CPU_H_
+#define HOST_CPU_H_
+
+#include <stdint.h>
+
+/*
+ * PRIMASK of the modelled core : IRQ_LOCK masks the model interrupts, IRQ_UNLOCK takes
+ * the interrupts which became pending meanwhile
+ */
+uint32_t model_irq_lock(void);
+void model_irq_unlock(uint32_t primask);
+
+#define IRQ_LOCK(primask)	do{ (primask) = model_irq_lock(); }while(0)
+#define IRQ_UNLOCK(primask)	model_irq_unlock(primask)
+
+#endif /* HOST_CPU_H_ */
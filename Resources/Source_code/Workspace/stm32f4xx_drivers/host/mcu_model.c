@@ -0,0 +1,1355 @@
+/*
+ * mcu_model.c
+ *
+ * Register level model of SPI, DMA, NVIC and DWT for the host build, see mcu_model.h
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "mcu_model.h"
+
+#define PERIPH_SIZE			0x80000U
+#define CORE_BASEADDR		0xE0000000U
+#define CORE_SIZE			0x100000U
+#define MODEL_PAGE_SIZE		0x1000U
+#define EFLAGS_TF			0x100
+
+#define SPI_COUNT			3
+#define SPI_REG_SPAN		0x24U
+#define DMA_REG_SPAN		0xD0U
+#define DMA_STREAM_SPAN		0x18U
+#define NULL_PAGE_END		0x10000U
+
+#define MODEL_STORM_MAX		(1U << 24)
+#define MODEL_SPIN_NS		500000		/* thread CPU time without a register access which counts as spinning */
+
+#define NVIC_ISER_ADDR		0xE000E100U
+#define NVIC_ICER_ADDR		0xE000E180U
+#define DWT_CYCCNT_ADDR		0xE0001004U
+
+//stream flags, same layout as one group of LISR/HISR
+#define DMA_FEIF			( 1 << 0)
+#define DMA_DMEIF			( 1 << 2)
+#define DMA_TEIF			( 1 << DMA_ISR_TEIF)
+#define DMA_HTIF			( 1 << DMA_ISR_HTIF)
+#define DMA_TCIF			( 1 << DMA_ISR_TCIF)
+#define DMA_FLAGS			( DMA_FEIF | DMA_DMEIF | DMA_TEIF | DMA_HTIF | DMA_TCIF )
+
+//SPI CR1 bits which must not change while SPE=1
+#define SPI_CR1_CONFIG		( ( 1 << SPI_CR1_CPHA) | ( 1 << SPI_CR1_CPOL) | ( 1 << SPI_CR1_MSTR) | ( 0x7 << SPI_CR1_BR) | \
+							  ( 1 << SPI_CR1_LSBFIRST) | ( 1 << SPI_CR1_RXONLY) | ( 1 << SPI_CR1_DFF) | \
+							  ( 1 << SPI_CR1_CRCEN) | ( 1 << SPI_CR1_BIDIMODE) )
+
+/*
+ * pages whose registers have side effects, every access to them traps
+ * (SPI2/SPI3, SPI1 with SYSCFG/EXTI, DMA1/DMA2, DWT, NVIC)
+ */
+static const uint32_t TrapPages[] = { 0x40003000U, 0x40013000U, 0x40026000U, 0xE0001000U, 0xE000E000U };
+#define TRAP_PAGES			( sizeof(TrapPages) / sizeof(TrapPages[0]) )
+
+typedef struct
+{
+	uint32_t			Base;
+	uint8_t				IRQNumber;
+	model_spi_device_t	Device;
+	void				*pContext;
+	GPIO_RegDef_t		*pCSPort[MODEL_CS_MAX];
+	uint8_t				CSPin[MODEL_CS_MAX];
+	uint16_t			TxBuf;			/* TX buffer, TXE = !TxFull */
+	uint8_t				TxFull;
+	uint8_t				Shifting;		/* shift register busy till ShiftEnd */
+	uint8_t				ShiftCrc;		/* the frame shifting is the CRC */
+	uint16_t			Shift;
+	uint64_t			ShiftEnd;
+	uint16_t			RxBuf;			/* RX buffer, read through DR */
+	uint8_t				Rxne;
+	uint8_t				Ovr;
+	uint8_t				OvrDRRead;		/* DR read while OVR, the next SR read clears OVR */
+	uint8_t				CrcErr;
+	uint8_t				CrcNext;		/* CRC frame due once the TX buffer is empty */
+	uint16_t			TxCrc;
+	uint16_t			RxCrc;
+	model_spi_stats_t	Stats;
+}spi_model_t;
+
+typedef struct
+{
+	uint8_t		Flags;
+	uint8_t		IRQNumber;
+	uint16_t	Ndtr;
+	uint16_t	NdtrInit;
+	uint32_t	Offset;				/* bytes moved from the current memory base */
+	uint64_t	BusyUntil;			/* next data item not before this cycle */
+}dma_stream_model_t;
+
+/*
+ * DMA request mapping of the SPI peripherals (RM0090 table 42/43)
+ */
+typedef struct
+{
+	uint8_t Dma;
+	uint8_t Stream;
+	uint8_t Channel;
+	uint8_t Spi;
+	uint8_t Tx;
+}dma_map_t;
+
+static const dma_map_t DmaMap[] =
+{
+	{ 1, 3, 0, 1, 0 }, { 1, 4, 0, 1, 1 },									/* SPI2 */
+	{ 1, 0, 0, 2, 0 }, { 1, 2, 0, 2, 0 }, { 1, 5, 0, 2, 1 }, { 1, 7, 0, 2, 1 },	/* SPI3 */
+	{ 2, 0, 3, 0, 0 }, { 2, 2, 3, 0, 0 }, { 2, 3, 3, 0, 1 }, { 2, 5, 3, 0, 1 },	/* SPI1 */
+};
+
+static const uint8_t DmaFlagOffset[4] = { 0, 6, 16, 22 };
+static const uint8_t DmaIRQ[2][8] =
+{
+	{ IRQ_NO_DMA1_STREAM0, IRQ_NO_DMA1_STREAM1, IRQ_NO_DMA1_STREAM2, IRQ_NO_DMA1_STREAM3,
+	  IRQ_NO_DMA1_STREAM4, IRQ_NO_DMA1_STREAM5, IRQ_NO_DMA1_STREAM6, IRQ_NO_DMA1_STREAM7 },
+	{ IRQ_NO_DMA2_STREAM0, IRQ_NO_DMA2_STREAM1, IRQ_NO_DMA2_STREAM2, IRQ_NO_DMA2_STREAM3,
+	  IRQ_NO_DMA2_STREAM4, IRQ_NO_DMA2_STREAM5, IRQ_NO_DMA2_STREAM6, IRQ_NO_DMA2_STREAM7 },
+};
+
+/*
+ * the access being single stepped
+ */
+typedef struct
+{
+	int8_t		Page;			/* -1 : no access in flight */
+	uint8_t		Write;
+	uint8_t		AlrmBlocked;
+	uint32_t	Addr;
+	uint32_t	Old;
+}model_step_t;
+
+/*
+ * vector table, the application (or test) provides the handlers it enables
+ */
+void SPI1_IRQHandler(void) __attribute__((weak));
+void SPI2_IRQHandler(void) __attribute__((weak));
+void SPI3_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream0_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream1_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream2_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream3_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream4_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream5_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream6_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream7_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream0_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream1_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream2_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream3_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream4_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream5_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream6_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream7_IRQHandler(void) __attribute__((weak));
+
+static uint8_t *PeriphAlias;
+static uint8_t *CoreAlias;
+
+static __vo uint64_t Now;
+static uint64_t CycOffset;
+static uint64_t LastActivity;
+static uint64_t IdleExit;
+
+static __vo uint32_t Primask;
+static __vo uint8_t InISR;
+static uint64_t SpinStart;
+
+static model_step_t Step = { -1, 0, 0, 0, 0 };
+
+static spi_model_t Spi[SPI_COUNT];
+static dma_stream_model_t Dma[2][8];
+static model_dma_stats_t DmaStats;
+static uint32_t NvicEn[3];
+static model_irq_stats_t IRQStats[96];
+
+static model_log_t Log[MODEL_LOG_MAX];
+static uint32_t LogCount;
+
+static void model_advance(uint64_t Target, uint8_t StopOnIRQ);
+static uint8_t model_dispatch(void);
+static void model_sync(void);
+
+
+//some helper function implementations
+
+static uint64_t model_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+	return (uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec;
+}
+
+
+static __vo uint32_t *model_reg(uint32_t Addr)
+{
+	if(Addr >= CORE_BASEADDR)
+	{
+		return (__vo uint32_t*)(CoreAlias + (Addr - CORE_BASEADDR));
+	}
+	return (__vo uint32_t*)(PeriphAlias + (Addr - PERIPH_BASEADDR));
+}
+
+
+static SPI_RegDef_t *spi_regs(spi_model_t *s)
+{
+	return (SPI_RegDef_t*)model_reg(s->Base);
+}
+
+
+static DMA_RegDef_t *dma_regs(uint8_t Ctrl)
+{
+	return (DMA_RegDef_t*)model_reg(Ctrl ? DMA2_BASEADDR : DMA1_BASEADDR);
+}
+
+
+static spi_model_t *spi_of(SPI_RegDef_t *pSPIx)
+{
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		if(Spi[i].Base == (uint32_t)(uintptr_t)pSPIx)
+		{
+			return &Spi[i];
+		}
+	}
+
+	fprintf(stderr,"model: %p is not an SPI\n",(void*)pSPIx);
+	abort();
+}
+
+
+static uint8_t spi_enabled(spi_model_t *s)
+{
+	uint32_t cr1 = spi_regs(s)->CR1;
+
+	return ( (cr1 & ( 1 << SPI_CR1_SPE)) && (cr1 & ( 1 << SPI_CR1_MSTR)) );
+}
+
+
+static uint8_t spi_busy(spi_model_t *s)
+{
+	return spi_enabled(s) && (s->Shifting || s->TxFull);
+}
+
+
+static uint32_t spi_frame_cycles(spi_model_t *s)
+{
+	uint32_t cr1 = spi_regs(s)->CR1;
+	uint32_t bits = (cr1 & ( 1 << SPI_CR1_DFF)) ? 16 : 8;
+
+	//fPCLK / 2^(BR+1), both clocks are HSI after reset
+	return bits * ( 2U << ( (cr1 >> SPI_CR1_BR) & 0x7) );
+}
+
+
+static uint16_t spi_crc(spi_model_t *s, uint16_t Crc, uint16_t Data)
+{
+	SPI_RegDef_t *r = spi_regs(s);
+	uint8_t bits = (r->CR1 & ( 1 << SPI_CR1_DFF)) ? 16 : 8;
+	uint16_t poly = (uint16_t)r->CRCPR;
+	uint16_t msb = (uint16_t)( 1U << (bits - 1) );
+	uint16_t mask = (bits == 16) ? 0xFFFF : 0xFF;
+
+	//MSB first, initial value 0, as the hardware CRC unit
+	for(int8_t i = bits - 1 ; i >= 0 ; i--)
+	{
+		uint8_t fb = ( (Crc & msb) ? 1 : 0 ) ^ ( (Data >> i) & 1 );
+		Crc = (uint16_t)( (Crc << 1) & mask );
+		if(fb)
+		{
+			Crc ^= poly;
+		}
+	}
+	return Crc & mask;
+}
+
+
+static void spi_sample_cs(spi_model_t *s)
+{
+	uint8_t low = 0, index = 0;
+
+	for(uint8_t i = 0 ; i < MODEL_CS_MAX ; i++)
+	{
+		if(s->pCSPort[i] && !( s->pCSPort[i]->ODR & ( 1 << s->CSPin[i]) ))
+		{
+			low++;
+			index = i;
+		}
+	}
+
+	if( (s->pCSPort[0] == NULL) && (s->pCSPort[1] == NULL) && (s->pCSPort[2] == NULL) && (s->pCSPort[3] == NULL) )
+	{
+		return;
+	}
+
+	if(low == 1)
+	{
+		s->Stats.CSFrames[index]++;
+	}else
+	{
+		s->Stats.CSErrors++;
+	}
+}
+
+
+static void spi_start_frame(spi_model_t *s)
+{
+	SPI_RegDef_t *r = spi_regs(s);
+
+	if(s->TxFull)
+	{
+		s->Shift = s->TxBuf;
+		s->TxFull = 0;
+		s->ShiftCrc = 0;
+		if(r->CR1 & ( 1 << SPI_CR1_CRCEN))
+		{
+			s->TxCrc = spi_crc(s,s->TxCrc,s->Shift);
+		}
+	}else
+	{
+		//CRCNEXT with an empty TX buffer : the CRC follows the last data frame
+		s->Shift = s->TxCrc;
+		s->ShiftCrc = 1;
+		s->CrcNext = 0;
+		r->CR1 &= ~( 1 << SPI_CR1_CRCNEXT);
+	}
+
+	s->Shifting = 1;
+	s->ShiftEnd = Now + spi_frame_cycles(s);
+	spi_sample_cs(s);
+}
+
+
+static void spi_end_frame(spi_model_t *s)
+{
+	SPI_RegDef_t *r = spi_regs(s);
+	uint16_t mask = (r->CR1 & ( 1 << SPI_CR1_DFF)) ? 0xFFFF : 0xFF;
+	uint16_t miso = s->Shift;
+
+	s->Shifting = 0;
+
+	if(s->Device)
+	{
+		miso = s->Device((SPI_RegDef_t*)(uintptr_t)s->Base,s->Shift,s->ShiftCrc,s->pContext);
+	}
+	miso &= mask;
+
+	if(s->ShiftCrc)
+	{
+		s->Stats.CRCFrames++;
+		if(miso != s->RxCrc)
+		{
+			s->CrcErr = 1;
+		}
+	}else if(r->CR1 & ( 1 << SPI_CR1_CRCEN))
+	{
+		s->RxCrc = spi_crc(s,s->RxCrc,miso);
+	}
+
+	//while OVR is set nothing new reaches DR
+	if(s->Rxne || s->Ovr)
+	{
+		s->Ovr = 1;
+		s->Stats.Overruns++;
+	}else
+	{
+		s->RxBuf = miso;
+		s->Rxne = 1;
+	}
+
+	s->Stats.Frames++;
+	s->Stats.LastFrameEnd = Now;
+}
+
+
+static void spi_dr_write(spi_model_t *s, uint32_t Value)
+{
+	uint16_t mask = (spi_regs(s)->CR1 & ( 1 << SPI_CR1_DFF)) ? 0xFFFF : 0xFF;
+
+	if(s->TxFull)
+	{
+		s->Stats.DRWhileFull++;
+	}
+	s->TxBuf = (uint16_t)(Value & mask);
+	s->TxFull = 1;
+}
+
+
+static uint16_t spi_dr_read(spi_model_t *s)
+{
+	s->Rxne = 0;
+	if(s->Ovr)
+	{
+		s->OvrDRRead = 1;
+	}
+	return s->RxBuf;
+}
+
+
+static uint8_t spi_irq_line(spi_model_t *s)
+{
+	uint32_t cr2 = spi_regs(s)->CR2;
+
+	if( !s->TxFull && (cr2 & ( 1 << SPI_CR2_TXEIE)) )
+	{
+		return 1;
+	}
+	if( s->Rxne && (cr2 & ( 1 << SPI_CR2_RXNEIE)) )
+	{
+		return 1;
+	}
+	if( (s->Ovr || s->CrcErr) && (cr2 & ( 1 << SPI_CR2_ERRIE)) )
+	{
+		return 1;
+	}
+	return 0;
+}
+
+
+static void spi_write(spi_model_t *s, uint32_t Offset, uint32_t Old, uint32_t New)
+{
+	if(Offset == 0x00)
+	{
+		//CR1
+		if( (Old & ( 1 << SPI_CR1_SPE)) && (New & ( 1 << SPI_CR1_SPE)) && ( (Old ^ New) & SPI_CR1_CONFIG ) )
+		{
+			s->Stats.ConfigWhileOn++;
+		}
+
+		if( (Old & ( 1 << SPI_CR1_SPE)) && !(New & ( 1 << SPI_CR1_SPE)) && (s->Shifting || s->TxFull) )
+		{
+			//the frame on the wire is cut
+			s->Stats.SPEOffBusy++;
+			s->Shifting = 0;
+		}
+
+		if( (Old ^ New) & ( 1 << SPI_CR1_CRCEN) )
+		{
+			s->TxCrc = 0;
+			s->RxCrc = 0;
+		}
+
+		if( !(Old & ( 1 << SPI_CR1_CRCNEXT)) && (New & ( 1 << SPI_CR1_CRCNEXT)) )
+		{
+			s->CrcNext = 1;
+		}
+	}else if(Offset == 0x08)
+	{
+		//SR, CRCERR is cleared by writing 0
+		if( !(New & ( 1 << SPI_SR_CRCERR)) )
+		{
+			s->CrcErr = 0;
+		}
+	}else if(Offset == 0x0C)
+	{
+		spi_dr_write(s,New);
+	}
+}
+
+
+static void spi_read(spi_model_t *s, uint32_t Offset)
+{
+	if(Offset == 0x0C)
+	{
+		(void)spi_dr_read(s);
+	}else if(Offset == 0x08)
+	{
+		//OVR is cleared by a DR read followed by a SR read
+		if(s->Ovr && s->OvrDRRead)
+		{
+			s->Ovr = 0;
+			s->OvrDRRead = 0;
+		}
+	}
+}
+
+
+static const dma_map_t *dma_map(uint8_t Ctrl, uint8_t Stream)
+{
+	DMA_Stream_RegDef_t *st = &dma_regs(Ctrl)->S[Stream];
+	uint8_t channel = (st->CR >> DMA_SxCR_CHSEL) & 0x7;
+
+	for(uint8_t i = 0 ; i < sizeof(DmaMap) / sizeof(DmaMap[0]) ; i++)
+	{
+		const dma_map_t *m = &DmaMap[i];
+
+		if( (m->Dma == Ctrl + 1) && (m->Stream == Stream) && (m->Channel == channel) &&
+				(st->PAR == Spi[m->Spi].Base + 0x0C) )
+		{
+			return m;
+		}
+	}
+	return NULL;
+}
+
+
+static uint8_t dma_request(uint8_t Ctrl, uint8_t Stream)
+{
+	DMA_Stream_RegDef_t *st = &dma_regs(Ctrl)->S[Stream];
+	const dma_map_t *m;
+	spi_model_t *s;
+	uint32_t cr2;
+
+	if( !(st->CR & ( 1 << DMA_SxCR_EN)) )
+	{
+		return 0;
+	}
+
+	m = dma_map(Ctrl,Stream);
+	if(m == NULL)
+	{
+		return 0;
+	}
+
+	s = &Spi[m->Spi];
+	cr2 = spi_regs(s)->CR2;
+
+	//memory to peripheral for Tx (DIR=01), peripheral to memory for Rx (DIR=00)
+	if(m->Tx)
+	{
+		return ( ( (st->CR >> DMA_SxCR_DIR) & 0x3 ) == 1 ) && !s->TxFull && (cr2 & ( 1 << SPI_CR2_TXDMAEN));
+	}
+	return ( ( (st->CR >> DMA_SxCR_DIR) & 0x3 ) == 0 ) && s->Rxne && (cr2 & ( 1 << SPI_CR2_RXDMAEN));
+}
+
+
+static void dma_item(uint8_t Ctrl, uint8_t Stream)
+{
+	DMA_Stream_RegDef_t *st = &dma_regs(Ctrl)->S[Stream];
+	dma_stream_model_t *d = &Dma[Ctrl][Stream];
+	const dma_map_t *m = dma_map(Ctrl,Stream);
+	spi_model_t *s = &Spi[m->Spi];
+	uint32_t cr = st->CR;
+	uint8_t size = 1 << ( (cr >> DMA_SxCR_MSIZE) & 0x3 );
+	uint32_t addr = ( (cr & ( 1 << DMA_SxCR_CT)) ? st->M1AR : st->M0AR ) + d->Offset;
+	uint32_t value = 0;
+
+	d->BusyUntil = Now + MODEL_DMA_ITEM_CYCLES;
+
+	if(addr < NULL_PAGE_END)
+	{
+		//bus error : TE and the stream stops
+		DmaStats.NullAccess++;
+		d->Flags |= DMA_TEIF;
+		st->CR &= ~( 1 << DMA_SxCR_EN);
+		return;
+	}
+
+	if(m->Tx)
+	{
+		memcpy(&value,(void*)(uintptr_t)addr,size);
+		spi_dr_write(s,value);
+	}else
+	{
+		value = spi_dr_read(s);
+		memcpy((void*)(uintptr_t)addr,&value,size);
+	}
+	DmaStats.Items++;
+
+	if(cr & ( 1 << DMA_SxCR_MINC))
+	{
+		d->Offset += size;
+	}
+
+	d->Ndtr--;
+	if(d->Ndtr == d->NdtrInit / 2)
+	{
+		d->Flags |= DMA_HTIF;
+	}
+
+	if(d->Ndtr == 0)
+	{
+		d->Flags |= DMA_TCIF;
+
+		if(cr & ( 1 << DMA_SxCR_DBM))
+		{
+			st->CR ^= ( 1 << DMA_SxCR_CT);
+			d->Ndtr = d->NdtrInit;
+			d->Offset = 0;
+		}else if(cr & ( 1 << DMA_SxCR_CIRC))
+		{
+			d->Ndtr = d->NdtrInit;
+			d->Offset = 0;
+		}else
+		{
+			st->CR &= ~( 1 << DMA_SxCR_EN);
+
+			//the SPI sends its CRC after the last item of a Tx stream
+			if(m->Tx && (spi_regs(s)->CR1 & ( 1 << SPI_CR1_CRCEN)))
+			{
+				s->CrcNext = 1;
+			}
+		}
+	}
+}
+
+
+static uint8_t dma_irq_line(uint8_t Ctrl, uint8_t Stream)
+{
+	uint32_t cr = dma_regs(Ctrl)->S[Stream].CR;
+	uint8_t flags = Dma[Ctrl][Stream].Flags;
+
+	return ( (flags & DMA_TCIF) && (cr & ( 1 << DMA_SxCR_TCIE)) ) ||
+		   ( (flags & DMA_HTIF) && (cr & ( 1 << DMA_SxCR_HTIE)) ) ||
+		   ( (flags & DMA_TEIF) && (cr & ( 1 << DMA_SxCR_TEIE)) ) ||
+		   ( (flags & DMA_DMEIF) && (cr & ( 1 << DMA_SxCR_DMEIE)) );
+}
+
+
+static void dma_write(uint8_t Ctrl, uint32_t Offset, uint32_t Old, uint32_t New)
+{
+	DMA_RegDef_t *r = dma_regs(Ctrl);
+
+	if( (Offset == 0x08) || (Offset == 0x0C) )
+	{
+		//LIFCR/HIFCR, write 1 to clear
+		uint8_t first = (Offset == 0x0C) ? 4 : 0;
+
+		for(uint8_t n = 0 ; n < 4 ; n++)
+		{
+			Dma[Ctrl][first + n].Flags &= ~( (New >> DmaFlagOffset[n]) & DMA_FLAGS );
+		}
+		return;
+	}
+
+	if( (Offset >= 0x10) && (Offset < DMA_REG_SPAN) )
+	{
+		uint8_t n = (Offset - 0x10) / DMA_STREAM_SPAN;
+		uint32_t reg = (Offset - 0x10) % DMA_STREAM_SPAN;
+		DMA_Stream_RegDef_t *st = &r->S[n];
+		dma_stream_model_t *d = &Dma[Ctrl][n];
+
+		if(reg == 0x00)
+		{
+			if(Old & ( 1 << DMA_SxCR_EN))
+			{
+				if( (Old ^ New) & ~( ( 1 << DMA_SxCR_EN) | ( 1 << DMA_SxCR_CT) ) )
+				{
+					DmaStats.WriteWhileOn++;
+				}
+				if( !(New & ( 1 << DMA_SxCR_EN)) && d->Ndtr )
+				{
+					//disabled before the end : the stream stops and reports TC
+					d->Flags |= DMA_TCIF;
+				}
+			}else if(New & ( 1 << DMA_SxCR_EN))
+			{
+				if(d->Flags)
+				{
+					DmaStats.StaleFlags++;
+				}
+				d->NdtrInit = d->Ndtr;
+				d->Offset = 0;
+				d->BusyUntil = Now;
+				if(d->Ndtr == 0)
+				{
+					st->CR &= ~( 1 << DMA_SxCR_EN);
+				}
+			}
+		}else if(reg == 0x04)
+		{
+			if(st->CR & ( 1 << DMA_SxCR_EN))
+			{
+				DmaStats.WriteWhileOn++;
+			}else
+			{
+				d->Ndtr = (uint16_t)New;
+			}
+		}else if(reg == 0x08)
+		{
+			if(st->CR & ( 1 << DMA_SxCR_EN))
+			{
+				DmaStats.WriteWhileOn++;
+			}
+		}
+	}
+}
+
+
+static void model_write(uint32_t Addr, uint32_t Old, uint32_t New)
+{
+	if(LogCount < MODEL_LOG_MAX)
+	{
+		Log[LogCount].Cycle = Now;
+		Log[LogCount].Addr = Addr;
+		Log[LogCount].Old = Old;
+		Log[LogCount].New = New;
+		LogCount++;
+	}
+
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		if( (Addr >= Spi[i].Base) && (Addr < Spi[i].Base + SPI_REG_SPAN) )
+		{
+			spi_write(&Spi[i],Addr - Spi[i].Base,Old,New);
+			return;
+		}
+	}
+
+	if( (Addr >= DMA1_BASEADDR) && (Addr < DMA1_BASEADDR + DMA_REG_SPAN) )
+	{
+		dma_write(0,Addr - DMA1_BASEADDR,Old,New);
+	}else if( (Addr >= DMA2_BASEADDR) && (Addr < DMA2_BASEADDR + DMA_REG_SPAN) )
+	{
+		dma_write(1,Addr - DMA2_BASEADDR,Old,New);
+	}else if( (Addr >= NVIC_ISER_ADDR) && (Addr < NVIC_ISER_ADDR + 12) )
+	{
+		NvicEn[(Addr - NVIC_ISER_ADDR) / 4] |= New;
+	}else if( (Addr >= NVIC_ICER_ADDR) && (Addr < NVIC_ICER_ADDR + 12) )
+	{
+		NvicEn[(Addr - NVIC_ICER_ADDR) / 4] &= ~New;
+	}else if(Addr == DWT_CYCCNT_ADDR)
+	{
+		CycOffset = Now - New;
+	}
+}
+
+
+static void model_read(uint32_t Addr)
+{
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		if( (Addr >= Spi[i].Base) && (Addr < Spi[i].Base + SPI_REG_SPAN) )
+		{
+			spi_read(&Spi[i],Addr - Spi[i].Base);
+			return;
+		}
+	}
+}
+
+
+/*
+ * brings the registers the core can read in line with the model state
+ */
+static void model_sync(void)
+{
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		spi_model_t *s = &Spi[i];
+		SPI_RegDef_t *r = spi_regs(s);
+		uint32_t sr = 0;
+
+		sr |= s->Rxne ? ( 1 << SPI_SR_RXNE) : 0;
+		sr |= s->TxFull ? 0 : ( 1 << SPI_SR_TXE);
+		sr |= s->CrcErr ? ( 1 << SPI_SR_CRCERR) : 0;
+		sr |= s->Ovr ? ( 1 << SPI_SR_OVR) : 0;
+		sr |= spi_busy(s) ? ( 1 << SPI_SR_BSY) : 0;
+
+		r->SR = sr;
+		r->DR = s->RxBuf;
+		r->RXCRCR = s->RxCrc;
+		r->TXCRCR = s->TxCrc;
+	}
+
+	for(uint8_t c = 0 ; c < 2 ; c++)
+	{
+		DMA_RegDef_t *r = dma_regs(c);
+		uint32_t isr[2] = { 0, 0 };
+
+		for(uint8_t n = 0 ; n < 8 ; n++)
+		{
+			isr[n / 4] |= (uint32_t)Dma[c][n].Flags << DmaFlagOffset[n % 4];
+			r->S[n].NDTR = Dma[c][n].Ndtr;
+		}
+		r->LISR = isr[0];
+		r->HISR = isr[1];
+		r->LIFCR = 0;
+		r->HIFCR = 0;
+	}
+
+	for(uint8_t i = 0 ; i < 3 ; i++)
+	{
+		*model_reg(NVIC_ISER_ADDR + 4 * i) = NvicEn[i];
+		*model_reg(NVIC_ICER_ADDR + 4 * i) = NvicEn[i];
+	}
+
+	*model_reg(DWT_CYCCNT_ADDR) = (uint32_t)(Now - CycOffset);
+}
+
+
+/*
+ * everything the hardware does at the current cycle, returns 0 once nothing is left to do
+ */
+static uint8_t model_hw_step(void)
+{
+	uint8_t done = 0;
+
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		spi_model_t *s = &Spi[i];
+
+		if(s->Shifting && (s->ShiftEnd <= Now))
+		{
+			spi_end_frame(s);
+			done = 1;
+		}
+
+		if( !s->Shifting && spi_enabled(s) && (s->TxFull || s->CrcNext) )
+		{
+			spi_start_frame(s);
+			done = 1;
+		}
+	}
+
+	for(uint8_t c = 0 ; c < 2 ; c++)
+	{
+		for(uint8_t n = 0 ; n < 8 ; n++)
+		{
+			if( (Dma[c][n].BusyUntil <= Now) && dma_request(c,n) )
+			{
+				dma_item(c,n);
+				done = 1;
+			}
+		}
+	}
+
+	if(done)
+	{
+		LastActivity = Now;
+	}
+
+	return done;
+}
+
+
+static uint64_t model_hw_next(void)
+{
+	uint64_t next = UINT64_MAX;
+
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		if(Spi[i].Shifting && (Spi[i].ShiftEnd < next))
+		{
+			next = Spi[i].ShiftEnd;
+		}
+	}
+
+	for(uint8_t c = 0 ; c < 2 ; c++)
+	{
+		for(uint8_t n = 0 ; n < 8 ; n++)
+		{
+			if( (Dma[c][n].BusyUntil > Now) && (Dma[c][n].BusyUntil < next) && dma_request(c,n) )
+			{
+				next = Dma[c][n].BusyUntil;
+			}
+		}
+	}
+
+	return next;
+}
+
+
+static void (*model_vector(uint8_t IRQNumber))(void)
+{
+	switch(IRQNumber)
+	{
+		case IRQ_NO_SPI1: return SPI1_IRQHandler;
+		case IRQ_NO_SPI2: return SPI2_IRQHandler;
+		case IRQ_NO_SPI3: return SPI3_IRQHandler;
+		case IRQ_NO_DMA1_STREAM0: return DMA1_Stream0_IRQHandler;
+		case IRQ_NO_DMA1_STREAM1: return DMA1_Stream1_IRQHandler;
+		case IRQ_NO_DMA1_STREAM2: return DMA1_Stream2_IRQHandler;
+		case IRQ_NO_DMA1_STREAM3: return DMA1_Stream3_IRQHandler;
+		case IRQ_NO_DMA1_STREAM4: return DMA1_Stream4_IRQHandler;
+		case IRQ_NO_DMA1_STREAM5: return DMA1_Stream5_IRQHandler;
+		case IRQ_NO_DMA1_STREAM6: return DMA1_Stream6_IRQHandler;
+		case IRQ_NO_DMA1_STREAM7: return DMA1_Stream7_IRQHandler;
+		case IRQ_NO_DMA2_STREAM0: return DMA2_Stream0_IRQHandler;
+		case IRQ_NO_DMA2_STREAM1: return DMA2_Stream1_IRQHandler;
+		case IRQ_NO_DMA2_STREAM2: return DMA2_Stream2_IRQHandler;
+		case IRQ_NO_DMA2_STREAM3: return DMA2_Stream3_IRQHandler;
+		case IRQ_NO_DMA2_STREAM4: return DMA2_Stream4_IRQHandler;
+		case IRQ_NO_DMA2_STREAM5: return DMA2_Stream5_IRQHandler;
+		case IRQ_NO_DMA2_STREAM6: return DMA2_Stream6_IRQHandler;
+		case IRQ_NO_DMA2_STREAM7: return DMA2_Stream7_IRQHandler;
+	}
+	return NULL;
+}
+
+
+static uint8_t model_irq_enabled(uint8_t IRQNumber)
+{
+	return ( NvicEn[IRQNumber / 32] >> (IRQNumber % 32) ) & 1;
+}
+
+
+/*
+ * lowest enabled IRQ number with its line active, -1 if none
+ */
+static int16_t model_pending_irq(void)
+{
+	int16_t irq = -1;
+
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		uint8_t n = Spi[i].IRQNumber;
+
+		if( model_irq_enabled(n) && spi_irq_line(&Spi[i]) && ( (irq < 0) || (n < irq) ) )
+		{
+			irq = n;
+		}
+	}
+
+	for(uint8_t c = 0 ; c < 2 ; c++)
+	{
+		for(uint8_t s = 0 ; s < 8 ; s++)
+		{
+			uint8_t n = Dma[c][s].IRQNumber;
+
+			if( model_irq_enabled(n) && dma_irq_line(c,s) && ( (irq < 0) || (n < irq) ) )
+			{
+				irq = n;
+			}
+		}
+	}
+
+	return irq;
+}
+
+
+/*
+ * runs the hardware up to Target, or only till an interrupt can be taken
+ */
+static void model_advance(uint64_t Target, uint8_t StopOnIRQ)
+{
+	uint64_t next;
+
+	for(;;)
+	{
+		while(model_hw_step());
+
+		if(StopOnIRQ && (model_pending_irq() >= 0))
+		{
+			break;
+		}
+
+		next = model_hw_next();
+		if(next > Target)
+		{
+			if(Now < Target)
+			{
+				Now = Target;
+			}
+			break;
+		}
+		Now = next;
+	}
+
+	model_sync();
+}
+
+
+/*
+ * takes the pending interrupts, tail chained, one level deep. Returns 0 if no handler ran
+ */
+static uint8_t model_dispatch(void)
+{
+	uint32_t chain = 0;
+	uint64_t entry, cycles;
+	int16_t irq;
+	void (*handler)(void);
+
+	if(InISR || Primask)
+	{
+		return 0;
+	}
+
+	InISR = 1;
+	while( (irq = model_pending_irq()) >= 0 )
+	{
+		handler = model_vector((uint8_t)irq);
+		if(handler == NULL)
+		{
+			fprintf(stderr,"model: IRQ %d is enabled and pending but has no handler\n",irq);
+			abort();
+		}
+
+		entry = Now;
+		model_advance(Now + MODEL_ISR_ENTRY_CYCLES,0);
+		handler();
+		model_advance(Now + MODEL_ISR_EXIT_CYCLES,0);
+
+		cycles = Now - entry;
+		IRQStats[irq].Entries++;
+		if(cycles > IRQStats[irq].MaxCycles)
+		{
+			IRQStats[irq].MaxCycles = (uint32_t)cycles;
+		}
+
+		if(++chain > MODEL_STORM_MAX)
+		{
+			fprintf(stderr,"model: IRQ %d never stops firing\n",irq);
+			abort();
+		}
+	}
+	InISR = 0;
+
+	return (chain != 0);
+}
+
+
+static int8_t model_trap_page(uintptr_t Addr)
+{
+	for(uint8_t i = 0 ; i < TRAP_PAGES ; i++)
+	{
+		if( (Addr >= TrapPages[i]) && (Addr < TrapPages[i] + MODEL_PAGE_SIZE) )
+		{
+			return (int8_t)i;
+		}
+	}
+	return -1;
+}
+
+
+/*
+ * a register access : update the registers, then let the instruction run alone (TF)
+ */
+static void model_segv(int Sig, siginfo_t *pInfo, void *pCtx)
+{
+	ucontext_t *pUc = pCtx;
+	uintptr_t addr = (uintptr_t)pInfo->si_addr;
+	int8_t page = model_trap_page(addr);
+
+	if( (page < 0) || (Step.Page >= 0) )
+	{
+		//not a register, a real fault of the code under test
+		fprintf(stderr,"model: invalid access to %p\n",pInfo->si_addr);
+		signal(SIGSEGV,SIG_DFL);
+		return;
+	}
+
+	Step.Page = page;
+	Step.Addr = (uint32_t)addr & ~0x3U;
+	Step.Write = (pUc->uc_mcontext.gregs[REG_ERR] & 0x2) ? 1 : 0;
+	Step.AlrmBlocked = sigismember(&pUc->uc_sigmask,SIGALRM);
+
+	//the hardware runs on while the core gets to the access
+	model_advance(Now + MODEL_ACCESS_CYCLES,0);
+	LastActivity = Now;
+	Step.Old = *model_reg(Step.Addr);
+
+	mprotect((void*)(uintptr_t)TrapPages[page],MODEL_PAGE_SIZE,PROT_READ | PROT_WRITE);
+	pUc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+	sigaddset(&pUc->uc_sigmask,SIGALRM);
+}
+
+
+/*
+ * the access is done : protect the page again, apply the side effects, take interrupts
+ */
+static void model_trap(int Sig, siginfo_t *pInfo, void *pCtx)
+{
+	ucontext_t *pUc = pCtx;
+
+	if(Step.Page < 0)
+	{
+		return;
+	}
+
+	pUc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+	mprotect((void*)(uintptr_t)TrapPages[Step.Page],MODEL_PAGE_SIZE,PROT_NONE);
+	Step.Page = -1;
+
+	if(Step.Write)
+	{
+		model_write(Step.Addr,Step.Old,*model_reg(Step.Addr));
+	}else
+	{
+		model_read(Step.Addr);
+	}
+	model_advance(Now,0);
+
+	if(!Step.AlrmBlocked)
+	{
+		sigdelset(&pUc->uc_sigmask,SIGALRM);
+	}
+
+	model_dispatch();
+
+	//the trap handling itself is CPU time of the thread, spinning starts from here
+	if(!InISR)
+	{
+		SpinStart = model_cpu_ns();
+	}
+}
+
+
+/*
+ * lets time run while the core spins on memory. While the thread accesses registers, these
+ * accesses are what moves time on : only a thread which has run MODEL_SPIN_NS of CPU time
+ * since its last access is spinning. The host charges the trap handling to the thread, so
+ * this is well above the longest gap seen between two accesses of a polling loop
+ */
+static void model_tick(int Sig)
+{
+	if(model_cpu_ns() - SpinStart >= MODEL_SPIN_NS)
+	{
+		model_advance(Now + MODEL_TICK_CYCLES,(InISR || Primask) ? 0 : 1);
+
+		if(IdleExit && (Now - LastActivity > IdleExit))
+		{
+			fflush(stdout);
+			_exit(0);
+		}
+	}
+
+	if(model_dispatch())
+	{
+		//the handlers may have ended the wait, the thread is not known to spin any more
+		SpinStart = model_cpu_ns();
+	}
+}
+
+
+static void model_map(uint32_t Base, uint32_t Size, uint8_t **ppAlias)
+{
+	int fd = memfd_create("mcu_model",0);
+	void *p;
+
+	if( (fd < 0) || (ftruncate(fd,Size) != 0) )
+	{
+		perror("model: memfd");
+		exit(1);
+	}
+
+	//the registers at their real address, and a second view of the same pages for the model
+	p = mmap((void*)(uintptr_t)Base,Size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED_NOREPLACE,fd,0);
+	if(p != (void*)(uintptr_t)Base)
+	{
+		fprintf(stderr,"model: can not map 0x%08x, is the binary linked with -no-pie ?\n",Base);
+		exit(1);
+	}
+
+	*ppAlias = mmap(NULL,Size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	if(*ppAlias == MAP_FAILED)
+	{
+		perror("model: mmap");
+		exit(1);
+	}
+	close(fd);
+}
+
+
+static void model_block_tick(sigset_t *pOld)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set,SIGALRM);
+	sigprocmask(SIG_BLOCK,&set,pOld);
+}
+
+
+__attribute__((constructor)) static void model_init(void)
+{
+	struct sigaction sa;
+	struct itimerval timer;
+
+	model_map(PERIPH_BASEADDR,PERIPH_SIZE,&PeriphAlias);
+	model_map(CORE_BASEADDR,CORE_SIZE,&CoreAlias);
+
+	model_reset();
+
+	memset(&sa,0,sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sigaddset(&sa.sa_mask,SIGALRM);
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sa.sa_sigaction = model_segv;
+	sigaction(SIGSEGV,&sa,NULL);
+	sa.sa_sigaction = model_trap;
+	sigaction(SIGTRAP,&sa,NULL);
+
+	memset(&sa,0,sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sa.sa_handler = model_tick;
+	sigaction(SIGALRM,&sa,NULL);
+
+	for(uint8_t i = 0 ; i < TRAP_PAGES ; i++)
+	{
+		mprotect((void*)(uintptr_t)TrapPages[i],MODEL_PAGE_SIZE,PROT_NONE);
+	}
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = MODEL_TICK_US;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_REAL,&timer,NULL);
+}
+
+
+/*
+ * APIs
+ */
+
+uint32_t model_irq_lock(void)
+{
+	uint32_t primask = Primask;
+
+	Primask = 1;
+	return primask;
+}
+
+
+void model_irq_unlock(uint32_t primask)
+{
+	sigset_t old;
+
+	Primask = primask;
+	SpinStart = model_cpu_ns();
+	if(!primask)
+	{
+		//what became pending while masked is taken now
+		model_block_tick(&old);
+		model_dispatch();
+		sigprocmask(SIG_SETMASK,&old,NULL);
+	}
+}
+
+
+void model_reset(void)
+{
+	static const uint32_t spibase[SPI_COUNT] = { SPI1_BASEADDR, SPI2_BASEADDR, SPI3_BASEADDR };
+	static const uint8_t spiirq[SPI_COUNT] = { IRQ_NO_SPI1, IRQ_NO_SPI2, IRQ_NO_SPI3 };
+	sigset_t old;
+
+	model_block_tick(&old);
+
+	memset(PeriphAlias,0,PERIPH_SIZE);
+	memset(CoreAlias,0,CORE_SIZE);
+
+	memset(Spi,0,sizeof(Spi));
+	for(uint8_t i = 0 ; i < SPI_COUNT ; i++)
+	{
+		Spi[i].Base = spibase[i];
+		Spi[i].IRQNumber = spiirq[i];
+		spi_regs(&Spi[i])->CRCPR = 0x7;
+	}
+
+	memset(Dma,0,sizeof(Dma));
+	for(uint8_t c = 0 ; c < 2 ; c++)
+	{
+		for(uint8_t n = 0 ; n < 8 ; n++)
+		{
+			Dma[c][n].IRQNumber = DmaIRQ[c][n];
+			dma_regs(c)->S[n].FCR = 0x21;
+		}
+	}
+
+	memset(&DmaStats,0,sizeof(DmaStats));
+	memset(NvicEn,0,sizeof(NvicEn));
+	memset(IRQStats,0,sizeof(IRQStats));
+	LogCount = 0;
+	CycOffset = Now;
+	LastActivity = Now;
+
+	model_sync();
+	sigprocmask(SIG_SETMASK,&old,NULL);
+}
+
+
+uint64_t model_cycles(void)
+{
+	return Now;
+}
+
+
+void model_run(uint32_t Cycles)
+{
+	uint64_t end = Now + Cycles;
+
+	//the tick only moves time on for a spinning thread
+	while(Now < end);
+}
+
+
+uint8_t model_wait(__vo uint8_t *pFlag, uint32_t MaxCycles)
+{
+	uint64_t deadline = Now + MaxCycles;
+
+	while(! *pFlag)
+	{
+		if(Now >= deadline)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+void model_exit_when_idle(uint32_t Cycles)
+{
+	IdleExit = Cycles;
+}
+
+
+void model_spi_attach(SPI_RegDef_t *pSPIx, model_spi_device_t Device, void *pContext)
+{
+	spi_model_t *s = spi_of(pSPIx);
+
+	s->Device = Device;
+	s->pContext = pContext;
+}
+
+
+void model_spi_watch_cs(SPI_RegDef_t *pSPIx, uint8_t Index, GPIO_RegDef_t *pPort, uint8_t Pin)
+{
+	spi_model_t *s = spi_of(pSPIx);
+
+	s->pCSPort[Index] = pPort;
+	s->CSPin[Index] = Pin;
+}
+
+
+const model_spi_stats_t *model_spi_stats(SPI_RegDef_t *pSPIx)
+{
+	return &spi_of(pSPIx)->Stats;
+}
+
+
+const model_dma_stats_t *model_dma_stats(void)
+{
+	return &DmaStats;
+}
+
+
+const model_irq_stats_t *model_irq_stats(uint8_t IRQNumber)
+{
+	return &IRQStats[IRQNumber];
+}
+
+
+uint32_t model_log_count(void)
+{
+	return LogCount;
+}
+
+
+const model_log_t *model_log_entry(uint32_t Index)
+{
+	return &Log[Index];
+}
+
+
+int32_t model_log_find(uint32_t Addr, uint32_t Mask, uint32_t Value, uint32_t From)
+{
+	for(uint32_t i = From ; i < LogCount ; i++)
+	{
+		if( (Log[i].Addr == Addr) && ( (Log[i].Old & Mask) != Value ) && ( (Log[i].New & Mask) == Value ) )
+		{
+			return (int32_t)i;
+		}
+	}
+	return -1;
+}
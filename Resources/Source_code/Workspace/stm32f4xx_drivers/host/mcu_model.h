@@ -0,0 +1,131 @@
+/*
+ * mcu_model.h
+ *
+ * Register level model of the STM32F407 blocks the SPI driver talks to, so that the drivers
+ * (and the applications built on them) run unchanged on a Linux x86-64 host :
+ *
+ *  - SPI1/2/3 as full duplex master : TX buffer + shift register, TXE/RXNE/BSY/OVR/CRCERR
+ *    timing from BR and DFF, hardware CRC (CRCNEXT, automatic CRC after a Tx DMA run),
+ *    a device on MISO (loopback unless one is attached) and chip select sampling
+ *  - DMA1/DMA2 streams serving the SPI requests : NDTR, MINC, data sizes, circular and
+ *    double buffer mode, TC/HT/TE flags, IFCR, TC on disable, TE on a NULL page address
+ *  - NVIC ISER/ICER and the SPI/DMA interrupt lines, DWT_CYCCNT
+ *
+ * How : the peripheral pages are mapped at their real addresses. The pages holding SPI,
+ * DMA, NVIC and DWT registers are kept inaccessible, every access traps (SIGSEGV), the model
+ * brings the registers up to date, the instruction is single stepped (SIGTRAP) and the side
+ * effects of the access are applied. Time is virtual : MODEL_ACCESS_CYCLES per register
+ * access, the hardware in between, and a periodic tick which moves time on while the code
+ * spins on RAM (while(!TxDone);) without touching a register.
+ * Pending interrupts are taken after each register access, on the tick and on IRQ_UNLOCK,
+ * one level deep, lowest IRQ number first.
+ *
+ * Build with -no-pie and keep DMA buffers static : the driver passes memory addresses to
+ * the DMA as uint32_t.
+ *
+ * The model also counts what the reference manual forbids (SPE cleared while BSY, SPI
+ * configuration changed while SPE=1, stream enabled with stale flags, stream registers
+ * written while EN=1, DMA to the NULL page) and logs every register write for sequence checks.
+ */
+
+#ifndef MCU_MODEL_H_
+#define MCU_MODEL_H_
+
+#include "stm32f407xx.h"
+
+#define MODEL_ACCESS_CYCLES		4		/* one register access, with the instructions around it */
+#define MODEL_ISR_ENTRY_CYCLES	12		/* exception entry, stacking */
+#define MODEL_ISR_EXIT_CYCLES	10		/* exception return, unstacking */
+#define MODEL_DMA_ITEM_CYCLES	4		/* one data item through a stream */
+#define MODEL_TICK_CYCLES		256		/* most a tick moves time on */
+#define MODEL_TICK_US			20		/* host time between ticks */
+#define MODEL_LOG_MAX			4096	/* register writes kept */
+#define MODEL_CS_MAX			4		/* chip selects watched per SPI */
+
+/*
+ * device on the far side of the bus, called at the end of every frame with the frame the
+ * master sent (Crc set for the CRC frame), returns the frame it sends back
+ */
+typedef uint16_t (*model_spi_device_t)(SPI_RegDef_t *pSPIx, uint16_t Mosi, uint8_t Crc, void *pContext);
+
+typedef struct
+{
+	uint32_t Frames;			/* frames shifted, CRC frames included */
+	uint32_t CRCFrames;			/* CRC frames shifted */
+	uint32_t Overruns;			/* frames lost to OVR */
+	uint32_t SPEOffBusy;		/* SPE cleared while BSY */
+	uint32_t ConfigWhileOn;		/* BR/DFF/CPOL/CPHA/CRCEN/MSTR/LSBFIRST changed with SPE=1 */
+	uint32_t DRWhileFull;		/* DR written while TXE=0 */
+	uint32_t CSFrames[MODEL_CS_MAX];	/* frames clocked with watched chip select n (alone) low */
+	uint32_t CSErrors;			/* frames with none or several watched chip selects low */
+	uint64_t LastFrameEnd;		/* cycle the last frame ended */
+}model_spi_stats_t;
+
+typedef struct
+{
+	uint32_t Items;				/* data items moved */
+	uint32_t NullAccess;		/* items aimed at the NULL page, the stream stops with TE */
+	uint32_t StaleFlags;		/* streams enabled with flags of a previous run still set */
+	uint32_t WriteWhileOn;		/* CR config/NDTR/PAR written while EN=1 */
+}model_dma_stats_t;
+
+typedef struct
+{
+	uint32_t Entries;			/* handler runs */
+	uint32_t MaxCycles;			/* longest run, entry and exit included */
+}model_irq_stats_t;
+
+typedef struct
+{
+	uint64_t Cycle;
+	uint32_t Addr;
+	uint32_t Old;
+	uint32_t New;
+}model_log_t;
+
+/*
+ * set up : the model maps itself before main (constructor), model_reset brings the
+ * peripherals, the statistics and all peripheral memory back to their reset state
+ */
+void model_reset(void);
+uint64_t model_cycles(void);
+
+/*
+ * let time run : model_run for Cycles, model_wait until *pFlag is non zero (returns 0 on
+ * timeout). Both spin, interrupts are taken meanwhile
+ */
+void model_run(uint32_t Cycles);
+uint8_t model_wait(__vo uint8_t *pFlag, uint32_t MaxCycles);
+
+/*
+ * leaves the process once no register was accessed and no hardware was active for Cycles,
+ * for applications which end in while(1);
+ */
+void model_exit_when_idle(uint32_t Cycles);
+
+/*
+ * SPI bus
+ */
+void model_spi_attach(SPI_RegDef_t *pSPIx, model_spi_device_t Device, void *pContext);
+void model_spi_watch_cs(SPI_RegDef_t *pSPIx, uint8_t Index, GPIO_RegDef_t *pPort, uint8_t Pin);
+const model_spi_stats_t *model_spi_stats(SPI_RegDef_t *pSPIx);
+
+/*
+ * DMA, both controllers
+ */
+const model_dma_stats_t *model_dma_stats(void);
+
+/*
+ * interrupts
+ */
+const model_irq_stats_t *model_irq_stats(uint8_t IRQNumber);
+
+/*
+ * register write log, model_log_find returns the first entry from From on where the bits
+ * in Mask of register Addr turn to Value, -1 if there is none
+ */
+uint32_t model_log_count(void);
+const model_log_t *model_log_entry(uint32_t Index);
+int32_t model_log_find(uint32_t Addr, uint32_t Mask, uint32_t Value, uint32_t From);
+
+#endif /* MCU_MODEL_H_ */
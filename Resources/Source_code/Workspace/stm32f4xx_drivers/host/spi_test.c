@@ -0,0 +1,597 @@
+/*
+ * spi_test.c
+ *
+ * SPI driver tests on the host register model (make -C host test)
+ *
+ * SPI2 master, SCLK = PCLK1/2 (PCLK1/32 for the IT transfers, an interrupt per frame does not
+ * keep up with 16 cycle frames), MISO looped back to MOSI unless a device is attached.
+ * DMA1 stream 4 ch 0 for Tx, DMA1 stream 3 ch 0 for Rx.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "stm32f407xx.h"
+#include "mcu_model.h"
+
+#define TEST_WAIT_CYCLES	20000000
+#define TEST_EVENTS_MAX		8
+#define TEST_BIG_LEN		70000		/* more than one DMA run (65535 frames) */
+
+#define CHECK(cond)		do{ if(!(cond)) { printf("  FAIL %s:%d: %s\n",__func__,__LINE__,#cond); Failures++; } }while(0)
+
+SPI_Handle_t SPI2handle;
+DMA_Handle_t DMATxhandle;
+DMA_Handle_t DMARxhandle;
+
+static uint8_t TxBuff[TEST_BIG_LEN];
+static uint8_t RxBuff[TEST_BIG_LEN];
+
+static __vo uint8_t Done;
+static __vo uint8_t EventCount;
+static uint8_t Events[TEST_EVENTS_MAX];
+static uint8_t BusyAtEvent[TEST_EVENTS_MAX];
+static uint32_t FramesAtEvent[TEST_EVENTS_MAX];
+
+static uint32_t Failures;
+
+
+/*
+ * device which answers the CRC frame with a wrong CRC
+ */
+static uint16_t dev_bad_crc(SPI_RegDef_t *pSPIx, uint16_t Mosi, uint8_t Crc, void *pContext)
+{
+	return Crc ? (uint16_t)(Mosi ^ 0x1) : Mosi;
+}
+
+
+static void test_setup(uint8_t Speed, uint8_t Dff, uint8_t Crc, uint8_t TxDma, uint8_t RxDma)
+{
+	model_reset();
+
+	memset(&SPI2handle,0,sizeof(SPI2handle));
+	memset(&DMATxhandle,0,sizeof(DMATxhandle));
+	memset(&DMARxhandle,0,sizeof(DMARxhandle));
+	memset(RxBuff,0,sizeof(RxBuff));
+
+	Done = RESET;
+	EventCount = 0;
+
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2handle.SPIConfig.SPI_SclkSpeed = Speed;
+	SPI2handle.SPIConfig.SPI_DFF = Dff;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI2handle.SPIConfig.SPI_CRC = Crc;
+
+	SPI_Init(&SPI2handle);
+	SPI_SSIConfig(SPI2,ENABLE);
+
+	DMATxhandle.pDMAx = DMA1;
+	DMATxhandle.Stream = 4;
+	DMATxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMATxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	DMATxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	DMARxhandle.pDMAx = DMA1;
+	DMARxhandle.Stream = 3;
+	DMARxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMARxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_VERY_HIGH;
+	DMARxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	SPI2handle.pDMATx = TxDma ? &DMATxhandle : NULL;
+	SPI2handle.pDMARx = RxDma ? &DMARxhandle : NULL;
+
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2,ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM3,ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM4,ENABLE);
+
+	SPI_PeripheralControl(SPI2,ENABLE);
+
+	for(uint32_t i = 0 ; i < TEST_BIG_LEN ; i++)
+		TxBuff[i] = (uint8_t)(i * 7 + 1);
+}
+
+
+/*
+ * waits for the first event, then lets the ones raised right after it come in
+ */
+static uint8_t test_wait(void)
+{
+	uint8_t done = model_wait(&Done,TEST_WAIT_CYCLES);
+
+	model_run(2000);
+	return done;
+}
+
+
+static void test_blocking_loopback(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,0,0);
+
+	CHECK(SPI_TransmitReceive(SPI2,TxBuff,RxBuff,64) == SPI_READY);
+	CHECK(memcmp(TxBuff,RxBuff,64) == 0);
+	CHECK(model_spi_stats(SPI2)->Frames == 64);
+	CHECK(model_spi_stats(SPI2)->Overruns == 0);
+}
+
+
+static void test_blocking_16bit(void)
+{
+	uint16_t tx[8], rx[8];
+
+	for(uint8_t i = 0 ; i < 8 ; i++)
+		tx[i] = (uint16_t)(0x1234 * (i + 1));
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_16BITS,SPI_CRC_DI,0,0);
+
+	CHECK(SPI_TransmitReceive16(SPI2,tx,rx,8) == SPI_READY);
+	CHECK(memcmp(tx,rx,sizeof(tx)) == 0);
+	CHECK(model_spi_stats(SPI2)->Frames == 8);
+}
+
+
+static void test_it_txrx(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV32,SPI_DFF_8BITS,SPI_CRC_DI,0,0);
+
+	CHECK(SPI_TransmitReceiveIT(&SPI2handle,TxBuff,RxBuff,64) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 2);
+	CHECK(Events[0] == SPI_EVENT_TX_CMPLT);
+	CHECK(Events[1] == SPI_EVENT_RX_CMPLT);
+	CHECK(memcmp(TxBuff,RxBuff,64) == 0);
+	CHECK(model_spi_stats(SPI2)->Overruns == 0);
+}
+
+
+static void test_dma_tx_only(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,0);
+
+	CHECK(SPI_SendDataDMA(&SPI2handle,TxBuff,256) == SPI_READY);
+	CHECK(test_wait());
+
+	//completion is raised once the last frame is out of the shift register
+	CHECK(EventCount == 1);
+	CHECK(Events[0] == SPI_EVENT_TX_CMPLT);
+	CHECK(BusyAtEvent[0] == 0);
+	CHECK(FramesAtEvent[0] == 256);
+	CHECK(model_spi_stats(SPI2)->DRWhileFull == 0);
+	CHECK(model_spi_stats(SPI2)->SPEOffBusy == 0);
+	CHECK(SPI2handle.TxState == SPI_READY);
+	CHECK( !(SPI2->SR & ( 1 << SPI_SR_OVR)) );
+}
+
+
+static void test_dma_tx_linked(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+
+	CHECK(SPI_SendDataDMA(&SPI2handle,TxBuff,256) == SPI_READY);
+	CHECK(test_wait());
+
+	//the Rx stream ends the transfer : no RX_CMPLT for frames nobody asked for, no spin in the ISR
+	CHECK(EventCount == 1);
+	CHECK(Events[0] == SPI_EVENT_TX_CMPLT);
+	CHECK(BusyAtEvent[0] == 0);
+	CHECK(FramesAtEvent[0] == 256);
+	CHECK(model_spi_stats(SPI2)->Overruns == 0);
+	CHECK(model_irq_stats(IRQ_NO_DMA1_STREAM3)->Entries == 1);
+	CHECK(model_irq_stats(IRQ_NO_DMA1_STREAM3)->MaxCycles < 400);
+	CHECK(model_dma_stats()->NullAccess == 0);
+}
+
+
+/*
+ * RM0090 DMA sequence : RXDMAEN, Rx stream EN, Tx stream EN, TXDMAEN, each stream programmed
+ * while disabled and enabled without flags of a previous run
+ */
+static void test_dma_sequence(void)
+{
+	uint32_t cr2 = (uint32_t)(uintptr_t)&SPI2->CR2;
+	uint32_t rxcr = (uint32_t)(uintptr_t)&DMA1->S[3].CR;
+	uint32_t txcr = (uint32_t)(uintptr_t)&DMA1->S[4].CR;
+	int32_t rxdmaen, rxen, txen, txdmaen;
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+
+	for(uint8_t run = 0 ; run < 2 ; run++)
+	{
+		uint32_t from = model_log_count();
+
+		Done = RESET;
+		EventCount = 0;
+		CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,64) == SPI_READY);
+		CHECK(test_wait());
+		CHECK(EventCount == 2);
+
+		rxdmaen = model_log_find(cr2,( 1 << SPI_CR2_RXDMAEN),( 1 << SPI_CR2_RXDMAEN),from);
+		rxen = model_log_find(rxcr,( 1 << DMA_SxCR_EN),( 1 << DMA_SxCR_EN),from);
+		txen = model_log_find(txcr,( 1 << DMA_SxCR_EN),( 1 << DMA_SxCR_EN),from);
+		txdmaen = model_log_find(cr2,( 1 << SPI_CR2_TXDMAEN),( 1 << SPI_CR2_TXDMAEN),from);
+
+		CHECK(rxdmaen >= 0);
+		CHECK(rxen > rxdmaen);
+		CHECK(txen > rxen);
+		CHECK(txdmaen > txen);
+	}
+
+	//Tx only : TXDMAEN is first set once the stream runs
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,0);
+
+	CHECK(SPI_SendDataDMA(&SPI2handle,TxBuff,64) == SPI_READY);
+	CHECK(test_wait());
+
+	txen = model_log_find(txcr,( 1 << DMA_SxCR_EN),( 1 << DMA_SxCR_EN),0);
+	txdmaen = model_log_find(cr2,( 1 << SPI_CR2_TXDMAEN),( 1 << SPI_CR2_TXDMAEN),0);
+
+	CHECK(txen >= 0);
+	CHECK(txdmaen > txen);
+
+	CHECK(model_dma_stats()->StaleFlags == 0);
+	CHECK(model_dma_stats()->WriteWhileOn == 0);
+	CHECK(model_spi_stats(SPI2)->SPEOffBusy == 0);
+	CHECK(model_spi_stats(SPI2)->ConfigWhileOn == 0);
+
+	//and the clock can be switched off again
+	DMA_PeriClockControl(DMA1,DISABLE);
+	CHECK( !(RCC->AHB1ENR & ( 1 << 21)) );
+}
+
+
+static void test_queue_callback(SPI_Transaction_t *pTrans, uint8_t AppEv)
+{
+	uint8_t index = (uint8_t)(uintptr_t)pTrans->pContext;
+
+	if(index < TEST_EVENTS_MAX)
+	{
+		Events[index] = AppEv;
+	}
+	EventCount++;
+	if(pTrans->pNext == NULL)
+	{
+		Done = SET;
+	}
+}
+
+
+static void test_queue_device(SPI_Device_t *pDev, uint8_t Pin, uint8_t Speed, uint8_t Dff, uint8_t Cpol)
+{
+	GPIO_Handle_t cs;
+
+	memset(&cs,0,sizeof(cs));
+	cs.pGPIOx = GPIOB;
+	cs.GPIO_PinConfig.GPIO_PinNumber = Pin;
+	cs.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	cs.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	cs.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GPIO_Init(&cs);
+	GPIO_WriteToOutputPin(GPIOB,Pin,GPIO_PIN_SET);
+
+	memset(pDev,0,sizeof(*pDev));
+	pDev->pCSPort = GPIOB;
+	pDev->CSPin = Pin;
+	pDev->SPI_SclkSpeed = Speed;
+	pDev->SPI_DFF = Dff;
+	pDev->SPI_CPOL = Cpol;
+}
+
+
+static void test_queue_trans(SPI_Transaction_t *pTrans, SPI_Device_t *pDev, uint8_t *pTx, uint8_t *pRx, uint32_t Len, uint8_t Index)
+{
+	memset(pTrans,0,sizeof(*pTrans));
+	pTrans->pDevice = pDev;
+	pTrans->pTxBuffer = pTx;
+	pTrans->pRxBuffer = pRx;
+	pTrans->Len = Len;
+	pTrans->Callback = test_queue_callback;
+	pTrans->pContext = (void*)(uintptr_t)Index;
+}
+
+
+/*
+ * two devices with their own chip select and settings, DMA path
+ */
+static void test_queue(void)
+{
+	SPI_Device_t devA, devB;
+	SPI_Transaction_t t[3];
+	const model_spi_stats_t *pStats = model_spi_stats(SPI2);
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+	test_queue_device(&devA,GPIO_PIN_NO_12,SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CPOL_LOW);
+	test_queue_device(&devB,GPIO_PIN_NO_11,SPI_SCLK_SPEED_DIV8,SPI_DFF_16BITS,SPI_CPOL_HIGH);
+	model_spi_watch_cs(SPI2,0,GPIOB,GPIO_PIN_NO_12);
+	model_spi_watch_cs(SPI2,1,GPIOB,GPIO_PIN_NO_11);
+
+	//full duplex, Tx only (nothing may land at address 0), Rx only
+	test_queue_trans(&t[0],&devA,TxBuff,RxBuff,16,0);
+	test_queue_trans(&t[1],&devB,TxBuff,NULL,32,1);
+	test_queue_trans(&t[2],&devA,NULL,RxBuff + 16,8,2);
+
+	for(uint8_t i = 0 ; i < 3 ; i++)
+	{
+		CHECK(SPI_QueueTransaction(&SPI2handle,&t[i]) == SPI_READY);
+	}
+	CHECK(test_wait());
+
+	CHECK(EventCount == 3);
+	CHECK(Events[0] == SPI_EVENT_TRANS_CMPLT);
+	CHECK(Events[1] == SPI_EVENT_TRANS_CMPLT);
+	CHECK(Events[2] == SPI_EVENT_TRANS_CMPLT);
+	CHECK(memcmp(TxBuff,RxBuff,16) == 0);
+	CHECK(RxBuff[16] == 0xFF && RxBuff[23] == 0xFF);
+
+	CHECK(pStats->CSFrames[0] == 16 + 8);
+	CHECK(pStats->CSFrames[1] == 16);
+	CHECK(pStats->CSErrors == 0);
+	CHECK(pStats->ConfigWhileOn == 0);
+	CHECK(pStats->SPEOffBusy == 0);
+	CHECK(pStats->Overruns == 0);
+	CHECK(model_dma_stats()->NullAccess == 0);
+	CHECK((GPIOB->ODR & ((1 << GPIO_PIN_NO_11) | (1 << GPIO_PIN_NO_12))) == ((1 << GPIO_PIN_NO_11) | (1 << GPIO_PIN_NO_12)));
+	CHECK(SPI2handle.pQueueHead == NULL);
+}
+
+
+/*
+ * a transaction which can not start (odd Len in 16 bit DFF) must not stall the queue
+ */
+static void test_queue_refused(void)
+{
+	SPI_Device_t devA, devB;
+	SPI_Transaction_t t[3];
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+	test_queue_device(&devA,GPIO_PIN_NO_12,SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CPOL_LOW);
+	test_queue_device(&devB,GPIO_PIN_NO_11,SPI_SCLK_SPEED_DIV2,SPI_DFF_16BITS,SPI_CPOL_LOW);
+	model_spi_watch_cs(SPI2,0,GPIOB,GPIO_PIN_NO_12);
+	model_spi_watch_cs(SPI2,1,GPIOB,GPIO_PIN_NO_11);
+
+	//refused on an idle bus : the caller keeps it, the queue stays usable
+	test_queue_trans(&t[0],&devB,TxBuff,RxBuff,3,0);
+	CHECK(SPI_QueueTransaction(&SPI2handle,&t[0]) == SPI_ERR_LEN);
+	CHECK(SPI2handle.pQueueHead == NULL);
+	CHECK(EventCount == 0);
+
+	//refused when its turn comes : completed with START_ERR, the next one still runs
+	test_queue_trans(&t[0],&devA,TxBuff,RxBuff,64,0);
+	test_queue_trans(&t[1],&devB,TxBuff,RxBuff,3,1);
+	test_queue_trans(&t[2],&devA,TxBuff,RxBuff + 64,16,2);
+
+	for(uint8_t i = 0 ; i < 3 ; i++)
+	{
+		CHECK(SPI_QueueTransaction(&SPI2handle,&t[i]) == SPI_READY);
+	}
+	CHECK(test_wait());
+
+	CHECK(EventCount == 3);
+	CHECK(Events[0] == SPI_EVENT_TRANS_CMPLT);
+	CHECK(Events[1] == SPI_EVENT_START_ERR);
+	CHECK(Events[2] == SPI_EVENT_TRANS_CMPLT);
+	CHECK(memcmp(TxBuff,RxBuff + 64,16) == 0);
+	CHECK(model_spi_stats(SPI2)->CSFrames[0] == 64 + 16);
+	CHECK(model_spi_stats(SPI2)->CSFrames[1] == 0);
+	CHECK(model_spi_stats(SPI2)->CSErrors == 0);
+	CHECK((GPIOB->ODR & ((1 << GPIO_PIN_NO_11) | (1 << GPIO_PIN_NO_12))) == ((1 << GPIO_PIN_NO_11) | (1 << GPIO_PIN_NO_12)));
+	CHECK(SPI2handle.pQueueHead == NULL);
+}
+
+
+/*
+ * a direct transfer on the bus : the queue refuses without touching CR1 or a chip select
+ */
+static void test_queue_direct_busy(void)
+{
+	SPI_Device_t devB;
+	SPI_Transaction_t t;
+	const model_spi_stats_t *pStats = model_spi_stats(SPI2);
+
+	test_setup(SPI_SCLK_SPEED_DIV8,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+	test_queue_device(&devB,GPIO_PIN_NO_11,SPI_SCLK_SPEED_DIV2,SPI_DFF_16BITS,SPI_CPOL_HIGH);
+	model_spi_watch_cs(SPI2,1,GPIOB,GPIO_PIN_NO_11);
+
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,256) == SPI_READY);
+	model_run(200);
+
+	test_queue_trans(&t,&devB,TxBuff,NULL,8,0);
+	t.Callback = NULL;
+	CHECK(SPI_QueueTransaction(&SPI2handle,&t) != SPI_READY);
+	CHECK(SPI2handle.pQueueHead == NULL);
+
+	CHECK(test_wait());
+	model_run(256 * 16);
+
+	CHECK(EventCount == 2);
+	CHECK(pStats->Frames == 256);
+	CHECK(memcmp(TxBuff,RxBuff,256) == 0);
+	CHECK(pStats->SPEOffBusy == 0);
+	CHECK(pStats->ConfigWhileOn == 0);
+	CHECK(pStats->CSFrames[1] == 0);
+	CHECK(GPIOB->ODR & (1 << GPIO_PIN_NO_11));
+}
+
+
+static void test_no_dma(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,0,0);
+
+	CHECK(SPI_SendDataDMA(&SPI2handle,TxBuff,16) == SPI_ERR_NO_DMA);
+	CHECK(SPI_ReceiveDataDMA(&SPI2handle,RxBuff,16) == SPI_ERR_NO_DMA);
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,16) == SPI_ERR_NO_DMA);
+
+	//a master receiving through DMA clocks dummy frames out through the Tx stream
+	SPI2handle.pDMARx = &DMARxhandle;
+	CHECK(SPI_ReceiveDataDMA(&SPI2handle,RxBuff,16) == SPI_ERR_NO_DMA);
+	CHECK(SPI2handle.RxState == SPI_READY);
+
+	model_run(1000);
+	CHECK(EventCount == 0);
+	CHECK(model_dma_stats()->Items == 0);
+}
+
+
+static void test_dma_rx_null(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,NULL,128) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 1);
+	CHECK(Events[0] == SPI_EVENT_TX_CMPLT);
+	CHECK(model_dma_stats()->NullAccess == 0);
+
+	//and the other way round, dummy 0xFF frames out
+	Done = RESET;
+	EventCount = 0;
+	CHECK(SPI_ReceiveDataDMA(&SPI2handle,RxBuff,128) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 1);
+	CHECK(Events[0] == SPI_EVENT_RX_CMPLT);
+	CHECK(RxBuff[0] == 0xFF && RxBuff[127] == 0xFF);
+	CHECK(model_dma_stats()->NullAccess == 0);
+}
+
+
+static void test_dma_chunks(void)
+{
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,1,1);
+
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,TEST_BIG_LEN) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 2);
+	CHECK(Events[0] == SPI_EVENT_TX_CMPLT);
+	CHECK(Events[1] == SPI_EVENT_RX_CMPLT);
+	CHECK(memcmp(TxBuff,RxBuff,TEST_BIG_LEN) == 0);
+	CHECK(model_spi_stats(SPI2)->Frames == TEST_BIG_LEN);
+	CHECK(model_spi_stats(SPI2)->Overruns == 0);
+}
+
+
+static void test_crc(void)
+{
+	//interrupt driven, CRC appended with CRCNEXT
+	test_setup(SPI_SCLK_SPEED_DIV32,SPI_DFF_8BITS,SPI_CRC_EN,0,0);
+
+	CHECK(SPI_TransmitReceiveIT(&SPI2handle,TxBuff,RxBuff,32) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 2);
+	CHECK(Events[1] == SPI_EVENT_RX_CMPLT);
+	CHECK(model_spi_stats(SPI2)->CRCFrames == 1);
+	CHECK(memcmp(TxBuff,RxBuff,32) == 0);
+
+	//DMA, CRC appended by the hardware after the Tx stream
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_EN,1,1);
+
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,100) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 2);
+	CHECK(Events[1] == SPI_EVENT_RX_CMPLT);
+	CHECK(model_spi_stats(SPI2)->CRCFrames == 1);
+
+	//a device which gets the CRC wrong
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_EN,1,1);
+	model_spi_attach(SPI2,dev_bad_crc,NULL);
+
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,100) == SPI_READY);
+	CHECK(test_wait());
+	CHECK(EventCount == 2);
+	CHECK(Events[1] == SPI_EVENT_CRC_ERR);
+	CHECK( !(SPI2->SR & ( 1 << SPI_SR_CRCERR)) );
+}
+
+
+static void test_len_dff(void)
+{
+	uint16_t tx16[2] = { 0x1111, 0x2222 };
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_16BITS,SPI_CRC_DI,1,1);
+
+	CHECK(SPI_SendData(SPI2,TxBuff,3) == SPI_ERR_LEN);
+	CHECK(SPI_SendDataDMA(&SPI2handle,TxBuff,3) == SPI_ERR_LEN);
+	CHECK(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,3) == SPI_ERR_LEN);
+	CHECK(SPI_TransmitReceiveIT(&SPI2handle,TxBuff,RxBuff,3) == SPI_ERR_LEN);
+
+	//ping-pong : odd, empty, or more frames than NDTR counts (the buffers are never touched)
+	SPI_PingPong_t pp = { .pBuffer = { TxBuff, RxBuff }, .Len = 3 };
+	CHECK(SPI_SlaveReceivePingPong(&SPI2handle,&pp) == SPI_ERR_LEN);
+	pp.Len = 0;
+	CHECK(SPI_SlaveReceivePingPong(&SPI2handle,&pp) == SPI_ERR_LEN);
+	pp.Len = 2 * 65536;
+	CHECK(SPI_SlaveReceivePingPong(&SPI2handle,&pp) == SPI_ERR_LEN);
+	CHECK(SPI2handle.RxState == SPI_READY);
+
+	test_setup(SPI_SCLK_SPEED_DIV2,SPI_DFF_8BITS,SPI_CRC_DI,0,0);
+
+	CHECK(SPI_SendData16(SPI2,tx16,4) == SPI_ERR_DFF);
+	CHECK(SPI_SendData16IT(&SPI2handle,tx16,4) == SPI_ERR_DFF);
+
+	model_run(1000);
+	CHECK(model_spi_stats(SPI2)->Frames == 0);
+	CHECK(EventCount == 0);
+}
+
+
+int main(void)
+{
+	static void (*const Tests[])(void) =
+	{
+		test_blocking_loopback,
+		test_blocking_16bit,
+		test_it_txrx,
+		test_dma_tx_only,
+		test_dma_tx_linked,
+		test_dma_sequence,
+		test_queue,
+		test_queue_refused,
+		test_queue_direct_busy,
+		test_no_dma,
+		test_dma_rx_null,
+		test_dma_chunks,
+		test_crc,
+		test_len_dff,
+	};
+
+	setvbuf(stdout,NULL,_IONBF,0);
+
+	for(uint8_t i = 0 ; i < sizeof(Tests) / sizeof(Tests[0]) ; i++)
+	{
+		Tests[i]();
+	}
+
+	printf("spi_test: %u failure(s)\n",Failures);
+
+	return Failures ? 1 : 0;
+}
+
+
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2handle);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	SPI_DMARxIRQHandling(&SPI2handle);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	SPI_DMATxIRQHandling(&SPI2handle);
+}
+
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
+{
+	if(EventCount < TEST_EVENTS_MAX)
+	{
+		Events[EventCount] = AppEv;
+		BusyAtEvent[EventCount] = SPI_GetFlagStatus(SPI2,SPI_BUSY_FLAG);
+		FramesAtEvent[EventCount] = model_spi_stats(SPI2)->Frames;
+	}
+	EventCount++;
+	Done = SET;
+}
@@ -64,7 +64,11 @@ void I2C1_Inits(void)
 	I2C1Handle.I2C_Config.I2C_FMDutyCycle = I2C_FM_DUTY_2;
 	I2C1Handle.I2C_Config.I2C_SCLSpeed = I2C_SCL_SPEED_SM;
 
-	I2C_Init(&I2C1Handle);
+	if(I2C_Init(&I2C1Handle) != I2C_TIMING_OK)
+	{
+		//SCL speed not reachable from this PCLK1, nothing can run
+		while(1);
+	}
 
 }
 
@@ -15,6 +15,8 @@ USART_Handle_t usart2_handle;
 
 void USART2_Init(void)
 {
+	uint8_t status;
+
 	usart2_handle.pUSARTx = USART2;
 	usart2_handle.USART_Config.USART_Baud = USART_STD_BAUD_115200;
 	usart2_handle.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
@@ -22,7 +24,13 @@ void USART2_Init(void)
 	usart2_handle.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
 	usart2_handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
 	usart2_handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
-	USART_Init(&usart2_handle);
+	status = USART_Init(&usart2_handle);
+	if(status != USART_BAUD_OK)
+	{
+		//USART_BAUD_ERR_RANGE / USART_BAUD_ERR_TOLERANCE : the APB clock can not give this baud rate,
+		//nothing would come out of the line
+		while(1);
+	}
 }
 
 void 	USART2_GPIOInit(void)
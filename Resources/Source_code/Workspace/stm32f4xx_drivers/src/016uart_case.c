@@ -17,11 +17,17 @@ char *msg[3] = {"hihihihihihi123", "Hello How are you ?" , "Today is Monday !"};
 
 //reply from arduino will be stored here
 char rx_buf[1024] ;
+uint32_t rx_len;
+
+//the DMA writes in to this buffer forever, the driver hands over the received chunks
+uint8_t rx_ring[256];
+USART_RxStream_t rx_stream = { .pBuffer = rx_ring, .Len = sizeof(rx_ring) };
 
 USART_Handle_t usart2_handle;
+DMA_Handle_t usart2_dma_rx;
 
 
-//This flag indicates reception completion
+//This flag indicates reception completion (the line went idle after the reply)
 uint8_t rxCmplt = RESET;
 
 uint8_t g_data = 0;
@@ -30,6 +36,8 @@ extern void initialise_monitor_handles();
 
 void USART2_Init(void)
 {
+	uint8_t status;
+
 	usart2_handle.pUSARTx = USART2;
 	usart2_handle.USART_Config.USART_Baud = USART_STD_BAUD_115200;
 	usart2_handle.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
@@ -37,7 +45,27 @@ void USART2_Init(void)
 	usart2_handle.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
 	usart2_handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
 	usart2_handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
-	USART_Init(&usart2_handle);
+	status = USART_Init(&usart2_handle);
+	if(status != USART_BAUD_OK)
+	{
+		//USART_BAUD_ERR_RANGE / USART_BAUD_ERR_TOLERANCE : the APB clock can not give this baud rate
+		printf("USART2 : baud rate refused, error %d\n",status);
+		while(1);
+	}
+}
+
+void USART2_DMAInit(void)
+{
+	//USART2_RX : DMA1 stream 5 channel 4
+	usart2_dma_rx.pDMAx = DMA1;
+	usart2_dma_rx.Stream = 5;
+	usart2_dma_rx.DMAConfig.DMA_Channel = DMA_CHANNEL_4;
+	usart2_dma_rx.DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	usart2_dma_rx.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	usart2_handle.pDMARx = &usart2_dma_rx;
+
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM5,ENABLE);
 }
 
 void 	USART2_GPIOInit(void)
@@ -99,11 +127,15 @@ int main(void)
 
 	USART2_GPIOInit();
     USART2_Init();
+    USART2_DMAInit();
 
     USART_IRQInterruptConfig(IRQ_NO_USART2,ENABLE);
 
     USART_PeripheralControl(USART2,ENABLE);
 
+    //reception runs from here on, whatever the length of the replies
+    USART_ReceiveStreamDMA(&usart2_handle,&rx_stream);
+
     printf("Application is running\n");
 
     //do forever
@@ -118,27 +150,24 @@ int main(void)
 		// Next message index ; make sure that cnt value doesn't cross 2
 		cnt = cnt % 3;
 
-		//First lets enable the reception in interrupt mode
-		//this code enables the receive interrupt
-		while ( USART_ReceiveDataIT(&usart2_handle,rx_buf,strlen(msg[cnt])) != USART_READY );
-
 		//Send the msg indexed by cnt in blocking mode
     	USART_SendData(&usart2_handle,(uint8_t*)msg[cnt],strlen(msg[cnt]));
 
     	printf("Transmitted : %s\n",msg[cnt]);
 
 
-    	//Now lets wait until all the bytes are received from the arduino .
-    	//When all the bytes are received rxCmplt will be SET in application callback
+    	//Now lets wait until the arduino has replied.
+    	//When the line goes idle after the reply rxCmplt will be SET in application callback
     	while(rxCmplt != SET);
 
     	//just make sure that last byte should be null otherwise %s fails while printing
-    	rx_buf[strlen(msg[cnt])+ 1] = '\0';
+    	rx_buf[rx_len] = '\0';
 
     	//Print what we received from the arduino
     	printf("Received    : %s\n",rx_buf);
 
     	//invalidate the flag
+    	rx_len = 0;
     	rxCmplt = RESET;
 
     	//move on to next message indexed in msg[]
@@ -156,12 +185,30 @@ void USART2_IRQHandler(void)
 }
 
 
+void DMA1_Stream5_IRQHandler(void)
+{
+	USART_DMARxIRQHandling(&usart2_handle);
+}
+
+
 
 
 
 void USART_ApplicationEventCallback( USART_Handle_t *pUSARTHandle,uint8_t ApEv)
 {
-   if(ApEv == USART_EVENT_RX_CMPLT)
+   if(ApEv == USART_EVENT_RX_CHUNK)
+   {
+	   //copy the chunk out of the ring before the DMA comes round again
+	   uint32_t len = pUSARTHandle->pRxStream->ChunkLen;
+
+	   if(len > sizeof(rx_buf) - 1 - rx_len)
+	   {
+		   len = sizeof(rx_buf) - 1 - rx_len;
+	   }
+	   memcpy(&rx_buf[rx_len],pUSARTHandle->pRxStream->pChunk,len);
+	   rx_len += len;
+
+   }else if(ApEv == USART_EVENT_IDLE)
    {
 			rxCmplt = SET;
 
@@ -0,0 +1,209 @@
+/*
+ * 017spi_txrx_benchmark.c
+ *
+ *  Created on: Apr 15, 2019
+ *      Author: admin
+ */
+
+/*
+ * Measures full duplex SPI2 throughput with the DWT cycle counter :
+ *  1. byte loop as done in 008spi_cmd_handling.c (SPI_SendData + SPI_ReceiveData per byte)
+ *  2. SPI_TransmitReceive   (blocking, TXE/RXNE in lockstep)
+ *  3. SPI_TransmitReceiveIT
+ *  4. SPI_TransferDMA (DMA1 stream 4 ch 0 : Tx , DMA1 stream 3 ch 0 : Rx)
+ *
+ * SCLK = PCLK1/2 = 8MHz with HSI, so a gap free transfer costs 16 cycles per byte.
+ * Connect PB14 (MISO) to PB15 (MOSI) to also check the received data.
+ */
+
+#include<stdio.h>
+#include<string.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+#define BENCH_LEN		512
+
+SPI_Handle_t SPI2handle;
+DMA_Handle_t DMATxhandle;
+DMA_Handle_t DMARxhandle;
+
+uint8_t TxBuff[BENCH_LEN];
+uint8_t RxBuff[BENCH_LEN];
+
+__vo uint8_t XferDone = RESET;
+
+/*
+ * PB14 --> SPI2_MISO
+ * PB15 --> SPI2_MOSI
+ * PB13 -> SPI2_SCLK
+ * ALT function mode : 5
+ */
+
+void SPI2_GPIOInits(void)
+{
+	GPIO_Handle_t SPIPins;
+
+	SPIPins.pGPIOx = GPIOB;
+	SPIPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	SPIPins.GPIO_PinConfig.GPIO_PinAltFunMode = 5;
+	SPIPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	SPIPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	SPIPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//SCLK
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&SPIPins);
+
+	//MOSI
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_15;
+	GPIO_Init(&SPIPins);
+
+	//MISO
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_14;
+	GPIO_Init(&SPIPins);
+}
+
+void SPI2_Inits(void)
+{
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2handle.SPIConfig.SPI_SclkHz = 8000000; //prescaler is computed from the live PCLK1
+	SPI2handle.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_EN; //software slave management, no NSS pin
+
+	SPI_Init(&SPI2handle);
+
+	//SSI=1 keeps NSS internally high and avoids MODF error
+	SPI_SSIConfig(SPI2,ENABLE);
+}
+
+void DMA1_Inits(void)
+{
+	DMATxhandle.pDMAx = DMA1;
+	DMATxhandle.Stream = 4;
+	DMATxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMATxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	DMATxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	DMARxhandle.pDMAx = DMA1;
+	DMARxhandle.Stream = 3;
+	DMARxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMARxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_VERY_HIGH;
+	DMARxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	SPI2handle.pDMATx = &DMATxhandle;
+	SPI2handle.pDMARx = &DMARxhandle;
+
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM3,ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM4,ENABLE);
+}
+
+void bench_report(char *name, uint32_t cycles)
+{
+	uint32_t errors = 0;
+
+	for(uint32_t i = 0 ; i < BENCH_LEN ; i++)
+	{
+		if(RxBuff[i] != TxBuff[i])
+			errors++;
+	}
+
+	printf("%-22s : %6lu cycles  %3lu.%02lu cycles/byte  mismatches(loopback) %lu\n",name,
+			cycles, cycles / BENCH_LEN, ((cycles % BENCH_LEN) * 100) / BENCH_LEN, errors);
+
+	memset(RxBuff,0,sizeof(RxBuff));
+}
+
+int main(void)
+{
+	uint32_t start, cycles;
+
+	initialise_monitor_handles();
+
+	printf("SPI full duplex benchmark, %d bytes\n",BENCH_LEN);
+
+	for(uint32_t i = 0 ; i < BENCH_LEN ; i++)
+		TxBuff[i] = (uint8_t)i;
+
+	SPI2_GPIOInits();
+	SPI2_Inits();
+	DMA1_Inits();
+
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2,ENABLE);
+
+	DWT_CYCCNT_INIT();
+
+	SPI_PeripheralControl(SPI2,ENABLE);
+
+	//1. byte loop : send a byte, then wait for the byte clocked in
+	start = DWT_CYCCNT_GET();
+	for(uint32_t i = 0 ; i < BENCH_LEN ; i++)
+	{
+		SPI_SendData(SPI2,&TxBuff[i],1);
+		SPI_ReceiveData(SPI2,&RxBuff[i],1);
+	}
+	cycles = DWT_CYCCNT_GET() - start;
+	bench_report("byte loop",cycles);
+
+	//2. blocking full duplex
+	start = DWT_CYCCNT_GET();
+	SPI_TransmitReceive(SPI2,TxBuff,RxBuff,BENCH_LEN);
+	cycles = DWT_CYCCNT_GET() - start;
+	bench_report("SPI_TransmitReceive",cycles);
+
+	//3. interrupt driven full duplex
+	XferDone = RESET;
+	start = DWT_CYCCNT_GET();
+	while(SPI_TransmitReceiveIT(&SPI2handle,TxBuff,RxBuff,BENCH_LEN) != SPI_READY);
+	while(! XferDone);
+	cycles = DWT_CYCCNT_GET() - start;
+	bench_report("SPI_TransmitReceiveIT",cycles);
+
+	//4. DMA full duplex
+	XferDone = RESET;
+	start = DWT_CYCCNT_GET();
+	while(SPI_TransferDMA(&SPI2handle,TxBuff,RxBuff,BENCH_LEN) != SPI_READY);
+	while(! XferDone);
+	cycles = DWT_CYCCNT_GET() - start;
+	bench_report("SPI_TransferDMA",cycles);
+
+	//lets confirm SPI is not busy
+	while( SPI_GetFlagStatus(SPI2,SPI_BUSY_FLAG) );
+
+	SPI_PeripheralControl(SPI2,DISABLE);
+
+	printf("Benchmark done\n");
+
+	while(1);
+
+	return 0;
+}
+
+
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2handle);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	SPI_DMARxIRQHandling(&SPI2handle);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	SPI_DMATxIRQHandling(&SPI2handle);
+}
+
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
+{
+	if(AppEv == SPI_EVENT_RX_CMPLT)
+	{
+		XferDone = SET;
+	}
+}
@@ -0,0 +1,181 @@
+/*
+ * 018spi_dff16_benchmark.c
+ *
+ *  Created on: Apr 16, 2019
+ *      Author: admin
+ */
+
+/*
+ * Sends the same 4KB block over SPI2 in 8 bit and in 16 bit DFF, polled and interrupt driven,
+ * and prints the cycles taken (DWT) and the number of SPI2 interrupts.
+ * At equal byte throughput the 16 bit frames need half the DR accesses / interrupts.
+ * The interrupt runs are repeated with SPI_IRQBurst = IRQ_BURST, the handler then keeps
+ * filling DR while TXE is set and the interrupt entries drop.
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+#define BENCH_LEN		4096
+#define IRQ_BURST		8
+
+SPI_Handle_t SPI2handle;
+
+uint16_t TxBuff[BENCH_LEN / 2];
+
+__vo uint8_t TxDone = RESET;
+
+/*
+ * PB15 --> SPI2_MOSI
+ * PB13 -> SPI2_SCLK
+ * ALT function mode : 5
+ */
+
+void SPI2_GPIOInits(void)
+{
+	GPIO_Handle_t SPIPins;
+
+	SPIPins.pGPIOx = GPIOB;
+	SPIPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	SPIPins.GPIO_PinConfig.GPIO_PinAltFunMode = 5;
+	SPIPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	SPIPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	SPIPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//SCLK
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&SPIPins);
+
+	//MOSI
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_15;
+	GPIO_Init(&SPIPins);
+}
+
+void SPI2_Inits(uint8_t dff, uint8_t burst)
+{
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2handle.SPIConfig.SPI_SclkHz = 8000000; //prescaler is computed from the live PCLK1
+	SPI2handle.SPIConfig.SPI_DFF = dff;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI2handle.SPIConfig.SPI_CRC = SPI_CRC_DI;
+	SPI2handle.SPIConfig.SPI_IRQBurst = burst;
+
+	//SPI_Init rewrites CR1, which also disables the peripheral
+	SPI_Init(&SPI2handle);
+
+	SPI_SSIConfig(SPI2,ENABLE);
+	SPI_PeripheralControl(SPI2,ENABLE);
+}
+
+void bench_report(char *name, uint32_t cycles, uint32_t isr)
+{
+	printf("%-16s : %7lu cycles  %3lu.%02lu cycles/byte  %5lu interrupts\n",name,
+			cycles, cycles / BENCH_LEN, ((cycles % BENCH_LEN) * 100) / BENCH_LEN, isr);
+}
+
+uint32_t bench_polled(uint8_t dff)
+{
+	uint32_t start;
+
+	SPI2_Inits(dff,0);
+
+	start = DWT_CYCCNT_GET();
+	if(dff == SPI_DFF_16BITS)
+	{
+		SPI_SendData16(SPI2,TxBuff,BENCH_LEN / 2);
+	}else
+	{
+		SPI_SendData(SPI2,(uint8_t*)TxBuff,BENCH_LEN);
+	}
+	while( SPI_GetFlagStatus(SPI2,SPI_BUSY_FLAG) );
+
+	return DWT_CYCCNT_GET() - start;
+}
+
+uint32_t bench_it(uint8_t dff, uint8_t burst)
+{
+	uint32_t start;
+
+	SPI2_Inits(dff,burst);
+
+	TxDone = RESET;
+
+	start = DWT_CYCCNT_GET();
+	if(dff == SPI_DFF_16BITS)
+	{
+		SPI_SendData16IT(&SPI2handle,TxBuff,BENCH_LEN / 2);
+	}else
+	{
+		SPI_SendDataIT(&SPI2handle,(uint8_t*)TxBuff,BENCH_LEN);
+	}
+	while(! TxDone);
+	while( SPI_GetFlagStatus(SPI2,SPI_BUSY_FLAG) );
+
+	return DWT_CYCCNT_GET() - start;
+}
+
+int main(void)
+{
+	uint32_t cycles;
+
+	initialise_monitor_handles();
+
+	printf("SPI 8 bit vs 16 bit DFF, %d bytes\n",BENCH_LEN);
+
+	for(uint32_t i = 0 ; i < BENCH_LEN / 2 ; i++)
+		TxBuff[i] = (uint16_t)i;
+
+	SPI2_GPIOInits();
+
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2,ENABLE);
+
+	DWT_CYCCNT_INIT();
+
+	cycles = bench_polled(SPI_DFF_8BITS);
+	bench_report("polled  8 bit",cycles,0);
+
+	cycles = bench_polled(SPI_DFF_16BITS);
+	bench_report("polled 16 bit",cycles,0);
+
+	//IRQEntries is cleared by the driver when the IT transfer is started
+	cycles = bench_it(SPI_DFF_8BITS,0);
+	bench_report("IT      8 bit",cycles,SPI2handle.IRQEntries);
+
+	cycles = bench_it(SPI_DFF_16BITS,0);
+	bench_report("IT     16 bit",cycles,SPI2handle.IRQEntries);
+
+	cycles = bench_it(SPI_DFF_8BITS,IRQ_BURST);
+	bench_report("IT burst  8 bit",cycles,SPI2handle.IRQEntries);
+
+	cycles = bench_it(SPI_DFF_16BITS,IRQ_BURST);
+	bench_report("IT burst 16 bit",cycles,SPI2handle.IRQEntries);
+
+	SPI_PeripheralControl(SPI2,DISABLE);
+
+	printf("Benchmark done\n");
+
+	while(1);
+
+	return 0;
+}
+
+
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2handle);
+}
+
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
+{
+	if(AppEv == SPI_EVENT_TX_CMPLT)
+	{
+		TxDone = SET;
+	}
+}
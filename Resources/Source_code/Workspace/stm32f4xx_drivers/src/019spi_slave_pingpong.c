@@ -0,0 +1,183 @@
+/*
+ * 019spi_slave_pingpong.c
+ *
+ *  Created on: Apr 17, 2019
+ *      Author: admin
+ */
+
+/*
+ * SPI2 slave receiving a continuous stream from the Arduino master
+ * (Resources/Arduino/spi/004SPIMasterStream) with two ping-pong buffers.
+ * DMA1 stream 3 channel 0 fills one buffer while main() checks the other.
+ * A buffer is handed over when it is full or when the master releases NSS.
+ *
+ * The Arduino sends blocks of incrementing bytes, so every byte must be previous + 1.
+ *
+ * PB14 --> SPI2_MISO
+ * PB15 --> SPI2_MOSI
+ * PB13 -> SPI2_SCLK
+ * PB12 --> SPI2_NSS (also EXTI12, rising edge)
+ * ALT function mode : 5
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+#define PINGPONG_LEN	256
+
+SPI_Handle_t SPI2handle;
+DMA_Handle_t DMARxhandle;
+SPI_PingPong_t PingPong;
+
+uint8_t Buff0[PINGPONG_LEN];
+uint8_t Buff1[PINGPONG_LEN];
+
+//handed over buffers, at most 2 can be owned by main() at a time
+uint8_t * __vo ReadyBuff[2];
+__vo uint32_t ReadyLen[2];
+__vo uint8_t ReadyWr = 0;
+uint8_t ReadyRd = 0;
+
+__vo uint32_t Overruns = 0;
+
+void SPI2_GPIOInits(void)
+{
+	GPIO_Handle_t SPIPins;
+
+	SPIPins.pGPIOx = GPIOB;
+	SPIPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	SPIPins.GPIO_PinConfig.GPIO_PinAltFunMode = 5;
+	SPIPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	SPIPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	SPIPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//SCLK
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&SPIPins);
+
+	//MOSI
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_15;
+	GPIO_Init(&SPIPins);
+
+	//MISO
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_14;
+	GPIO_Init(&SPIPins);
+
+	//NSS
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	SPIPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	GPIO_Init(&SPIPins);
+
+	//NSS rising edge also goes to EXTI12, the pin stays in alternate function mode
+	SPIPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_RT;
+	GPIO_Init(&SPIPins);
+}
+
+void SPI2_Inits(void)
+{
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_SLAVE;
+	SPI2handle.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV2;//don't care for a slave
+	SPI2handle.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_DI; //Hardware slave management enabled for NSS pin
+	SPI2handle.SPIConfig.SPI_CRC = SPI_CRC_DI;
+
+	SPI_Init(&SPI2handle);
+
+	DMARxhandle.pDMAx = DMA1;
+	DMARxhandle.Stream = 3;
+	DMARxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMARxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_VERY_HIGH;
+	DMARxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	SPI2handle.pDMARx = &DMARxhandle;
+}
+
+int main(void)
+{
+	uint8_t *pBuf;
+	uint32_t len;
+	uint8_t expected = 0;
+	uint32_t total = 0, errors = 0;
+
+	initialise_monitor_handles();
+
+	printf("SPI2 slave ping-pong reception\n");
+
+	SPI2_GPIOInits();
+	SPI2_Inits();
+
+	//NSS and the Rx stream must not preempt each other
+	GPIO_IRQPriorityConfig(IRQ_NO_EXTI15_10,NVIC_IRQ_PRI15);
+	DMA_IRQPriorityConfig(IRQ_NO_DMA1_STREAM3,NVIC_IRQ_PRI15);
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI15_10,ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM3,ENABLE);
+
+	PingPong.pBuffer[0] = Buff0;
+	PingPong.pBuffer[1] = Buff1;
+	PingPong.Len = PINGPONG_LEN;
+
+	SPI_SlaveReceivePingPong(&SPI2handle,&PingPong);
+
+	SPI_PeripheralControl(SPI2,ENABLE);
+
+	while(1)
+	{
+		if(ReadyRd == ReadyWr)
+			continue;
+
+		pBuf = ReadyBuff[ReadyRd & 1];
+		len = ReadyLen[ReadyRd & 1];
+
+		//1. each byte must follow the previous one, even across buffers and NSS pulses
+		for(uint32_t i = 0 ; i < len ; i++)
+		{
+			if(pBuf[i] != expected)
+				errors++;
+			expected = pBuf[i] + 1;
+		}
+		total += len;
+
+		//2. the buffer goes back to the driver, no copy was made
+		SPI_SlaveReleaseBuffer(&SPI2handle,pBuf);
+		ReadyRd++;
+
+		if( (total % (64 * 1024)) < len )
+		{
+			printf("received %lu bytes, %lu sequence errors, %lu overruns\n",total,errors,Overruns);
+		}
+	}
+
+	return 0;
+}
+
+
+void EXTI15_10_IRQHandler(void)
+{
+	GPIO_IRQHandling(GPIO_PIN_NO_12);
+	SPI_SlaveNSSHandling(&SPI2handle);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	SPI_DMARxIRQHandling(&SPI2handle);
+}
+
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
+{
+	if(AppEv == SPI_EVENT_RX_BUF_READY)
+	{
+		ReadyBuff[ReadyWr & 1] = pSPIHandle->pPingPong->pReady;
+		ReadyLen[ReadyWr & 1] = pSPIHandle->pPingPong->ReadyLen;
+		ReadyWr++;
+	}else if(AppEv == SPI_EVENT_OVR_ERR)
+	{
+		Overruns++;
+	}
+}
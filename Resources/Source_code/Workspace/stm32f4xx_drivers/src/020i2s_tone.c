@@ -0,0 +1,183 @@
+/*
+ * 020i2s_tone.c
+ *
+ *  Created on: Apr 18, 2019
+ *      Author: admin
+ */
+
+/*
+ * I2S3 master transmitter streaming a 1kHz sine (48kHz, 16 bit stereo, MCLK = 256 * Fs)
+ * from a circular buffer. DMA1 stream 5 channel 0 (SPI3_TX) plays one half of the buffer
+ * while the half complete / complete callbacks compute the next samples into the other half.
+ *
+ * The on board CS43L22 needs its I2C setup to produce sound, without it check the
+ * lines with a logic analyzer or feed an external I2S DAC.
+ *
+ * PC7  --> I2S3_MCK
+ * PC10 --> I2S3_CK
+ * PC12 --> I2S3_SD
+ * PA4  --> I2S3_WS
+ * ALT function mode : 6
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+//stereo frames per half buffer, 2ms of audio at 48kHz
+#define HALF_FRAMES		96
+
+I2S_Handle_t I2S3handle;
+DMA_Handle_t DMATxhandle;
+
+//left, right, left, right ..
+int16_t AudioBuff[2 * HALF_FRAMES * 2];
+
+//one period of a 1kHz sine at 48kHz
+const int16_t SineTable[48] =
+{
+	     0,   2138,   4240,   6270,   8191,   9973,  11585,  12998,
+	 14188,  15136,  15825,  16243,  16383,  16243,  15825,  15136,
+	 14188,  12998,  11585,   9973,   8191,   6270,   4240,   2138,
+	     0,  -2138,  -4240,  -6270,  -8191,  -9973, -11585, -12998,
+	-14188, -15136, -15825, -16243, -16383, -16243, -15825, -15136,
+	-14188, -12998, -11585,  -9973,  -8192,  -6270,  -4240,  -2138,
+};
+
+uint8_t Phase = 0;
+__vo uint32_t HalvesPlayed = 0;
+__vo uint32_t Underruns = 0;
+
+void I2S3_GPIOInits(void)
+{
+	GPIO_Handle_t I2SPins;
+
+	I2SPins.pGPIOx = GPIOC;
+	I2SPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	I2SPins.GPIO_PinConfig.GPIO_PinAltFunMode = 6;
+	I2SPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	I2SPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	I2SPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//MCK
+	I2SPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_7;
+	GPIO_Init(&I2SPins);
+
+	//CK
+	I2SPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_10;
+	GPIO_Init(&I2SPins);
+
+	//SD
+	I2SPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	GPIO_Init(&I2SPins);
+
+	//WS
+	I2SPins.pGPIOx = GPIOA;
+	I2SPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_4;
+	GPIO_Init(&I2SPins);
+}
+
+void I2S3_Inits(void)
+{
+	I2S3handle.pSPIx = SPI3;
+	I2S3handle.I2SConfig.I2S_Mode = I2S_MODE_MASTER_TX;
+	I2S3handle.I2SConfig.I2S_Standard = I2S_STANDARD_PHILIPS;
+	I2S3handle.I2SConfig.I2S_DataFormat = I2S_DATAFORMAT_16B;
+	I2S3handle.I2SConfig.I2S_MCLKOutput = ENABLE;
+	I2S3handle.I2SConfig.I2S_CPOL = I2S_CPOL_LOW;
+	I2S3handle.I2SConfig.I2S_AudioFreq = 48000;
+
+	DMATxhandle.pDMAx = DMA1;
+	DMATxhandle.Stream = 5;
+	DMATxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMATxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	DMATxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	I2S3handle.pDMA = &DMATxhandle;
+
+	I2S_Init(&I2S3handle);
+}
+
+/*
+ * computes the next HALF_FRAMES stereo frames into pBuf
+ */
+void audio_fill(int16_t *pBuf)
+{
+	for(uint32_t i = 0 ; i < HALF_FRAMES ; i++)
+	{
+		pBuf[2 * i] = SineTable[Phase];			//left
+		pBuf[2 * i + 1] = SineTable[Phase] / 2;	//right, 6dB lower
+
+		if(++Phase == sizeof(SineTable) / sizeof(SineTable[0]))
+			Phase = 0;
+	}
+}
+
+int main(void)
+{
+	I2S_Clock_t clock;
+	uint32_t reported = 0;
+
+	initialise_monitor_handles();
+
+	printf("I2S3 1kHz tone, requested Fs %lu Hz\n",48000UL);
+
+	I2S3_GPIOInits();
+	I2S3_Inits();
+
+	//the driver has already programmed it, this is only to print the settings
+	I2S_ComputeClock(&I2S3handle.I2SConfig,&clock);
+	printf("PLLI2SN %u PLLI2SR %u I2SDIV %u ODD %u : Fs %lu Hz\n",clock.PLLI2SN,clock.PLLI2SR,
+			clock.I2SDIV,clock.ODD,I2S3handle.AudioFreqReal);
+
+	//both halves are valid before the first request
+	audio_fill(&AudioBuff[0]);
+	audio_fill(&AudioBuff[2 * HALF_FRAMES]);
+
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM5,ENABLE);
+	SPI_IRQInterruptConfig(IRQ_NO_SPI3,ENABLE);
+
+	I2S_StartStream(&I2S3handle,(uint16_t*)AudioBuff,sizeof(AudioBuff) / sizeof(uint16_t));
+
+	while(1)
+	{
+		//every 10 seconds
+		if(HalvesPlayed - reported >= 5000)
+		{
+			reported = HalvesPlayed;
+			printf("%lu half buffers played, %lu underruns\n",reported,Underruns);
+		}
+	}
+
+	return 0;
+}
+
+
+void DMA1_Stream5_IRQHandler(void)
+{
+	I2S_DMAIRQHandling(&I2S3handle);
+}
+
+void SPI3_IRQHandler(void)
+{
+	I2S_IRQHandling(&I2S3handle);
+}
+
+
+void I2S_ApplicationEventCallback(I2S_Handle_t *pI2SHandle,uint8_t AppEv)
+{
+	if(AppEv == I2S_EVENT_HALF_CMPLT)
+	{
+		//first half was played, DMA now reads the second half
+		audio_fill(&AudioBuff[0]);
+		HalvesPlayed++;
+	}else if(AppEv == I2S_EVENT_CMPLT)
+	{
+		audio_fill(&AudioBuff[2 * HALF_FRAMES]);
+		HalvesPlayed++;
+	}else if(AppEv == I2S_EVENT_UDR_ERR)
+	{
+		Underruns++;
+	}
+}
@@ -0,0 +1,208 @@
+/*
+ * 021spi_benchmark.c
+ *
+ *  Created on: Apr 19, 2019
+ *      Author: admin
+ */
+
+/*
+ * SPI2 transmit benchmark over transfer sizes from 1 byte to 64KB, for each size and mode :
+ *  - cycles of one transfer (DWT), from the API call to the last frame out of the shift register
+ *  - CPU cycles per byte
+ *  - bytes/s
+ *  - interrupt entries per transfer (SPI2 for the IT modes, DMA1 stream 4 for DMA)
+ *
+ * Modes : polled (SPI_SendData), IT (SPI_SendDataIT), IT with SPI_IRQBurst = IRQ_BURST,
+ * DMA (SPI_SendDataDMA, DMA1 stream 4 ch 0, chunked above 65535 bytes).
+ *
+ * With HSI, SYSCLK = 16MHz and SCLK = PCLK1/2 = 8MHz, the wire limit is 16 cycles/byte (1MB/s).
+ * The 1 byte row is the fixed cost (latency) of each mode.
+ *
+ * PB15 --> SPI2_MOSI
+ * PB13 -> SPI2_SCLK
+ * ALT function mode : 5
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+#define SYSCLK_HZ		16000000
+#define BENCH_MAX_LEN	(64 * 1024)
+#define IRQ_BURST		8
+
+#define MODE_POLLED		0
+#define MODE_IT			1
+#define MODE_IT_BURST	2
+#define MODE_DMA		3
+
+SPI_Handle_t SPI2handle;
+DMA_Handle_t DMATxhandle;
+
+uint8_t TxBuff[BENCH_MAX_LEN];
+
+char *ModeName[4] = { "polled", "IT", "IT burst", "DMA" };
+
+__vo uint8_t TxDone = RESET;
+__vo uint32_t DmaIsrEntries = 0;
+
+void SPI2_GPIOInits(void)
+{
+	GPIO_Handle_t SPIPins;
+
+	SPIPins.pGPIOx = GPIOB;
+	SPIPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	SPIPins.GPIO_PinConfig.GPIO_PinAltFunMode = 5;
+	SPIPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	SPIPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	SPIPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//SCLK
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&SPIPins);
+
+	//MOSI
+	SPIPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_15;
+	GPIO_Init(&SPIPins);
+}
+
+void SPI2_Inits(void)
+{
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2handle.SPIConfig.SPI_SclkHz = 8000000; //prescaler is computed from the live PCLK1
+	SPI2handle.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI2handle.SPIConfig.SPI_CRC = SPI_CRC_DI;
+
+	SPI_Init(&SPI2handle);
+
+	SPI_SSIConfig(SPI2,ENABLE);
+
+	DMATxhandle.pDMAx = DMA1;
+	DMATxhandle.Stream = 4;
+	DMATxhandle.DMAConfig.DMA_Channel = DMA_CHANNEL_0;
+	DMATxhandle.DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	DMATxhandle.DMAConfig.DMA_FIFOMode = DMA_FIFOMODE_DI;
+
+	SPI2handle.pDMATx = &DMATxhandle;
+}
+
+/*
+ * runs one transfer of len bytes, returns the cycles taken and the interrupt entries in *pIsr
+ */
+uint32_t bench_run(uint8_t mode, uint32_t len, uint32_t *pIsr)
+{
+	uint32_t start, cycles;
+
+	TxDone = RESET;
+	DmaIsrEntries = 0;
+	SPI2handle.SPIConfig.SPI_IRQBurst = (mode == MODE_IT_BURST) ? IRQ_BURST : 0;
+
+	start = DWT_CYCCNT_GET();
+
+	if(mode == MODE_POLLED)
+	{
+		SPI_SendData(SPI2,TxBuff,len);
+	}else
+	{
+		if(mode == MODE_DMA)
+		{
+			SPI_SendDataDMA(&SPI2handle,TxBuff,len);
+		}else
+		{
+			SPI_SendDataIT(&SPI2handle,TxBuff,len);
+		}
+		while(! TxDone);
+	}
+	while( SPI_GetFlagStatus(SPI2,SPI_BUSY_FLAG) );
+
+	cycles = DWT_CYCCNT_GET() - start;
+
+	if(mode == MODE_DMA)
+	{
+		*pIsr = DmaIsrEntries;
+	}else if(mode == MODE_POLLED)
+	{
+		*pIsr = 0;
+	}else
+	{
+		*pIsr = SPI2handle.IRQEntries;
+	}
+
+	return cycles;
+}
+
+void bench_report(uint8_t mode, uint32_t len, uint32_t cycles, uint32_t isr)
+{
+	//bytes/s = len * SYSCLK / cycles, 64 bit as len * SYSCLK does not fit in 32 bits
+	uint32_t bps = (uint32_t)( ( (uint64_t)len * SYSCLK_HZ ) / cycles );
+
+	printf("%6lu %-9s %8lu %5lu.%02lu %8lu %6lu\n",len,ModeName[mode],cycles,
+			cycles / len, ((cycles % len) * 100) / len, bps, isr);
+}
+
+int main(void)
+{
+	uint32_t cycles, isr;
+
+	initialise_monitor_handles();
+
+	for(uint32_t i = 0 ; i < BENCH_MAX_LEN ; i++)
+		TxBuff[i] = (uint8_t)i;
+
+	SPI2_GPIOInits();
+	SPI2_Inits();
+
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2,ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM4,ENABLE);
+
+	DWT_CYCCNT_INIT();
+
+	SPI_PeripheralControl(SPI2,ENABLE);
+
+	printf("SPI2 transmit benchmark, SYSCLK %lu Hz, SCLK %lu Hz\n",(uint32_t)SYSCLK_HZ,SPI_GetSclkValue(SPI2));
+	printf("  size mode        cycles   cyc/B      B/s    isr\n");
+
+	for(uint32_t len = 1 ; len <= BENCH_MAX_LEN ; len *= 2)
+	{
+		for(uint8_t mode = MODE_POLLED ; mode <= MODE_DMA ; mode++)
+		{
+			cycles = bench_run(mode,len,&isr);
+			bench_report(mode,len,cycles,isr);
+		}
+	}
+
+	SPI_PeripheralControl(SPI2,DISABLE);
+
+	printf("Benchmark done\n");
+
+	while(1);
+
+	return 0;
+}
+
+
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2handle);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	DmaIsrEntries++;
+	SPI_DMATxIRQHandling(&SPI2handle);
+}
+
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle,uint8_t AppEv)
+{
+	if(AppEv == SPI_EVENT_TX_CMPLT)
+	{
+		TxDone = SET;
+	}
+}
@@ -0,0 +1,162 @@
+/*
+ * 023i2c_slave_regfile.c
+ *
+ *  Created on: Apr 22, 2019
+ *      Author: admin
+ */
+
+/*
+ * I2C1 slave at 0x68 exposing a register map, served by the driver without any code in the
+ * application callback (compare with 014i2c_slave_tx_string2.c) :
+ *
+ *  0x00       WHO_AM_I   RO  0xA5
+ *  0x01       STATUS     RO  bit 0 : LED on
+ *  0x04-0x07  UPTIME     RO  main loop passes, little endian
+ *  0x10       LED_CTRL   RW  bit 0 drives the green LED, applied by the OnWrite hook
+ *  0x20-0x3F  SCRATCH    RW  32 bytes of free memory
+ *
+ * Master side (e.g. Arduino Wire) : write {0x04} then read 4 bytes returns UPTIME,
+ * write {0x10, 0x01} turns the LED on, write {0x20, ...} fills SCRATCH.
+ *
+ * PB6-> SCL
+ * PB7 -> SDA
+ */
+
+#include<stdint.h>
+#include "stm32f407xx.h"
+
+#define MY_ADDR 0x68
+
+I2C_Handle_t I2C1Handle;
+
+uint8_t WhoAmI = 0xA5;
+uint8_t Status = 0;
+uint8_t Uptime[4];
+uint8_t LedCtrl = 0;
+uint8_t Scratch[32];
+
+void led_ctrl_written(I2C_Register_t *pReg);
+
+//sorted by address
+I2C_Register_t RegTable[] =
+{
+	{ 0x00, 1, 						I2C_REG_RO, &WhoAmI, 	NULL },
+	{ 0x01, 1, 						I2C_REG_RO, &Status, 	NULL },
+	{ 0x04, sizeof(Uptime), 		I2C_REG_RO, Uptime, 	NULL },
+	{ 0x10, 1, 						I2C_REG_RW, &LedCtrl, 	led_ctrl_written },
+	{ 0x20, sizeof(Scratch), 		I2C_REG_RW, Scratch, 	NULL },
+};
+
+I2C_RegFile_t RegFile = { RegTable, sizeof(RegTable) / sizeof(RegTable[0]) };
+
+void I2C1_GPIOInits(void)
+{
+	GPIO_Handle_t I2CPins;
+
+	I2CPins.pGPIOx = GPIOB;
+	I2CPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	I2CPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_OD;
+	I2CPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	I2CPins.GPIO_PinConfig.GPIO_PinAltFunMode = 4;
+	I2CPins.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//scl
+	I2CPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_6;
+	GPIO_Init(&I2CPins);
+
+	//sda
+	I2CPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_7;
+	GPIO_Init(&I2CPins);
+}
+
+void I2C1_Inits(void)
+{
+	I2C1Handle.pI2Cx = I2C1;
+	I2C1Handle.I2C_Config.I2C_AckControl = I2C_ACK_ENABLE;
+	I2C1Handle.I2C_Config.I2C_DeviceAddress = MY_ADDR;
+	I2C1Handle.I2C_Config.I2C_FMDutyCycle = I2C_FM_DUTY_2;
+	I2C1Handle.I2C_Config.I2C_SCLSpeed = I2C_SCL_SPEED_SM;
+
+	if(I2C_Init(&I2C1Handle) != I2C_TIMING_OK)
+	{
+		//SCL speed not reachable from this PCLK1, nothing can run
+		while(1);
+	}
+}
+
+void GPIO_LedInit(void)
+{
+	GPIO_Handle_t GpioLed;
+
+	GpioLed.pGPIOx = GPIOD;
+	GpioLed.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	GpioLed.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	GpioLed.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GpioLed.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GpioLed.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_PeriClockControl(GPIOD,ENABLE);
+
+	GPIO_Init(&GpioLed);
+}
+
+/*
+ * OnWrite hook of LED_CTRL, runs in the I2C event interrupt
+ */
+void led_ctrl_written(I2C_Register_t *pReg)
+{
+	GPIO_WriteToOutputPin(GPIOD,GPIO_PIN_NO_12,*pReg->pData & 1);
+	Status = *pReg->pData & 1;
+}
+
+int main(void)
+{
+	uint32_t passes = 0;
+
+	GPIO_LedInit();
+
+	//i2c pin inits
+	I2C1_GPIOInits();
+
+	//i2c peripheral configuration
+	I2C1_Inits();
+
+	//enable the i2c peripheral
+	I2C_PeripheralControl(I2C1,ENABLE);
+
+	//ack bit is made 1 after PE=1
+	I2C_ManageAcking(I2C1,I2C_ACK_ENABLE);
+
+	I2C_IRQInterruptConfig(IRQ_NO_I2C1_ER,ENABLE);
+	I2C_IRQInterruptConfig(IRQ_NO_I2C1_EV,ENABLE);
+
+	//from here on the driver answers the master
+	I2C_SlaveRegFileInit(&I2C1Handle,&RegFile);
+
+	while(1)
+	{
+		passes++;
+		Uptime[0] = (uint8_t)passes;
+		Uptime[1] = (uint8_t)(passes >> 8);
+		Uptime[2] = (uint8_t)(passes >> 16);
+		Uptime[3] = (uint8_t)(passes >> 24);
+	}
+}
+
+
+void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	//I2C_EV_STOP and bus errors only, the register file needs nothing from here
+}
+
+
+void I2C1_EV_IRQHandler(void)
+{
+	I2C_EV_IRQHandling(&I2C1Handle);
+}
+
+
+void I2C1_ER_IRQHandler(void)
+{
+	I2C_ER_IRQHandling(&I2C1Handle);
+}
@@ -0,0 +1,137 @@
+/*
+ * 024uart_ring_echo.c
+ *
+ *  Created on: Apr 22, 2019
+ *      Author: admin
+ */
+
+/*
+ * Echoes every byte received on USART2 through the Tx/Rx rings (USART_Write/USART_Read).
+ * Neither side ever waits on the USART, the loop only moves what is there.
+ * Press the user button to print the ring stats, use them to size the rings.
+ *
+ * PA2 -> USART2_TX
+ * PA3 -> USART2_RX
+ * PA0 -> user button
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+
+#define TX_RING_SIZE	256		/* power of two */
+#define RX_RING_SIZE	128		/* power of two */
+
+uint8_t tx_storage[TX_RING_SIZE];
+uint8_t rx_storage[RX_RING_SIZE];
+
+USART_Ring_t tx_ring;
+USART_Ring_t rx_ring;
+
+USART_Handle_t usart2_handle;
+
+extern void initialise_monitor_handles();
+
+void USART2_Init(void)
+{
+	uint8_t status;
+
+	usart2_handle.pUSARTx = USART2;
+	usart2_handle.USART_Config.USART_Baud = USART_STD_BAUD_115200;
+	usart2_handle.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
+	usart2_handle.USART_Config.USART_Mode = USART_MODE_TXRX;
+	usart2_handle.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
+	usart2_handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
+	usart2_handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
+	status = USART_Init(&usart2_handle);
+	if(status != USART_BAUD_OK)
+	{
+		//USART_BAUD_ERR_RANGE / USART_BAUD_ERR_TOLERANCE : the APB clock can not give this baud rate
+		printf("USART2 : baud rate refused, error %d\n",status);
+		while(1);
+	}
+}
+
+void USART2_GPIOInit(void)
+{
+	GPIO_Handle_t usart_gpios;
+
+	usart_gpios.pGPIOx = GPIOA;
+	usart_gpios.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	usart_gpios.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	usart_gpios.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	usart_gpios.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	usart_gpios.GPIO_PinConfig.GPIO_PinAltFunMode = 7;
+
+	usart_gpios.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_2;
+	GPIO_Init(&usart_gpios);
+
+	usart_gpios.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_3;
+	GPIO_Init(&usart_gpios);
+}
+
+void GPIO_ButtonInit(void)
+{
+	GPIO_Handle_t GPIOBtn;
+
+	GPIOBtn.pGPIOx = GPIOA;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_0;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IN;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_Init(&GPIOBtn);
+}
+
+int main(void)
+{
+	uint8_t buf[32];
+	uint32_t len;
+	uint8_t pressed = 0;
+
+	initialise_monitor_handles();
+
+	GPIO_ButtonInit();
+	USART2_GPIOInit();
+	USART2_Init();
+
+	USART_RingInit(&tx_ring,tx_storage,sizeof(tx_storage));
+	USART_RingInit(&rx_ring,rx_storage,sizeof(rx_storage));
+	USART_AttachRings(&usart2_handle,&tx_ring,&rx_ring);
+
+	USART_IRQInterruptConfig(IRQ_NO_USART2,ENABLE);
+	USART_PeripheralControl(USART2,ENABLE);
+
+	printf("Application is running\n");
+
+	while(1)
+	{
+		//echo whatever came in since the last pass
+		len = USART_Read(&usart2_handle,buf,sizeof(buf));
+		if(len)
+		{
+			USART_Write(&usart2_handle,buf,len);
+		}
+
+		//print the stats once per button press
+		if(GPIO_ReadFromInputPin(GPIOA,GPIO_PIN_NO_0))
+		{
+			if(!pressed)
+			{
+				printf("tx ring : high water %lu/%lu dropped %lu\n",tx_ring.HighWater,tx_ring.Size,tx_ring.Dropped);
+				printf("rx ring : high water %lu/%lu dropped %lu\n",rx_ring.HighWater,rx_ring.Size,rx_ring.Dropped);
+			}
+			pressed = 1;
+		}else
+		{
+			pressed = 0;
+		}
+	}
+
+	return 0;
+}
+
+
+void USART2_IRQHandler(void)
+{
+	USART_IRQHandling(&usart2_handle);
+}
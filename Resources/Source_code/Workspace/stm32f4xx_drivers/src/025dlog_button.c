@@ -0,0 +1,127 @@
+/*
+ * 025dlog_button.c
+ *
+ *  Created on: Apr 23, 2019
+ *      Author: admin
+ */
+
+/*
+ * Deferred logging (bsp/dlog.h) from the thread and from an ISR. The button interrupt
+ * logs every edge with its latency, the main loop logs a heartbeat and drains the log
+ * ring in to the USART2 Tx ring. Nothing is formatted on the target, decode with
+ *     python3 tools/dlog.py Debug/stm32f4xx_drivers.elf capture.bin --hclk 16000000
+ *
+ * PA2 -> USART2_TX (115200 8N1, capture it raw)
+ * PA0 -> user button
+ */
+
+#include "stm32f407xx.h"
+#include "dlog.h"
+
+#define HEARTBEAT_CYCLES	16000000U	/* 1s at 16MHz HSI */
+
+uint8_t tx_storage[512];
+USART_Ring_t tx_ring;
+
+USART_Handle_t usart2_handle;
+
+uint32_t presses;
+
+void USART2_Init(void)
+{
+	uint8_t status;
+
+	usart2_handle.pUSARTx = USART2;
+	usart2_handle.USART_Config.USART_Baud = USART_STD_BAUD_115200;
+	usart2_handle.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
+	usart2_handle.USART_Config.USART_Mode = USART_MODE_ONLY_TX;
+	usart2_handle.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
+	usart2_handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
+	usart2_handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
+	status = USART_Init(&usart2_handle);
+	if(status != USART_BAUD_OK)
+	{
+		//USART_BAUD_ERR_RANGE / USART_BAUD_ERR_TOLERANCE : the APB clock can not give this baud rate,
+		//nothing would come out of the line
+		while(1);
+	}
+}
+
+void USART2_GPIOInit(void)
+{
+	GPIO_Handle_t usart_gpios;
+
+	usart_gpios.pGPIOx = GPIOA;
+	usart_gpios.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	usart_gpios.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	usart_gpios.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	usart_gpios.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	usart_gpios.GPIO_PinConfig.GPIO_PinAltFunMode = 7;
+	usart_gpios.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_2;
+	GPIO_Init(&usart_gpios);
+}
+
+void GPIO_ButtonInit(void)
+{
+	GPIO_Handle_t GPIOBtn;
+
+	//button pulls PA0 high, interrupt on the rising edge
+	GPIOBtn.pGPIOx = GPIOA;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_0;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_RT;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_Init(&GPIOBtn);
+
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI0,ENABLE);
+}
+
+int main(void)
+{
+	uint32_t last = 0;
+	uint32_t beats = 0;
+
+	USART2_GPIOInit();
+	USART2_Init();
+
+	USART_RingInit(&tx_ring,tx_storage,sizeof(tx_storage));
+	USART_AttachRings(&usart2_handle,&tx_ring,NULL);
+
+	USART_IRQInterruptConfig(IRQ_NO_USART2,ENABLE);
+	USART_PeripheralControl(USART2,ENABLE);
+
+	dlog_init(&usart2_handle);
+	DLOG("dlog_button running, ring of %u words", DLOG_RING_WORDS);
+
+	GPIO_ButtonInit();
+
+	while(1)
+	{
+		if(DWT_CYCCNT_GET() - last >= HEARTBEAT_CYCLES)
+		{
+			last = DWT_CYCCNT_GET();
+			DLOG("heartbeat %lu, %lu presses, log ring high water %lu dropped %lu",
+					++beats, presses, DLOG_Ring.HighWater, DLOG_Ring.Dropped);
+		}
+
+		dlog_drain();
+	}
+
+	return 0;
+}
+
+
+void EXTI0_IRQHandler(void)
+{
+	GPIO_IRQHandling(GPIO_PIN_NO_0);
+
+	//cheap enough to stay in the ISR
+	DLOG("button press %lu, level %u", ++presses, GPIO_ReadFromInputPin(GPIOA,GPIO_PIN_NO_0));
+}
+
+
+void USART2_IRQHandler(void)
+{
+	USART_IRQHandling(&usart2_handle);
+}
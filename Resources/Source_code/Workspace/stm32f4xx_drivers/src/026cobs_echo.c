@@ -0,0 +1,147 @@
+/*
+ * 026cobs_echo.c
+ *
+ *  Created on: Apr 23, 2019
+ *      Author: admin
+ */
+
+/*
+ * Packet echo over USART2 with bsp/cobs.h : every good frame received is sent back as is.
+ * Frames are COBS encoded with a CRC-16 and end with 0x00, so binary payloads go through
+ * and a lost byte costs one frame instead of shifting every message after it (the newline
+ * and fixed length framing of 016uart_case.c cannot recover from that).
+ * Press the user button to print the link stats.
+ *
+ * PA2 -> USART2_TX
+ * PA3 -> USART2_RX
+ * PA0 -> user button
+ */
+
+#include<stdio.h>
+#include "stm32f407xx.h"
+#include "cobs.h"
+
+#define TX_RING_SIZE	512		/* power of two, a few encoded frames */
+#define RX_RING_SIZE	512		/* power of two, largest encoded frame plus what arrives meanwhile */
+#define FRAME_SIZE		256		/* largest payload which may wrap around the end of the Rx ring */
+
+uint8_t tx_storage[TX_RING_SIZE];
+uint8_t rx_storage[RX_RING_SIZE];
+uint8_t frame[FRAME_SIZE];
+
+USART_Ring_t tx_ring;
+USART_Ring_t rx_ring;
+
+USART_Handle_t usart2_handle;
+COBS_Link_t link;
+
+extern void initialise_monitor_handles();
+
+void USART2_Init(void)
+{
+	uint8_t status;
+
+	usart2_handle.pUSARTx = USART2;
+	usart2_handle.USART_Config.USART_Baud = USART_STD_BAUD_115200;
+	usart2_handle.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
+	usart2_handle.USART_Config.USART_Mode = USART_MODE_TXRX;
+	usart2_handle.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
+	usart2_handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
+	usart2_handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
+	status = USART_Init(&usart2_handle);
+	if(status != USART_BAUD_OK)
+	{
+		//USART_BAUD_ERR_RANGE / USART_BAUD_ERR_TOLERANCE : the APB clock can not give this baud rate
+		printf("USART2 : baud rate refused, error %d\n",status);
+		while(1);
+	}
+}
+
+void USART2_GPIOInit(void)
+{
+	GPIO_Handle_t usart_gpios;
+
+	usart_gpios.pGPIOx = GPIOA;
+	usart_gpios.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	usart_gpios.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	usart_gpios.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	usart_gpios.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	usart_gpios.GPIO_PinConfig.GPIO_PinAltFunMode = 7;
+
+	usart_gpios.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_2;
+	GPIO_Init(&usart_gpios);
+
+	usart_gpios.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_3;
+	GPIO_Init(&usart_gpios);
+}
+
+void GPIO_ButtonInit(void)
+{
+	GPIO_Handle_t GPIOBtn;
+
+	GPIOBtn.pGPIOx = GPIOA;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_0;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IN;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GPIOBtn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_Init(&GPIOBtn);
+}
+
+int main(void)
+{
+	uint8_t pressed = 0;
+
+	initialise_monitor_handles();
+
+	GPIO_ButtonInit();
+	USART2_GPIOInit();
+	USART2_Init();
+
+	USART_RingInit(&tx_ring,tx_storage,sizeof(tx_storage));
+	USART_RingInit(&rx_ring,rx_storage,sizeof(rx_storage));
+	USART_AttachRings(&usart2_handle,&tx_ring,&rx_ring);
+
+	cobs_init(&link,&usart2_handle,frame,sizeof(frame));
+
+	USART_IRQInterruptConfig(IRQ_NO_USART2,ENABLE);
+	USART_PeripheralControl(USART2,ENABLE);
+
+	printf("Application is running\n");
+
+	while(1)
+	{
+		//decode what came in, cobs_frame_callback runs for each complete frame
+		cobs_poll(&link);
+
+		//print the stats once per button press
+		if(GPIO_ReadFromInputPin(GPIOA,GPIO_PIN_NO_0))
+		{
+			if(!pressed)
+			{
+				printf("frames %lu crc errors %lu format errors %lu oversize %lu tx full %lu\n",
+						link.Frames,link.CRCErrors,link.FormatErrors,link.Oversize,link.TxFull);
+				printf("rx ring : high water %lu/%lu dropped %lu\n",rx_ring.HighWater,rx_ring.Size,rx_ring.Dropped);
+			}
+			pressed = 1;
+		}else
+		{
+			pressed = 0;
+		}
+	}
+
+	return 0;
+}
+
+
+void cobs_frame_callback(COBS_Link_t *pLink, uint8_t *pPayload, uint32_t Len)
+{
+	//the payload is still in the Rx ring here, it is encoded again straight in to the Tx ring
+	cobs_send(pLink,pPayload,Len);
+}
+
+
+void USART2_IRQHandler(void)
+{
+	USART_IRQHandling(&usart2_handle);
+}
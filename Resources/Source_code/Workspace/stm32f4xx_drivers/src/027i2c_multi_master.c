@@ -0,0 +1,203 @@
+/*
+ * 027i2c_multi_master.c
+ *
+ *  Created on: Apr 23, 2019
+ *      Author: admin
+ */
+
+/*
+ * Two (or more) boards running this application share one bus as masters, with the
+ * 023i2c_slave_regfile.c board as slave at 0x68. Each master toggles the LED_CTRL register
+ * and reads UPTIME back through the transaction queue, as fast as the bus allows, so the
+ * masters keep colliding. A lost arbitration is retried up to I2C_ArloRetries times after a
+ * random backoff.
+ *
+ * The queue runs back to back from the ISRs. A transaction waiting for its backoff is started
+ * by I2C_TimeoutHandling, called on every pass of the main loop.
+ *
+ * PB6-> SCL
+ * PB7 -> SDA
+ */
+
+#include<stdio.h>
+#include<string.h>
+#include "stm32f407xx.h"
+
+extern void initialise_monitor_handles();
+
+#define MY_ADDR 0x61
+
+#define SLAVE_ADDR  0x68
+#define REG_UPTIME	0x04
+#define REG_LED		0x10
+
+I2C_Handle_t I2C1Handle;
+
+I2C_Transaction_t LedTrans;
+I2C_Transaction_t UptimeTrans;
+
+uint8_t led_value;
+uint8_t uptime_buf[4];
+
+//transactions of the current round still running
+__vo uint8_t pending = 0;
+__vo uint32_t done_count = 0;
+__vo uint32_t error_count = 0;
+
+/*
+ * PB6-> SCL
+ * PB7 -> SDA
+ */
+
+void I2C1_GPIOInits(void)
+{
+	GPIO_Handle_t I2CPins;
+
+	I2CPins.pGPIOx = GPIOB;
+	I2CPins.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	I2CPins.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_OD;
+	I2CPins.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	I2CPins.GPIO_PinConfig.GPIO_PinAltFunMode = 4;
+	I2CPins. GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+
+	//scl
+	I2CPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_6;
+	GPIO_Init(&I2CPins);
+
+
+	//sda
+	I2CPins.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_7;
+	GPIO_Init(&I2CPins);
+
+	//bus clear pins for I2C_BusRecover
+	I2C1Handle.pSCLPort = GPIOB;
+	I2C1Handle.SCLPin = GPIO_PIN_NO_6;
+	I2C1Handle.pSDAPort = GPIOB;
+	I2C1Handle.SDAPin = GPIO_PIN_NO_7;
+
+}
+
+void I2C1_Inits(void)
+{
+	I2C1Handle.pI2Cx = I2C1;
+	I2C1Handle.I2C_Config.I2C_AckControl = I2C_ACK_ENABLE;
+	I2C1Handle.I2C_Config.I2C_DeviceAddress = MY_ADDR;
+	I2C1Handle.I2C_Config.I2C_FMDutyCycle = I2C_FM_DUTY_2;
+	I2C1Handle.I2C_Config.I2C_SCLSpeed = I2C_SCL_SPEED_SM;
+	I2C1Handle.I2C_Config.I2C_ArloRetries = 3;
+
+	if(I2C_Init(&I2C1Handle) != I2C_TIMING_OK)
+	{
+		//SCL speed not reachable from this PCLK1, nothing can run
+		while(1);
+	}
+
+}
+
+void trans_callback(I2C_Transaction_t *pTrans, uint8_t AppEv)
+{
+	if(AppEv == I2C_EV_TX_CMPLT || AppEv == I2C_EV_RX_CMPLT)
+	{
+		done_count++;
+	}else
+	{
+		//I2C_ERROR_ARLO here means the retries are used up
+		error_count++;
+	}
+	pending--;
+}
+
+void queue_round(void)
+{
+	led_value ^= 1;
+
+	LedTrans.Type = I2C_TRANS_MEM_WRITE;
+	LedTrans.SlaveAddr = SLAVE_ADDR;
+	LedTrans.MemAddr = REG_LED;
+	LedTrans.MemAddrSize = I2C_MEMADD_SIZE_8BIT;
+	LedTrans.pBuffer = &led_value;
+	LedTrans.Len = 1;
+	LedTrans.Callback = trans_callback;
+
+	UptimeTrans.Type = I2C_TRANS_MEM_READ;
+	UptimeTrans.SlaveAddr = SLAVE_ADDR;
+	UptimeTrans.MemAddr = REG_UPTIME;
+	UptimeTrans.MemAddrSize = I2C_MEMADD_SIZE_8BIT;
+	UptimeTrans.pBuffer = uptime_buf;
+	UptimeTrans.Len = sizeof(uptime_buf);
+	UptimeTrans.Callback = trans_callback;
+
+	pending = 2;
+	if(I2C_QueueTransaction(&I2C1Handle,&LedTrans) != I2C_READY)
+	{
+		pending--;
+	}
+	if(I2C_QueueTransaction(&I2C1Handle,&UptimeTrans) != I2C_READY)
+	{
+		pending--;
+	}
+}
+
+
+int main(void)
+{
+	uint32_t rounds = 0;
+
+	initialise_monitor_handles();
+
+	printf("Application is running\n");
+
+	//i2c pin inits
+	I2C1_GPIOInits();
+
+	//i2c peripheral configuration
+	I2C1_Inits();
+
+	//I2C IRQ configurations
+	I2C_IRQInterruptConfig(IRQ_NO_I2C1_EV,ENABLE);
+	I2C_IRQInterruptConfig(IRQ_NO_I2C1_ER,ENABLE);
+
+	//enable the i2c peripheral
+	I2C_PeripheralControl(I2C1,ENABLE);
+
+	//ack bit is made 1 after PE=1
+	I2C_ManageAcking(I2C1,I2C_ACK_ENABLE);
+
+	while(1)
+	{
+		//starts a retry after its backoff, recovers a stuck bus
+		I2C_TimeoutHandling(&I2C1Handle);
+
+		if(pending)
+			continue;
+
+		if((++rounds % 1000) == 0)
+		{
+			printf("done %lu  errors %lu  arlo %lu  retried %lu  lost %lu\n",done_count,error_count,
+					I2C1Handle.ArloCount,I2C1Handle.RetryCount,I2C1Handle.LostCount);
+		}
+
+		queue_round();
+	}
+
+}
+
+
+void I2C1_EV_IRQHandler (void)
+{
+	I2C_EV_IRQHandling(&I2C1Handle);
+}
+
+
+void I2C1_ER_IRQHandler (void)
+{
+	I2C_ER_IRQHandling(&I2C1Handle);
+}
+
+
+void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle,uint8_t AppEv)
+{
+	//the queued transactions report through their own callback
+	(void)pI2CHandle;
+	(void)AppEv;
+}
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""
+dlog.py - rebuilds the text of the deferred logger (bsp/dlog.h) from its binary stream
+
+The format strings are not on the target, they are read from the .dlog_fmt section of
+the ELF which produced the stream :
+    python3 dlog.py Debug/stm32f4xx_drivers.elf capture.bin --hclk 16000000
+capture.bin is the raw byte stream of the USART (e.g. from a serial terminal logging to
+a file), or with --itm a raw SWO capture of ITM stimulus port 0.
+Use - for stdin to decode a live stream, entries are printed as they complete :
+    stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 | python3 dlog.py fw.elf -
+
+Each entry is printed as
+    [   time(s)] text
+Entries lost on the target (ring full) show up as a gap in the sequence numbers. Bytes
+which do not decode (start of a capture, line noise) are skipped up to the next header.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xA
+MAX_ARGS = 6
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+CONV = re.compile(r"%([-+ #0]*)(\d+)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.raw = f.read()
+        if self.raw[:4] != b"\x7fELF" or self.raw[4] != 1 or self.raw[5] != 1:
+            sys.exit("%s : not a 32 bit little endian ELF" % path)
+
+        shoff, = struct.unpack_from("<I", self.raw, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.raw, 0x2E)
+        headers = [struct.unpack_from("<IIIIII", self.raw, shoff + i * shentsize) for i in range(shnum)]
+        strtab = headers[shstrndx][4]
+
+        self.sections = {}
+        self.alloc = []
+        for name, stype, flags, addr, offset, size in headers:
+            end = self.raw.index(b"\0", strtab + name)
+            sname = self.raw[strtab + name:end].decode()
+            self.sections[sname] = (addr, offset, size)
+            if stype == SHT_PROGBITS and flags & SHF_ALLOC:
+                self.alloc.append((addr, offset, size))
+
+        if ".dlog_fmt" not in self.sections:
+            sys.exit("%s : no .dlog_fmt section, was it linked with LinkerScript.ld ?" % path)
+
+    @staticmethod
+    def cstring(raw, pos, end):
+        stop = raw.find(b"\0", pos, end)
+        return raw[pos:stop if stop >= 0 else end].decode("latin-1")
+
+    def fmt(self, ident):
+        addr, offset, size = self.sections[".dlog_fmt"]
+        if not addr <= ident < addr + size:
+            return None
+        pos = offset + ident - addr
+        # an id points at the start of a string
+        if ident != addr and self.raw[pos - 1] != 0:
+            return None
+        return self.cstring(self.raw, pos, offset + size)
+
+    def string(self, address):
+        for addr, offset, size in self.alloc:
+            if addr <= address < addr + size:
+                return self.cstring(self.raw, offset + address - addr, offset + size)
+        return "<0x%08x>" % address
+
+
+def render(elf, fmt, args):
+    args = list(args)
+    out = []
+    pos = 0
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if not args:
+            out.append("<missing>")
+            continue
+        value = args.pop(0)
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        if conv in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            out.append((spec + "d") % value)
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xFF))
+        elif conv == "s":
+            out.append((spec + "s") % elf.string(value))
+        elif conv == "p":
+            out.append("0x%08x" % value)
+        else:
+            out.append((spec + ("d" if conv == "u" else conv)) % value)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def itm_payload(data):
+    """keeps the bytes of the 32 bit writes to stimulus port 0 of a raw ITM stream,
+    returns them with the number of bytes used : a packet cut by the end of data is left"""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        h = data[i]
+        size = {1: 1, 2: 2, 3: 4}.get(h & 0x3, 0)
+        if size:
+            if i + 1 + size > len(data):
+                break
+            # software source packet, port in bits 7:3
+            if not h & 0x4 and h >> 3 == 0 and size == 4:
+                out += data[i + 1:i + 5]
+            i += 1 + size
+        elif h & 0x80 and h & 0x0F == 0:
+            # time stamp packet with continuation bytes
+            j = i + 1
+            while j < len(data) and data[j] & 0x80:
+                j += 1
+            if j >= len(data):
+                break
+            i = j + 1
+        else:
+            i += 1
+    return bytes(out), i
+
+
+class Decoder:
+    """decodes the stream piece by piece, the state carries over from one feed to the next"""
+
+    def __init__(self, elf, hclk):
+        self.elf = elf
+        self.hclk = hclk
+        self.seq = None
+        self.now = None
+        self.skipped = 0
+
+    def feed(self, data):
+        """prints the entries complete in data, returns the number of bytes used"""
+        elf = self.elf
+        pos = 0
+
+        while pos + 8 <= len(data):
+            hdr, stamp = struct.unpack_from("<II", data, pos)
+            nargs = hdr & 0xF
+            fmt = elf.fmt(hdr >> 16) if (hdr >> 4) & 0xF == SYNC and nargs <= MAX_ARGS else None
+            if fmt is None:
+                # not a header, the stream may also be out of word alignment : slide by one byte
+                self.skipped += 1
+                pos += 1
+                continue
+
+            end = pos + 8 + 4 * nargs
+            if end > len(data):
+                break
+
+            if self.skipped:
+                print("... %u bytes skipped" % self.skipped)
+                self.skipped = 0
+
+            s = (hdr >> 8) & 0xFF
+            if self.seq is not None and s != (self.seq + 1) & 0xFF:
+                print("... %u entries dropped on the target" % ((s - self.seq - 1) & 0xFF))
+            self.seq = s
+
+            # DWT_CYCCNT wraps every 2^32 cycles, keep a 64 bit time line
+            self.now = stamp if self.now is None else self.now + ((stamp - self.now) & 0xFFFFFFFF)
+            args = struct.unpack_from("<%uI" % nargs, data, pos + 8)
+            print("[%12.6f] %s" % (self.now / self.hclk, render(elf, fmt, args)))
+            pos = end
+
+        return pos
+
+
+def main():
+    ap = argparse.ArgumentParser(description="decode the deferred logger stream")
+    ap.add_argument("elf", help="ELF file of the firmware which produced the stream")
+    ap.add_argument("capture", help="raw capture, - for stdin")
+    ap.add_argument("--itm", action="store_true", help="capture is a raw SWO/ITM stream")
+    ap.add_argument("--hclk", type=float, default=16e6, help="CPU clock in Hz (default 16MHz HSI)")
+    args = ap.parse_args()
+
+    decoder = Decoder(Elf(args.elf), args.hclk)
+    if args.capture == "-":
+        # a live stream : decode what has come, keep the tail which is not complete yet
+        raw = b""
+        pending = b""
+        while True:
+            chunk = os.read(sys.stdin.fileno(), 4096)
+            if not chunk:
+                break
+            raw += chunk
+            if args.itm:
+                payload, used = itm_payload(raw)
+                raw = raw[used:]
+            else:
+                payload, raw = raw, b""
+            pending += payload
+            pending = pending[decoder.feed(pending):]
+            sys.stdout.flush()
+    else:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+        if args.itm:
+            data = itm_payload(data)[0]
+        decoder.feed(data)
+
+
+if __name__ == "__main__":
+    main()
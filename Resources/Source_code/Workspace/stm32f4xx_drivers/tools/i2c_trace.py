@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+i2c_trace.py - decodes the event trace of the I2C driver (build with -DI2C_TRACE)
+
+Halt the target and dump the ring :
+    (gdb) dump binary value i2c_trace.bin I2C_Trace
+then
+    python3 i2c_trace.py i2c_trace.bin --hclk 16000000 --scl 100000
+
+One line per master transaction (START mark to STOP mark), one indented line per
+START of it (the first one and the repeated ones) :
+    START->SB    START request to the SB interrupt
+    SB->ADDR     address byte(s) on the bus, includes the ACK of the slave
+    data         TXE/RXNE/BTF interrupts after ADDR and their span
+    stretch      time the data interrupts lag behind the bus, i.e. SCL held low by the
+                 master : sum of (gap - 9 SCL periods) over consecutive data interrupts
+    ->STOP       last interrupt to the STOP request
+A summary with min/avg/max of each phase follows. Entries without a START mark
+(slave mode) are only counted.
+"""
+
+import argparse
+import struct
+import sys
+
+TAG_EV = 0x10
+TAG_ER = 0x20
+TAG_START = 0x30
+TAG_STOP = 0x40
+SR2_NONE = 0xFF
+
+SR1_SB = 1 << 0
+SR1_ADDR = 1 << 1
+SR1_BTF = 1 << 2
+SR1_RXNE = 1 << 6
+SR1_TXE = 1 << 7
+SR1_DATA = SR1_BTF | SR1_RXNE | SR1_TXE
+
+SR1_ERRORS = {8: "BERR", 9: "ARLO", 10: "AF", 11: "OVR", 12: "PECERR", 14: "TIMEOUT"}
+SR2_TRA = 1 << 2
+
+
+def load(path):
+    with open(path, "rb") as f:
+        raw = f.read()
+    head, depth = struct.unpack_from("<II", raw, 0)
+    if depth == 0 or len(raw) < 8 + 8 * depth:
+        sys.exit("%s : not an I2C_Trace dump (Depth %u, %u bytes)" % (path, depth, len(raw)))
+
+    count = min(head, depth)
+    entries = []
+    now = None
+    for k in range(head - count, head):
+        stamp, sr1, sr2, tag = struct.unpack_from("<IHBB", raw, 8 + 8 * (k % depth))
+        # DWT_CYCCNT wraps every 2^32 cycles, keep a 64 bit time line
+        now = stamp if now is None else now + ((stamp - now) & 0xFFFFFFFF)
+        entries.append((now, sr1, sr2, tag))
+    return head, depth, entries
+
+
+class Phase:
+    def __init__(self, start):
+        self.start = start
+        self.sb = None
+        self.addr = None
+        self.data = []
+        self.read = None
+
+
+class Transaction:
+    def __init__(self, bus, start):
+        self.bus = bus
+        self.phases = [Phase(start)]
+        self.errors = []
+        self.stop = None
+        self.last = start
+
+
+def build(entries):
+    done = []
+    open_txn = {}
+    orphans = 0
+
+    for t, sr1, sr2, tag in entries:
+        bus = tag & 0x0F
+        src = tag & 0xF0
+        txn = open_txn.get(bus)
+
+        if src == TAG_START:
+            if txn is None:
+                open_txn[bus] = Transaction(bus, t)
+            else:
+                txn.phases.append(Phase(t))
+            continue
+
+        if txn is None:
+            orphans += 1
+            continue
+
+        if src == TAG_STOP:
+            txn.stop = t
+            done.append(txn)
+            del open_txn[bus]
+            continue
+
+        phase = txn.phases[-1]
+        if src == TAG_ER:
+            txn.errors += [name for bit, name in SR1_ERRORS.items() if sr1 & (1 << bit)]
+        elif src == TAG_EV:
+            if sr1 & SR1_SB and phase.sb is None:
+                phase.sb = t
+            if sr1 & SR1_ADDR and phase.addr is None:
+                phase.addr = t
+            elif sr1 & SR1_DATA and phase.addr is not None:
+                phase.data.append(t)
+            if sr2 != SR2_NONE and phase.addr is not None and phase.read is None:
+                phase.read = not (sr2 & SR2_TRA)
+        txn.last = t
+
+    return done, list(open_txn.values()), orphans
+
+
+def main():
+    ap = argparse.ArgumentParser(description="decode an I2C_Trace dump")
+    ap.add_argument("dump", help="binary dump of I2C_Trace")
+    ap.add_argument("--hclk", type=float, default=16e6, help="CPU clock in Hz (default 16MHz HSI)")
+    ap.add_argument("--scl", type=float, default=100e3, help="SCL in Hz, for the stretch estimate")
+    args = ap.parse_args()
+
+    head, depth, entries = load(args.dump)
+    txns, pending, orphans = build(entries)
+    byte = 9 * args.hclk / args.scl
+    us = lambda cycles: cycles * 1e6 / args.hclk
+    fmt = lambda cycles: "%9.1fus" % us(cycles) if cycles is not None else "        -  "
+    stats = {}
+
+    def stat(name, cycles):
+        if cycles is not None:
+            stats.setdefault(name, []).append(cycles)
+        return fmt(cycles)
+
+    print("%u entries written, %u kept (depth %u)" % (head, len(entries), depth))
+    if head > depth:
+        print("ring wrapped, the oldest transaction may be partial")
+    t0 = entries[0][0] if entries else 0
+
+    for n, txn in enumerate(txns + pending):
+        end = txn.stop if txn.stop is not None else txn.last
+        status = " ".join(txn.errors) if txn.errors else ("ok" if txn.stop is not None else "no STOP")
+        print("#%-4u I2C%u  t=%10.1fus  total %s  %s" %
+              (n, txn.bus, us(txn.phases[0].start - t0), stat("total", end - txn.phases[0].start), status))
+
+        for i, ph in enumerate(txn.phases):
+            kind = "?" if ph.read is None else ("R" if ph.read else "W")
+            sb = ph.sb - ph.start if ph.sb is not None else None
+            addr = ph.addr - ph.sb if ph.addr is not None and ph.sb is not None else None
+            span = ph.data[-1] - ph.addr if ph.data else None
+            stretch = None
+            if len(ph.data) > 1:
+                stretch = sum(max(0, b - a - byte) for a, b in zip(ph.data, ph.data[1:]))
+            print("      %s %s  START->SB %s  SB->ADDR %s  data %3u ev %s  stretch %s" %
+                  ("Sr" if i else "S ", kind, stat("START->SB", sb), stat("SB->ADDR", addr),
+                   len(ph.data), fmt(span), stat("stretch", stretch)))
+
+        if txn.stop is not None:
+            ph = txn.phases[-1]
+            last = ph.data[-1] if ph.data else (ph.addr or ph.sb or ph.start)
+            print("      ->STOP %s" % stat("->STOP", txn.stop - last))
+
+    if orphans:
+        print("%u entries outside a master transaction (slave mode, or START before the ring)" % orphans)
+
+    if stats:
+        print("\n%-10s %6s %11s %11s %11s" % ("phase", "n", "min", "avg", "max"))
+        for name in ("START->SB", "SB->ADDR", "stretch", "->STOP", "total"):
+            v = stats.get(name)
+            if v:
+                print("%-10s %6u %s %s %s" % (name, len(v), fmt(min(v)), fmt(sum(v) / len(v)), fmt(max(v))))
+
+
+if __name__ == "__main__":
+    main()